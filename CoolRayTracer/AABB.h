@@ -0,0 +1,84 @@
+#pragma once
+
+#include "vec3.h"
+#include "Ray.h"
+
+#include <cfloat>
+
+struct AABB
+{
+  vec3 vMin = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+  vec3 vMax = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+  void Grow(const vec3& _vPoint)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      vMin[i] = (_vPoint[i] < vMin[i]) ? _vPoint[i] : vMin[i];
+      vMax[i] = (_vPoint[i] > vMax[i]) ? _vPoint[i] : vMax[i];
+    }
+  }
+
+  void Grow(const AABB& _oBounds)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      vMin[i] = (_oBounds.vMin[i] < vMin[i]) ? _oBounds.vMin[i] : vMin[i];
+      vMax[i] = (_oBounds.vMax[i] > vMax[i]) ? _oBounds.vMax[i] : vMax[i];
+    }
+  }
+
+  bool IsEmpty() const
+  {
+    return vMin.x() > vMax.x() || vMin.y() > vMax.y() || vMin.z() > vMax.z();
+  }
+
+  vec3 Center() const
+  {
+    return 0.5f * (vMin + vMax);
+  }
+
+  vec3 Extent() const
+  {
+    return vMax - vMin;
+  }
+
+  int LargestAxis() const
+  {
+    vec3 vExtent = Extent();
+    if (vExtent.x() >= vExtent.y() && vExtent.x() >= vExtent.z()) return 0;
+    return (vExtent.y() >= vExtent.z()) ? 1 : 2;
+  }
+
+  float SurfaceArea() const
+  {
+    if (IsEmpty())
+      return 0.f;
+    vec3 vExtent = Extent();
+    return 2.0f * (vExtent.x() * vExtent.y() + vExtent.y() * vExtent.z() + vExtent.z() * vExtent.x());
+  }
+};
+
+// Slab test. Returns the entry distance in fTEntry_ when the ray overlaps the box within [0, _fTMax].
+inline bool HitAABB(const ray& _oRay, const vec3& _vInvDir, const AABB& _oBounds, float _fTMax, float& fTEntry_)
+{
+  float fTMin = 0.f;
+  float fTMax = _fTMax;
+  for (int i = 0; i < 3; i++)
+  {
+    float fT0 = (_oBounds.vMin[i] - _oRay.vOrigin[i]) * _vInvDir[i];
+    float fT1 = (_oBounds.vMax[i] - _oRay.vOrigin[i]) * _vInvDir[i];
+    if (fT0 > fT1)
+    {
+      float fTmp = fT0;
+      fT0 = fT1;
+      fT1 = fTmp;
+    }
+    fTMin = fT0 > fTMin ? fT0 : fTMin;
+    fTMax = fT1 < fTMax ? fT1 : fTMax;
+    if (fTMin > fTMax)
+      return false;
+  }
+  fTEntry_ = fTMin;
+  return true;
+}
@@ -0,0 +1,672 @@
+#include "BVH.h"
+
+#include "Parallel.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cfloat>
+#include <functional>
+#include <future>
+
+// Ranges bigger than this are binned and partitioned by several threads
+static constexpr uint32_t uPARALLEL_RANGE_THRESHOLD = 1u << 16;
+
+// Ranges bigger than this spawn their left subtree as a separate task
+static constexpr uint32_t uSUBTREE_TASK_THRESHOLD = 1u << 12;
+
+// Past this depth SAH splits are replaced by median splits, which bounds the traversal stack
+static constexpr int iMAX_SAH_DEPTH = 64;
+
+static constexpr int iMAX_BIN_COUNT = 64;
+
+static constexpr int iTRAVERSAL_STACK_SIZE = 128;
+
+struct BVHBin
+{
+  AABB oBounds;
+  uint32_t uCount = 0;
+};
+
+struct BVHSplit
+{
+  int iAxis = -1;
+  int iBin = 0;
+  float fCost = FLT_MAX;
+};
+
+struct BVHRangeBounds
+{
+  AABB oBounds;
+  AABB oCentroidBounds;
+};
+
+struct BVHBuildContext
+{
+  const BVHBuildSettings* pSettings;
+  std::vector<AABB> vPrimBounds;      // Indexed by hittable
+  std::vector<vec3> vPrimCentroids;   // Indexed by hittable
+  std::vector<uint32_t> vMortonCodes; // LBVH only, parallel to pPrimIndices
+  std::vector<uint32_t> vScratch;     // Parallel partition target, parallel to pPrimIndices
+  uint32_t* pPrimIndices;
+  BVHNode* pNodes;
+  std::atomic<uint32_t> uNodeCount;
+  int iThreadCount;
+  int iTaskDepth;
+  int iBinCount;
+  int iMaxLeafSize;
+};
+
+static BVHRangeBounds ComputeRangeBounds(const BVHBuildContext& _oCtx, uint32_t _uBegin, uint32_t _uEnd)
+{
+  auto fnAccumulate = [&_oCtx](uint32_t uBegin, uint32_t uEnd, BVHRangeBounds& oBounds_)
+  {
+    for (uint32_t i = uBegin; i < uEnd; i++)
+    {
+      uint32_t uPrim = _oCtx.pPrimIndices[i];
+      oBounds_.oBounds.Grow(_oCtx.vPrimBounds[uPrim]);
+      oBounds_.oCentroidBounds.Grow(_oCtx.vPrimCentroids[uPrim]);
+    }
+  };
+
+  BVHRangeBounds oResult = {};
+  uint32_t uCount = _uEnd - _uBegin;
+
+  if (uCount < uPARALLEL_RANGE_THRESHOLD || _oCtx.iThreadCount <= 1)
+  {
+    fnAccumulate(_uBegin, _uEnd, oResult);
+    return oResult;
+  }
+
+  std::vector<BVHRangeBounds> vChunkBounds(_oCtx.iThreadCount);
+  int iChunkCount = ParallelForChunks(static_cast<int>(uCount), _oCtx.iThreadCount,
+    [&](int iBegin, int iEnd, int iChunk)
+    {
+      fnAccumulate(_uBegin + iBegin, _uBegin + iEnd, vChunkBounds[iChunk]);
+    });
+
+  for (int i = 0; i < iChunkCount; i++)
+  {
+    oResult.oBounds.Grow(vChunkBounds[i].oBounds);
+    oResult.oCentroidBounds.Grow(vChunkBounds[i].oCentroidBounds);
+  }
+  return oResult;
+}
+
+static int GetBinIndex(const vec3& _vCentroid, const AABB& _oCentroidBounds, int _iAxis, int _iBinCount)
+{
+  float fExtent = _oCentroidBounds.vMax[_iAxis] - _oCentroidBounds.vMin[_iAxis];
+  int iBin = static_cast<int>((_vCentroid[_iAxis] - _oCentroidBounds.vMin[_iAxis]) * (_iBinCount / fExtent));
+  return std::clamp(iBin, 0, _iBinCount - 1);
+}
+
+static void BinRange(const BVHBuildContext& _oCtx, uint32_t _uBegin, uint32_t _uEnd, const AABB& _oCentroidBounds, BVHBin* pBins_)
+{
+  const int iBinCount = _oCtx.iBinCount;
+  for (uint32_t i = _uBegin; i < _uEnd; i++)
+  {
+    uint32_t uPrim = _oCtx.pPrimIndices[i];
+    for (int iAxis = 0; iAxis < 3; iAxis++)
+    {
+      if (_oCentroidBounds.vMax[iAxis] <= _oCentroidBounds.vMin[iAxis])
+        continue;
+      BVHBin& oBin = pBins_[iAxis * iBinCount + GetBinIndex(_oCtx.vPrimCentroids[uPrim], _oCentroidBounds, iAxis, iBinCount)];
+      oBin.oBounds.Grow(_oCtx.vPrimBounds[uPrim]);
+      oBin.uCount++;
+    }
+  }
+}
+
+static BVHSplit FindBestSplit(const BVHBuildContext& _oCtx, uint32_t _uBegin, uint32_t _uEnd, const BVHRangeBounds& _oRangeBounds)
+{
+  const int iBinCount = _oCtx.iBinCount;
+  const uint32_t uCount = _uEnd - _uBegin;
+
+  BVHBin aBins[3 * iMAX_BIN_COUNT];
+
+  if (uCount < uPARALLEL_RANGE_THRESHOLD || _oCtx.iThreadCount <= 1)
+  {
+    BinRange(_oCtx, _uBegin, _uEnd, _oRangeBounds.oCentroidBounds, aBins);
+  }
+  else
+  {
+    std::vector<BVHBin> vChunkBins(static_cast<size_t>(_oCtx.iThreadCount) * 3 * iBinCount);
+    int iChunkCount = ParallelForChunks(static_cast<int>(uCount), _oCtx.iThreadCount,
+      [&](int iBegin, int iEnd, int iChunk)
+      {
+        BinRange(_oCtx, _uBegin + iBegin, _uBegin + iEnd, _oRangeBounds.oCentroidBounds, vChunkBins.data() + iChunk * 3 * iBinCount);
+      });
+
+    for (int iChunk = 0; iChunk < iChunkCount; iChunk++)
+    {
+      for (int i = 0; i < 3 * iBinCount; i++)
+      {
+        const BVHBin& oChunkBin = vChunkBins[iChunk * 3 * iBinCount + i];
+        aBins[i].oBounds.Grow(oChunkBin.oBounds);
+        aBins[i].uCount += oChunkBin.uCount;
+      }
+    }
+  }
+
+  BVHSplit oBest = {};
+  float fParentArea = _oRangeBounds.oBounds.SurfaceArea();
+  if (fParentArea <= 0.f)
+    return oBest;
+
+  const BVHBuildSettings& oSettings = *_oCtx.pSettings;
+
+  for (int iAxis = 0; iAxis < 3; iAxis++)
+  {
+    if (_oRangeBounds.oCentroidBounds.vMax[iAxis] <= _oRangeBounds.oCentroidBounds.vMin[iAxis])
+      continue;
+
+    const BVHBin* pAxisBins = aBins + iAxis * iBinCount;
+
+    float aRightArea[iMAX_BIN_COUNT];
+    uint32_t aRightCount[iMAX_BIN_COUNT];
+
+    AABB oRightBounds = {};
+    uint32_t uRightCount = 0;
+    for (int i = iBinCount - 1; i > 0; i--)
+    {
+      oRightBounds.Grow(pAxisBins[i].oBounds);
+      uRightCount += pAxisBins[i].uCount;
+      aRightArea[i] = oRightBounds.SurfaceArea();
+      aRightCount[i] = uRightCount;
+    }
+
+    AABB oLeftBounds = {};
+    uint32_t uLeftCount = 0;
+    for (int i = 0; i < iBinCount - 1; i++)
+    {
+      oLeftBounds.Grow(pAxisBins[i].oBounds);
+      uLeftCount += pAxisBins[i].uCount;
+
+      if (uLeftCount == 0 || aRightCount[i + 1] == 0)
+        continue;
+
+      float fCost = oSettings.fTraversalCost + oSettings.fIntersectionCost *
+        (oLeftBounds.SurfaceArea() * uLeftCount + aRightArea[i + 1] * aRightCount[i + 1]) / fParentArea;
+
+      if (fCost < oBest.fCost)
+      {
+        oBest.iAxis = iAxis;
+        oBest.iBin = i;
+        oBest.fCost = fCost;
+      }
+    }
+  }
+
+  return oBest;
+}
+
+// Stable two pass partition: every chunk counts its left side, then scatters into the scratch buffer.
+static uint32_t ParallelPartition(BVHBuildContext& oCtx_, uint32_t _uBegin, uint32_t _uEnd, const AABB& _oCentroidBounds, const BVHSplit& _oSplit)
+{
+  const int iCount = static_cast<int>(_uEnd - _uBegin);
+  const int iBinCount = oCtx_.iBinCount;
+
+  auto fnIsLeft = [&](uint32_t uPrim)
+  {
+    return GetBinIndex(oCtx_.vPrimCentroids[uPrim], _oCentroidBounds, _oSplit.iAxis, iBinCount) <= _oSplit.iBin;
+  };
+
+  std::vector<uint32_t> vLeftCounts(oCtx_.iThreadCount, 0u);
+  int iChunkCount = ParallelForChunks(iCount, oCtx_.iThreadCount,
+    [&](int iBegin, int iEnd, int iChunk)
+    {
+      uint32_t uLeft = 0;
+      for (int i = iBegin; i < iEnd; i++)
+      {
+        uLeft += fnIsLeft(oCtx_.pPrimIndices[_uBegin + i]) ? 1u : 0u;
+      }
+      vLeftCounts[iChunk] = uLeft;
+    });
+
+  uint32_t uTotalLeft = 0;
+  std::vector<uint32_t> vLeftOffsets(iChunkCount);
+  for (int i = 0; i < iChunkCount; i++)
+  {
+    vLeftOffsets[i] = uTotalLeft;
+    uTotalLeft += vLeftCounts[i];
+  }
+
+  ParallelForChunks(iCount, oCtx_.iThreadCount,
+    [&](int iBegin, int iEnd, int iChunk)
+    {
+      uint32_t uLeft = _uBegin + vLeftOffsets[iChunk];
+      uint32_t uRight = _uBegin + uTotalLeft + (static_cast<uint32_t>(iBegin) - vLeftOffsets[iChunk]);
+      for (int i = iBegin; i < iEnd; i++)
+      {
+        uint32_t uPrim = oCtx_.pPrimIndices[_uBegin + i];
+        oCtx_.vScratch[fnIsLeft(uPrim) ? uLeft++ : uRight++] = uPrim;
+      }
+    });
+
+  ParallelForChunks(iCount, oCtx_.iThreadCount,
+    [&](int iBegin, int iEnd, int)
+    {
+      std::copy(oCtx_.vScratch.begin() + _uBegin + iBegin, oCtx_.vScratch.begin() + _uBegin + iEnd, oCtx_.pPrimIndices + _uBegin + iBegin);
+    });
+
+  return _uBegin + uTotalLeft;
+}
+
+static uint32_t MedianSplit(BVHBuildContext& oCtx_, uint32_t _uBegin, uint32_t _uEnd, const AABB& _oCentroidBounds)
+{
+  uint32_t uMid = _uBegin + (_uEnd - _uBegin) / 2;
+  int iAxis = _oCentroidBounds.LargestAxis();
+  if (_oCentroidBounds.vMax[iAxis] > _oCentroidBounds.vMin[iAxis])
+  {
+    std::nth_element(oCtx_.pPrimIndices + _uBegin, oCtx_.pPrimIndices + uMid, oCtx_.pPrimIndices + _uEnd,
+      [&](uint32_t a, uint32_t b) { return oCtx_.vPrimCentroids[a][iAxis] < oCtx_.vPrimCentroids[b][iAxis]; });
+  }
+  return uMid;
+}
+
+static void BuildChildren(const BVHBuildContext& _oCtx, uint32_t _uCount, int _iDepth, const std::function<void()>& _fnBuildLeft, const std::function<void()>& _fnBuildRight)
+{
+  if (_iDepth < _oCtx.iTaskDepth && _uCount >= uSUBTREE_TASK_THRESHOLD)
+  {
+    std::future<void> oLeftTask = std::async(std::launch::async, _fnBuildLeft);
+    _fnBuildRight();
+    oLeftTask.get();
+  }
+  else
+  {
+    _fnBuildLeft();
+    _fnBuildRight();
+  }
+}
+
+static void BuildSAHRecursive(BVHBuildContext& oCtx_, uint32_t _uNodeIdx, uint32_t _uBegin, uint32_t _uEnd, int _iDepth)
+{
+  const BVHBuildSettings& oSettings = *oCtx_.pSettings;
+  const uint32_t uCount = _uEnd - _uBegin;
+
+  BVHRangeBounds oRangeBounds = ComputeRangeBounds(oCtx_, _uBegin, _uEnd);
+
+  BVHNode& oNode = oCtx_.pNodes[_uNodeIdx];
+  oNode.oBounds = oRangeBounds.oBounds;
+
+  if (uCount <= 1u)
+  {
+    oNode.uFirst = _uBegin;
+    oNode.uCount = uCount;
+    return;
+  }
+
+  BVHSplit oSplit = (_iDepth < iMAX_SAH_DEPTH) ? FindBestSplit(oCtx_, _uBegin, _uEnd, oRangeBounds) : BVHSplit{};
+
+  float fLeafCost = oSettings.fIntersectionCost * uCount;
+  if (uCount <= static_cast<uint32_t>(oCtx_.iMaxLeafSize) && (oSplit.iAxis < 0 || fLeafCost <= oSplit.fCost))
+  {
+    oNode.uFirst = _uBegin;
+    oNode.uCount = uCount;
+    return;
+  }
+
+  uint32_t uMid;
+  if (oSplit.iAxis < 0)
+  {
+    uMid = MedianSplit(oCtx_, _uBegin, _uEnd, oRangeBounds.oCentroidBounds);
+  }
+  else if (uCount >= uPARALLEL_RANGE_THRESHOLD && oCtx_.iThreadCount > 1)
+  {
+    uMid = ParallelPartition(oCtx_, _uBegin, _uEnd, oRangeBounds.oCentroidBounds, oSplit);
+  }
+  else
+  {
+    const AABB& oCentroidBounds = oRangeBounds.oCentroidBounds;
+    uint32_t* pMid = std::partition(oCtx_.pPrimIndices + _uBegin, oCtx_.pPrimIndices + _uEnd,
+      [&](uint32_t uPrim)
+      {
+        return GetBinIndex(oCtx_.vPrimCentroids[uPrim], oCentroidBounds, oSplit.iAxis, oCtx_.iBinCount) <= oSplit.iBin;
+      });
+    uMid = static_cast<uint32_t>(pMid - oCtx_.pPrimIndices);
+  }
+
+  uint32_t uLeftIdx = oCtx_.uNodeCount.fetch_add(2u);
+  oNode.uFirst = uLeftIdx;
+  oNode.uCount = 0;
+
+  std::function<void()> fnBuildLeft = [&oCtx_, uLeftIdx, _uBegin, uMid, _iDepth]() { BuildSAHRecursive(oCtx_, uLeftIdx, _uBegin, uMid, _iDepth + 1); };
+  std::function<void()> fnBuildRight = [&oCtx_, uLeftIdx, uMid, _uEnd, _iDepth]() { BuildSAHRecursive(oCtx_, uLeftIdx + 1, uMid, _uEnd, _iDepth + 1); };
+  BuildChildren(oCtx_, uCount, _iDepth, fnBuildLeft, fnBuildRight);
+}
+
+// Spreads the lower 10 bits of _uValue so that there are two zero bits between each of them
+static uint32_t ExpandBits(uint32_t _uValue)
+{
+  _uValue = (_uValue * 0x00010001u) & 0xFF0000FFu;
+  _uValue = (_uValue * 0x00000101u) & 0x0F00F00Fu;
+  _uValue = (_uValue * 0x00000011u) & 0xC30C30C3u;
+  _uValue = (_uValue * 0x00000005u) & 0x49249249u;
+  return _uValue;
+}
+
+static uint32_t MortonCode(const vec3& _vCentroid, const AABB& _oCentroidBounds)
+{
+  uint32_t aQuantized[3];
+  for (int i = 0; i < 3; i++)
+  {
+    float fExtent = _oCentroidBounds.vMax[i] - _oCentroidBounds.vMin[i];
+    float fNormalized = fExtent > 0.f ? (_vCentroid[i] - _oCentroidBounds.vMin[i]) / fExtent : 0.f;
+    aQuantized[i] = static_cast<uint32_t>(std::clamp(fNormalized * 1024.f, 0.f, 1023.f));
+  }
+  return (ExpandBits(aQuantized[0]) << 2) | (ExpandBits(aQuantized[1]) << 1) | ExpandBits(aQuantized[2]);
+}
+
+static void SortByMortonCode(BVHBuildContext& oCtx_, uint32_t _uPrimCount, const AABB& _oCentroidBounds)
+{
+  // Key is the code in the high bits and the hittable index in the low bits, so sorting is deterministic
+  std::vector<uint64_t> vKeys(_uPrimCount);
+
+  int iChunkCount = ParallelForChunks(static_cast<int>(_uPrimCount), oCtx_.iThreadCount,
+    [&](int iBegin, int iEnd, int)
+    {
+      for (int i = iBegin; i < iEnd; i++)
+      {
+        uint32_t uPrim = oCtx_.pPrimIndices[i];
+        vKeys[i] = (static_cast<uint64_t>(MortonCode(oCtx_.vPrimCentroids[uPrim], _oCentroidBounds)) << 32) | uPrim;
+      }
+      std::sort(vKeys.begin() + iBegin, vKeys.begin() + iEnd);
+    });
+
+  // Merge the sorted chunks pairwise, each round in parallel
+  std::vector<size_t> vBoundaries;
+  for (int i = 0; i <= iChunkCount; i++)
+  {
+    vBoundaries.push_back(static_cast<size_t>((static_cast<unsigned long long>(_uPrimCount) * i) / iChunkCount));
+  }
+
+  while (vBoundaries.size() > 2)
+  {
+    int iMergeCount = static_cast<int>((vBoundaries.size() - 1) / 2);
+    ParallelForChunks(iMergeCount, iMergeCount,
+      [&](int iBegin, int iEnd, int)
+      {
+        for (int i = iBegin; i < iEnd; i++)
+        {
+          std::inplace_merge(vKeys.begin() + vBoundaries[2 * i], vKeys.begin() + vBoundaries[2 * i + 1], vKeys.begin() + vBoundaries[2 * i + 2]);
+        }
+      });
+
+    std::vector<size_t> vMerged;
+    for (size_t i = 0; i < vBoundaries.size(); i += 2)
+    {
+      vMerged.push_back(vBoundaries[i]);
+    }
+    if (vMerged.back() != vBoundaries.back())
+    {
+      vMerged.push_back(vBoundaries.back());
+    }
+    vBoundaries.swap(vMerged);
+  }
+
+  oCtx_.vMortonCodes.resize(_uPrimCount);
+  for (uint32_t i = 0; i < _uPrimCount; i++)
+  {
+    oCtx_.pPrimIndices[i] = static_cast<uint32_t>(vKeys[i] & 0xFFFFFFFFu);
+    oCtx_.vMortonCodes[i] = static_cast<uint32_t>(vKeys[i] >> 32);
+  }
+}
+
+// Returns the first index of the right child: the first code whose highest differing bit is set.
+static uint32_t FindMortonSplit(const uint32_t* _pCodes, uint32_t _uBegin, uint32_t _uEnd)
+{
+  uint32_t uFirstCode = _pCodes[_uBegin];
+  uint32_t uLastCode = _pCodes[_uEnd - 1];
+
+  if (uFirstCode == uLastCode)
+    return _uBegin + (_uEnd - _uBegin) / 2;
+
+  int iCommonPrefix = std::countl_zero(uFirstCode ^ uLastCode);
+
+  uint32_t uSplit = _uBegin;
+  uint32_t uStep = _uEnd - 1 - _uBegin;
+  do
+  {
+    uStep = (uStep + 1) >> 1;
+    uint32_t uNewSplit = uSplit + uStep;
+    if (uNewSplit < _uEnd - 1 && std::countl_zero(uFirstCode ^ _pCodes[uNewSplit]) > iCommonPrefix)
+    {
+      uSplit = uNewSplit;
+    }
+  } while (uStep > 1);
+
+  return uSplit + 1;
+}
+
+static void BuildLBVHRecursive(BVHBuildContext& oCtx_, uint32_t _uNodeIdx, uint32_t _uBegin, uint32_t _uEnd, int _iDepth)
+{
+  const uint32_t uCount = _uEnd - _uBegin;
+  BVHNode& oNode = oCtx_.pNodes[_uNodeIdx];
+
+  if (uCount <= static_cast<uint32_t>(oCtx_.iMaxLeafSize))
+  {
+    oNode.oBounds = {};
+    for (uint32_t i = _uBegin; i < _uEnd; i++)
+    {
+      oNode.oBounds.Grow(oCtx_.vPrimBounds[oCtx_.pPrimIndices[i]]);
+    }
+    oNode.uFirst = _uBegin;
+    oNode.uCount = uCount;
+    return;
+  }
+
+  uint32_t uMid = FindMortonSplit(oCtx_.vMortonCodes.data(), _uBegin, _uEnd);
+
+  uint32_t uLeftIdx = oCtx_.uNodeCount.fetch_add(2u);
+  oNode.uFirst = uLeftIdx;
+  oNode.uCount = 0;
+
+  std::function<void()> fnBuildLeft = [&oCtx_, uLeftIdx, _uBegin, uMid, _iDepth]() { BuildLBVHRecursive(oCtx_, uLeftIdx, _uBegin, uMid, _iDepth + 1); };
+  std::function<void()> fnBuildRight = [&oCtx_, uLeftIdx, uMid, _uEnd, _iDepth]() { BuildLBVHRecursive(oCtx_, uLeftIdx + 1, uMid, _uEnd, _iDepth + 1); };
+  BuildChildren(oCtx_, uCount, _iDepth, fnBuildLeft, fnBuildRight);
+
+  // Bounds are refit bottom-up once both children are done
+  oNode.oBounds = oCtx_.pNodes[uLeftIdx].oBounds;
+  oNode.oBounds.Grow(oCtx_.pNodes[uLeftIdx + 1].oBounds);
+}
+
+float ComputeSAHCost(const BVH& _oBVH, float _fTraversalCost, float _fIntersectionCost)
+{
+  if (_oBVH.vNodes.empty())
+    return 0.f;
+
+  float fRootArea = _oBVH.vNodes[0].oBounds.SurfaceArea();
+  if (fRootArea <= 0.f)
+    return _fIntersectionCost * _oBVH.vPrimIndices.size();
+
+  double dCost = 0.0;
+  for (const BVHNode& oNode : _oBVH.vNodes)
+  {
+    float fRelativeArea = oNode.oBounds.SurfaceArea() / fRootArea;
+    dCost += oNode.IsLeaf()
+      ? static_cast<double>(fRelativeArea) * _fIntersectionCost * oNode.uCount
+      : static_cast<double>(fRelativeArea) * _fTraversalCost;
+  }
+  return static_cast<float>(dCost);
+}
+
+BVHBuildStats BuildBVH(const std::vector<Hittable>& _vHittables, const BVHBuildSettings& _oSettings, BVH& oBVH_)
+{
+  auto oStartTime = std::chrono::steady_clock::now();
+
+  BVHBuildContext oCtx;
+  oCtx.pSettings = &_oSettings;
+  oCtx.iThreadCount = _oSettings.iThreadCount > 0 ? _oSettings.iThreadCount : GetDefaultThreadCount();
+  oCtx.iBinCount = std::clamp(_oSettings.iBinCount, 2, iMAX_BIN_COUNT);
+  oCtx.iMaxLeafSize = std::clamp(_oSettings.iMaxLeafSize, 1, iMAX_BVH_LEAF_SIZE);
+  oCtx.iTaskDepth = 0;
+  while ((1 << oCtx.iTaskDepth) < oCtx.iThreadCount)
+  {
+    oCtx.iTaskDepth++;
+  }
+  // A couple of extra levels of tasks keep threads busy when the top splits are unbalanced
+  oCtx.iTaskDepth += (oCtx.iThreadCount > 1) ? 2 : 0;
+
+  oBVH_.vNodes.clear();
+  oBVH_.vPrimIndices.clear();
+  oBVH_.vUnbounded.clear();
+
+  const uint32_t uHittableCount = static_cast<uint32_t>(_vHittables.size());
+  oCtx.vPrimBounds.resize(uHittableCount);
+  oCtx.vPrimCentroids.resize(uHittableCount);
+
+  for (uint32_t i = 0; i < uHittableCount; i++)
+  {
+    if (GetHittableBounds(_vHittables[i], oCtx.vPrimBounds[i]))
+    {
+      oCtx.vPrimCentroids[i] = oCtx.vPrimBounds[i].Center();
+      oBVH_.vPrimIndices.push_back(i);
+    }
+    else
+    {
+      oBVH_.vUnbounded.push_back(i);
+    }
+  }
+
+  const uint32_t uPrimCount = static_cast<uint32_t>(oBVH_.vPrimIndices.size());
+
+  if (uPrimCount > 0)
+  {
+    oBVH_.vNodes.resize(2 * uPrimCount - 1);
+    oCtx.pNodes = oBVH_.vNodes.data();
+    oCtx.pPrimIndices = oBVH_.vPrimIndices.data();
+    oCtx.uNodeCount = 1;
+
+    if (_oSettings.eMode == BVHBuildMode_LBVH)
+    {
+      BVHRangeBounds oRangeBounds = ComputeRangeBounds(oCtx, 0, uPrimCount);
+      SortByMortonCode(oCtx, uPrimCount, oRangeBounds.oCentroidBounds);
+      BuildLBVHRecursive(oCtx, 0, 0, uPrimCount, 0);
+    }
+    else
+    {
+      oCtx.vScratch.resize(uPrimCount);
+      BuildSAHRecursive(oCtx, 0, 0, uPrimCount, 0);
+    }
+
+    oBVH_.vNodes.resize(oCtx.uNodeCount.load());
+    oBVH_.vNodes.shrink_to_fit();
+  }
+
+  auto oEndTime = std::chrono::steady_clock::now();
+
+  BVHBuildStats oStats = {};
+  oStats.dBuildTimeMs = std::chrono::duration<double, std::milli>(oEndTime - oStartTime).count();
+  oStats.fSAHCost = ComputeSAHCost(oBVH_, _oSettings.fTraversalCost, _oSettings.fIntersectionCost);
+  oStats.uPrimCount = uPrimCount;
+  oStats.uNodeCount = static_cast<uint32_t>(oBVH_.vNodes.size());
+
+  if (!oBVH_.vNodes.empty())
+  {
+    std::vector<std::pair<uint32_t, uint32_t>> vStack = { { 0u, 1u } };
+    while (!vStack.empty())
+    {
+      auto [uNodeIdx, uDepth] = vStack.back();
+      vStack.pop_back();
+
+      const BVHNode& oNode = oBVH_.vNodes[uNodeIdx];
+      oStats.uMaxDepth = std::max(oStats.uMaxDepth, uDepth);
+      if (oNode.IsLeaf())
+      {
+        oStats.uLeafCount++;
+      }
+      else
+      {
+        vStack.push_back({ oNode.uFirst, uDepth + 1 });
+        vStack.push_back({ oNode.uFirst + 1, uDepth + 1 });
+      }
+    }
+  }
+
+  return oStats;
+}
+
+int IntersectBVH(const BVH& _oBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_)
+{
+  int iHittableIdx = -1;
+  float fClosestT = FLT_MAX;
+
+  RenderCounters& oCounters = t_oRenderCounters;
+  oCounters.uRays++;
+
+  auto fnTestHittable = [&](uint32_t uIdx)
+  {
+    oCounters.uPrimTests++;
+    HitInfo oCandidateHitInfo = {};
+    if (HitHittable(_oRay, _vHittables[uIdx], oCandidateHitInfo) && oCandidateHitInfo.fT < fClosestT)
+    {
+      fClosestT = oCandidateHitInfo.fT;
+      oHitInfo_ = oCandidateHitInfo;
+      iHittableIdx = static_cast<int>(uIdx);
+    }
+  };
+
+  for (uint32_t uIdx : _oBVH.vUnbounded)
+  {
+    fnTestHittable(uIdx);
+  }
+
+  if (_oBVH.vNodes.empty())
+    return iHittableIdx;
+
+  vec3 vInvDir = vec3(1.0f / _oRay.vDir.x(), 1.0f / _oRay.vDir.y(), 1.0f / _oRay.vDir.z());
+
+  float fEntryT;
+  if (!HitAABB(_oRay, vInvDir, _oBVH.vNodes[0].oBounds, fClosestT, fEntryT))
+    return iHittableIdx;
+
+  uint32_t aStack[iTRAVERSAL_STACK_SIZE];
+  int iStackSize = 0;
+  uint32_t uNodeIdx = 0;
+
+  while (true)
+  {
+    const BVHNode& oNode = _oBVH.vNodes[uNodeIdx];
+    oCounters.uNodeVisits++;
+
+    if (oNode.IsLeaf())
+    {
+      for (uint32_t i = 0; i < oNode.uCount; i++)
+      {
+        fnTestHittable(_oBVH.vPrimIndices[oNode.uFirst + i]);
+      }
+    }
+    else
+    {
+      uint32_t uNear = oNode.uFirst;
+      uint32_t uFar = oNode.uFirst + 1;
+      float fNearT, fFarT;
+      bool bHitNear = HitAABB(_oRay, vInvDir, _oBVH.vNodes[uNear].oBounds, fClosestT, fNearT);
+      bool bHitFar = HitAABB(_oRay, vInvDir, _oBVH.vNodes[uFar].oBounds, fClosestT, fFarT);
+
+      if (bHitNear && bHitFar)
+      {
+        if (fFarT < fNearT)
+        {
+          std::swap(uNear, uFar);
+        }
+        aStack[iStackSize++] = uFar;
+        uNodeIdx = uNear;
+        continue;
+      }
+      else if (bHitNear || bHitFar)
+      {
+        uNodeIdx = bHitNear ? uNear : uFar;
+        continue;
+      }
+    }
+
+    if (iStackSize == 0)
+      break;
+    uNodeIdx = aStack[--iStackSize];
+  }
+
+  return iHittableIdx;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "AABB.h"
+#include "Hittable.h"
+
+#include <stdint.h>
+#include <vector>
+
+enum BVHBuildMode
+{
+  BVHBuildMode_BinnedSAH, // Best traversal quality, meant for final renders
+  BVHBuildMode_LBVH       // Morton ordered build, several times faster but lower quality, meant for interactive use
+};
+
+// Leaves hold at most this many hittables, the wide BVH stores their counts in 8 bits
+static constexpr int iMAX_BVH_LEAF_SIZE = 255;
+
+struct BVHBuildSettings
+{
+  BVHBuildMode eMode = BVHBuildMode_BinnedSAH;
+  int iBinCount = 16;
+  int iMaxLeafSize = 4; // Clamped to [1, iMAX_BVH_LEAF_SIZE]
+  int iThreadCount = 0; // 0 uses every hardware thread
+  float fTraversalCost = 1.0f;
+  float fIntersectionCost = 1.0f;
+};
+
+// Inner nodes store the index of their left child in uFirst, the right child is always uFirst + 1.
+// Leaves store a range of BVH::vPrimIndices in uFirst/uCount.
+struct BVHNode
+{
+  AABB oBounds;
+  uint32_t uFirst;
+  uint32_t uCount;
+
+  bool IsLeaf() const { return uCount > 0; }
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode is expected to be 32 bytes");
+
+struct BVH
+{
+  std::vector<BVHNode> vNodes;
+  std::vector<uint32_t> vPrimIndices;
+  std::vector<uint32_t> vUnbounded; // Hittables without finite bounds (planes), always tested
+};
+
+struct BVHBuildStats
+{
+  double dBuildTimeMs;
+  float fSAHCost;
+  uint32_t uPrimCount;
+  uint32_t uNodeCount;
+  uint32_t uLeafCount;
+  uint32_t uMaxDepth;
+};
+
+BVHBuildStats BuildBVH(const std::vector<Hittable>& _vHittables, const BVHBuildSettings& _oSettings, BVH& oBVH_);
+
+// SAH cost of the hierarchy relative to its root, the lower the better.
+float ComputeSAHCost(const BVH& _oBVH, float _fTraversalCost, float _fIntersectionCost);
+
+// Closest hit query. Returns the index of the hit hittable, or -1 if the ray escapes.
+int IntersectBVH(const BVH& _oBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_);
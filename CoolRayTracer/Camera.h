@@ -0,0 +1,79 @@
+#pragma once
+
+#include "vec3.h"
+#include "Ray.h"
+
+#include <math.h>
+
+// Looks down -Z with +Y up when yaw and pitch are 0. Angles are in radians.
+struct Camera
+{
+  vec3 vPosition = vec3(0.f, 0.f, 0.f);
+  float fYaw = 0.f;
+  float fPitch = 0.f;
+  float fVerticalFOV = 0.927295218f; // 2 * atan(0.5), a viewport of height 1 at focal length 1
+};
+
+// Camera basis and pixel grid for one resolution, shared by every ray of a frame
+struct CameraFrame
+{
+  vec3 vOrigin;
+  vec3 vStartPixel;
+  vec3 vPixelDeltaX;
+  vec3 vPixelDeltaY;
+  float fPixelSpread; // Angle covered by one pixel at the image center, starts the texture footprint cones
+};
+
+inline void GetCameraBasis(const Camera& _oCamera, vec3& vRight_, vec3& vUp_, vec3& vForward_)
+{
+  float fCosPitch = cosf(_oCamera.fPitch);
+  vForward_ = vec3(-sinf(_oCamera.fYaw) * fCosPitch, sinf(_oCamera.fPitch), -cosf(_oCamera.fYaw) * fCosPitch);
+  vRight_ = vec3(cosf(_oCamera.fYaw), 0.f, -sinf(_oCamera.fYaw));
+  vUp_ = Cross(vRight_, vForward_);
+}
+
+inline CameraFrame ComputeCameraFrame(const Camera& _oCamera, int _iWidth, int _iHeight)
+{
+  vec3 vRight, vUp, vForward;
+  GetCameraBasis(_oCamera, vRight, vUp, vForward);
+
+  float fFocalLength = 1.0f;
+  float fViewportHeight = 2.0f * tanf(_oCamera.fVerticalFOV * 0.5f) * fFocalLength;
+  float fViewportWidth = fViewportHeight * (float(_iWidth) / _iHeight);
+
+  vec3 vViewportX = fViewportWidth * vRight;
+  vec3 vViewportY = -fViewportHeight * vUp;
+
+  CameraFrame oFrame = {};
+  oFrame.vOrigin = _oCamera.vPosition;
+  oFrame.vPixelDeltaX = vViewportX / float(_iWidth);
+  oFrame.vPixelDeltaY = vViewportY / float(_iHeight);
+  oFrame.fPixelSpread = fViewportHeight / (_iHeight * fFocalLength);
+
+  vec3 vViewportUpperLeft = _oCamera.vPosition - (vViewportX / 2) - (vViewportY / 2) + (fFocalLength * vForward);
+  oFrame.vStartPixel = vViewportUpperLeft + (oFrame.vPixelDeltaX / 2) + (oFrame.vPixelDeltaY / 2);
+  return oFrame;
+}
+
+// _fX and _fY are in pixels, integer values hit pixel centers
+inline ray GetCameraRay(const CameraFrame& _oFrame, float _fX, float _fY)
+{
+  vec3 vPixelCenter = _oFrame.vStartPixel + _fX * _oFrame.vPixelDeltaX + _fY * _oFrame.vPixelDeltaY;
+  return ray(_oFrame.vOrigin, Normalize(vPixelCenter - _oFrame.vOrigin));
+}
+
+// _vLocalDelta is expressed in camera space: x right, y up, z forward. Vertical movement ignores pitch.
+inline void MoveCamera(Camera& oCamera_, const vec3& _vLocalDelta)
+{
+  vec3 vRight = vec3(cosf(oCamera_.fYaw), 0.f, -sinf(oCamera_.fYaw));
+  vec3 vFlatForward = vec3(-sinf(oCamera_.fYaw), 0.f, -cosf(oCamera_.fYaw));
+  oCamera_.vPosition += _vLocalDelta.x() * vRight + _vLocalDelta.y() * vec3(0.f, 1.f, 0.f) + _vLocalDelta.z() * vFlatForward;
+}
+
+inline void RotateCamera(Camera& oCamera_, float _fDeltaYaw, float _fDeltaPitch)
+{
+  constexpr float fMAX_PITCH = 1.55f;
+  oCamera_.fYaw += _fDeltaYaw;
+  oCamera_.fPitch += _fDeltaPitch;
+  oCamera_.fPitch = oCamera_.fPitch > fMAX_PITCH ? fMAX_PITCH : (oCamera_.fPitch < -fMAX_PITCH ? -fMAX_PITCH : oCamera_.fPitch);
+}
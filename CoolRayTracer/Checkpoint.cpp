@@ -0,0 +1,276 @@
+#include "Checkpoint.h"
+
+#include "Sampler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static CheckpointHeader MakeCheckpointHeader(const CheckpointKey& _oKey)
+{
+  CheckpointHeader oHeader = {};
+  oHeader.uMagic = g_uCheckpointMagic;
+  oHeader.uVersion = g_uCheckpointVersion;
+  oHeader.uSamplerVersion = g_uSamplerVersion;
+  oHeader.iWidth = _oKey.iWidth;
+  oHeader.iHeight = _oKey.iHeight;
+  oHeader.iMaxBounces = _oKey.iMaxBounces;
+  oHeader.uSceneHash = _oKey.uSceneHash;
+  oHeader.aCameraPosition[0] = _oKey.oCamera.vPosition.x();
+  oHeader.aCameraPosition[1] = _oKey.oCamera.vPosition.y();
+  oHeader.aCameraPosition[2] = _oKey.oCamera.vPosition.z();
+  oHeader.fCameraYaw = _oKey.oCamera.fYaw;
+  oHeader.fCameraPitch = _oKey.oCamera.fPitch;
+  oHeader.fCameraVerticalFOV = _oKey.oCamera.fVerticalFOV;
+  oHeader.iGuideTrainingPasses = _oKey.iGuideTrainingPasses;
+  oHeader.fGuideCellSize = _oKey.fGuideCellSize;
+  oHeader.iLightPathsPerPass = _oKey.iLightPathsPerPass;
+  oHeader.iBufferFormat = _oKey.eBufferFormat;
+  return oHeader;
+}
+
+template <typename T>
+static bool WriteArray(FILE* _pFile, const std::vector<T>& _vValues)
+{
+  return _vValues.empty() || fwrite(_vValues.data(), sizeof(T), _vValues.size(), _pFile) == _vValues.size();
+}
+
+template <typename T>
+static bool ReadArray(FILE* _pFile, std::vector<T>& vValues_)
+{
+  return vValues_.empty() || fread(vValues_.data(), sizeof(T), vValues_.size(), _pFile) == vValues_.size();
+}
+
+// Only the array of the buffer's format is allocated, the others write and read nothing
+static bool WritePackedBuffer(FILE* _pFile, const PackedVec3Buffer& _oBuffer)
+{
+  return WriteArray(_pFile, _oBuffer.vFloat) && WriteArray(_pFile, _oBuffer.vHalf) && WriteArray(_pFile, _oBuffer.vRgbe);
+}
+
+static bool WritePackedBuffer(FILE* _pFile, const PackedFloatBuffer& _oBuffer)
+{
+  return WriteArray(_pFile, _oBuffer.vFloat) && WriteArray(_pFile, _oBuffer.vHalf);
+}
+
+static bool ReadPackedBuffer(FILE* _pFile, PackedVec3Buffer& oBuffer_)
+{
+  return ReadArray(_pFile, oBuffer_.vFloat) && ReadArray(_pFile, oBuffer_.vHalf) && ReadArray(_pFile, oBuffer_.vRgbe);
+}
+
+static bool ReadPackedBuffer(FILE* _pFile, PackedFloatBuffer& oBuffer_)
+{
+  return ReadArray(_pFile, oBuffer_.vFloat) && ReadArray(_pFile, oBuffer_.vHalf);
+}
+
+static bool FlushToDisk(FILE* _pFile)
+{
+  if (fflush(_pFile) != 0)
+    return false;
+#if defined(_WIN32)
+  return _commit(_fileno(_pFile)) == 0;
+#else
+  return fsync(fileno(_pFile)) == 0;
+#endif
+}
+
+static bool ReplaceCheckpointFile(const char* _sFrom, const char* _sTo)
+{
+#if defined(_WIN32)
+  return MoveFileExA(_sFrom, _sTo, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return rename(_sFrom, _sTo) == 0;
+#endif
+}
+
+bool SaveCheckpoint(const char* _sPath, const CheckpointKey& _oKey, const AccumulationBuffers& _oAccum, std::string& sError_)
+{
+  if (_oAccum.iWidth != _oKey.iWidth || _oAccum.iHeight != _oKey.iHeight || _oAccum.eFormat != _oKey.eBufferFormat)
+  {
+    sError_ = "buffers do not match the render size or format";
+    return false;
+  }
+
+  std::string sTempPath = std::string(_sPath) + ".tmp";
+  FILE* pFile = fopen(sTempPath.c_str(), "wb");
+  if (!pFile)
+  {
+    sError_ = "could not create " + sTempPath;
+    return false;
+  }
+
+  CheckpointHeader oHeader = MakeCheckpointHeader(_oKey);
+  bool bOk = fwrite(&oHeader, sizeof(oHeader), 1, pFile) == 1
+    && WritePackedBuffer(pFile, _oAccum.oColor)
+    && WritePackedBuffer(pFile, _oAccum.oAlbedo)
+    && WritePackedBuffer(pFile, _oAccum.oNormal)
+    && WritePackedBuffer(pFile, _oAccum.oDepth)
+    && WriteArray(pFile, _oAccum.vHitCount)
+    && WriteArray(pFile, _oAccum.vSampleCount)
+    && FlushToDisk(pFile);
+  bOk = fclose(pFile) == 0 && bOk;
+
+  if (!bOk)
+  {
+    remove(sTempPath.c_str());
+    sError_ = "could not write " + sTempPath;
+    return false;
+  }
+
+  if (!ReplaceCheckpointFile(sTempPath.c_str(), _sPath))
+  {
+    remove(sTempPath.c_str());
+    sError_ = "could not rename " + sTempPath;
+    return false;
+  }
+  return true;
+}
+
+bool LoadCheckpoint(const char* _sPath, const CheckpointKey& _oKey, AccumulationBuffers& oAccum_, std::string& sError_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+  {
+    sError_ = "could not open file";
+    return false;
+  }
+
+  CheckpointHeader oHeader = {};
+  CheckpointHeader oExpected = MakeCheckpointHeader(_oKey);
+  if (fread(&oHeader, sizeof(oHeader), 1, pFile) != 1 || oHeader.uMagic != g_uCheckpointMagic)
+  {
+    fclose(pFile);
+    sError_ = "not a checkpoint";
+    return false;
+  }
+  if (oHeader.uVersion != g_uCheckpointVersion || oHeader.uSamplerVersion != g_uSamplerVersion)
+  {
+    fclose(pFile);
+    sError_ = "written by another version of the renderer";
+    return false;
+  }
+  if (memcmp(&oHeader, &oExpected, sizeof(oHeader)) != 0)
+  {
+    fclose(pFile);
+    sError_ = "written for another scene, camera, image size or render settings";
+    return false;
+  }
+
+  ResizeAccumulationBuffers(oHeader.iWidth, oHeader.iHeight, _oKey.eBufferFormat, oAccum_);
+  bool bOk = ReadPackedBuffer(pFile, oAccum_.oColor)
+    && ReadPackedBuffer(pFile, oAccum_.oAlbedo)
+    && ReadPackedBuffer(pFile, oAccum_.oNormal)
+    && ReadPackedBuffer(pFile, oAccum_.oDepth)
+    && ReadArray(pFile, oAccum_.vHitCount)
+    && ReadArray(pFile, oAccum_.vSampleCount)
+    && fgetc(pFile) == EOF;
+  fclose(pFile);
+
+  if (!bOk)
+  {
+    sError_ = "truncated or oversized file";
+    return false;
+  }
+  return true;
+}
+
+static void CheckpointWriterThread(CheckpointWriter* pWriter)
+{
+  CheckpointWriter& oWriter = *pWriter;
+  AccumulationBuffers oWriting;
+
+  std::unique_lock<std::mutex> oLock(oWriter.oMutex);
+  while (true)
+  {
+    oWriter.oCondition.wait(oLock, [&oWriter]() { return oWriter.bStop || oWriter.bPending; });
+    if (!oWriter.bPending)
+      break;
+
+    // Swapped rather than copied, both sides keep their allocations for the next checkpoint
+    std::swap(oWriting, oWriter.oPending);
+    oWriter.bPending = false;
+    oLock.unlock();
+
+    std::string sError;
+    bool bOk = SaveCheckpoint(oWriter.sPath.c_str(), oWriter.oKey, oWriting, sError);
+
+    oLock.lock();
+    if (bOk)
+    {
+      oWriter.iWritten++;
+    }
+    else
+    {
+      oWriter.sError = sError;
+    }
+  }
+}
+
+void StartCheckpointWriter(const char* _sPath, const CheckpointKey& _oKey, CheckpointWriter& oWriter_)
+{
+  oWriter_.sPath = _sPath;
+  oWriter_.oKey = _oKey;
+  oWriter_.bPending = false;
+  oWriter_.bStop = false;
+  oWriter_.iWritten = 0;
+  oWriter_.sError.clear();
+  oWriter_.oThread = std::thread(CheckpointWriterThread, &oWriter_);
+}
+
+// Assigned element by element so the pending buffers keep their allocations
+static void CopyPackedBuffer(const PackedVec3Buffer& _oSource, PackedVec3Buffer& oCopy_)
+{
+  oCopy_.eFormat = _oSource.eFormat;
+  oCopy_.vFloat.assign(_oSource.vFloat.begin(), _oSource.vFloat.end());
+  oCopy_.vHalf.assign(_oSource.vHalf.begin(), _oSource.vHalf.end());
+  oCopy_.vRgbe.assign(_oSource.vRgbe.begin(), _oSource.vRgbe.end());
+}
+
+static void CopyPackedBuffer(const PackedFloatBuffer& _oSource, PackedFloatBuffer& oCopy_)
+{
+  oCopy_.eFormat = _oSource.eFormat;
+  oCopy_.vFloat.assign(_oSource.vFloat.begin(), _oSource.vFloat.end());
+  oCopy_.vHalf.assign(_oSource.vHalf.begin(), _oSource.vHalf.end());
+}
+
+void QueueCheckpoint(CheckpointWriter& oWriter_, const AccumulationBuffers& _oAccum)
+{
+  {
+    std::lock_guard<std::mutex> oLock(oWriter_.oMutex);
+    AccumulationBuffers& oPending = oWriter_.oPending;
+    oPending.iWidth = _oAccum.iWidth;
+    oPending.iHeight = _oAccum.iHeight;
+    oPending.eFormat = _oAccum.eFormat;
+    CopyPackedBuffer(_oAccum.oColor, oPending.oColor);
+    CopyPackedBuffer(_oAccum.oAlbedo, oPending.oAlbedo);
+    CopyPackedBuffer(_oAccum.oNormal, oPending.oNormal);
+    CopyPackedBuffer(_oAccum.oDepth, oPending.oDepth);
+    oPending.vHitCount.assign(_oAccum.vHitCount.begin(), _oAccum.vHitCount.end());
+    oPending.vSampleCount.assign(_oAccum.vSampleCount.begin(), _oAccum.vSampleCount.end());
+    oWriter_.bPending = true;
+  }
+  oWriter_.oCondition.notify_one();
+}
+
+bool StopCheckpointWriter(CheckpointWriter& oWriter_, std::string& sError_)
+{
+  {
+    std::lock_guard<std::mutex> oLock(oWriter_.oMutex);
+    oWriter_.bStop = true;
+  }
+  oWriter_.oCondition.notify_one();
+  if (oWriter_.oThread.joinable())
+  {
+    oWriter_.oThread.join();
+  }
+
+  sError_ = oWriter_.sError;
+  return oWriter_.sError.empty();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Camera.h"
+#include "RenderBuffers.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+static constexpr uint32_t g_uCheckpointMagic = 0x504b4843u; // "CHKP"
+static constexpr uint32_t g_uCheckpointVersion = 5;
+
+// Identifies a render, a checkpoint is only resumed by the render that wrote it
+struct CheckpointKey
+{
+  uint64_t uSceneHash = 0;
+  Camera oCamera;
+  int iWidth = 0;
+  int iHeight = 0;
+  int iMaxBounces = 0;
+  int iGuideTrainingPasses = 0;
+  float fGuideCellSize = 0.f;
+  int iLightPathsPerPass = 0;
+  BufferFormat eBufferFormat = BufferFormat_Float32;
+};
+
+// Header of a checkpoint file, followed by the arrays of AccumulationBuffers in declaration order, each in the
+// format it accumulates in
+struct CheckpointHeader
+{
+  uint32_t uMagic;
+  uint32_t uVersion;
+  uint32_t uSamplerVersion;
+  int32_t iWidth;
+  int32_t iHeight;
+  int32_t iMaxBounces;
+  uint64_t uSceneHash;
+  float aCameraPosition[3];
+  float fCameraYaw;
+  float fCameraPitch;
+  float fCameraVerticalFOV;
+  int32_t iGuideTrainingPasses;
+  float fGuideCellSize;
+  int32_t iLightPathsPerPass;
+  int32_t iBufferFormat;
+};
+
+// Writes _sPath with a .tmp suffix, flushes it to disk and renames it over _sPath, so a kill at any point leaves
+// either the previous checkpoint or the new one
+bool SaveCheckpoint(const char* _sPath, const CheckpointKey& _oKey, const AccumulationBuffers& _oAccum, std::string& sError_);
+
+// Fails if the file is missing, truncated or was written by another render
+bool LoadCheckpoint(const char* _sPath, const CheckpointKey& _oKey, AccumulationBuffers& oAccum_, std::string& sError_);
+
+// Saves checkpoints on its own thread. Queueing copies the means and returns right away, a checkpoint queued while
+// another one is being written replaces the one still waiting.
+struct CheckpointWriter
+{
+  std::string sPath;
+  CheckpointKey oKey;
+  std::thread oThread;
+  std::mutex oMutex;
+  std::condition_variable oCondition;
+  AccumulationBuffers oPending;
+  bool bPending = false;
+  bool bStop = false;
+  int iWritten = 0;
+  std::string sError; // Last failure, empty if every write succeeded
+};
+
+void StartCheckpointWriter(const char* _sPath, const CheckpointKey& _oKey, CheckpointWriter& oWriter_);
+
+void QueueCheckpoint(CheckpointWriter& oWriter_, const AccumulationBuffers& _oAccum);
+
+// Writes the checkpoint still waiting, then joins the thread. Returns false if any write failed.
+bool StopCheckpointWriter(CheckpointWriter& oWriter_, std::string& sError_);
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct GameScreenBuffer
@@ -13,14 +14,31 @@ struct GameInput
 {
   float XOffset = 0.f;
   float YOffset = 0.f;
+
+  // Camera controls in [-1, 1], scaled by fDeltaTime
+  float fMoveRight = 0.f;
+  float fMoveUp = 0.f;
+  float fMoveForward = 0.f;
+  float fTurnRight = 0.f;
+  float fTurnUp = 0.f;
+  float fDeltaTime = 0.f; // Seconds since the previous call
 };
 
 static constexpr size_t g_uBytesPerPixel = 4;
 
 void InitGame();
 
+void ResizeGameBuffers(int _iWidth, int _iHeight);
+
 void UpdateScreenBufferPartial(GameScreenBuffer* Buffer, int _iStartX, int _iStartY, int _iEndX, int _iEndY);
 
+// Called once every tile of the frame is done, to run full frame passes such as denoising.
+// Returns false if a camera change cancelled the frame, the buffer then holds the interactive preview.
+bool ResolveScreenBuffer(GameScreenBuffer* Buffer);
+
+// Applies the camera input, any camera change cancels the tiled frame and restarts the progressive preview
 void UpdateGameBackBuffer(GameScreenBuffer* Buffer, const GameInput& GameInput);
 
+void ShutdownGame();
+
 void UpdateGameSoundBuffer(uint32_t& uCurrSampleIdx, void* pRegion1, size_t uRegion1Size, void* pRegion2, size_t uRegion2Size, size_t uBytesPerSample);
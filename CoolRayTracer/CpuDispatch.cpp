@@ -0,0 +1,123 @@
+#include "CpuDispatch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if CPU_DISPATCH_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+CpuIsa g_eCpuIsa = GetBestCpuIsa();
+
+#if CPU_DISPATCH_X86
+
+static void ReadCpuid(uint32_t _uLeaf, uint32_t _uSubLeaf, uint32_t aRegs_[4])
+{
+#if defined(_MSC_VER)
+  int aInfo[4];
+  __cpuidex(aInfo, static_cast<int>(_uLeaf), static_cast<int>(_uSubLeaf));
+  for (int i = 0; i < 4; i++)
+  {
+    aRegs_[i] = static_cast<uint32_t>(aInfo[i]);
+  }
+#else
+  __cpuid_count(_uLeaf, _uSubLeaf, aRegs_[0], aRegs_[1], aRegs_[2], aRegs_[3]);
+#endif
+}
+
+// XCR0, the register state the OS saves on context switches
+static uint64_t ReadEnabledStates()
+{
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t uLow, uHigh;
+  __asm__("xgetbv" : "=a"(uLow), "=d"(uHigh) : "c"(0));
+  return (static_cast<uint64_t>(uHigh) << 32) | uLow;
+#endif
+}
+
+bool IsCpuIsaSupported(CpuIsa _eIsa)
+{
+  if (_eIsa == CpuIsa_SSE2)
+    return true;
+
+  uint32_t aRegs[4];
+  ReadCpuid(0, 0, aRegs);
+  if (aRegs[0] < 7)
+    return false;
+
+  ReadCpuid(1, 0, aRegs);
+  constexpr uint32_t uOSXSAVE = 1u << 27;
+  constexpr uint32_t uAVX = 1u << 28;
+  constexpr uint32_t uF16C = 1u << 29;
+  if ((aRegs[2] & (uOSXSAVE | uAVX | uF16C)) != (uOSXSAVE | uAVX | uF16C))
+    return false;
+
+  uint64_t uStates = ReadEnabledStates();
+  constexpr uint64_t uYMM_STATES = 0x6; // SSE and AVX
+  constexpr uint64_t uZMM_STATES = 0xe6; // Plus the opmask and both halves of the ZMM registers
+
+  ReadCpuid(7, 0, aRegs);
+  constexpr uint32_t uAVX2 = 1u << 5;
+  constexpr uint32_t uAVX512F = 1u << 16;
+  bool bAVX2 = (aRegs[1] & uAVX2) != 0 && (uStates & uYMM_STATES) == uYMM_STATES;
+
+  if (_eIsa == CpuIsa_AVX2)
+    return bAVX2;
+
+  return bAVX2 && (aRegs[1] & uAVX512F) != 0 && (uStates & uZMM_STATES) == uZMM_STATES;
+}
+
+#else
+
+bool IsCpuIsaSupported(CpuIsa _eIsa)
+{
+  return _eIsa == CpuIsa_SSE2;
+}
+
+#endif
+
+CpuIsa GetBestCpuIsa()
+{
+  for (int i = CpuIsa_Count - 1; i > CpuIsa_SSE2; i--)
+  {
+    if (IsCpuIsaSupported(static_cast<CpuIsa>(i)))
+      return static_cast<CpuIsa>(i);
+  }
+  return CpuIsa_SSE2;
+}
+
+bool SelectCpuIsa(CpuIsa _eIsa)
+{
+  if (_eIsa < CpuIsa_SSE2 || _eIsa >= CpuIsa_Count || !IsCpuIsaSupported(_eIsa))
+    return false;
+
+  g_eCpuIsa = _eIsa;
+  return true;
+}
+
+static const char* s_aCpuIsaNames[CpuIsa_Count] = { "sse2", "avx2", "avx512" };
+
+const char* GetCpuIsaName(CpuIsa _eIsa)
+{
+  return (_eIsa >= CpuIsa_SSE2 && _eIsa < CpuIsa_Count) ? s_aCpuIsaNames[_eIsa] : "unknown";
+}
+
+bool ParseCpuIsa(const char* _sName, CpuIsa& eIsa_)
+{
+  for (int i = 0; i < CpuIsa_Count; i++)
+  {
+    if (strcmp(_sName, s_aCpuIsaNames[i]) == 0)
+    {
+      eIsa_ = static_cast<CpuIsa>(i);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_DISPATCH_X86 1
+#else
+#define CPU_DISPATCH_X86 0
+#endif
+
+// Hot kernels are compiled once per instruction set in the same translation unit. With GCC and Clang the wider
+// variants carry a target attribute, and their entry points are flattened so every helper they call is compiled
+// for the same target. MSVC accepts the intrinsics in any function and needs neither. The AVX2 level also takes
+// F16C for the half float conversions, every CPU with AVX2 has it.
+#if CPU_DISPATCH_X86 && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx2,f16c,avx512f")))
+#define CPU_FLATTEN __attribute__((flatten))
+#else
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#define CPU_FLATTEN
+#endif
+
+// Kernels built for the wider sets evaluate the same operations per lane and the core library is compiled without
+// floating point contraction, so every path produces the same bits and only the speed changes
+enum CpuIsa
+{
+  CpuIsa_SSE2,
+  CpuIsa_AVX2,
+  CpuIsa_AVX512,
+  CpuIsa_Count
+};
+
+// Chosen from cpuid at startup. Kernels read it on every call, so it is only changed before rendering starts.
+extern CpuIsa g_eCpuIsa;
+
+// Checks both the CPU and that the OS saves the wider registers
+bool IsCpuIsaSupported(CpuIsa _eIsa);
+
+CpuIsa GetBestCpuIsa();
+
+// Overrides the automatic choice, for benchmarking. Fails if the CPU cannot run _eIsa.
+bool SelectCpuIsa(CpuIsa _eIsa);
+
+const char* GetCpuIsaName(CpuIsa _eIsa);
+
+// Accepts the names returned by GetCpuIsaName
+bool ParseCpuIsa(const char* _sName, CpuIsa& eIsa_);
@@ -0,0 +1,194 @@
+#include "DeadlineRender.h"
+
+#include "ProgressiveRender.h"
+
+using DeadlineClock = std::chrono::steady_clock;
+
+static double MillisecondsBetween(DeadlineClock::time_point _oStart, DeadlineClock::time_point _oEnd)
+{
+  return std::chrono::duration<double, std::milli>(_oEnd - _oStart).count();
+}
+
+// Visits the tiles in bit reversed order, so any prefix of a pass is spread over the whole curve
+static void BuildSpreadOrder(size_t _uCount, std::vector<uint32_t>& vOrder_)
+{
+  vOrder_.clear();
+
+  uint32_t uBits = 0;
+  while ((size_t(1) << uBits) < _uCount)
+  {
+    uBits++;
+  }
+
+  for (uint32_t i = 0; i < (1u << uBits); i++)
+  {
+    uint32_t uReversed = 0;
+    for (uint32_t uBit = 0; uBit < uBits; uBit++)
+    {
+      uReversed |= ((i >> uBit) & 1u) << (uBits - 1 - uBit);
+    }
+    if (uReversed < _uCount)
+    {
+      vOrder_.push_back(uReversed);
+    }
+  }
+}
+
+// Single thread cost of one camera sample, traced on a sparse grid without touching the accumulation buffers
+static double MeasureSampleCostNs(const Scene& _oScene, const CameraFrame& _oFrame, int _iMaxBounces, int _iWidth, int _iHeight)
+{
+  constexpr int iPILOT_STRIDE = 16;
+
+  DeadlineClock::time_point oStart = DeadlineClock::now();
+  int iSampleCount = 0;
+  for (int y = iPILOT_STRIDE / 2; y < _iHeight; y += iPILOT_STRIDE)
+  {
+    for (int x = iPILOT_STRIDE / 2; x < _iWidth; x += iPILOT_STRIDE)
+    {
+      PrimaryHit oPrimaryHit;
+      TracePath(_oScene, GetCameraRay(_oFrame, static_cast<float>(x), static_cast<float>(y)), _iMaxBounces, _oFrame.fPixelSpread, oPrimaryHit);
+      iSampleCount++;
+    }
+  }
+  FlushRenderCounters();
+
+  return iSampleCount > 0 ? MillisecondsBetween(oStart, DeadlineClock::now()) * 1e6 / iSampleCount : 0.0;
+}
+
+// Times the resolve and the denoiser on a small synthetic crop and scales them to the full frame. The resolve runs on
+// one thread, the denoiser on all of them.
+static double EstimateResolveMs(const DeadlineSettings& _oSettings, int _iWidth, int _iHeight, int _iThreadCount)
+{
+  constexpr int iCROP_SIZE = 64;
+
+  AccumulationBuffers oCropAccum;
+  ResizeAccumulationBuffers(iCROP_SIZE, iCROP_SIZE, _oSettings.eBufferFormat, oCropAccum);
+  RenderBuffers oCrop = {};
+  std::vector<color> vOutput;
+
+  DeadlineClock::time_point oStart = DeadlineClock::now();
+  ResolveAccumulationBuffers(oCropAccum, oCrop);
+  if (!_oSettings.bDenoise)
+  {
+    UnpackVec3Buffer(oCrop.oColor, vOutput);
+  }
+  double dResolveMs = MillisecondsBetween(oStart, DeadlineClock::now());
+
+  double dPixelRatio = (static_cast<double>(_iWidth) * _iHeight) / (iCROP_SIZE * iCROP_SIZE);
+  if (!_oSettings.bDenoise)
+    return dResolveMs * dPixelRatio;
+
+  for (size_t i = 0; i < static_cast<size_t>(iCROP_SIZE) * iCROP_SIZE; i++)
+  {
+    StoreVec3(oCrop.oColor, i, color(0.5f, 0.5f, 0.5f));
+    StoreVec3(oCrop.oAlbedo, i, color(0.5f, 0.5f, 0.5f));
+    StoreVec3(oCrop.oNormal, i, vec3(0.f, 1.f, 0.f));
+    StoreFloat(oCrop.oDepth, i, 1.f);
+  }
+
+  DenoiseSettings oCropSettings = _oSettings.oDenoiseSettings;
+  oCropSettings.iThreadCount = 1;
+
+  oStart = DeadlineClock::now();
+  DenoiseATrous(oCrop, oCropSettings, vOutput);
+  double dCropMs = MillisecondsBetween(oStart, DeadlineClock::now());
+
+  return (dResolveMs + dCropMs / _iThreadCount) * dPixelRatio;
+}
+
+DeadlineReport RenderWithDeadline(const Scene& _oScene, const Camera& _oCamera, int _iWidth, int _iHeight,
+  const DeadlineSettings& _oSettings, DeadlineClock::time_point _oDeadline,
+  AccumulationBuffers& oAccum_, RenderBuffers& oBuffers_, std::vector<color>& vResolved_)
+{
+  DeadlineClock::time_point oStart = DeadlineClock::now();
+  DeadlineReport oReport = {};
+
+  int iThreadCount = _oSettings.iThreadCount > 0 ? _oSettings.iThreadCount : GetDefaultThreadCount();
+
+  ResizeAccumulationBuffers(_iWidth, _iHeight, _oSettings.eBufferFormat, oAccum_);
+
+  CameraFrame oFrame = ComputeCameraFrame(_oCamera, _iWidth, _iHeight);
+
+  std::vector<ScreenTile> vTiles;
+  BuildTileList(_iWidth, _iHeight, _oSettings.oTileSettings, iThreadCount, vTiles);
+
+  std::vector<uint32_t> vTileOrder;
+  BuildSpreadOrder(vTiles.size(), vTileOrder);
+
+  oReport.dSampleCostNs = MeasureSampleCostNs(_oScene, oFrame, _oSettings.iMaxBounces, _iWidth, _iHeight);
+  oReport.dResolveEstimateMs = EstimateResolveMs(_oSettings, _iWidth, _iHeight, iThreadCount);
+
+  // Sampling has to stop early enough to leave room for the resolve
+  DeadlineClock::time_point oSampleDeadline = _oDeadline - std::chrono::duration_cast<DeadlineClock::duration>(
+    std::chrono::duration<double, std::milli>(oReport.dResolveEstimateMs * _oSettings.fSafetyMargin));
+
+  double dPassEstimateMs = oReport.dSampleCostNs * 1e-6 * _iWidth * _iHeight / iThreadCount;
+
+  for (int iPass = 0; iPass < _oSettings.iMaxSamplesPerPixel; iPass++)
+  {
+    DeadlineClock::time_point oPassStart = DeadlineClock::now();
+
+    double dTimeLeftMs = MillisecondsBetween(oPassStart, oSampleDeadline);
+    if (iPass > 0 && dPassEstimateMs * _oSettings.fSafetyMargin > dTimeLeftMs)
+      break;
+
+    // Only passes after the first can be cut, the image always gets at least one sample per pixel
+    bool bCanAbort = iPass > 0;
+    std::atomic<bool> bAborted = false;
+
+    RenderTilesInParallel(vTileOrder.size(), iThreadCount, [&](uint32_t uOrderIdx)
+      {
+        if (bCanAbort && DeadlineClock::now() >= oSampleDeadline)
+        {
+          bAborted = true;
+          return false;
+        }
+
+        const ScreenTile& oTile = vTiles[vTileOrder[uOrderIdx]];
+        ForEachPixel(oTile.iStartX, oTile.iStartY, oTile.iEndX, oTile.iEndY, _oSettings.oTileSettings.ePixelOrder, [&](int x, int y)
+          {
+            AccumulatePixelSample(_oScene, oFrame, x, y, _oSettings.iMaxBounces, oAccum_);
+          });
+        return true;
+      });
+
+    if (bAborted)
+      break;
+
+    // Later passes cost about the same as the last one, which beats the single thread pilot estimate
+    dPassEstimateMs = MillisecondsBetween(oPassStart, DeadlineClock::now());
+    oReport.iCompletedPasses++;
+  }
+
+  DeadlineClock::time_point oRenderEnd = DeadlineClock::now();
+  oReport.dRenderMs = MillisecondsBetween(oStart, oRenderEnd);
+
+  ResolveAccumulationBuffers(oAccum_, oBuffers_);
+  if (_oSettings.bDenoise)
+  {
+    DenoiseSettings oDenoiseSettings = _oSettings.oDenoiseSettings;
+    oDenoiseSettings.iThreadCount = iThreadCount;
+    DenoiseATrous(oBuffers_, oDenoiseSettings, vResolved_);
+  }
+  else
+  {
+    UnpackVec3Buffer(oBuffers_.oColor, vResolved_);
+  }
+
+  DeadlineClock::time_point oEnd = DeadlineClock::now();
+  oReport.dResolveMs = MillisecondsBetween(oRenderEnd, oEnd);
+  oReport.dTotalMs = MillisecondsBetween(oStart, oEnd);
+  oReport.bMissedDeadline = oEnd > _oDeadline;
+
+  uint64_t uTotalSamples = 0;
+  oReport.uMinSamplesPerPixel = oAccum_.vSampleCount.empty() ? 0u : UINT32_MAX;
+  for (uint32_t uSamples : oAccum_.vSampleCount)
+  {
+    uTotalSamples += uSamples;
+    oReport.uMinSamplesPerPixel = uSamples < oReport.uMinSamplesPerPixel ? uSamples : oReport.uMinSamplesPerPixel;
+    oReport.uMaxSamplesPerPixel = uSamples > oReport.uMaxSamplesPerPixel ? uSamples : oReport.uMaxSamplesPerPixel;
+  }
+  oReport.dMeanSamplesPerPixel = oAccum_.vSampleCount.empty() ? 0.0 : static_cast<double>(uTotalSamples) / oAccum_.vSampleCount.size();
+
+  return oReport;
+}
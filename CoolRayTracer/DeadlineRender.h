@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Camera.h"
+#include "Scene.h"
+#include "TileOrder.h"
+#include "RenderBuffers.h"
+#include "Denoiser.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <vector>
+
+struct DeadlineSettings
+{
+  int iThreadCount = 0;           // 0 uses every hardware thread
+  int iMaxBounces = 4;
+  int iMaxSamplesPerPixel = 4096;
+  float fSafetyMargin = 1.1f;     // A pass only starts if its estimated cost times this margin fits in the time left
+  bool bDenoise = true;
+  BufferFormat eBufferFormat = BufferFormat_Float32;
+  DenoiseSettings oDenoiseSettings;
+  TileSettings oTileSettings;
+};
+
+struct DeadlineReport
+{
+  int iCompletedPasses = 0;
+  uint32_t uMinSamplesPerPixel = 0;
+  uint32_t uMaxSamplesPerPixel = 0;
+  double dMeanSamplesPerPixel = 0.0;
+  double dSampleCostNs = 0.0;    // Single thread cost of one camera sample, measured by the pilot pass
+  double dResolveEstimateMs = 0.0;
+  double dRenderMs = 0.0;
+  double dResolveMs = 0.0;
+  double dTotalMs = 0.0;
+  bool bMissedDeadline = false;  // The first pass always completes, even if it alone overruns the deadline
+};
+
+// Clears oAccum_ and adds one sample per pixel per pass until the next pass is estimated to miss _oDeadline, then
+// resolves the frame (denoised if requested) into vResolved_. A pass cut short by a bad estimate is spread over the
+// whole screen, so no pixel ends more than one sample ahead of another.
+DeadlineReport RenderWithDeadline(const Scene& _oScene, const Camera& _oCamera, int _iWidth, int _iHeight,
+  const DeadlineSettings& _oSettings, std::chrono::steady_clock::time_point _oDeadline,
+  AccumulationBuffers& oAccum_, RenderBuffers& oBuffers_, std::vector<color>& vResolved_);
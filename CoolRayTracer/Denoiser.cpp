@@ -0,0 +1,128 @@
+#include "Denoiser.h"
+
+#include "Parallel.h"
+
+#include <math.h>
+
+static constexpr float fALBEDO_EPSILON = 0.001f;
+
+static const float aKERNEL[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+static color SafeDivide(const color& _vValue, const color& _vAlbedo)
+{
+  return color(
+    _vValue.r() / (_vAlbedo.r() > fALBEDO_EPSILON ? _vAlbedo.r() : 1.f),
+    _vValue.g() / (_vAlbedo.g() > fALBEDO_EPSILON ? _vAlbedo.g() : 1.f),
+    _vValue.b() / (_vAlbedo.b() > fALBEDO_EPSILON ? _vAlbedo.b() : 1.f));
+}
+
+static color Remodulate(const color& _vIrradiance, const color& _vAlbedo)
+{
+  return color(
+    _vIrradiance.r() * (_vAlbedo.r() > fALBEDO_EPSILON ? _vAlbedo.r() : 1.f),
+    _vIrradiance.g() * (_vAlbedo.g() > fALBEDO_EPSILON ? _vAlbedo.g() : 1.f),
+    _vIrradiance.b() * (_vAlbedo.b() > fALBEDO_EPSILON ? _vAlbedo.b() : 1.f));
+}
+
+static void FilterRows(const RenderBuffers& _oBuffers, const vec3* _pNormals, const float* _pDepths, const DenoiseSettings& _oSettings,
+  int _iStep, float _fColorSigma, const std::vector<color>& _vInput, std::vector<color>& vOutput_, int _iStartY, int _iEndY)
+{
+  const int iWidth = _oBuffers.iWidth;
+  const int iHeight = _oBuffers.iHeight;
+  const float fInvColorSigma2 = 1.f / (_fColorSigma * _fColorSigma);
+
+  for (int y = _iStartY; y < _iEndY; y++)
+  {
+    for (int x = 0; x < iWidth; x++)
+    {
+      const size_t uCenter = static_cast<size_t>(y) * iWidth + x;
+      const color& vCenterColor = _vInput[uCenter];
+      const vec3& vCenterNormal = _pNormals[uCenter];
+      const float fCenterDepth = _pDepths[uCenter];
+      const float fInvDepthSigma = 1.f / (_oSettings.fDepthSigma * _iStep * (fCenterDepth > 0.f ? fCenterDepth : 1.f));
+
+      color vSum = { 0.f, 0.f, 0.f };
+      float fWeightSum = 0.f;
+
+      for (int j = -2; j <= 2; j++)
+      {
+        int iSampleY = y + j * _iStep;
+        if (iSampleY < 0 || iSampleY >= iHeight)
+          continue;
+
+        for (int i = -2; i <= 2; i++)
+        {
+          int iSampleX = x + i * _iStep;
+          if (iSampleX < 0 || iSampleX >= iWidth)
+            continue;
+
+          const size_t uSample = static_cast<size_t>(iSampleY) * iWidth + iSampleX;
+          const float fSampleDepth = _pDepths[uSample];
+
+          // Never mix geometry with background
+          if ((fCenterDepth > 0.f) != (fSampleDepth > 0.f))
+            continue;
+
+          color vDiff = _vInput[uSample] - vCenterColor;
+          float fColorWeight = expf(-vDiff.LengthSqr() * fInvColorSigma2);
+
+          float fNormalWeight = 1.f;
+          float fDepthWeight = 1.f;
+          if (fCenterDepth > 0.f)
+          {
+            float fCosine = Dot(vCenterNormal, _pNormals[uSample]);
+            fNormalWeight = fCosine > 0.f ? powf(fCosine, _oSettings.fNormalPower) : 0.f;
+            fDepthWeight = expf(-fabsf(fCenterDepth - fSampleDepth) * fInvDepthSigma);
+          }
+
+          float fWeight = aKERNEL[i + 2] * aKERNEL[j + 2] * fColorWeight * fNormalWeight * fDepthWeight;
+          vSum += fWeight * _vInput[uSample];
+          fWeightSum += fWeight;
+        }
+      }
+
+      vOutput_[uCenter] = fWeightSum > 0.f ? vSum / fWeightSum : vCenterColor;
+    }
+  }
+}
+
+void DenoiseATrous(const RenderBuffers& _oBuffers, const DenoiseSettings& _oSettings, std::vector<color>& vOutput_)
+{
+  const size_t uPixelCount = static_cast<size_t>(_oBuffers.iWidth) * _oBuffers.iHeight;
+  const int iThreadCount = _oSettings.iThreadCount > 0 ? _oSettings.iThreadCount : GetDefaultThreadCount();
+
+  // Packed buffers are unpacked once, the filter reads every feature 25 times per iteration
+  std::vector<color> vPing;
+  std::vector<color> vPong(uPixelCount);
+  std::vector<color> vAlbedoScratch;
+  std::vector<vec3> vNormalScratch;
+  std::vector<float> vDepthScratch;
+  UnpackVec3Buffer(_oBuffers.oColor, vPing);
+  const color* pAlbedos = GetFloatVec3s(_oBuffers.oAlbedo, vAlbedoScratch);
+  const vec3* pNormals = GetFloatVec3s(_oBuffers.oNormal, vNormalScratch);
+  const float* pDepths = GetFloats(_oBuffers.oDepth, vDepthScratch);
+
+  for (size_t i = 0; i < uPixelCount; i++)
+  {
+    vPing[i] = SafeDivide(vPing[i], pAlbedos[i]);
+  }
+
+  float fColorSigma = _oSettings.fColorSigma;
+  for (int iIteration = 0; iIteration < _oSettings.iIterations; iIteration++)
+  {
+    const int iStep = 1 << iIteration;
+    ParallelForChunks(_oBuffers.iHeight, iThreadCount,
+      [&](int iStartY, int iEndY, int)
+      {
+        FilterRows(_oBuffers, pNormals, pDepths, _oSettings, iStep, fColorSigma, vPing, vPong, iStartY, iEndY);
+      });
+    vPing.swap(vPong);
+    fColorSigma *= 0.5f;
+  }
+
+  vOutput_.resize(uPixelCount);
+  for (size_t i = 0; i < uPixelCount; i++)
+  {
+    vOutput_[i] = Remodulate(vPing[i], pAlbedos[i]);
+  }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "RenderBuffers.h"
+
+#include <vector>
+
+struct DenoiseSettings
+{
+  int iIterations = 5;          // Filter footprint is 4 * 2^iIterations + 1 pixels wide
+  float fColorSigma = 0.6f;     // Halved every iteration
+  float fNormalPower = 64.f;
+  float fDepthSigma = 0.1f;     // Relative to the depth of the center pixel
+  int iThreadCount = 0;         // 0 uses every hardware thread
+};
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by the albedo, normal and depth buffers.
+// Albedo is divided out before filtering so texture-like detail is kept sharp.
+void DenoiseATrous(const RenderBuffers& _oBuffers, const DenoiseSettings& _oSettings, std::vector<color>& vOutput_);
@@ -0,0 +1,460 @@
+#include "EnvironmentMap.h"
+
+#include "Lights.h"
+#include "MathUtils.h"
+
+#include <algorithm>
+#include <bit>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Larger images are rejected before anything is allocated for them
+static constexpr int iMAX_ENVIRONMENT_SIZE = 32768;
+
+// Reads up to the next '\n' starting at uPos_, returns false past the end of the data
+static bool ReadHeaderLine(const uint8_t* _pData, size_t _uSize, size_t& uPos_, std::string& sLine_)
+{
+  if (uPos_ >= _uSize)
+    return false;
+
+  const uint8_t* pLineEnd = static_cast<const uint8_t*>(memchr(_pData + uPos_, '\n', _uSize - uPos_));
+  if (pLineEnd == nullptr)
+    return false;
+
+  sLine_.assign(reinterpret_cast<const char*>(_pData + uPos_), reinterpret_cast<const char*>(pLineEnd));
+  uPos_ = (pLineEnd - _pData) + 1;
+  return true;
+}
+
+static color RGBEToColor(const uint8_t* _pRGBE)
+{
+  if (_pRGBE[3] == 0)
+    return color(0.f, 0.f, 0.f);
+
+  float fScale = ldexpf(1.f, static_cast<int>(_pRGBE[3]) - (128 + 8));
+  return color(_pRGBE[0] * fScale, _pRGBE[1] * fScale, _pRGBE[2] * fScale);
+}
+
+static bool DecodeRadianceHDR(const uint8_t* _pData, size_t _uSize, EnvironmentMip& oImage_, std::string& sError_)
+{
+  size_t uPos = 0;
+  std::string sLine;
+
+  // Header lines up to an empty one, then the resolution line
+  while (true)
+  {
+    if (!ReadHeaderLine(_pData, _uSize, uPos, sLine))
+    {
+      sError_ = "truncated header";
+      return false;
+    }
+    if (sLine.empty())
+      break;
+    if (sLine.compare(0, 7, "FORMAT=") == 0 && sLine != "FORMAT=32-bit_rle_rgbe")
+    {
+      sError_ = "unsupported " + sLine;
+      return false;
+    }
+  }
+
+  int iWidth, iHeight;
+  if (!ReadHeaderLine(_pData, _uSize, uPos, sLine) || sscanf(sLine.c_str(), "-Y %d +X %d", &iHeight, &iWidth) != 2
+    || iWidth <= 0 || iHeight <= 0 || iWidth > iMAX_ENVIRONMENT_SIZE || iHeight > iMAX_ENVIRONMENT_SIZE)
+  {
+    sError_ = "unsupported resolution line";
+    return false;
+  }
+
+  oImage_.iWidth = iWidth;
+  oImage_.iHeight = iHeight;
+  oImage_.vTexels.resize(static_cast<size_t>(iWidth) * iHeight);
+
+  std::vector<uint8_t> vScanline(static_cast<size_t>(iWidth) * 4);
+  for (int y = 0; y < iHeight; y++)
+  {
+    bool bRunLength = iWidth >= 8 && iWidth < 32768 && uPos + 4 <= _uSize
+      && _pData[uPos] == 2 && _pData[uPos + 1] == 2 && ((_pData[uPos + 2] << 8) | _pData[uPos + 3]) == iWidth;
+
+    if (bRunLength)
+    {
+      // Four planes, each a sequence of runs (count > 128) and literal spans
+      uPos += 4;
+      for (int iChannel = 0; iChannel < 4; iChannel++)
+      {
+        int x = 0;
+        while (x < iWidth)
+        {
+          if (uPos >= _uSize)
+          {
+            sError_ = "truncated scanline";
+            return false;
+          }
+
+          int iCount = _pData[uPos++];
+          bool bRun = iCount > 128;
+          iCount = bRun ? iCount - 128 : iCount;
+          if (iCount == 0 || x + iCount > iWidth || uPos + (bRun ? 1 : iCount) > _uSize)
+          {
+            sError_ = "corrupt scanline";
+            return false;
+          }
+
+          for (int i = 0; i < iCount; i++)
+          {
+            vScanline[(x + i) * 4 + iChannel] = bRun ? _pData[uPos] : _pData[uPos + i];
+          }
+          uPos += bRun ? 1 : iCount;
+          x += iCount;
+        }
+      }
+    }
+    else
+    {
+      if (uPos + vScanline.size() > _uSize)
+      {
+        sError_ = "truncated scanline";
+        return false;
+      }
+      memcpy(vScanline.data(), _pData + uPos, vScanline.size());
+      uPos += vScanline.size();
+    }
+
+    for (int x = 0; x < iWidth; x++)
+    {
+      oImage_.vTexels[static_cast<size_t>(y) * iWidth + x] = RGBEToColor(&vScanline[x * 4]);
+    }
+  }
+
+  return true;
+}
+
+static bool DecodePFM(const uint8_t* _pData, size_t _uSize, EnvironmentMip& oImage_, std::string& sError_)
+{
+  size_t uPos = 0;
+  std::string sMagic, sSize, sScale;
+  if (!ReadHeaderLine(_pData, _uSize, uPos, sMagic) || !ReadHeaderLine(_pData, _uSize, uPos, sSize) || !ReadHeaderLine(_pData, _uSize, uPos, sScale))
+  {
+    sError_ = "truncated header";
+    return false;
+  }
+
+  int iChannels = sMagic == "PF" ? 3 : 1;
+  int iWidth, iHeight;
+  if (sscanf(sSize.c_str(), "%d %d", &iWidth, &iHeight) != 2 || iWidth <= 0 || iHeight <= 0 || iWidth > iMAX_ENVIRONMENT_SIZE
+    || iHeight > iMAX_ENVIRONMENT_SIZE)
+  {
+    sError_ = "bad size line";
+    return false;
+  }
+
+  // The capped size cannot overflow, and uPos is at most _uSize after the header
+  size_t uFloatCount = static_cast<size_t>(iWidth) * static_cast<size_t>(iHeight) * static_cast<size_t>(iChannels);
+  if (uFloatCount * sizeof(float) > _uSize - uPos)
+  {
+    sError_ = "truncated pixel data";
+    return false;
+  }
+
+  // A negative scale means little endian
+  bool bSwap = (atof(sScale.c_str()) < 0.0) != (std::endian::native == std::endian::little);
+
+  oImage_.iWidth = iWidth;
+  oImage_.iHeight = iHeight;
+  oImage_.vTexels.resize(static_cast<size_t>(iWidth) * iHeight);
+
+  const uint8_t* pPixels = _pData + uPos;
+  for (int y = 0; y < iHeight; y++)
+  {
+    for (int x = 0; x < iWidth; x++)
+    {
+      float aValues[3];
+      for (int iChannel = 0; iChannel < iChannels; iChannel++)
+      {
+        uint8_t aBytes[4];
+        memcpy(aBytes, pPixels + ((static_cast<size_t>(y) * iWidth + x) * iChannels + iChannel) * 4, 4);
+        if (bSwap)
+        {
+          std::swap(aBytes[0], aBytes[3]);
+          std::swap(aBytes[1], aBytes[2]);
+        }
+        memcpy(&aValues[iChannel], aBytes, 4);
+      }
+
+      // Rows are stored bottom to top
+      color vTexel = iChannels == 3 ? color(aValues[0], aValues[1], aValues[2]) : color(aValues[0], aValues[0], aValues[0]);
+      oImage_.vTexels[static_cast<size_t>(iHeight - 1 - y) * iWidth + x] = vTexel;
+    }
+  }
+
+  return true;
+}
+
+bool DecodeEnvironmentImage(const uint8_t* _pData, size_t _uSize, EnvironmentMip& oImage_, std::string& sError_)
+{
+  if (_uSize >= 3 && _pData[0] == 'P' && (_pData[1] == 'F' || _pData[1] == 'f') && _pData[2] == '\n')
+    return DecodePFM(_pData, _uSize, oImage_, sError_);
+
+  if (_uSize >= 2 && _pData[0] == '#' && _pData[1] == '?')
+    return DecodeRadianceHDR(_pData, _uSize, oImage_, sError_);
+
+  sError_ = "not a Radiance HDR or PFM file";
+  return false;
+}
+
+bool LoadEnvironmentMap(const char* _sPath, float _fIntensity, EnvironmentMap& oMap_, std::string& sError_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+  {
+    sError_ = "could not open file";
+    return false;
+  }
+
+  std::vector<uint8_t> vData;
+  uint8_t aBuffer[65536];
+  size_t uRead;
+  while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0)
+  {
+    vData.insert(vData.end(), aBuffer, aBuffer + uRead);
+  }
+  fclose(pFile);
+
+  EnvironmentMip oImage;
+  if (!DecodeEnvironmentImage(vData.data(), vData.size(), oImage, sError_))
+    return false;
+
+  oMap_ = {};
+  oMap_.vMips.push_back(std::move(oImage));
+  oMap_.fIntensity = _fIntensity;
+  BuildEnvironmentMap(oMap_);
+  return true;
+}
+
+static void BuildEnvironmentMips(EnvironmentMap& oMap_)
+{
+  oMap_.vMips.resize(1);
+  while (oMap_.vMips.back().iWidth > 1 || oMap_.vMips.back().iHeight > 1)
+  {
+    const EnvironmentMip& oSource = oMap_.vMips.back();
+    EnvironmentMip oMip;
+    oMip.iWidth = max(1, (oSource.iWidth + 1) / 2);
+    oMip.iHeight = max(1, (oSource.iHeight + 1) / 2);
+    oMip.vTexels.resize(static_cast<size_t>(oMip.iWidth) * oMip.iHeight);
+
+    for (int y = 0; y < oMip.iHeight; y++)
+    {
+      int iY0 = min(2 * y, oSource.iHeight - 1);
+      int iY1 = min(2 * y + 1, oSource.iHeight - 1);
+      for (int x = 0; x < oMip.iWidth; x++)
+      {
+        int iX0 = min(2 * x, oSource.iWidth - 1);
+        int iX1 = min(2 * x + 1, oSource.iWidth - 1);
+        color vSum = oSource.vTexels[static_cast<size_t>(iY0) * oSource.iWidth + iX0] + oSource.vTexels[static_cast<size_t>(iY0) * oSource.iWidth + iX1]
+          + oSource.vTexels[static_cast<size_t>(iY1) * oSource.iWidth + iX0] + oSource.vTexels[static_cast<size_t>(iY1) * oSource.iWidth + iX1];
+        oMip.vTexels[static_cast<size_t>(y) * oMip.iWidth + x] = vSum * 0.25f;
+      }
+    }
+
+    oMap_.vMips.push_back(std::move(oMip));
+  }
+}
+
+static void BuildEnvironmentDistribution(EnvironmentMap& oMap_)
+{
+  oMap_.iSampleLevel = 0;
+  while (oMap_.iSampleLevel + 1 < static_cast<int>(oMap_.vMips.size()) && oMap_.vMips[oMap_.iSampleLevel].iWidth > g_iEnvironmentSampleWidth)
+  {
+    oMap_.iSampleLevel++;
+  }
+
+  const EnvironmentMip& oMip = oMap_.vMips[oMap_.iSampleLevel];
+  int iWidth = oMip.iWidth;
+  int iHeight = oMip.iHeight;
+
+  oMap_.vTexelPdf.assign(static_cast<size_t>(iWidth) * iHeight, 0.f);
+  oMap_.vConditionalCdf.assign(static_cast<size_t>(iWidth + 1) * iHeight, 0.f);
+  oMap_.vMarginalCdf.assign(iHeight + 1, 0.f);
+
+  // Accumulated in double, a bright sun next to millions of dim texels loses the dim ones in float
+  std::vector<double> vRowSum(iHeight, 0.0);
+  double dTotal = 0.0;
+  for (int y = 0; y < iHeight; y++)
+  {
+    float fSinTheta = sinf(fPI * (y + 0.5f) / iHeight);
+    for (int x = 0; x < iWidth; x++)
+    {
+      size_t uIdx = static_cast<size_t>(y) * iWidth + x;
+      oMap_.vTexelPdf[uIdx] = max(0.f, Luminance(oMip.vTexels[uIdx])) * fSinTheta;
+      vRowSum[y] += oMap_.vTexelPdf[uIdx];
+    }
+    dTotal += vRowSum[y];
+  }
+
+  if (dTotal <= 0.0)
+  {
+    oMap_.vTexelPdf.clear();
+    return;
+  }
+
+  double dMarginal = 0.0;
+  for (int y = 0; y < iHeight; y++)
+  {
+    float* pConditional = &oMap_.vConditionalCdf[static_cast<size_t>(y) * (iWidth + 1)];
+    double dConditional = 0.0;
+    for (int x = 0; x < iWidth; x++)
+    {
+      size_t uIdx = static_cast<size_t>(y) * iWidth + x;
+      dConditional += oMap_.vTexelPdf[uIdx];
+      pConditional[x + 1] = vRowSum[y] > 0.0 ? static_cast<float>(dConditional / vRowSum[y]) : static_cast<float>(x + 1) / iWidth;
+      oMap_.vTexelPdf[uIdx] = static_cast<float>(oMap_.vTexelPdf[uIdx] / dTotal);
+    }
+    pConditional[iWidth] = 1.f;
+
+    dMarginal += vRowSum[y];
+    oMap_.vMarginalCdf[y + 1] = static_cast<float>(dMarginal / dTotal);
+  }
+  oMap_.vMarginalCdf[iHeight] = 1.f;
+}
+
+void BuildEnvironmentMap(EnvironmentMap& oMap_)
+{
+  BuildEnvironmentMips(oMap_);
+  BuildEnvironmentDistribution(oMap_);
+}
+
+size_t GetEnvironmentMapMemoryUsage(const EnvironmentMap& _oMap)
+{
+  size_t uBytes = (_oMap.vMarginalCdf.capacity() + _oMap.vConditionalCdf.capacity() + _oMap.vTexelPdf.capacity()) * sizeof(float);
+  for (const EnvironmentMip& oMip : _oMap.vMips)
+  {
+    uBytes += oMip.vTexels.capacity() * sizeof(color);
+  }
+  return uBytes;
+}
+
+// [0,1)^2 lat-long coordinates, u grows with the angle from -Z towards +X, v from +Y down
+static void DirectionToLatLong(const vec3& _vDir, float& fU_, float& fV_)
+{
+  fU_ = 0.5f + atan2f(_vDir.x(), -_vDir.z()) / (2.f * fPI);
+  fV_ = acosf(clamp(_vDir.y(), -1.f, 1.f)) / fPI;
+}
+
+static vec3 LatLongToDirection(float _fU, float _fV, float& fSinTheta_)
+{
+  float fTheta = _fV * fPI;
+  float fPhi = (_fU - 0.5f) * 2.f * fPI;
+  float fCosTheta, fSinPhi, fCosPhi;
+  SinCos(fTheta, fSinTheta_, fCosTheta);
+  SinCos(fPhi, fSinPhi, fCosPhi);
+  return vec3(fSinTheta_ * fSinPhi, fCosTheta, -fSinTheta_ * fCosPhi);
+}
+
+static color LookupMipBilinear(const EnvironmentMip& _oMip, float _fU, float _fV)
+{
+  // Wraps around in u, clamps at the poles
+  float fX = _fU * _oMip.iWidth - 0.5f;
+  float fY = clamp(_fV * _oMip.iHeight - 0.5f, 0.f, static_cast<float>(_oMip.iHeight - 1));
+  int iX0 = static_cast<int>(floorf(fX));
+  int iY0 = static_cast<int>(fY);
+  float fTx = fX - iX0;
+  float fTy = fY - iY0;
+  int iY1 = min(iY0 + 1, _oMip.iHeight - 1);
+  iX0 = ((iX0 % _oMip.iWidth) + _oMip.iWidth) % _oMip.iWidth;
+  int iX1 = (iX0 + 1) % _oMip.iWidth;
+
+  const color* pRow0 = &_oMip.vTexels[static_cast<size_t>(iY0) * _oMip.iWidth];
+  const color* pRow1 = &_oMip.vTexels[static_cast<size_t>(iY1) * _oMip.iWidth];
+  color vTop = pRow0[iX0] * (1.f - fTx) + pRow0[iX1] * fTx;
+  color vBottom = pRow1[iX0] * (1.f - fTx) + pRow1[iX1] * fTx;
+  return vTop * (1.f - fTy) + vBottom * fTy;
+}
+
+color LookupEnvironment(const EnvironmentMap& _oMap, const vec3& _vDir, float _fLevel)
+{
+  float fU, fV;
+  DirectionToLatLong(_vDir, fU, fV);
+
+  float fLevel = clamp(_fLevel, 0.f, static_cast<float>(_oMap.vMips.size() - 1));
+  int iLevel0 = static_cast<int>(fLevel);
+  int iLevel1 = min(iLevel0 + 1, static_cast<int>(_oMap.vMips.size()) - 1);
+  float fT = fLevel - iLevel0;
+
+  color vValue = LookupMipBilinear(_oMap.vMips[iLevel0], fU, fV);
+  if (fT > 0.f)
+  {
+    vValue = vValue * (1.f - fT) + LookupMipBilinear(_oMap.vMips[iLevel1], fU, fV) * fT;
+  }
+  return vValue * _oMap.fIntensity;
+}
+
+float GetEnvironmentLevel(const EnvironmentMap& _oMap, float _fConeAngle)
+{
+  // A texel of vMips[0] spans 2 pi / width radians along the equator, the poles are not accounted for
+  float fTexels = _fConeAngle * static_cast<float>(_oMap.vMips[0].iWidth) / (2.f * fPI);
+  return Log2(max(fTexels, 1.f));
+}
+
+static size_t GetSampleTexelIndex(const EnvironmentMip& _oMip, float _fU, float _fV)
+{
+  int iX = min(static_cast<int>(_fU * _oMip.iWidth), _oMip.iWidth - 1);
+  int iY = min(static_cast<int>(_fV * _oMip.iHeight), _oMip.iHeight - 1);
+  return static_cast<size_t>(max(iY, 0)) * _oMip.iWidth + max(iX, 0);
+}
+
+color GetEnvironmentTexel(const EnvironmentMap& _oMap, const vec3& _vDir)
+{
+  float fU, fV;
+  DirectionToLatLong(_vDir, fU, fV);
+  const EnvironmentMip& oMip = _oMap.vMips[_oMap.iSampleLevel];
+  return oMip.vTexels[GetSampleTexelIndex(oMip, fU, fV)] * _oMap.fIntensity;
+}
+
+// Index of the CDF interval that holds _fValue, with the position inside it in fFraction_
+static int SampleCdf(const float* _pCdf, int _iCount, float _fValue, float& fFraction_)
+{
+  int iIdx = static_cast<int>(std::upper_bound(_pCdf, _pCdf + _iCount + 1, _fValue) - _pCdf) - 1;
+  iIdx = clamp(iIdx, 0, _iCount - 1);
+  float fWidth = _pCdf[iIdx + 1] - _pCdf[iIdx];
+  fFraction_ = fWidth > 0.f ? clamp((_fValue - _pCdf[iIdx]) / fWidth, 0.f, 0.99999994f) : 0.5f;
+  return iIdx;
+}
+
+bool SampleEnvironment(const EnvironmentMap& _oMap, float _fRandom1, float _fRandom2, vec3& vDir_, color& vRadiance_, float& fPdf_)
+{
+  if (_oMap.vTexelPdf.empty())
+    return false;
+
+  const EnvironmentMip& oMip = _oMap.vMips[_oMap.iSampleLevel];
+
+  float fFractionY, fFractionX;
+  int iY = SampleCdf(_oMap.vMarginalCdf.data(), oMip.iHeight, _fRandom2, fFractionY);
+  int iX = SampleCdf(&_oMap.vConditionalCdf[static_cast<size_t>(iY) * (oMip.iWidth + 1)], oMip.iWidth, _fRandom1, fFractionX);
+
+  size_t uIdx = static_cast<size_t>(iY) * oMip.iWidth + iX;
+  float fSinTheta;
+  vDir_ = LatLongToDirection((iX + fFractionX) / oMip.iWidth, (iY + fFractionY) / oMip.iHeight, fSinTheta);
+  if (fSinTheta <= 0.f || _oMap.vTexelPdf[uIdx] <= 0.f)
+    return false;
+
+  // Texel probability to density over the unit square, then to solid angle
+  fPdf_ = _oMap.vTexelPdf[uIdx] * oMip.iWidth * oMip.iHeight / (2.f * fPI * fPI * fSinTheta);
+  vRadiance_ = oMip.vTexels[uIdx] * _oMap.fIntensity;
+  return true;
+}
+
+float GetEnvironmentPdf(const EnvironmentMap& _oMap, const vec3& _vDir)
+{
+  if (_oMap.vTexelPdf.empty())
+    return 0.f;
+
+  float fU, fV;
+  DirectionToLatLong(_vDir, fU, fV);
+  float fSinTheta = sinf(fV * fPI);
+  if (fSinTheta <= 0.f)
+    return 0.f;
+
+  const EnvironmentMip& oMip = _oMap.vMips[_oMap.iSampleLevel];
+  return _oMap.vTexelPdf[GetSampleTexelIndex(oMip, fU, fV)] * oMip.iWidth * oMip.iHeight / (2.f * fPI * fPI * fSinTheta);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vec3.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using color = vec3;
+
+// Widest mip the sampling distribution is built from, a sharp sun stays a handful of texels
+static constexpr int g_iEnvironmentSampleWidth = 512;
+
+struct EnvironmentMip
+{
+  int iWidth = 0;
+  int iHeight = 0;
+  std::vector<color> vTexels;
+};
+
+// Lat-long radiance map, +Y up and -Z at the horizontal center. vMips[0] is the loaded image, each next level
+// is a 2x2 box filter of the previous one down to 1x1. Directions are importance sampled from iSampleLevel with
+// a marginal CDF over rows and a conditional CDF per row, both weighted by luminance * sin(theta).
+struct EnvironmentMap
+{
+  std::vector<EnvironmentMip> vMips;
+  float fIntensity = 1.f;
+
+  int iSampleLevel = 0;
+  std::vector<float> vMarginalCdf;    // Height + 1 entries
+  std::vector<float> vConditionalCdf; // Height rows of width + 1 entries
+  std::vector<float> vTexelPdf;       // Discrete probability of each texel of iSampleLevel
+};
+
+// Radiance .hdr (RGBE, flat or new-style RLE scanlines, -Y h +X w only) or PFM, picked from the header. Images wider
+// or taller than 32768 texels are rejected.
+bool DecodeEnvironmentImage(const uint8_t* _pData, size_t _uSize, EnvironmentMip& oImage_, std::string& sError_);
+
+// Decodes the file and builds the mips and sampling CDFs
+bool LoadEnvironmentMap(const char* _sPath, float _fIntensity, EnvironmentMap& oMap_, std::string& sError_);
+
+// Builds the mips and sampling CDFs from vMips[0]
+void BuildEnvironmentMap(EnvironmentMap& oMap_);
+
+size_t GetEnvironmentMapMemoryUsage(const EnvironmentMap& _oMap);
+
+// Mip level whose texels are as wide as a ray cone spreading by _fConeAngle radians, for LookupEnvironment
+float GetEnvironmentLevel(const EnvironmentMap& _oMap, float _fConeAngle);
+
+// Trilinear lookup between the two mips around _fLevel, _vDir must be normalized
+color LookupEnvironment(const EnvironmentMap& _oMap, const vec3& _vDir, float _fLevel);
+
+// Unfiltered texel of iSampleLevel, the radiance the sampling distribution is proportional to
+color GetEnvironmentTexel(const EnvironmentMap& _oMap, const vec3& _vDir);
+
+// Returns false if the map is black everywhere. vRadiance_ is GetEnvironmentTexel of vDir_.
+bool SampleEnvironment(const EnvironmentMap& _oMap, float _fRandom1, float _fRandom2, vec3& vDir_, color& vRadiance_, float& fPdf_);
+
+// Solid angle density of SampleEnvironment
+float GetEnvironmentPdf(const EnvironmentMap& _oMap, const vec3& _vDir);
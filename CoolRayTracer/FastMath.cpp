@@ -0,0 +1,3 @@
+#include "FastMath.h"
+
+thread_local MathPrecision t_eMathPrecision = MathPrecision_Accurate;
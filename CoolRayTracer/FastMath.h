@@ -0,0 +1,225 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FAST_MATH_SSE 1
+#include <xmmintrin.h>
+#else
+#define FAST_MATH_SSE 0
+#endif
+
+// Approximations of the libm functions used while tracing. The error bounds were measured against double precision
+// over every float of the stated input range (rsqrt, rcp, log2) or 2^24 evenly spaced inputs (sincos, exp2, pow).
+//
+//   FastRsqrt    x > 0 normal                rel 3.0e-7 with SSE, 4.8e-6 without
+//   FastRcp      x normal                    rel 2.0e-7 with SSE, 1.6e-7 without
+//   FastSinCos   |x| <= 8192                 abs 4.4e-7
+//   FastExp2     -126 <= x <= 127            rel 2.6e-7
+//   FastLog2     x > 0 normal                abs 1.4e-7 for 1/2 <= x <= 2, rel 1.1e-7 elsewhere
+//   FastPow      x > 0, |y log2 x| <= 126    rel 2.6e-7 + 7.2e-8 |y log2 x|
+//
+// Non finite inputs and denormals are not handled, callers clamp before calling.
+
+enum MathPrecision
+{
+  MathPrecision_Accurate,
+  MathPrecision_Fast
+};
+
+// Picks the path of the selecting functions below on the calling thread. Render threads start accurate, the preview
+// switches its workers to fast. Building with FAST_MATH_ACCURATE_ONLY compiles the fast paths out.
+extern thread_local MathPrecision t_eMathPrecision;
+
+inline bool IsFastMath()
+{
+#if defined(FAST_MATH_ACCURATE_ONLY)
+  return false;
+#else
+  return t_eMathPrecision == MathPrecision_Fast;
+#endif
+}
+
+inline uint32_t FloatToBits(float _fValue)
+{
+  uint32_t uBits;
+  memcpy(&uBits, &_fValue, sizeof(uBits));
+  return uBits;
+}
+
+inline float BitsToFloat(uint32_t _uBits)
+{
+  float fValue;
+  memcpy(&fValue, &_uBits, sizeof(fValue));
+  return fValue;
+}
+
+inline float FastRsqrt(float _fValue)
+{
+#if FAST_MATH_SSE
+  float fEstimate = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(_fValue)));
+  return fEstimate * (1.5f - 0.5f * _fValue * fEstimate * fEstimate);
+#else
+  float fEstimate = BitsToFloat(0x5f375a86u - (FloatToBits(_fValue) >> 1));
+  fEstimate = fEstimate * (1.5f - 0.5f * _fValue * fEstimate * fEstimate);
+  return fEstimate * (1.5f - 0.5f * _fValue * fEstimate * fEstimate);
+#endif
+}
+
+inline float FastRcp(float _fValue)
+{
+#if FAST_MATH_SSE
+  float fEstimate = _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(_fValue)));
+  return fEstimate * (2.f - _fValue * fEstimate);
+#else
+  float fEstimate = BitsToFloat(0x7ef311c3u - FloatToBits(_fValue));
+  fEstimate = fEstimate * (2.f - _fValue * fEstimate);
+  fEstimate = fEstimate * (2.f - _fValue * fEstimate);
+  return fEstimate * (2.f - _fValue * fEstimate);
+#endif
+}
+
+// floorf is a library call without SSE4.1, the conversion truncates toward zero instead
+inline int FloorToInt(float _fValue)
+{
+  int iValue = static_cast<int>(_fValue);
+  return iValue - (_fValue < static_cast<float>(iValue) ? 1 : 0);
+}
+
+// Taylor coefficients, on [-pi/4, pi/4] the first omitted terms stay below float precision
+static constexpr float g_fSinC3 = -1.f / 6.f;
+static constexpr float g_fSinC5 = 1.f / 120.f;
+static constexpr float g_fSinC7 = -1.f / 5040.f;
+static constexpr float g_fCosC2 = -0.5f;
+static constexpr float g_fCosC4 = 1.f / 24.f;
+static constexpr float g_fCosC6 = -1.f / 720.f;
+static constexpr float g_fCosC8 = 1.f / 40320.f;
+
+// sin and cos of _fAngle in [-pi/4, pi/4] from Taylor polynomials of degree 7 and 8, max error 3.3e-7 and 2.5e-8
+inline void SinCosQuarterPi(float _fAngle, float& fSin_, float& fCos_)
+{
+  float fA2 = _fAngle * _fAngle;
+
+  float fSin = g_fSinC7;
+  fSin = fSin * fA2 + g_fSinC5;
+  fSin = fSin * fA2 + g_fSinC3;
+  fSin_ = _fAngle + (_fAngle * fA2) * fSin;
+
+  float fCos = g_fCosC8;
+  fCos = fCos * fA2 + g_fCosC6;
+  fCos = fCos * fA2 + g_fCosC4;
+  fCos = fCos * fA2 + g_fCosC2;
+  fCos_ = 1.f + fA2 * fCos;
+}
+
+inline void FastSinCos(float _fAngle, float& fSin_, float& fCos_)
+{
+  // Quadrant from the nearest multiple of pi/2, subtracted in two parts so the reduction stays exact for small quadrants
+  constexpr float fTWO_OVER_PI = 0.636619772f;
+  constexpr float fHALF_PI_HIGH = 1.5703125f;
+  constexpr float fHALF_PI_LOW = 4.83826794897e-4f;
+
+  int iQuadrant = FloorToInt(_fAngle * fTWO_OVER_PI + 0.5f);
+  float fQuadrant = static_cast<float>(iQuadrant);
+  float fReduced = (_fAngle - fQuadrant * fHALF_PI_HIGH) - fQuadrant * fHALF_PI_LOW;
+
+  float fSin, fCos;
+  SinCosQuarterPi(fReduced, fSin, fCos);
+
+  // Odd quadrants swap sin and cos, the sign bits follow the quadrant
+  bool bSwap = (iQuadrant & 1) != 0;
+  uint32_t uSinSign = static_cast<uint32_t>(iQuadrant & 2) << 30;
+  uint32_t uCosSign = static_cast<uint32_t>((iQuadrant + 1) & 2) << 30;
+  fSin_ = BitsToFloat(FloatToBits(bSwap ? fCos : fSin) ^ uSinSign);
+  fCos_ = BitsToFloat(FloatToBits(bSwap ? fSin : fCos) ^ uCosSign);
+}
+
+inline float FastExp2(float _fValue)
+{
+  // 2^x = 2^i * e^(f ln2) with f in [-0.5, 0.5], Taylor series of degree 6 evaluated in pairs to shorten the dependency chain
+  int iExponent = FloorToInt(_fValue + 0.5f);
+  float fT = (_fValue - static_cast<float>(iExponent)) * 0.693147181f;
+  float fT2 = fT * fT;
+
+  float fPoly01 = 1.f + fT;
+  float fPoly23 = 0.5f + fT * (1.f / 6.f);
+  float fPoly45 = 1.f / 24.f + fT * (1.f / 120.f);
+  float fPoly = fPoly01 + fT2 * (fPoly23 + fT2 * (fPoly45 + fT2 * (1.f / 720.f)));
+
+  // Exponent bits of zero flush the underflowing results to 0
+  iExponent = iExponent < -127 ? -127 : iExponent;
+  return fPoly * BitsToFloat(static_cast<uint32_t>(iExponent + 127) << 23);
+}
+
+inline float FastLog2(float _fValue)
+{
+  // Mantissa moved to [sqrt(1/2), sqrt(2)), then log(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.1716
+  uint32_t uBits = FloatToBits(_fValue);
+  int iExponent = static_cast<int>((uBits >> 23) & 0xffu) - 127;
+  uint32_t uMantissa = uBits & 0x7fffffu;
+  if (uMantissa > 0x3504f3u)
+  {
+    uMantissa -= 0x800000u;
+    iExponent++;
+  }
+  float fMantissa = BitsToFloat(uMantissa + 0x3f800000u);
+
+  float fS = (fMantissa - 1.f) / (fMantissa + 1.f);
+  float fS2 = fS * fS;
+  float fPoly = 1.f / 9.f;
+  fPoly = fPoly * fS2 + 1.f / 7.f;
+  fPoly = fPoly * fS2 + 1.f / 5.f;
+  fPoly = fPoly * fS2 + 1.f / 3.f;
+  fPoly = fPoly * fS2 + 1.f;
+
+  constexpr float fTWO_OVER_LN2 = 2.88539008f;
+  return static_cast<float>(iExponent) + fTWO_OVER_LN2 * fS * fPoly;
+}
+
+inline float FastPow(float _fBase, float _fExponent)
+{
+  return FastExp2(_fExponent * FastLog2(_fBase));
+}
+
+// Selecting versions, fast or accurate depending on the calling thread's precision mode
+
+inline float Rsqrt(float _fValue)
+{
+  return IsFastMath() ? FastRsqrt(_fValue) : 1.f / sqrtf(_fValue);
+}
+
+inline float Rcp(float _fValue)
+{
+  return IsFastMath() ? FastRcp(_fValue) : 1.f / _fValue;
+}
+
+inline void SinCos(float _fAngle, float& fSin_, float& fCos_)
+{
+  if (IsFastMath())
+  {
+    FastSinCos(_fAngle, fSin_, fCos_);
+  }
+  else
+  {
+    fSin_ = sinf(_fAngle);
+    fCos_ = cosf(_fAngle);
+  }
+}
+
+inline float Exp2(float _fValue)
+{
+  return IsFastMath() ? FastExp2(_fValue) : exp2f(_fValue);
+}
+
+inline float Log2(float _fValue)
+{
+  return IsFastMath() ? FastLog2(_fValue) : log2f(_fValue);
+}
+
+// Only for positive bases, like every pow in the renderer
+inline float Pow(float _fBase, float _fExponent)
+{
+  return IsFastMath() ? FastPow(_fBase, _fExponent) : powf(_fBase, _fExponent);
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "vec3.h"
+#include "Ray.h"
+#include "AABB.h"
+#include "Vec2.h"
+
+#include <math.h>
+
+enum HittableType
+{
+  HittableType_Sphere,
+  HittableType_Plane
+};
+
+struct Sphere
+{
+  vec3 vCenter;
+  float fRadius;
+};
+
+struct Plane
+{
+  vec3 vNormal;
+  float fPoint;
+};
+
+struct Hittable
+{
+  HittableType eType;
+  union
+  {
+    Sphere oSphere;
+    Plane oPlane;
+  };
+};
+
+struct HitInfo
+{
+  float fT;
+  vec3 vNormal;
+};
+
+inline bool HitSphere(const ray& _oRay, const Sphere& _oSphere, HitInfo& oHitInfo_)
+{
+  vec3 vSphereToRay = _oRay.vOrigin - _oSphere.vCenter;
+  float a = Dot(_oRay.vDir, _oRay.vDir);
+  float b = 2.0f * Dot(vSphereToRay, _oRay.vDir);
+  float c = Dot(vSphereToRay, vSphereToRay) - (_oSphere.fRadius * _oSphere.fRadius);
+  float discriminant = (b * b) - (4 * a * c);
+  if (discriminant > 0)
+  {
+    float sqrtDisc = sqrtf(discriminant);
+    float t0 = (-b - sqrtDisc) / (2.0f * a);
+    float t1 = (-b + sqrtDisc) / (2.0f * a);
+
+    float fT = (t0 > 0.f) ? t0 : ((t1 > 0.f) ? t1 : -1.f);
+
+    if (fT > 0.001f)
+    {
+      oHitInfo_.fT = fT;
+      oHitInfo_.vNormal = Normalize((_oRay.vOrigin + (oHitInfo_.fT * _oRay.vDir)) - _oSphere.vCenter);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline bool HitPlane(const ray& _oRay, const Plane& _oPlane, HitInfo& oHitInfo_)
+{
+  float fDenom = Dot(_oPlane.vNormal, _oRay.vDir);
+  if (fabs(fDenom) > 0.0001f)
+  {
+    float fT = (_oPlane.fPoint - Dot(_oPlane.vNormal, _oRay.vOrigin)) / fDenom;
+    if (fT >= 0)
+    {
+      oHitInfo_.fT = fT;
+      oHitInfo_.vNormal = _oPlane.vNormal;
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool HitHittable(const ray& _oRay, const Hittable& _oHittable, HitInfo& oHitInfo)
+{
+  switch (_oHittable.eType)
+  {
+  case HittableType_Sphere:
+  {
+    return HitSphere(_oRay, _oHittable.oSphere, oHitInfo);
+  } break;
+  case HittableType_Plane:
+  {
+    return HitPlane(_oRay, _oHittable.oPlane, oHitInfo);
+  } break;
+  }
+
+  return false;
+}
+
+// Occlusion tests: same hit rules as above, but only report whether a hit lies before _fMaxT, no normal
+inline bool OccludeSphere(const ray& _oRay, const Sphere& _oSphere, float _fMaxT)
+{
+  vec3 vSphereToRay = _oRay.vOrigin - _oSphere.vCenter;
+  float a = Dot(_oRay.vDir, _oRay.vDir);
+  float b = 2.0f * Dot(vSphereToRay, _oRay.vDir);
+  float c = Dot(vSphereToRay, vSphereToRay) - (_oSphere.fRadius * _oSphere.fRadius);
+  float discriminant = (b * b) - (4 * a * c);
+  if (discriminant > 0)
+  {
+    float sqrtDisc = sqrtf(discriminant);
+    float t0 = (-b - sqrtDisc) / (2.0f * a);
+    float t1 = (-b + sqrtDisc) / (2.0f * a);
+
+    float fT = (t0 > 0.f) ? t0 : ((t1 > 0.f) ? t1 : -1.f);
+
+    return fT > 0.001f && fT < _fMaxT;
+  }
+
+  return false;
+}
+
+inline bool OccludePlane(const ray& _oRay, const Plane& _oPlane, float _fMaxT)
+{
+  float fDenom = Dot(_oPlane.vNormal, _oRay.vDir);
+  if (fabs(fDenom) > 0.0001f)
+  {
+    float fT = (_oPlane.fPoint - Dot(_oPlane.vNormal, _oRay.vOrigin)) / fDenom;
+    return fT >= 0 && fT < _fMaxT;
+  }
+  return false;
+}
+
+inline bool OccludeHittable(const ray& _oRay, const Hittable& _oHittable, float _fMaxT)
+{
+  switch (_oHittable.eType)
+  {
+  case HittableType_Sphere:
+    return OccludeSphere(_oRay, _oHittable.oSphere, _fMaxT);
+  case HittableType_Plane:
+    return OccludePlane(_oRay, _oHittable.oPlane, _fMaxT);
+  }
+
+  return false;
+}
+
+// Surface coordinates in world units, arc lengths on spheres and in-plane distances on planes,
+// so one texture scale reads the same on both
+inline vec2 GetHittableUV(const Hittable& _oHittable, const vec3& _vPosition)
+{
+  switch (_oHittable.eType)
+  {
+  case HittableType_Sphere:
+  {
+    vec3 vLocal = (_vPosition - _oHittable.oSphere.vCenter) / _oHittable.oSphere.fRadius;
+    float fPhi = atan2f(vLocal.x(), -vLocal.z()) + 3.14159265359f;
+    float fTheta = acosf(vLocal.y() < -1.f ? -1.f : (vLocal.y() > 1.f ? 1.f : vLocal.y()));
+    return vec2(fPhi * _oHittable.oSphere.fRadius, fTheta * _oHittable.oSphere.fRadius);
+  }
+  case HittableType_Plane:
+  {
+    const vec3& vNormal = _oHittable.oPlane.vNormal;
+    vec3 vTangent = Normalize(Cross(fabsf(vNormal.x()) > 0.9f ? vec3(0.f, 1.f, 0.f) : vec3(1.f, 0.f, 0.f), vNormal));
+    vec3 vBitangent = Cross(vNormal, vTangent);
+    return vec2(Dot(_vPosition, vTangent), Dot(_vPosition, vBitangent));
+  }
+  }
+
+  return vec2(0.f, 0.f);
+}
+
+// Returns false for unbounded hittables (planes), which acceleration structures keep out of the hierarchy.
+inline bool GetHittableBounds(const Hittable& _oHittable, AABB& oBounds_)
+{
+  switch (_oHittable.eType)
+  {
+  case HittableType_Sphere:
+  {
+    vec3 vRadius = vec3(_oHittable.oSphere.fRadius, _oHittable.oSphere.fRadius, _oHittable.oSphere.fRadius);
+    oBounds_.vMin = _oHittable.oSphere.vCenter - vRadius;
+    oBounds_.vMax = _oHittable.oSphere.vCenter + vRadius;
+    return true;
+  }
+  case HittableType_Plane:
+    return false;
+  }
+
+  return false;
+}
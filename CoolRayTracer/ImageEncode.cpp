@@ -0,0 +1,72 @@
+#include "ImageEncode.h"
+
+#include "CoolRayTracer.h"
+#include "Renderer.h"
+
+#include <string.h>
+
+static void WriteU16(uint8_t*& pCursor_, uint16_t _uValue)
+{
+  *pCursor_++ = static_cast<uint8_t>(_uValue);
+  *pCursor_++ = static_cast<uint8_t>(_uValue >> 8);
+}
+
+static void WriteU32(uint8_t*& pCursor_, uint32_t _uValue)
+{
+  WriteU16(pCursor_, static_cast<uint16_t>(_uValue));
+  WriteU16(pCursor_, static_cast<uint16_t>(_uValue >> 16));
+}
+
+// Returns where the pixels go
+static uint8_t* WriteBMPHeaders(int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_)
+{
+  constexpr uint32_t uFILE_HEADER_SIZE = 14;
+  constexpr uint32_t uINFO_HEADER_SIZE = 40;
+
+  uint32_t uPixelBytes = static_cast<uint32_t>(_iWidth) * _iHeight * g_uBytesPerPixel;
+  vOutput_.resize(uFILE_HEADER_SIZE + uINFO_HEADER_SIZE + uPixelBytes);
+
+  uint8_t* pCursor = vOutput_.data();
+
+  // BITMAPFILEHEADER
+  WriteU16(pCursor, 0x4D42); // 'BM'
+  WriteU32(pCursor, static_cast<uint32_t>(vOutput_.size()));
+  WriteU32(pCursor, 0);
+  WriteU32(pCursor, uFILE_HEADER_SIZE + uINFO_HEADER_SIZE);
+
+  // BITMAPINFOHEADER, negative height for a top-down bitmap
+  WriteU32(pCursor, uINFO_HEADER_SIZE);
+  WriteU32(pCursor, static_cast<uint32_t>(_iWidth));
+  WriteU32(pCursor, static_cast<uint32_t>(-_iHeight));
+  WriteU16(pCursor, 1);
+  WriteU16(pCursor, 32);
+  memset(pCursor, 0, uINFO_HEADER_SIZE - 16);
+  pCursor += uINFO_HEADER_SIZE - 16;
+  return pCursor;
+}
+
+void StartBMP(int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_, GameScreenBuffer& oPixels_)
+{
+  oPixels_.pData = WriteBMPHeaders(_iWidth, _iHeight, vOutput_);
+  oPixels_.iWidth = _iWidth;
+  oPixels_.iHeight = _iHeight;
+}
+
+void EncodeBMP(const std::vector<color>& _vColors, int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_)
+{
+  GameScreenBuffer oPixels;
+  StartBMP(_iWidth, _iHeight, vOutput_, oPixels);
+  for (int y = 0; y < _iHeight; y++)
+  {
+    for (int x = 0; x < _iWidth; x++)
+    {
+      StorePixel(&oPixels, x, y, _vColors[static_cast<size_t>(y) * _iWidth + x]);
+    }
+  }
+}
+
+void EncodeBMP(const uint8_t* _pPixels, int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_)
+{
+  uint8_t* pPixels = WriteBMPHeaders(_iWidth, _iHeight, vOutput_);
+  memcpy(pPixels, _pPixels, static_cast<size_t>(_iWidth) * _iHeight * g_uBytesPerPixel);
+}
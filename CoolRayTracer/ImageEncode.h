@@ -0,0 +1,18 @@
+#pragma once
+
+#include "CoolRayTracer.h"
+#include "vec3.h"
+
+#include <stdint.h>
+#include <vector>
+
+using color = vec3;
+
+// Top-down 32-bit BMP, the same layout the Win32 layer saves. Colors are linear and gamma encoded here.
+void EncodeBMP(const std::vector<color>& _vColors, int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_);
+
+// Sizes vOutput_ and writes the headers, oPixels_ then takes the pixels with StorePixel
+void StartBMP(int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_, GameScreenBuffer& oPixels_);
+
+// Pixels already gamma encoded in the layout of the back buffer
+void EncodeBMP(const uint8_t* _pPixels, int _iWidth, int _iHeight, std::vector<uint8_t>& vOutput_);
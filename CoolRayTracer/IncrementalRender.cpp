@@ -0,0 +1,227 @@
+#include "IncrementalRender.h"
+
+#include "MathUtils.h"
+
+#include <float.h>
+#include <string.h>
+
+void ResetTileDependencies(const std::vector<ScreenTile>& _vTiles, size_t _uHittableCount, TileDependencies& oDependencies_)
+{
+  size_t uWordsPerTile = (_uHittableCount + 63) / 64;
+  bool bSameTiles = oDependencies_.vTiles.size() == _vTiles.size()
+    && (_vTiles.empty() || memcmp(oDependencies_.vTiles.data(), _vTiles.data(), _vTiles.size() * sizeof(ScreenTile)) == 0);
+  if (bSameTiles && oDependencies_.uWordsPerTile == uWordsPerTile)
+    return;
+
+  oDependencies_.vTiles = _vTiles;
+  oDependencies_.uWordsPerTile = uWordsPerTile;
+  oDependencies_.vBits.assign(_vTiles.size() * uWordsPerTile, 0ull);
+  oDependencies_.bLightTracedCaustics = false;
+}
+
+static bool IsSameVec3(const vec3& _vA, const vec3& _vB)
+{
+  return _vA.x() == _vB.x() && _vA.y() == _vB.y() && _vA.z() == _vB.z();
+}
+
+static bool IsSameHittable(const Hittable& _oA, const Hittable& _oB)
+{
+  if (_oA.eType != _oB.eType)
+    return false;
+  if (_oA.eType == HittableType_Sphere)
+    return IsSameVec3(_oA.oSphere.vCenter, _oB.oSphere.vCenter) && _oA.oSphere.fRadius == _oB.oSphere.fRadius;
+  return IsSameVec3(_oA.oPlane.vNormal, _oB.oPlane.vNormal) && _oA.oPlane.fPoint == _oB.oPlane.fPoint;
+}
+
+static bool IsSameMaterial(const Material& _oA, const Material& _oB)
+{
+  if (_oA.eType != _oB.eType || !IsSameVec3(_oA.vAlbedo, _oB.vAlbedo)
+    || _oA.iAlbedoTexture != _oB.iAlbedoTexture || _oA.fTextureScale != _oB.fTextureScale)
+    return false;
+
+  switch (_oA.eType)
+  {
+  case MaterialType_Metal:
+    return _oA.oMetal.fRoughness == _oB.oMetal.fRoughness;
+  case MaterialType_Dielectric:
+    return _oA.oDielectric.fRefractionIndex == _oB.oDielectric.fRefractionIndex;
+  case MaterialType_Emissive:
+    return _oA.oEmissive.fIntensity == _oB.oEmissive.fIntensity;
+  default:
+    return true;
+  }
+}
+
+static bool IsSameEnvironment(const EnvironmentMap& _oA, const EnvironmentMap& _oB)
+{
+  if (_oA.vMips.size() != _oB.vMips.size() || _oA.fIntensity != _oB.fIntensity)
+    return false;
+  if (_oA.vMips.empty())
+    return true;
+
+  const EnvironmentMip& oA = _oA.vMips[0];
+  const EnvironmentMip& oB = _oB.vMips[0];
+  return oA.iWidth == oB.iWidth && oA.iHeight == oB.iHeight
+    && memcmp(oA.vTexels.data(), oB.vTexels.data(), oA.vTexels.size() * sizeof(color)) == 0;
+}
+
+static bool IsSameLightTable(const LightTable& _oA, const LightTable& _oB)
+{
+  return _oA.vHittableIdx == _oB.vHittableIdx && _oA.vPmf == _oB.vPmf;
+}
+
+// Pixel rectangle a sphere covers, widened by a pixel for the sample jitter. Returns false if part of it is
+// behind the camera, it may then cover anything.
+static bool GetSphereScreenBounds(const Sphere& _oSphere, const Camera& _oCamera, const CameraFrame& _oFrame,
+  float& fMinX_, float& fMinY_, float& fMaxX_, float& fMaxY_)
+{
+  vec3 vRight, vUp, vForward;
+  GetCameraBasis(_oCamera, vRight, vUp, vForward);
+
+  float fInvDeltaX = 1.f / _oFrame.vPixelDeltaX.LengthSqr();
+  float fInvDeltaY = 1.f / _oFrame.vPixelDeltaY.LengthSqr();
+
+  fMinX_ = fMinY_ = FLT_MAX;
+  fMaxX_ = fMaxY_ = -FLT_MAX;
+  for (int iCorner = 0; iCorner < 8; iCorner++)
+  {
+    vec3 vOffset((iCorner & 1) ? _oSphere.fRadius : -_oSphere.fRadius,
+      (iCorner & 2) ? _oSphere.fRadius : -_oSphere.fRadius,
+      (iCorner & 4) ? _oSphere.fRadius : -_oSphere.fRadius);
+    vec3 vToCorner = _oSphere.vCenter + vOffset - _oFrame.vOrigin;
+    float fDepth = Dot(vToCorner, vForward);
+    if (fDepth <= 1e-4f)
+      return false;
+
+    // Onto the image plane at focal length 1, then into pixels
+    vec3 vOnPlane = _oFrame.vOrigin + vToCorner / fDepth - _oFrame.vStartPixel;
+    float fX = Dot(vOnPlane, _oFrame.vPixelDeltaX) * fInvDeltaX;
+    float fY = Dot(vOnPlane, _oFrame.vPixelDeltaY) * fInvDeltaY;
+    fMinX_ = min(fMinX_, fX);
+    fMinY_ = min(fMinY_, fY);
+    fMaxX_ = max(fMaxX_, fX);
+    fMaxY_ = max(fMaxY_, fY);
+  }
+
+  fMinX_ -= 1.f;
+  fMinY_ -= 1.f;
+  fMaxX_ += 1.f;
+  fMaxY_ += 1.f;
+  return true;
+}
+
+static void ClearTile(const ScreenTile& _oTile, AccumulationBuffers& oAccum_)
+{
+  for (int y = _oTile.iStartY; y < _oTile.iEndY; y++)
+  {
+    for (int x = _oTile.iStartX; x < _oTile.iEndX; x++)
+    {
+      size_t uPixelIdx = static_cast<size_t>(y) * oAccum_.iWidth + x;
+      StoreVec3(oAccum_.oColor, uPixelIdx, color(0.f, 0.f, 0.f));
+      StoreVec3(oAccum_.oAlbedo, uPixelIdx, color(0.f, 0.f, 0.f));
+      StoreVec3(oAccum_.oNormal, uPixelIdx, vec3(0.f, 0.f, 0.f));
+      StoreFloat(oAccum_.oDepth, uPixelIdx, 0.f);
+      oAccum_.vHitCount[uPixelIdx] = 0u;
+      oAccum_.vSampleCount[uPixelIdx] = 0u;
+    }
+  }
+}
+
+size_t InvalidateEditedTiles(const Scene& _oOld, const Scene& _oNew, const Camera& _oCamera, TileDependencies& oDependencies_,
+  AccumulationBuffers& oAccum_)
+{
+  size_t uTileCount = oDependencies_.vTiles.size();
+  std::vector<bool> vInvalid(uTileCount, false);
+
+  bool bInvalidateAll = _oOld.vHittables.size() != _oNew.vHittables.size()
+    || _oOld.fAirRefractionIndex != _oNew.fAirRefractionIndex
+    || !IsSameEnvironment(_oOld.oEnvironment, _oNew.oEnvironment);
+
+  // Hittables whose tiles are invalidated, by their old dependencies
+  std::vector<uint32_t> vEdited;
+  bool bAnyMoved = false;
+  CameraFrame oFrame = ComputeCameraFrame(_oCamera, oAccum_.iWidth, oAccum_.iHeight);
+  for (size_t i = 0; i < _oNew.vHittables.size() && !bInvalidateAll; i++)
+  {
+    bool bMoved = !IsSameHittable(_oOld.vHittables[i], _oNew.vHittables[i]);
+    if (!bMoved && IsSameMaterial(_oOld.vMaterials[i], _oNew.vMaterials[i]))
+      continue;
+
+    vEdited.push_back(static_cast<uint32_t>(i));
+    if (!bMoved)
+      continue;
+    bAnyMoved = true;
+
+    // Planes are unbounded, a moved one can show up anywhere
+    const Hittable& oHittable = _oNew.vHittables[i];
+    float fMinX, fMinY, fMaxX, fMaxY;
+    if (oHittable.eType != HittableType_Sphere || !GetSphereScreenBounds(oHittable.oSphere, _oCamera, oFrame, fMinX, fMinY, fMaxX, fMaxY))
+    {
+      bInvalidateAll = true;
+      break;
+    }
+
+    for (size_t uTile = 0; uTile < uTileCount; uTile++)
+    {
+      const ScreenTile& oTile = oDependencies_.vTiles[uTile];
+      if (fMaxX >= oTile.iStartX && fMinX < oTile.iEndX && fMaxY >= oTile.iStartY && fMinY < oTile.iEndY)
+      {
+        vInvalid[uTile] = true;
+      }
+    }
+  }
+
+  // Light picking probabilities change with any light power, every tile sampling a light sees that
+  bool bLightsChanged = !IsSameLightTable(_oOld.oLights, _oNew.oLights);
+  if (!bInvalidateAll && bLightsChanged)
+  {
+    vEdited.insert(vEdited.end(), _oOld.oLights.vHittableIdx.begin(), _oOld.oLights.vHittableIdx.end());
+    vEdited.insert(vEdited.end(), _oNew.oLights.vHittableIdx.begin(), _oNew.oLights.vHittableIdx.end());
+  }
+
+  // Light paths splat anywhere on screen, so kept pixels hold caustics of the old scene wherever an edit lands
+  bInvalidateAll = bInvalidateAll || (oDependencies_.bLightTracedCaustics && (!vEdited.empty() || bLightsChanged));
+
+  // A moved hittable can cast new shadows and show in new reflections wherever a path left its first hit. Paths
+  // only end there on emissive hittables and misses, every other hittable a tile depends on sent rays onwards.
+  std::vector<uint64_t> vScatterMask;
+  if (!bInvalidateAll && bAnyMoved)
+  {
+    vScatterMask.assign(oDependencies_.uWordsPerTile, 0ull);
+    for (size_t i = 0; i < _oOld.vMaterials.size(); i++)
+    {
+      if (_oOld.vMaterials[i].eType != MaterialType_Emissive)
+      {
+        vScatterMask[i >> 6] |= 1ull << (i & 63u);
+      }
+    }
+  }
+
+  size_t uInvalidCount = 0;
+  for (size_t uTile = 0; uTile < uTileCount; uTile++)
+  {
+    uint64_t* pBits = GetTileDependencyBits(oDependencies_, uTile);
+    bool bInvalid = bInvalidateAll || vInvalid[uTile];
+    for (size_t uWord = 0; uWord < vScatterMask.size() && !bInvalid; uWord++)
+    {
+      bInvalid = (pBits[uWord] & vScatterMask[uWord]) != 0;
+    }
+    for (size_t j = 0; j < vEdited.size() && !bInvalid; j++)
+    {
+      bInvalid = (pBits[vEdited[j] >> 6] >> (vEdited[j] & 63u)) & 1ull;
+    }
+    if (!bInvalid)
+      continue;
+
+    memset(pBits, 0, oDependencies_.uWordsPerTile * sizeof(uint64_t));
+    ClearTile(oDependencies_.vTiles[uTile], oAccum_);
+    uInvalidCount++;
+  }
+
+  // Bits past the old hittable count do not exist yet
+  if (_oOld.vHittables.size() != _oNew.vHittables.size())
+  {
+    ResetTileDependencies(oDependencies_.vTiles, _oNew.vHittables.size(), oDependencies_);
+  }
+  return uInvalidCount;
+}
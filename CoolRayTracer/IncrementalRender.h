@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Camera.h"
+#include "Scene.h"
+#include "TileOrder.h"
+#include "RenderBuffers.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Hittables each tile of a progressive render depends on: hit by any bounce, sampled as a light or blocking a
+// shadow ray. Bits are only added while the tile renders and cleared when it is invalidated.
+struct TileDependencies
+{
+  std::vector<ScreenTile> vTiles;
+  size_t uWordsPerTile = 0;
+  std::vector<uint64_t> vBits; // uWordsPerTile words per tile
+  bool bLightTracedCaustics = false; // Some kept samples hold light path splats, which depend on the whole scene
+};
+
+// Keeps the bits if the tiles and hittable count match, clears them otherwise
+void ResetTileDependencies(const std::vector<ScreenTile>& _vTiles, size_t _uHittableCount, TileDependencies& oDependencies_);
+
+inline uint64_t* GetTileDependencyBits(TileDependencies& oDependencies_, size_t _uTileIdx)
+{
+  return oDependencies_.vBits.data() + _uTileIdx * oDependencies_.uWordsPerTile;
+}
+
+// Compares two versions of a scene and clears the means of every tile the edit can change: the tiles that depended
+// on an edited hittable or material, and the tiles the new bounds of a moved sphere cover on screen. A moved
+// hittable also clears every tile whose paths went past their first hit, since its shadows and reflections can
+// land on any of them. A change to the light powers touches the tiles that sampled any light, changes to the
+// environment, the air or the hittable count touch every tile, and so does any edit once light traced caustics
+// were accumulated. Without path guiding the kept tiles then match a full render of the new scene bit for bit.
+// Returns the number of tiles cleared.
+size_t InvalidateEditedTiles(const Scene& _oOld, const Scene& _oNew, const Camera& _oCamera, TileDependencies& oDependencies_,
+  AccumulationBuffers& oAccum_);
@@ -0,0 +1,201 @@
+#include "LightTracing.h"
+
+#include "FastMath.h"
+#include "MathUtils.h"
+#include "Parallel.h"
+#include "PerfCounters.h"
+#include "Renderer.h"
+#include "SampleWarp.h"
+#include "Sampler.h"
+#include "TextureCache.h"
+
+#include <atomic>
+#include <math.h>
+
+// Value a diffuse point lit from the front adds to the pixel the camera sees it through, false if it is outside the
+// image or hidden. The camera samples a pixel uniformly over its square on the image plane at distance 1, so the
+// value is the reflected radiance over the pixel area, the distance squared and the cube of the cosine to the view
+// axis. Like the camera paths, the surface reflects to both sides.
+static bool ConnectToCamera(const Scene& _oScene, const CameraFrame& _oFrame, int _iWidth, int _iHeight, const vec3& _vPosition,
+  const vec3& _vNormal, const color& _vReflected, uint32_t& uPixelIdx_, color& vValue_)
+{
+  vec3 vToCamera = _oFrame.vOrigin - _vPosition;
+  float fDistance = vToCamera.Length();
+  vToCamera = vToCamera / fDistance;
+
+  vec3 vForward = Normalize(Cross(_oFrame.vPixelDeltaX, _oFrame.vPixelDeltaY));
+  float fCosView = -Dot(vToCamera, vForward);
+  if (fCosView <= 0.f)
+    return false;
+
+  vec3 vOnPlane = -vToCamera / fCosView - (_oFrame.vStartPixel - _oFrame.vOrigin);
+  int iX = FloorToInt(Dot(vOnPlane, _oFrame.vPixelDeltaX) / _oFrame.vPixelDeltaX.LengthSqr() + 0.5f);
+  int iY = FloorToInt(Dot(vOnPlane, _oFrame.vPixelDeltaY) / _oFrame.vPixelDeltaY.LengthSqr() + 0.5f);
+  if (iX < 0 || iY < 0 || iX >= _iWidth || iY >= _iHeight)
+    return false;
+
+  float fCosSurface = Dot(vToCamera, _vNormal);
+  ray oShadowRay(_vPosition + (fCosSurface > 0.f ? _vNormal : -_vNormal) * 0.001f, vToCamera);
+  if (OccludedWideBVH(_oScene.oBVH, _oScene.vHittables, oShadowRay, fDistance - 0.002f))
+    return false;
+
+  float fPixelArea = _oFrame.vPixelDeltaX.Length() * _oFrame.vPixelDeltaY.Length();
+  uPixelIdx_ = static_cast<uint32_t>(iY) * static_cast<uint32_t>(_iWidth) + static_cast<uint32_t>(iX);
+  vValue_ = _vReflected * (fabsf(fCosSurface) / (fPixelArea * fCosView * fCosView * fCosView * fDistance * fDistance));
+  return true;
+}
+
+// A sphere light picked by power, specular bounces up to the first diffuse surface, then any bounces, with every
+// diffuse surface connected to the camera. Paths whose first bounce is diffuse are left to the camera paths' light
+// sampling. Splats go to the list of their band.
+static void TraceLightPath(const Scene& _oScene, const CameraFrame& _oFrame, int _iWidth, int _iHeight, int _iMaxBounces,
+  uint32_t _uBandPixels, std::vector<LightSplat>* pLists_)
+{
+  float fPickPmf;
+  uint32_t uLight = SampleLightTable(_oScene.oLights, Random(), fPickPmf);
+  uint32_t uLightIdx = _oScene.oLights.vHittableIdx[uLight];
+  const Sphere& oSphere = _oScene.vHittables[uLightIdx].oSphere;
+
+  // Uniform point on the sphere, cosine weighted direction around its normal
+  float fZ = 1.f - 2.f * Random();
+  float fRadial = sqrtf(max(0.f, 1.f - fZ * fZ));
+  float fSin, fCos;
+  SinCos(2.f * fPI * Random(), fSin, fCos);
+  vec3 vLightNormal = vec3(fRadial * fCos, fRadial * fSin, fZ);
+  float fRandom1 = Random();
+  float fRandom2 = Random();
+  vec3 vDir = TangentToWorld(Normalize(SampleHemisphereCosinePolynomial(fRandom1, fRandom2)), vLightNormal);
+
+  // Emitted radiance over the pick, area and direction densities, the cosines cancel
+  float fArea = 4.f * fPI * oSphere.fRadius * oSphere.fRadius;
+  color vPower = GetEmission(_oScene.vMaterials[uLightIdx]) * (fPI * fArea / fPickPmf);
+  ray oRay(oSphere.vCenter + vLightNormal * (oSphere.fRadius + 0.001f), vDir);
+
+  // Camera paths have at most _iMaxBounces + 1 surface hits before the light
+  bool bSpecularStart = false;
+  for (int iHit = 0; iHit <= _iMaxBounces; iHit++)
+  {
+    HitInfo oHitInfo = {};
+    int iHittableIdx = IntersectWideBVH(_oScene.oBVH, _oScene.vHittables, oRay, oHitInfo);
+    if (iHittableIdx < 0)
+      return;
+
+    const Material& oMaterial = _oScene.vMaterials[iHittableIdx];
+    if (oMaterial.eType == MaterialType_Emissive)
+      return;
+
+    vec3 vHitPosition = oRay.vOrigin + (oHitInfo.fT * oRay.vDir);
+    color vAlbedo = oMaterial.vAlbedo;
+    if (oMaterial.iAlbedoTexture >= 0)
+    {
+      vec2 vUV = GetHittableUV(_oScene.vHittables[iHittableIdx], vHitPosition) / oMaterial.fTextureScale;
+      vAlbedo = vAlbedo * SampleTexture(*_oScene.pTextures, static_cast<uint32_t>(oMaterial.iAlbedoTexture), vUV.x(), vUV.y(), 0.f);
+    }
+
+    vec3 vOutRay;
+    if (oMaterial.eType == MaterialType_Lambertian)
+    {
+      // Camera paths only gather light from the front of a diffuse surface
+      if (!bSpecularStart || Dot(oRay.vDir, oHitInfo.vNormal) >= 0.f)
+        return;
+
+      LightSplat oSplat;
+      if (ConnectToCamera(_oScene, _oFrame, _iWidth, _iHeight, vHitPosition, oHitInfo.vNormal, vPower * (vAlbedo / fPI),
+        oSplat.uPixelIdx, oSplat.vValue))
+      {
+        pLists_[oSplat.uPixelIdx / _uBandPixels].push_back(oSplat);
+      }
+      float fRandomU = Random();
+      float fRandomV = Random();
+      vOutRay = TangentToWorld(Normalize(SampleHemisphereCosinePolynomial(fRandomU, fRandomV)), oHitInfo.vNormal);
+    }
+    else
+    {
+      bSpecularStart = true;
+      vOutRay = GetSpecularDirection(_oScene, oMaterial, oRay.vDir, oHitInfo.vNormal);
+    }
+
+    vec3 vBias = Dot(vOutRay, oHitInfo.vNormal) > 0.0f
+      ? oHitInfo.vNormal * 0.001f
+      : -oHitInfo.vNormal * 0.001f;
+    oRay = ray(vHitPosition + vBias, vOutRay);
+    vPower = vPower * vAlbedo;
+  }
+}
+
+void TraceLightPass(const Scene& _oScene, const CameraFrame& _oFrame, int _iWidth, int _iHeight, int _iMaxBounces, uint32_t _uPass,
+  uint32_t _uPathCount, int _iThreadCount, LightSplatBuffers& oSplats_)
+{
+  // Enough bands to keep every thread busy in the reduction
+  int iBandCount = _iThreadCount * 4 < _iHeight ? _iThreadCount * 4 : _iHeight;
+  oSplats_.uBatchCount = (_uPathCount + g_uLightPathsPerBatch - 1) / g_uLightPathsPerBatch;
+  oSplats_.iBandRows = (_iHeight + iBandCount - 1) / iBandCount;
+  oSplats_.uBandCount = static_cast<uint32_t>((_iHeight + oSplats_.iBandRows - 1) / oSplats_.iBandRows);
+  oSplats_.vSplats.resize(static_cast<size_t>(oSplats_.uBatchCount) * oSplats_.uBandCount);
+  for (std::vector<LightSplat>& vList : oSplats_.vSplats)
+  {
+    vList.clear();
+  }
+
+  uint32_t uBandPixels = static_cast<uint32_t>(oSplats_.iBandRows) * static_cast<uint32_t>(_iWidth);
+  std::atomic<uint32_t> uNextBatch = 0;
+  ParallelForChunks(_iThreadCount, _iThreadCount, [&](int, int, int)
+    {
+      while (true)
+      {
+        uint32_t uBatch = uNextBatch++;
+        if (uBatch >= oSplats_.uBatchCount)
+          break;
+
+        std::vector<LightSplat>* pLists = oSplats_.vSplats.data() + static_cast<size_t>(uBatch) * oSplats_.uBandCount;
+        uint32_t uEnd = (uBatch + 1) * g_uLightPathsPerBatch < _uPathCount ? (uBatch + 1) * g_uLightPathsPerBatch : _uPathCount;
+        for (uint32_t uPath = uBatch * g_uLightPathsPerBatch; uPath < uEnd; uPath++)
+        {
+          SeedLightPathSampler(uPath, _uPass);
+          TraceLightPath(_oScene, _oFrame, _iWidth, _iHeight, _iMaxBounces, uBandPixels, pLists);
+        }
+      }
+      FlushRenderCounters();
+    });
+}
+
+void AddLightSplats(const LightSplatBuffers& _oSplats, uint32_t _uPathCount, uint32_t _uTargetSamples, int _iThreadCount,
+  AccumulationBuffers& oAccum_)
+{
+  float fScale = 1.f / static_cast<float>(_uPathCount);
+  size_t uPixelCount = oAccum_.vSampleCount.size();
+  size_t uBandPixels = static_cast<size_t>(_oSplats.iBandRows) * oAccum_.iWidth;
+  ParallelForChunks(static_cast<int>(_oSplats.uBandCount), _iThreadCount, [&](int _iBegin, int _iEnd, int)
+    {
+      // Summed in floats first, each pixel then takes a single rounded update
+      std::vector<color> vBandSums(uBandPixels);
+      for (int iBand = _iBegin; iBand < _iEnd; iBand++)
+      {
+        size_t uBandBegin = static_cast<size_t>(iBand) * uBandPixels;
+        size_t uBandEnd = uBandBegin + uBandPixels < uPixelCount ? uBandBegin + uBandPixels : uPixelCount;
+        for (size_t i = 0; i < uBandEnd - uBandBegin; i++)
+        {
+          vBandSums[i] = color(0.f, 0.f, 0.f);
+        }
+
+        for (uint32_t uBatch = 0; uBatch < _oSplats.uBatchCount; uBatch++)
+        {
+          for (const LightSplat& oSplat : _oSplats.vSplats[static_cast<size_t>(uBatch) * _oSplats.uBandCount + iBand])
+          {
+            vBandSums[oSplat.uPixelIdx - uBandBegin] += oSplat.vValue * fScale;
+          }
+        }
+
+        for (size_t uPixelIdx = uBandBegin; uPixelIdx < uBandEnd; uPixelIdx++)
+        {
+          const color& vSum = vBandSums[uPixelIdx - uBandBegin];
+          uint32_t uSamples = oAccum_.vSampleCount[uPixelIdx];
+          if (uSamples < _uTargetSamples && (vSum.r() > 0.f || vSum.g() > 0.f || vSum.b() > 0.f))
+          {
+            uint64_t uRounding = MixSamplerBits(GetRoundingBits(uPixelIdx, uSamples) + 4);
+            StoreVec3Stochastic(oAccum_.oColor, uPixelIdx, AddToNextValue(LoadVec3(oAccum_.oColor, uPixelIdx), uSamples, vSum), uRounding);
+          }
+        }
+      }
+    });
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Camera.h"
+#include "RenderBuffers.h"
+#include "Scene.h"
+
+#include <stdint.h>
+#include <vector>
+
+static constexpr uint32_t g_uLightPathsPerBatch = 4096;
+
+struct LightSplat
+{
+  uint32_t uPixelIdx;
+  color vValue;
+};
+
+// Splats of one pass of light paths. The paths are traced in fixed batches and every batch files its splats by
+// band of rows, so threads never write to shared pixels. Each band is then summed by one thread in batch order,
+// which gives the same sums whatever the thread count.
+struct LightSplatBuffers
+{
+  uint32_t uBatchCount = 0;
+  uint32_t uBandCount = 0;
+  int iBandRows = 1;
+  std::vector<std::vector<LightSplat>> vSplats; // uBandCount lists per batch
+};
+
+// Traces _uPathCount light paths, seeded from their index and _uPass. A path counts once it has bounced off a metal
+// or dielectric before its first diffuse surface, from then on every diffuse surface it reaches is connected to the
+// camera. Those are the paths camera paths leave out while t_bLightTracedCaustics is set.
+void TraceLightPass(const Scene& _oScene, const CameraFrame& _oFrame, int _iWidth, int _iHeight, int _iMaxBounces, uint32_t _uPass,
+  uint32_t _uPathCount, int _iThreadCount, LightSplatBuffers& oSplats_);
+
+// Adds the splats over the path count to the next sample of the pixels below _uTargetSamples, the ones the camera
+// pass that follows samples, so the light and camera estimates stay paired one to one
+void AddLightSplats(const LightSplatBuffers& _oSplats, uint32_t _uPathCount, uint32_t _uTargetSamples, int _iThreadCount,
+  AccumulationBuffers& oAccum_);
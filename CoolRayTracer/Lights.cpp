@@ -0,0 +1,124 @@
+#include "Lights.h"
+
+#include "MathUtils.h"
+
+#include <math.h>
+
+void BuildLightTable(const std::vector<uint32_t>& _vHittableIdx, const std::vector<float>& _vPower, size_t _uHittableCount, LightTable& oTable_)
+{
+  oTable_ = {};
+  oTable_.vLightOfHittable.assign(_uHittableCount, -1);
+
+  float fTotalPower = 0.f;
+  for (size_t i = 0; i < _vHittableIdx.size(); i++)
+  {
+    if (_vPower[i] > 0.f)
+    {
+      oTable_.vHittableIdx.push_back(_vHittableIdx[i]);
+      oTable_.vPmf.push_back(_vPower[i]);
+      fTotalPower += _vPower[i];
+    }
+  }
+
+  size_t uCount = oTable_.vHittableIdx.size();
+  if (uCount == 0)
+    return;
+
+  for (size_t i = 0; i < uCount; i++)
+  {
+    oTable_.vPmf[i] /= fTotalPower;
+    oTable_.vLightOfHittable[oTable_.vHittableIdx[i]] = static_cast<int32_t>(i);
+  }
+
+  // Vose: scaled probabilities under 1 get topped up by one light that is over 1
+  std::vector<float> vScaled(uCount);
+  std::vector<uint32_t> vSmall, vLarge;
+  for (size_t i = 0; i < uCount; i++)
+  {
+    vScaled[i] = oTable_.vPmf[i] * uCount;
+    (vScaled[i] < 1.f ? vSmall : vLarge).push_back(static_cast<uint32_t>(i));
+  }
+
+  oTable_.vAlias.resize(uCount);
+  while (!vSmall.empty() && !vLarge.empty())
+  {
+    uint32_t uSmall = vSmall.back();
+    vSmall.pop_back();
+    uint32_t uLarge = vLarge.back();
+
+    oTable_.vAlias[uSmall] = { vScaled[uSmall], uLarge };
+    vScaled[uLarge] -= 1.f - vScaled[uSmall];
+    if (vScaled[uLarge] < 1.f)
+    {
+      vLarge.pop_back();
+      vSmall.push_back(uLarge);
+    }
+  }
+
+  // Leftovers are 1 up to rounding
+  for (uint32_t uIdx : vSmall)
+  {
+    oTable_.vAlias[uIdx] = { 1.f, uIdx };
+  }
+  for (uint32_t uIdx : vLarge)
+  {
+    oTable_.vAlias[uIdx] = { 1.f, uIdx };
+  }
+}
+
+uint32_t SampleLightTable(const LightTable& _oTable, float _fRandom, float& fPmf_)
+{
+  size_t uCount = _oTable.vAlias.size();
+  float fScaled = _fRandom * uCount;
+  size_t uBucket = static_cast<size_t>(fScaled);
+  uBucket = uBucket < uCount ? uBucket : uCount - 1;
+
+  const LightAliasEntry& oEntry = _oTable.vAlias[uBucket];
+  uint32_t uLight = (fScaled - uBucket) < oEntry.fProbability ? static_cast<uint32_t>(uBucket) : oEntry.uAlias;
+
+  fPmf_ = _oTable.vPmf[uLight];
+  return uLight;
+}
+
+// 1 - cos of the cone half angle, written so it does not cancel to 0 for small or distant spheres
+static float GetOneMinusCosThetaMax(float _fRadiusSqr, float _fDistSqr)
+{
+  float fSinSqr = _fRadiusSqr / _fDistSqr;
+  return fSinSqr / (1.f + sqrtf(1.f - fSinSqr));
+}
+
+bool SampleSphereLight(const Sphere& _oSphere, const vec3& _vPosition, float _fRandom1, float _fRandom2, vec3& vDir_, float& fDistance_, float& fPdf_)
+{
+  vec3 vToCenter = _oSphere.vCenter - _vPosition;
+  float fDistSqr = vToCenter.LengthSqr();
+  float fRadiusSqr = _oSphere.fRadius * _oSphere.fRadius;
+  if (fDistSqr <= fRadiusSqr)
+    return false;
+
+  float fOneMinusCosMax = GetOneMinusCosThetaMax(fRadiusSqr, fDistSqr);
+  float fOneMinusCos = _fRandom1 * fOneMinusCosMax;
+  float fCosTheta = 1.f - fOneMinusCos;
+  float fSinTheta = sqrtf(max(0.f, fOneMinusCos * (2.f - fOneMinusCos)));
+  float fPhi = 2.f * fPI * _fRandom2;
+
+  float fSinPhi, fCosPhi;
+  SinCos(fPhi, fSinPhi, fCosPhi);
+  vDir_ = TangentToWorld(vec3(fCosPhi * fSinTheta, fSinPhi * fSinTheta, fCosTheta), vToCenter / sqrtf(fDistSqr));
+
+  // From the ray's closest approach to the center, cancels less than going through fCosTheta
+  float fAlong = Dot(vToCenter, vDir_);
+  float fPerpSqr = (vToCenter - fAlong * vDir_).LengthSqr();
+  fDistance_ = fAlong - sqrtf(max(0.f, fRadiusSqr - fPerpSqr));
+  fPdf_ = 1.f / (2.f * fPI * fOneMinusCosMax);
+  return true;
+}
+
+float GetSphereLightPdf(const Sphere& _oSphere, const vec3& _vPosition)
+{
+  float fDistSqr = (_oSphere.vCenter - _vPosition).LengthSqr();
+  float fRadiusSqr = _oSphere.fRadius * _oSphere.fRadius;
+  if (fDistSqr <= fRadiusSqr)
+    return 0.f;
+
+  return 1.f / (2.f * fPI * GetOneMinusCosThetaMax(fRadiusSqr, fDistSqr));
+}
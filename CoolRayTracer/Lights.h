@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vec3.h"
+#include "Hittable.h"
+
+#include <stdint.h>
+#include <vector>
+
+using color = vec3;
+
+// One bucket of Vose's alias method: keep the bucket's own light with fProbability, else take uAlias
+struct LightAliasEntry
+{
+  float fProbability;
+  uint32_t uAlias;
+};
+
+// Emissive spheres picked in proportion to their power, O(1) per pick whatever the light count
+struct LightTable
+{
+  std::vector<uint32_t> vHittableIdx;
+  std::vector<float> vPmf;
+  std::vector<LightAliasEntry> vAlias;
+  std::vector<int32_t> vLightOfHittable; // -1 for hittables that are not sampled lights
+};
+
+void BuildLightTable(const std::vector<uint32_t>& _vHittableIdx, const std::vector<float>& _vPower, size_t _uHittableCount, LightTable& oTable_);
+
+// Returns the picked light index, its selection probability goes to fPmf_
+uint32_t SampleLightTable(const LightTable& _oTable, float _fRandom, float& fPmf_);
+
+// Uniform sampling of the cone of directions the sphere subtends from _vPosition, fDistance_ is the distance to
+// the near side of the sphere along vDir_. Returns false from inside the sphere.
+bool SampleSphereLight(const Sphere& _oSphere, const vec3& _vPosition, float _fRandom1, float _fRandom2, vec3& vDir_, float& fDistance_, float& fPdf_);
+
+// Solid angle density of SampleSphereLight for any direction that hits the sphere
+float GetSphereLightPdf(const Sphere& _oSphere, const vec3& _vPosition);
+
+inline float PowerHeuristic(float _fPdf, float _fOtherPdf)
+{
+  float fSqr = _fPdf * _fPdf;
+  float fOtherSqr = _fOtherPdf * _fOtherPdf;
+  return fSqr + fOtherSqr > 0.f ? fSqr / (fSqr + fOtherSqr) : 0.f;
+}
+
+inline float Luminance(const color& _vColor)
+{
+  return 0.2126f * _vColor.x() + 0.7152f * _vColor.y() + 0.0722f * _vColor.z();
+}
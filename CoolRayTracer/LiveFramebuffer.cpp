@@ -0,0 +1,444 @@
+#include "LiveFramebuffer.h"
+
+#include "CoolRayTracer.h"
+#include "Renderer.h"
+
+#include <atomic>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Shared with other processes, so the atomics must not fall back to locks living in this one
+static_assert(std::atomic_ref<uint32_t>::is_always_lock_free && std::atomic_ref<uint64_t>::is_always_lock_free,
+  "live framebuffer counters need lock free atomics");
+
+static constexpr uint64_t uLIVE_ALIGNMENT = 64;
+
+static uint64_t AlignLiveOffset(uint64_t _uOffset)
+{
+  return (_uOffset + uLIVE_ALIGNMENT - 1) & ~(uLIVE_ALIGNMENT - 1);
+}
+
+// Readers map the segment read only, loads through atomic_ref do not write on the targets this builds for
+template <typename T>
+static T LoadShared(const uint8_t* _pData, size_t _uOffset, std::memory_order _eOrder)
+{
+  return std::atomic_ref<T>(*reinterpret_cast<T*>(const_cast<uint8_t*>(_pData + _uOffset))).load(_eOrder);
+}
+
+template <typename T>
+static std::atomic_ref<T> GetShared(uint8_t* _pData, size_t _uOffset)
+{
+  return std::atomic_ref<T>(*reinterpret_cast<T*>(_pData + _uOffset));
+}
+
+static LiveFramebufferHeader& GetLiveHeader(uint8_t* _pData)
+{
+  return *reinterpret_cast<LiveFramebufferHeader*>(_pData);
+}
+
+#if defined(_WIN32)
+
+static int OpenSegment(const char*, bool)
+{
+  return -1;
+}
+
+static uint64_t GetSegmentBytes(int)
+{
+  return 0;
+}
+
+static bool GrowSegment(int, uint64_t)
+{
+  return false;
+}
+
+static uint8_t* MapSegment(int, size_t, bool)
+{
+  return nullptr;
+}
+
+static void UnmapSegment(uint8_t*, size_t)
+{
+}
+
+static void CloseSegment(int)
+{
+}
+
+static void UnlinkSegment(const char*)
+{
+}
+
+static uint32_t GetProcessId()
+{
+  return 0;
+}
+
+static bool IsProcessAlive(uint32_t)
+{
+  return true;
+}
+
+#else
+
+static int OpenSegment(const char* _sName, bool _bWritable)
+{
+  return _bWritable ? shm_open(_sName, O_RDWR | O_CREAT, 0644) : shm_open(_sName, O_RDONLY, 0);
+}
+
+static uint64_t GetSegmentBytes(int _iFile)
+{
+  struct stat oStat;
+  return fstat(_iFile, &oStat) == 0 ? static_cast<uint64_t>(oStat.st_size) : 0;
+}
+
+static bool GrowSegment(int _iFile, uint64_t _uBytes)
+{
+  return ftruncate(_iFile, static_cast<off_t>(_uBytes)) == 0;
+}
+
+static uint8_t* MapSegment(int _iFile, size_t _uBytes, bool _bWritable)
+{
+  void* pData = mmap(nullptr, _uBytes, _bWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _iFile, 0);
+  return pData == MAP_FAILED ? nullptr : static_cast<uint8_t*>(pData);
+}
+
+static void UnmapSegment(uint8_t* _pData, size_t _uBytes)
+{
+  munmap(_pData, _uBytes);
+}
+
+static void CloseSegment(int _iFile)
+{
+  close(_iFile);
+}
+
+static void UnlinkSegment(const char* _sName)
+{
+  shm_unlink(_sName);
+}
+
+static uint32_t GetProcessId()
+{
+  return static_cast<uint32_t>(getpid());
+}
+
+static bool IsProcessAlive(uint32_t _uProcess)
+{
+  return kill(static_cast<pid_t>(_uProcess), 0) == 0 || errno != ESRCH;
+}
+
+#endif
+
+// Replaces the mapping with one of the whole segment once it is at least _uBytes long
+static bool RemapSegment(int _iFile, uint64_t _uBytes, bool _bWritable, uint8_t*& pData_, size_t& uMappedBytes_)
+{
+  uint64_t uSegmentBytes = GetSegmentBytes(_iFile);
+  if (uSegmentBytes < _uBytes)
+  {
+    if (!_bWritable || !GrowSegment(_iFile, _uBytes))
+      return false;
+    uSegmentBytes = _uBytes;
+  }
+
+  uint8_t* pData = MapSegment(_iFile, static_cast<size_t>(uSegmentBytes), _bWritable);
+  if (!pData)
+    return false;
+
+  if (pData_)
+  {
+    UnmapSegment(pData_, uMappedBytes_);
+  }
+  pData_ = pData;
+  uMappedBytes_ = static_cast<size_t>(uSegmentBytes);
+  return true;
+}
+
+bool CreateLiveFramebuffer(const char* _sName, LivePixelFormat _eFormat, LiveFramebuffer& oFramebuffer_, std::string& sError_)
+{
+  CloseLiveFramebuffer(oFramebuffer_);
+
+  int iFile = OpenSegment(_sName, true);
+  if (iFile < 0)
+  {
+    sError_ = "could not create shared memory segment";
+    return false;
+  }
+
+  oFramebuffer_.sName = _sName;
+  oFramebuffer_.eFormat = _eFormat;
+  oFramebuffer_.iFile = iFile;
+  if (!RemapSegment(iFile, AlignLiveOffset(sizeof(LiveFramebufferHeader)), true, oFramebuffer_.pData, oFramebuffer_.uMappedBytes))
+  {
+    sError_ = "could not map shared memory segment";
+    CloseLiveFramebuffer(oFramebuffer_);
+    return false;
+  }
+
+  // No frame until the first reset, a segment left behind by an earlier render is taken over
+  uint8_t* pData = oFramebuffer_.pData;
+  std::atomic_ref<uint32_t> aLayout = GetShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uLayoutVersion));
+  aLayout.store(aLayout.load(std::memory_order_relaxed) | 1u, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  GetLiveHeader(pData).uMagic = g_uLiveFramebufferMagic;
+  GetLiveHeader(pData).uVersion = g_uLiveFramebufferVersion;
+  GetLiveHeader(pData).uWriterProcess = GetProcessId();
+  return true;
+}
+
+bool ResetLiveFramebuffer(LiveFramebuffer& oFramebuffer_, int _iWidth, int _iHeight, const std::vector<ScreenTile>& _vTiles,
+  uint32_t _uTargetSamplesPerPixel, std::string& sError_)
+{
+  if (!oFramebuffer_.pData)
+  {
+    sError_ = "live framebuffer is not open";
+    return false;
+  }
+
+  uint64_t uTileCount = _vTiles.size();
+  uint64_t uTilesOffset = AlignLiveOffset(sizeof(LiveFramebufferHeader));
+  uint64_t uVersionsOffset = AlignLiveOffset(uTilesOffset + uTileCount * sizeof(LiveTile));
+  uint64_t uCompletionOffset = AlignLiveOffset(uVersionsOffset + uTileCount * sizeof(uint32_t));
+  uint64_t uPixelsOffset = AlignLiveOffset(uCompletionOffset + (uTileCount + 63) / 64 * sizeof(uint64_t));
+  uint64_t uPixelBytes = static_cast<uint64_t>(_iWidth) * _iHeight * GetLivePixelBytes(oFramebuffer_.eFormat);
+  uint64_t uTotalBytes = uPixelsOffset + uPixelBytes;
+
+  // Odd while the frame is laid out, readers drop whatever they copied meanwhile
+  size_t uLayoutOffset = offsetof(LiveFramebufferHeader, uLayoutVersion);
+  uint32_t uLayoutVersion = GetShared<uint32_t>(oFramebuffer_.pData, uLayoutOffset).load(std::memory_order_relaxed) | 1u;
+  GetShared<uint32_t>(oFramebuffer_.pData, uLayoutOffset).store(uLayoutVersion, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (uTotalBytes > oFramebuffer_.uMappedBytes
+    && !RemapSegment(oFramebuffer_.iFile, uTotalBytes, true, oFramebuffer_.pData, oFramebuffer_.uMappedBytes))
+  {
+    sError_ = "could not grow shared memory segment";
+    return false;
+  }
+
+  uint8_t* pData = oFramebuffer_.pData;
+  LiveFramebufferHeader& oHeader = GetLiveHeader(pData);
+  oHeader.uFormat = static_cast<uint32_t>(oFramebuffer_.eFormat);
+  oHeader.iWidth = _iWidth;
+  oHeader.iHeight = _iHeight;
+  oHeader.uTileCount = static_cast<uint32_t>(uTileCount);
+  oHeader.uTotalBytes = uTotalBytes;
+  oHeader.uTilesOffset = uTilesOffset;
+  oHeader.uTileVersionsOffset = uVersionsOffset;
+  oHeader.uCompletionOffset = uCompletionOffset;
+  oHeader.uPixelsOffset = uPixelsOffset;
+  oHeader.uTargetSamplesPerPixel = _uTargetSamplesPerPixel;
+  GetShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uState)).store(LiveRenderState_Rendering, std::memory_order_relaxed);
+  GetShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uSamplesPerPixel)).store(0u, std::memory_order_relaxed);
+  GetShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uCompletedTiles)).store(0u, std::memory_order_relaxed);
+
+  LiveTile* pTiles = reinterpret_cast<LiveTile*>(pData + uTilesOffset);
+  for (size_t i = 0; i < _vTiles.size(); i++)
+  {
+    pTiles[i] = { _vTiles[i].iStartX, _vTiles[i].iStartY, _vTiles[i].iEndX, _vTiles[i].iEndY };
+  }
+  memset(pData + uVersionsOffset, 0, uPixelsOffset - uVersionsOffset);
+  memset(pData + uPixelsOffset, 0, uPixelBytes);
+
+  GetShared<uint32_t>(pData, uLayoutOffset).store(uLayoutVersion + 1, std::memory_order_release);
+  GetShared<uint64_t>(pData, offsetof(LiveFramebufferHeader, uUpdateCount)).fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void PublishLiveTile(LiveFramebuffer& oFramebuffer_, uint32_t _uTileIdx, const color* _pColors, size_t _uRowStride, bool _bFinal)
+{
+  uint8_t* pData = oFramebuffer_.pData;
+  const LiveFramebufferHeader& oHeader = GetLiveHeader(pData);
+  const LiveTile& oTile = reinterpret_cast<const LiveTile*>(pData + oHeader.uTilesOffset)[_uTileIdx];
+
+  // Each tile has one writer at a time, the counter is odd while its pixels change
+  std::atomic_ref<uint32_t> aVersion = GetShared<uint32_t>(pData, oHeader.uTileVersionsOffset + _uTileIdx * sizeof(uint32_t));
+  uint32_t uVersion = aVersion.load(std::memory_order_relaxed);
+  aVersion.store(uVersion + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint8_t* pPixels = pData + oHeader.uPixelsOffset;
+  if (oFramebuffer_.eFormat == LivePixelFormat_Bgra8)
+  {
+    GameScreenBuffer oPixels = {};
+    oPixels.pData = pPixels;
+    oPixels.iWidth = oHeader.iWidth;
+    oPixels.iHeight = oHeader.iHeight;
+    for (int y = oTile.iStartY; y < oTile.iEndY; y++)
+    {
+      const color* pRow = _pColors + static_cast<size_t>(y - oTile.iStartY) * _uRowStride;
+      for (int x = oTile.iStartX; x < oTile.iEndX; x++)
+      {
+        StorePixel(&oPixels, x, y, pRow[x - oTile.iStartX]);
+      }
+    }
+  }
+  else
+  {
+    static_assert(sizeof(color) == 3 * sizeof(float), "colors are copied as floats");
+    size_t uRowBytes = static_cast<size_t>(oTile.iEndX - oTile.iStartX) * sizeof(color);
+    for (int y = oTile.iStartY; y < oTile.iEndY; y++)
+    {
+      size_t uPixelIdx = static_cast<size_t>(y) * oHeader.iWidth + oTile.iStartX;
+      memcpy(pPixels + uPixelIdx * sizeof(color), _pColors + static_cast<size_t>(y - oTile.iStartY) * _uRowStride, uRowBytes);
+    }
+  }
+
+  aVersion.store(uVersion + 2, std::memory_order_release);
+
+  if (_bFinal)
+  {
+    uint64_t uBit = 1ull << (_uTileIdx % 64);
+    std::atomic_ref<uint64_t> aWord = GetShared<uint64_t>(pData, oHeader.uCompletionOffset + (_uTileIdx / 64) * sizeof(uint64_t));
+    if ((aWord.fetch_or(uBit, std::memory_order_release) & uBit) == 0)
+    {
+      GetShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uCompletedTiles)).fetch_add(1, std::memory_order_release);
+    }
+  }
+  GetShared<uint64_t>(pData, offsetof(LiveFramebufferHeader, uUpdateCount)).fetch_add(1, std::memory_order_release);
+}
+
+void SetLiveSamplesPerPixel(LiveFramebuffer& oFramebuffer_, uint32_t _uSamplesPerPixel)
+{
+  GetShared<uint32_t>(oFramebuffer_.pData, offsetof(LiveFramebufferHeader, uSamplesPerPixel)).store(_uSamplesPerPixel, std::memory_order_release);
+  GetShared<uint64_t>(oFramebuffer_.pData, offsetof(LiveFramebufferHeader, uUpdateCount)).fetch_add(1, std::memory_order_release);
+}
+
+void SetLiveRenderState(LiveFramebuffer& oFramebuffer_, LiveRenderState _eState)
+{
+  GetShared<uint32_t>(oFramebuffer_.pData, offsetof(LiveFramebufferHeader, uState)).store(_eState, std::memory_order_release);
+  GetShared<uint64_t>(oFramebuffer_.pData, offsetof(LiveFramebufferHeader, uUpdateCount)).fetch_add(1, std::memory_order_release);
+}
+
+void CloseLiveFramebuffer(LiveFramebuffer& oFramebuffer_)
+{
+  if (oFramebuffer_.pData)
+  {
+    UnmapSegment(oFramebuffer_.pData, oFramebuffer_.uMappedBytes);
+  }
+  if (oFramebuffer_.iFile >= 0)
+  {
+    CloseSegment(oFramebuffer_.iFile);
+    UnlinkSegment(oFramebuffer_.sName.c_str());
+  }
+  oFramebuffer_ = LiveFramebuffer();
+}
+
+bool OpenLiveFramebuffer(const char* _sName, LiveFramebufferView& oView_, std::string& sError_)
+{
+  CloseLiveFramebufferView(oView_);
+
+  int iFile = OpenSegment(_sName, false);
+  if (iFile < 0)
+  {
+    sError_ = "no shared memory segment of that name";
+    return false;
+  }
+
+  oView_.iFile = iFile;
+  if (!RemapSegment(iFile, sizeof(LiveFramebufferHeader), false, oView_.pData, oView_.uMappedBytes))
+  {
+    sError_ = "could not map shared memory segment";
+    CloseLiveFramebufferView(oView_);
+    return false;
+  }
+
+  const LiveFramebufferHeader& oHeader = *reinterpret_cast<const LiveFramebufferHeader*>(oView_.pData);
+  if (oHeader.uMagic != g_uLiveFramebufferMagic || oHeader.uVersion != g_uLiveFramebufferVersion)
+  {
+    sError_ = "not a live framebuffer of this version";
+    CloseLiveFramebufferView(oView_);
+    return false;
+  }
+  return true;
+}
+
+bool ReadLiveHeader(LiveFramebufferView& oView_, LiveFramebufferHeader& oHeader_)
+{
+  uint32_t uLayoutVersion = LoadShared<uint32_t>(oView_.pData, offsetof(LiveFramebufferHeader, uLayoutVersion), std::memory_order_acquire);
+  if (uLayoutVersion & 1u)
+    return false;
+
+  memcpy(&oHeader_, oView_.pData, sizeof(oHeader_));
+  oHeader_.uState = LoadShared<uint32_t>(oView_.pData, offsetof(LiveFramebufferHeader, uState), std::memory_order_acquire);
+  oHeader_.uUpdateCount = LoadShared<uint64_t>(oView_.pData, offsetof(LiveFramebufferHeader, uUpdateCount), std::memory_order_acquire);
+  oHeader_.uSamplesPerPixel = LoadShared<uint32_t>(oView_.pData, offsetof(LiveFramebufferHeader, uSamplesPerPixel), std::memory_order_acquire);
+  oHeader_.uCompletedTiles = LoadShared<uint32_t>(oView_.pData, offsetof(LiveFramebufferHeader, uCompletedTiles), std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (LoadShared<uint32_t>(oView_.pData, offsetof(LiveFramebufferHeader, uLayoutVersion), std::memory_order_relaxed) != uLayoutVersion)
+    return false;
+
+  oHeader_.uLayoutVersion = uLayoutVersion;
+  if (oHeader_.uTotalBytes > oView_.uMappedBytes)
+  {
+    // The writer grew the segment for a larger frame, the old mapping stays valid until replaced
+    if (!RemapSegment(oView_.iFile, oHeader_.uTotalBytes, false, oView_.pData, oView_.uMappedBytes))
+      return false;
+  }
+  return true;
+}
+
+bool ReadLiveTile(const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader, uint32_t _uTileIdx, uint8_t* pPixels_)
+{
+  if (_uTileIdx >= _oHeader.uTileCount)
+    return false;
+
+  const uint8_t* pData = _oView.pData;
+  size_t uVersionOffset = _oHeader.uTileVersionsOffset + _uTileIdx * sizeof(uint32_t);
+  uint32_t uVersion = LoadShared<uint32_t>(pData, uVersionOffset, std::memory_order_acquire);
+  if (uVersion & 1u)
+    return false;
+
+  LiveTile oTile = reinterpret_cast<const LiveTile*>(pData + _oHeader.uTilesOffset)[_uTileIdx];
+  if (oTile.iStartX < 0 || oTile.iStartY < 0 || oTile.iEndX > _oHeader.iWidth || oTile.iEndY > _oHeader.iHeight)
+    return false;
+
+  size_t uPixelBytes = GetLivePixelBytes(static_cast<LivePixelFormat>(_oHeader.uFormat));
+  size_t uRowBytes = static_cast<size_t>(oTile.iEndX - oTile.iStartX) * uPixelBytes;
+  for (int y = oTile.iStartY; y < oTile.iEndY; y++)
+  {
+    size_t uOffset = (static_cast<size_t>(y) * _oHeader.iWidth + oTile.iStartX) * uPixelBytes;
+    memcpy(pPixels_ + uOffset, pData + _oHeader.uPixelsOffset + uOffset, uRowBytes);
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return LoadShared<uint32_t>(pData, uVersionOffset, std::memory_order_relaxed) == uVersion
+    && LoadShared<uint32_t>(pData, offsetof(LiveFramebufferHeader, uLayoutVersion), std::memory_order_relaxed) == _oHeader.uLayoutVersion;
+}
+
+bool IsLiveWriterAlive(const LiveFramebufferView& _oView)
+{
+  // Written once before the segment is readable
+  return IsProcessAlive(reinterpret_cast<const LiveFramebufferHeader*>(_oView.pData)->uWriterProcess);
+}
+
+bool IsLiveTileComplete(const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader, uint32_t _uTileIdx)
+{
+  if (_uTileIdx >= _oHeader.uTileCount)
+    return false;
+
+  uint64_t uWord = LoadShared<uint64_t>(_oView.pData, _oHeader.uCompletionOffset + (_uTileIdx / 64) * sizeof(uint64_t), std::memory_order_acquire);
+  return (uWord >> (_uTileIdx % 64)) & 1u;
+}
+
+void CloseLiveFramebufferView(LiveFramebufferView& oView_)
+{
+  if (oView_.pData)
+  {
+    UnmapSegment(oView_.pData, oView_.uMappedBytes);
+  }
+  if (oView_.iFile >= 0)
+  {
+    CloseSegment(oView_.iFile);
+  }
+  oView_ = LiveFramebufferView();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "TileOrder.h"
+#include "vec3.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using color = vec3;
+
+// Progress of a render published through a POSIX shared memory segment, so external viewers can map it and read
+// the image while it renders, with no copies through the renderer and no sockets. Native endianness, the segment
+// never leaves the machine.
+//
+// The segment starts with a LiveFramebufferHeader, the arrays follow at its offsets. Every tile has a version
+// counter that is odd while its pixels are written: a reader copies the tile between two reads of the counter and
+// keeps the copy if both are the same even number. Counters and the fields marked atomic are only accessed through
+// atomic operations.
+
+static constexpr uint32_t g_uLiveFramebufferMagic = 0x4246564cu; // "LVFB"
+static constexpr uint32_t g_uLiveFramebufferVersion = 1u;
+
+enum LivePixelFormat
+{
+  LivePixelFormat_Bgra8,      // Gamma encoded, the layout of the Win32 back buffer
+  LivePixelFormat_RgbFloat32, // Linear
+  LivePixelFormat_Count
+};
+
+enum LiveRenderState
+{
+  LiveRenderState_Rendering,
+  LiveRenderState_Done,
+  LiveRenderState_Failed
+};
+
+struct LiveFramebufferHeader
+{
+  uint32_t uMagic;
+  uint32_t uVersion;
+  uint32_t uLayoutVersion;         // Atomic, odd while the writer lays out a new frame. Readers then wait and remap.
+  uint32_t uFormat;                // LivePixelFormat
+  int32_t iWidth;
+  int32_t iHeight;
+  uint32_t uTileCount;
+  uint32_t uState;                 // Atomic, LiveRenderState
+  uint64_t uTotalBytes;            // Used by the current layout, the segment may be larger
+  uint64_t uTilesOffset;           // LiveTile per tile
+  uint64_t uTileVersionsOffset;    // uint32_t per tile, atomic
+  uint64_t uCompletionOffset;      // uint64_t per 64 tiles, atomic, a tile's bit is set once its pixels are final
+  uint64_t uPixelsOffset;          // Row major over the whole image, GetLivePixelBytes per pixel
+  uint64_t uUpdateCount;           // Atomic, increased after every tile update, for viewers polling for changes
+  uint32_t uSamplesPerPixel;       // Atomic, samples every pixel has
+  uint32_t uTargetSamplesPerPixel;
+  uint32_t uCompletedTiles;        // Atomic
+  uint32_t uWriterProcess;         // Id of the rendering process, see IsLiveWriterAlive
+};
+
+struct LiveTile
+{
+  int32_t iStartX;
+  int32_t iStartY;
+  int32_t iEndX;
+  int32_t iEndY;
+};
+
+inline size_t GetLivePixelBytes(LivePixelFormat _eFormat)
+{
+  return _eFormat == LivePixelFormat_RgbFloat32 ? 3 * sizeof(float) : 4;
+}
+
+// Writer side, owned by the render
+struct LiveFramebuffer
+{
+  std::string sName;
+  LivePixelFormat eFormat = LivePixelFormat_Bgra8;
+  int iFile = -1;
+  uint8_t* pData = nullptr;
+  size_t uMappedBytes = 0;
+};
+
+// _sName is a shared memory object name such as "/render-42". An existing segment of that name is reused.
+bool CreateLiveFramebuffer(const char* _sName, LivePixelFormat _eFormat, LiveFramebuffer& oFramebuffer_, std::string& sError_);
+
+// Lays out a new frame with every tile unpublished. The segment only grows, so readers never lose pages under them.
+bool ResetLiveFramebuffer(LiveFramebuffer& oFramebuffer_, int _iWidth, int _iHeight, const std::vector<ScreenTile>& _vTiles,
+  uint32_t _uTargetSamplesPerPixel, std::string& sError_);
+
+// Copies one tile's linear colors, _pColors points at its first pixel and rows are _uRowStride pixels apart.
+// _bFinal marks the tile complete.
+void PublishLiveTile(LiveFramebuffer& oFramebuffer_, uint32_t _uTileIdx, const color* _pColors, size_t _uRowStride, bool _bFinal);
+
+void SetLiveSamplesPerPixel(LiveFramebuffer& oFramebuffer_, uint32_t _uSamplesPerPixel);
+
+void SetLiveRenderState(LiveFramebuffer& oFramebuffer_, LiveRenderState _eState);
+
+// Unmaps and removes the name, readers keep their mappings
+void CloseLiveFramebuffer(LiveFramebuffer& oFramebuffer_);
+
+// Reader side, for monitoring tools
+struct LiveFramebufferView
+{
+  int iFile = -1;
+  uint8_t* pData = nullptr; // Mapped read only
+  size_t uMappedBytes = 0;
+};
+
+bool OpenLiveFramebuffer(const char* _sName, LiveFramebufferView& oView_, std::string& sError_);
+
+// Copies the header, remapping if the segment grew. False while the writer lays out a new frame, try again later.
+bool ReadLiveHeader(LiveFramebufferView& oView_, LiveFramebufferHeader& oHeader_);
+
+// Copies the pixels of one tile into pPixels_, laid out like the whole image. False if the tile was written
+// meanwhile or the layout changed since _oHeader was read.
+bool ReadLiveTile(const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader, uint32_t _uTileIdx, uint8_t* pPixels_);
+
+// False once the rendering process exited, a render killed mid frame is never done
+bool IsLiveWriterAlive(const LiveFramebufferView& _oView);
+
+bool IsLiveTileComplete(const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader, uint32_t _uTileIdx);
+
+void CloseLiveFramebufferView(LiveFramebufferView& oView_);
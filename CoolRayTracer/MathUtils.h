@@ -1,7 +1,10 @@
 #pragma once
 
-#include "Vec3.h"
+#include "vec3.h"
 #include "Vec2.h"
+#include "Sampler.h"
+
+#include <stdlib.h>
 
 constexpr float fPI = 3.14159265359f;
 constexpr float fPI_2 = fPI / 2.0f;
@@ -95,7 +98,8 @@ inline vec3 TangentToWorld(vec3 _vDir, vec3 _vNormal)
   return vWorldDir;
 }
 
-float Random()
+// Draws from the calling thread's sampler stream, see SeedPixelSampler
+inline float Random()
 {
-  return static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+  return SampleRandom();
 }
\ No newline at end of file
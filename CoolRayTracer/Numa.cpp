@@ -0,0 +1,124 @@
+#include "Numa.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+// Parses the kernel list format, "0-3,8,10-11"
+static bool ParseCpuList(const char* _sList, std::vector<int>& vValues_)
+{
+  const char* pCursor = _sList;
+  while (*pCursor != '\0' && *pCursor != '\n')
+  {
+    char* pEnd;
+    long lFirst = strtol(pCursor, &pEnd, 10);
+    if (pEnd == pCursor || lFirst < 0)
+      return false;
+
+    long lLast = lFirst;
+    pCursor = pEnd;
+    if (*pCursor == '-')
+    {
+      lLast = strtol(pCursor + 1, &pEnd, 10);
+      if (pEnd == pCursor + 1 || lLast < lFirst)
+        return false;
+      pCursor = pEnd;
+    }
+
+    for (long l = lFirst; l <= lLast; l++)
+    {
+      vValues_.push_back(static_cast<int>(l));
+    }
+
+    if (*pCursor == ',')
+    {
+      pCursor++;
+    }
+  }
+  return true;
+}
+
+static bool ReadListFile(const char* _sPath, std::vector<int>& vValues_)
+{
+  FILE* pFile = fopen(_sPath, "r");
+  if (!pFile)
+    return false;
+
+  char aLine[4096];
+  bool bRead = fgets(aLine, sizeof(aLine), pFile) != nullptr;
+  fclose(pFile);
+
+  // Memory only nodes have an empty list
+  if (!bRead)
+    return true;
+  return ParseCpuList(aLine, vValues_);
+}
+
+bool DetectNumaTopology(NumaTopology& oTopology_)
+{
+  oTopology_.vNodes.clear();
+
+#if defined(__linux__)
+  std::vector<int> vNodeIds;
+  if (!ReadListFile("/sys/devices/system/node/online", vNodeIds))
+    return false;
+
+  for (int iId : vNodeIds)
+  {
+    char aPath[64];
+    snprintf(aPath, sizeof(aPath), "/sys/devices/system/node/node%d/cpulist", iId);
+
+    NumaNode oNode;
+    oNode.iId = iId;
+    if (!ReadListFile(aPath, oNode.vCpus))
+      return false;
+    if (!oNode.vCpus.empty())
+    {
+      oTopology_.vNodes.push_back(std::move(oNode));
+    }
+  }
+  return !oTopology_.vNodes.empty();
+#else
+  return false;
+#endif
+}
+
+bool PinThreadToNumaNode(const NumaNode& _oNode)
+{
+#if defined(__linux__)
+  cpu_set_t oCpus;
+  CPU_ZERO(&oCpus);
+  for (int iCpu : _oNode.vCpus)
+  {
+    if (iCpu < CPU_SETSIZE)
+    {
+      CPU_SET(iCpu, &oCpus);
+    }
+  }
+  return sched_setaffinity(0, sizeof(oCpus), &oCpus) == 0;
+#else
+  (void)_oNode;
+  return false;
+#endif
+}
+
+void AdviseHugePages(void* _pData, size_t _uBytes)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  constexpr uintptr_t uHUGE_PAGE_SIZE = 2u * 1024u * 1024u;
+  uintptr_t uBegin = (reinterpret_cast<uintptr_t>(_pData) + uHUGE_PAGE_SIZE - 1) & ~(uHUGE_PAGE_SIZE - 1);
+  uintptr_t uEnd = (reinterpret_cast<uintptr_t>(_pData) + _uBytes) & ~(uHUGE_PAGE_SIZE - 1);
+  if (uEnd > uBegin)
+  {
+    madvise(reinterpret_cast<void*>(uBegin), uEnd - uBegin, MADV_HUGEPAGE);
+  }
+#else
+  (void)_pData;
+  (void)_uBytes;
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+struct NumaNode
+{
+  int iId;              // Kernel node number
+  std::vector<int> vCpus;
+};
+
+struct NumaTopology
+{
+  std::vector<NumaNode> vNodes; // Nodes with CPUs, memory only nodes are left out
+};
+
+// Reads the nodes from /sys/devices/system/node. Returns false where that is not available, callers then treat
+// the machine as a single node.
+bool DetectNumaTopology(NumaTopology& oTopology_);
+
+// Restricts the calling thread to the CPUs of _oNode. Its allocations are then placed on that node the first
+// time they are touched, under the default kernel policy.
+bool PinThreadToNumaNode(const NumaNode& _oNode);
+
+// Asks for transparent huge pages on the 2 MB aligned part of the range. Only has an effect before the pages are
+// first touched, and only on Linux.
+void AdviseHugePages(void* _pData, size_t _uBytes);
+
+// Copies _vSource into fresh memory touched by the calling thread
+template <typename T>
+void CopyToLocalMemory(const std::vector<T>& _vSource, bool _bHugePages, std::vector<T>& vCopy_)
+{
+  std::vector<T>().swap(vCopy_);
+  vCopy_.reserve(_vSource.size());
+  if (_bHugePages)
+  {
+    AdviseHugePages(vCopy_.data(), vCopy_.capacity() * sizeof(T));
+  }
+  vCopy_.assign(_vSource.begin(), _vSource.end());
+}
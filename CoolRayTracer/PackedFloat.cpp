@@ -0,0 +1,210 @@
+#include "PackedFloat.h"
+
+#include "CpuDispatch.h"
+
+#include <math.h>
+#include <string.h>
+
+#if CPU_DISPATCH_X86
+#define PACKED_FLOAT_F16C 1
+#include <immintrin.h>
+#else
+#define PACKED_FLOAT_F16C 0
+#endif
+
+static constexpr float fHALF_MAX = 65504.f;
+
+static inline uint32_t GetFloatBits(float _fValue)
+{
+  uint32_t uBits;
+  memcpy(&uBits, &_fValue, sizeof(uBits));
+  return uBits;
+}
+
+static inline float GetBitsFloat(uint32_t _uBits)
+{
+  float fValue;
+  memcpy(&fValue, &_uBits, sizeof(fValue));
+  return fValue;
+}
+
+uint16_t FloatToHalf(float _fValue)
+{
+  uint32_t uBits = GetFloatBits(_fValue);
+  uint32_t uSign = (uBits >> 16) & 0x8000u;
+  uBits &= 0x7fffffffu;
+
+  uint32_t uHalf;
+  if (uBits >= 0x477ff000u) // Rounds past 65504, NaN stays NaN
+  {
+    uHalf = uBits > 0x7f800000u ? 0x7e00u : 0x7bffu;
+  }
+  else if (uBits < 0x38800000u) // Below 2^-14, the half is subnormal
+  {
+    // Adding 0.5 lines the ten mantissa bits up with the bottom of the float, the addition rounds them
+    uHalf = GetFloatBits(GetBitsFloat(uBits) + 0.5f) - 0x3f000000u;
+  }
+  else
+  {
+    // Rebias the exponent and round to nearest even with a carry into the kept bits
+    uint32_t uOdd = (uBits >> 13) & 1u;
+    uHalf = (uBits + 0xc8000fffu + uOdd) >> 13;
+  }
+  return static_cast<uint16_t>(uHalf | uSign);
+}
+
+float HalfToFloat(uint16_t _uHalf)
+{
+  constexpr uint32_t uEXPONENT_MASK = 0x7c00u << 13;
+
+  uint32_t uBits = (_uHalf & 0x7fffu) << 13;
+  uint32_t uExponent = uBits & uEXPONENT_MASK;
+  uBits += (127u - 15u) << 23;
+  if (uExponent == uEXPONENT_MASK) // Infinity and NaN
+  {
+    uBits += (128u - 16u) << 23;
+  }
+  else if (uExponent == 0) // Zero and subnormals, renormalized by the float unit
+  {
+    uBits += 1u << 23;
+    uBits = GetFloatBits(GetBitsFloat(uBits) - GetBitsFloat(113u << 23));
+  }
+  return GetBitsFloat(uBits | (static_cast<uint32_t>(_uHalf & 0x8000u) << 16));
+}
+
+uint16_t FloatToHalfStochastic(float _fValue, uint32_t _uRandom)
+{
+  uint32_t uBits = GetFloatBits(_fValue);
+  uint32_t uMagnitude = uBits & 0x7fffffffu;
+
+  // Subnormal halves are too small to matter, and the top of the range must not carry past 65504
+  if (uMagnitude < 0x38800000u || uMagnitude >= 0x477fe000u)
+    return FloatToHalf(_fValue);
+
+  uint32_t uHalf = (uMagnitude + (_uRandom & 0x1fffu) + 0xc8000000u) >> 13;
+  return static_cast<uint16_t>(uHalf | ((uBits >> 16) & 0x8000u));
+}
+
+#if PACKED_FLOAT_F16C
+
+CPU_TARGET_AVX2 static size_t FloatToHalfBatchF16C(const float* _pValues, size_t _uCount, uint16_t* pHalves_)
+{
+  __m256 vLow = _mm256_set1_ps(-fHALF_MAX);
+  __m256 vHigh = _mm256_set1_ps(fHALF_MAX);
+  size_t i = 0;
+  for (; i + 8 <= _uCount; i += 8)
+  {
+    // Clamped with NaN as the second operand of max, so NaN goes through like in the scalar version
+    __m256 vValues = _mm256_min_ps(vHigh, _mm256_max_ps(vLow, _mm256_loadu_ps(_pValues + i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pHalves_ + i), _mm256_cvtps_ph(vValues, _MM_FROUND_TO_NEAREST_INT));
+  }
+  return i;
+}
+
+CPU_TARGET_AVX2 static size_t HalfToFloatBatchF16C(const uint16_t* _pHalves, size_t _uCount, float* pValues_)
+{
+  size_t i = 0;
+  for (; i + 8 <= _uCount; i += 8)
+  {
+    __m128i vHalves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_pHalves + i));
+    _mm256_storeu_ps(pValues_ + i, _mm256_cvtph_ps(vHalves));
+  }
+  return i;
+}
+
+#endif
+
+void FloatToHalfBatch(const float* _pValues, size_t _uCount, uint16_t* pHalves_)
+{
+  size_t i = 0;
+#if PACKED_FLOAT_F16C
+  if (g_eCpuIsa >= CpuIsa_AVX2)
+    i = FloatToHalfBatchF16C(_pValues, _uCount, pHalves_);
+#endif
+
+  for (; i < _uCount; i++)
+  {
+    pHalves_[i] = FloatToHalf(_pValues[i]);
+  }
+}
+
+void HalfToFloatBatch(const uint16_t* _pHalves, size_t _uCount, float* pValues_)
+{
+  size_t i = 0;
+#if PACKED_FLOAT_F16C
+  if (g_eCpuIsa >= CpuIsa_AVX2)
+    i = HalfToFloatBatchF16C(_pHalves, _uCount, pValues_);
+#endif
+
+  for (; i < _uCount; i++)
+  {
+    pValues_[i] = HalfToFloat(_pHalves[i]);
+  }
+}
+
+// _aOffsets are added to the scaled channels before truncating, 0.5 rounds to nearest
+static uint32_t EncodeRgbe(const vec3& _vValue, const float _aOffsets[3])
+{
+  // Far from both ends of the exponent byte, and below it everything is black
+  constexpr float fMIN_VALUE = 1e-37f;
+  constexpr float fMAX_VALUE = 1e37f;
+
+  float aChannels[3];
+  float fMax = 0.f;
+  for (int i = 0; i < 3; i++)
+  {
+    float fChannel = _vValue[i] > 0.f ? _vValue[i] : 0.f;
+    aChannels[i] = fChannel < fMAX_VALUE ? fChannel : fMAX_VALUE;
+    fMax = aChannels[i] > fMax ? aChannels[i] : fMax;
+  }
+  if (!(fMax >= fMIN_VALUE))
+    return 0;
+
+  // The largest channel scales to [128, 256), or to 256 after rounding, which moves it to the next exponent
+  int iExponent;
+  frexpf(fMax, &iExponent);
+  float fScale = ldexpf(1.f, 8 - iExponent);
+  uint32_t aMantissas[3];
+  for (int iTry = 0; iTry < 2; iTry++)
+  {
+    uint32_t uLargest = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      aMantissas[i] = static_cast<uint32_t>(aChannels[i] * fScale + _aOffsets[i]);
+      uLargest = aMantissas[i] > uLargest ? aMantissas[i] : uLargest;
+    }
+    if (uLargest < 256)
+      break;
+    iExponent++;
+    fScale *= 0.5f;
+  }
+
+  return aMantissas[0] | (aMantissas[1] << 8) | (aMantissas[2] << 16) | (static_cast<uint32_t>(iExponent + 128) << 24);
+}
+
+uint32_t FloatToRgbe(const vec3& _vValue)
+{
+  const float aOffsets[3] = { 0.5f, 0.5f, 0.5f };
+  return EncodeRgbe(_vValue, aOffsets);
+}
+
+uint32_t FloatToRgbeStochastic(const vec3& _vValue, uint32_t _uRandom)
+{
+  float aOffsets[3];
+  for (int i = 0; i < 3; i++)
+  {
+    aOffsets[i] = (static_cast<float>((_uRandom >> (8 * i)) & 0xffu) + 0.5f) * (1.f / 256.f);
+  }
+  return EncodeRgbe(_vValue, aOffsets);
+}
+
+vec3 RgbeToFloat(uint32_t _uRgbe)
+{
+  uint32_t uExponent = _uRgbe >> 24;
+  if (uExponent == 0)
+    return vec3(0.f, 0.f, 0.f);
+
+  float fScale = ldexpf(1.f, static_cast<int>(uExponent) - (128 + 8));
+  return vec3(static_cast<float>(_uRgbe & 0xffu) * fScale, static_cast<float>((_uRgbe >> 8) & 0xffu) * fScale,
+    static_cast<float>((_uRgbe >> 16) & 0xffu) * fScale);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "vec3.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// IEEE half floats, rounded to nearest even. Magnitudes past the largest half saturate at 65504 instead of turning
+// into infinity.
+uint16_t FloatToHalf(float _fValue);
+
+float HalfToFloat(uint16_t _uHalf);
+
+// Rounds up with a probability equal to the fraction that is dropped, _uRandom supplies the 13 dropped bits. A
+// running mean stored as halves then keeps moving by updates smaller than half a step instead of stalling.
+uint16_t FloatToHalfStochastic(float _fValue, uint32_t _uRandom);
+
+// Same bits as the scalar versions, eight at a time with F16C when the AVX2 kernels are selected
+void FloatToHalfBatch(const float* _pValues, size_t _uCount, uint16_t* pHalves_);
+
+void HalfToFloatBatch(const uint16_t* _pHalves, size_t _uCount, float* pValues_);
+
+// Shared exponent colors: three 8 bit mantissas in the low bytes, scaled by the exponent of the largest channel in
+// the top byte. Channels smaller than the largest lose precision with it, negative ones are stored as 0.
+uint32_t FloatToRgbe(const vec3& _vValue);
+
+// _uRandom supplies 8 bits per channel, like FloatToHalfStochastic
+uint32_t FloatToRgbeStochastic(const vec3& _vValue, uint32_t _uRandom);
+
+vec3 RgbeToFloat(uint32_t _uRgbe);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <thread>
+#include <vector>
+
+inline int GetDefaultThreadCount()
+{
+  unsigned int uCount = std::thread::hardware_concurrency();
+  return uCount > 0u ? static_cast<int>(uCount) : 1;
+}
+
+// Splits [0, _iCount) into contiguous chunks and runs _fnBody(iBegin, iEnd, iChunk) for each of them,
+// one chunk per thread. The calling thread runs the first chunk. Returns the number of chunks used.
+template <typename F>
+int ParallelForChunks(int _iCount, int _iThreadCount, F&& _fnBody)
+{
+  int iChunkCount = (_iThreadCount < _iCount) ? _iThreadCount : _iCount;
+  if (iChunkCount <= 1)
+  {
+    if (_iCount > 0)
+      _fnBody(0, _iCount, 0);
+    return 1;
+  }
+
+  std::vector<std::thread> vThreads;
+  vThreads.reserve(iChunkCount - 1);
+
+  for (int iChunk = 1; iChunk < iChunkCount; iChunk++)
+  {
+    int iBegin = static_cast<int>((static_cast<long long>(_iCount) * iChunk) / iChunkCount);
+    int iEnd = static_cast<int>((static_cast<long long>(_iCount) * (iChunk + 1)) / iChunkCount);
+    vThreads.emplace_back([&_fnBody, iBegin, iEnd, iChunk]() { _fnBody(iBegin, iEnd, iChunk); });
+  }
+
+  _fnBody(0, static_cast<int>(static_cast<long long>(_iCount) / iChunkCount), 0);
+
+  for (std::thread& oThread : vThreads)
+  {
+    oThread.join();
+  }
+
+  return iChunkCount;
+}
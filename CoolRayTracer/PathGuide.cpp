@@ -0,0 +1,189 @@
+#include "PathGuide.h"
+
+#include "AABB.h"
+#include "MathUtils.h"
+
+#include <math.h>
+
+thread_local PathGuide* t_pPathGuide = nullptr;
+
+// Radiance is stored in 1/1024 steps. The clamp only keeps the sums from overflowing, it shapes the guide and
+// never the image.
+static constexpr float fGUIDE_FIXED_SCALE = 1024.f;
+static constexpr float fGUIDE_MAX_RADIANCE = 65536.f;
+
+void InitPathGuide(const Scene& _oScene, const Camera& _oCamera, float _fCellSize, PathGuide& oGuide_)
+{
+  if (_fCellSize <= 0.f)
+  {
+    AABB oBounds;
+    oBounds.Grow(_oCamera.vPosition);
+    for (const Hittable& oHittable : _oScene.vHittables)
+    {
+      AABB oHittableBounds;
+      if (GetHittableBounds(oHittable, oHittableBounds))
+      {
+        oBounds.Grow(oHittableBounds);
+      }
+    }
+    vec3 vExtent = oBounds.vMax - oBounds.vMin;
+    float fExtent = max(vExtent.x(), max(vExtent.y(), vExtent.z()));
+    _fCellSize = fExtent > 0.f ? fExtent / 8.f : 1.f;
+  }
+  oGuide_.fInvCellSize = 1.f / _fCellSize;
+
+  size_t uBinCount = static_cast<size_t>(g_uGuideCellCount) * g_iGuideBins;
+  if (oGuide_.vBinSums.size() != uBinCount)
+  {
+    oGuide_.vBinSums = std::vector<std::atomic<uint64_t>>(uBinCount);
+    oGuide_.vCellSamples = std::vector<std::atomic<uint32_t>>(g_uGuideCellCount);
+  }
+  for (std::atomic<uint64_t>& uSum : oGuide_.vBinSums)
+  {
+    uSum.store(0, std::memory_order_relaxed);
+  }
+  for (std::atomic<uint32_t>& uSamples : oGuide_.vCellSamples)
+  {
+    uSamples.store(0, std::memory_order_relaxed);
+  }
+  oGuide_.vBinCdf.assign(uBinCount, 0.f);
+
+  oGuide_.bTraining = true;
+  oGuide_.bReady = false;
+}
+
+void BuildPathGuide(PathGuide& oGuide_)
+{
+  for (uint32_t uCell = 0; uCell < g_uGuideCellCount; uCell++)
+  {
+    size_t uFirstBin = static_cast<size_t>(uCell) * g_iGuideBins;
+    float* pCdf = oGuide_.vBinCdf.data() + uFirstBin;
+
+    uint64_t uTotal = 0;
+    for (int i = 0; i < g_iGuideBins; i++)
+    {
+      uTotal += oGuide_.vBinSums[uFirstBin + i].load(std::memory_order_relaxed);
+    }
+    if (uTotal == 0 || oGuide_.vCellSamples[uCell].load(std::memory_order_relaxed) < g_uGuideMinCellSamples)
+    {
+      for (int i = 0; i < g_iGuideBins; i++)
+      {
+        pCdf[i] = 0.f;
+      }
+      continue;
+    }
+
+    uint64_t uRunning = 0;
+    for (int i = 0; i < g_iGuideBins; i++)
+    {
+      uRunning += oGuide_.vBinSums[uFirstBin + i].load(std::memory_order_relaxed);
+      pCdf[i] = static_cast<float>(static_cast<double>(uRunning) / static_cast<double>(uTotal));
+    }
+    pCdf[g_iGuideBins - 1] = 1.f;
+  }
+
+  oGuide_.bReady = true;
+}
+
+// Face of the major axis, then the other two coordinates over it in [-1, 1]
+static int GetCubeFace(const vec3& _vDirection, float& fU_, float& fV_, float& fMajor_)
+{
+  float fAbsX = fabsf(_vDirection.x());
+  float fAbsY = fabsf(_vDirection.y());
+  float fAbsZ = fabsf(_vDirection.z());
+  int iFace;
+  if (fAbsX >= fAbsY && fAbsX >= fAbsZ)
+  {
+    iFace = _vDirection.x() >= 0.f ? 0 : 1;
+    fMajor_ = fAbsX;
+    fU_ = _vDirection.y();
+    fV_ = _vDirection.z();
+  }
+  else if (fAbsY >= fAbsZ)
+  {
+    iFace = _vDirection.y() >= 0.f ? 2 : 3;
+    fMajor_ = fAbsY;
+    fU_ = _vDirection.x();
+    fV_ = _vDirection.z();
+  }
+  else
+  {
+    iFace = _vDirection.z() >= 0.f ? 4 : 5;
+    fMajor_ = fAbsZ;
+    fU_ = _vDirection.x();
+    fV_ = _vDirection.y();
+  }
+  fU_ /= fMajor_;
+  fV_ /= fMajor_;
+  return iFace;
+}
+
+static int GetFaceBin(float _fCoord)
+{
+  int iBin = static_cast<int>((_fCoord + 1.f) * (0.5f * g_iGuideFaceBins));
+  return iBin < 0 ? 0 : (iBin >= g_iGuideFaceBins ? g_iGuideFaceBins - 1 : iBin);
+}
+
+int GetGuideBin(const vec3& _vDirection)
+{
+  float fU, fV, fMajor;
+  int iFace = GetCubeFace(_vDirection, fU, fV, fMajor);
+  return (iFace * g_iGuideFaceBins + GetFaceBin(fU)) * g_iGuideFaceBins + GetFaceBin(fV);
+}
+
+vec3 SampleGuide(const PathGuide& _oGuide, uint32_t _uCell, float _fRandomBin, float _fRandomU, float _fRandomV)
+{
+  const float* pCdf = _oGuide.vBinCdf.data() + static_cast<size_t>(_uCell) * g_iGuideBins;
+
+  // First bin whose running sum passes the random number, empty bins are never picked
+  int iLow = 0;
+  int iHigh = g_iGuideBins - 1;
+  while (iLow < iHigh)
+  {
+    // Selects instead of branches, the comparisons are unpredictable
+    int iMid = (iLow + iHigh) / 2;
+    bool bAbove = pCdf[iMid] > _fRandomBin;
+    iHigh = bAbove ? iMid : iHigh;
+    iLow = bAbove ? iLow : iMid + 1;
+  }
+
+  // Uniform over the square of the bin on its face
+  constexpr float fBIN_SIZE = 2.f / g_iGuideFaceBins;
+  int iFace = iLow / (g_iGuideFaceBins * g_iGuideFaceBins);
+  float fU = (static_cast<float>((iLow / g_iGuideFaceBins) % g_iGuideFaceBins) + _fRandomU) * fBIN_SIZE - 1.f;
+  float fV = (static_cast<float>(iLow % g_iGuideFaceBins) + _fRandomV) * fBIN_SIZE - 1.f;
+  float fSign = (iFace & 1) ? -1.f : 1.f;
+  switch (iFace >> 1)
+  {
+  case 0:
+    return Normalize(vec3(fSign, fU, fV));
+  case 1:
+    return Normalize(vec3(fU, fSign, fV));
+  default:
+    return Normalize(vec3(fU, fV, fSign));
+  }
+}
+
+float GetGuidePdf(const PathGuide& _oGuide, uint32_t _uCell, const vec3& _vDirection)
+{
+  const float* pCdf = _oGuide.vBinCdf.data() + static_cast<size_t>(_uCell) * g_iGuideBins;
+  float fU, fV, fMajor;
+  int iFace = GetCubeFace(_vDirection, fU, fV, fMajor);
+  int iBin = (iFace * g_iGuideFaceBins + GetFaceBin(fU)) * g_iGuideFaceBins + GetFaceBin(fV);
+  float fBinProbability = pCdf[iBin] - (iBin > 0 ? pCdf[iBin - 1] : 0.f);
+
+  // Uniform on the face square, whose area element maps to the sphere scaled by the cube of the major axis
+  constexpr float fBIN_AREA = (2.f / g_iGuideFaceBins) * (2.f / g_iGuideFaceBins);
+  return fBinProbability / (fBIN_AREA * fMajor * fMajor * fMajor);
+}
+
+void SplatGuide(PathGuide& oGuide_, uint32_t _uCell, int _iBin, float _fRadiance)
+{
+  oGuide_.vCellSamples[_uCell].fetch_add(1, std::memory_order_relaxed);
+  if (!(_fRadiance > 0.f))
+    return;
+
+  float fClamped = _fRadiance < fGUIDE_MAX_RADIANCE ? _fRadiance : fGUIDE_MAX_RADIANCE;
+  uint64_t uFixed = static_cast<uint64_t>(fClamped * fGUIDE_FIXED_SCALE + 0.5f);
+  oGuide_.vBinSums[static_cast<size_t>(_uCell) * g_iGuideBins + _iBin].fetch_add(uFixed, std::memory_order_relaxed);
+}
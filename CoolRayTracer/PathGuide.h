@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Camera.h"
+#include "FastMath.h"
+#include "Scene.h"
+#include "vec3.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+// Directions are binned on a cube map, a square of g_iGuideFaceBins per side on each face. Finding the bin of a
+// direction takes a few divisions and no trigonometry.
+static constexpr int g_iGuideFaceBins = 4;
+static constexpr int g_iGuideBins = 6 * g_iGuideFaceBins * g_iGuideFaceBins;
+
+// Cells of the spatial hash. Colliding cells share a histogram, which only makes the guide less sharp.
+static constexpr uint32_t g_uGuideCellCount = 1u << 12;
+
+// Cells need this many training samples before they are sampled
+static constexpr uint32_t g_uGuideMinCellSamples = 32;
+
+// Online learned distribution of the light arriving at diffuse surfaces. Training paths add the luminance each
+// diffuse bounce received, over the pdf it was sampled with, to the bin of its direction. The sums use integer
+// atomics so every render thread updates them without locks and they do not depend on the order samples arrive in.
+// BuildPathGuide turns the sums into one distribution per cell, read only until the next build.
+struct PathGuide
+{
+  float fInvCellSize = 1.f;
+  float fGuideFraction = 0.5f;                     // Share of diffuse bounces sampled from the guide, the rest stay cosine
+  bool bTraining = false;
+  bool bReady = false;
+  std::vector<std::atomic<uint64_t>> vBinSums;     // Fixed point, g_iGuideBins per cell
+  std::vector<std::atomic<uint32_t>> vCellSamples;
+  std::vector<float> vBinCdf;                      // g_iGuideBins per cell, all 0 for cells not trained enough
+};
+
+// Guide of the calling render thread, null while guiding is off
+extern thread_local PathGuide* t_pPathGuide;
+
+// Clears the guide and starts training, every bounce is cosine sampled until the first build. A cell size of 0 picks one from the bounds of the scene and the camera.
+void InitPathGuide(const Scene& _oScene, const Camera& _oCamera, float _fCellSize, PathGuide& oGuide_);
+
+// Builds the distributions from the sums so far. Training goes on until bTraining is cleared.
+void BuildPathGuide(PathGuide& oGuide_);
+
+inline uint32_t GetGuideCell(const PathGuide& _oGuide, const vec3& _vPosition)
+{
+  // Far hits on planes are clamped before the conversion
+  constexpr float fMAX_COORD = 1e9f;
+  uint32_t aCoords[3];
+  for (int i = 0; i < 3; i++)
+  {
+    float fCoord = _vPosition[i] * _oGuide.fInvCellSize;
+    fCoord = fCoord < -fMAX_COORD ? -fMAX_COORD : (fCoord > fMAX_COORD ? fMAX_COORD : fCoord);
+    aCoords[i] = static_cast<uint32_t>(FloorToInt(fCoord));
+  }
+  return ((aCoords[0] * 73856093u) ^ (aCoords[1] * 19349663u) ^ (aCoords[2] * 83492791u)) & (g_uGuideCellCount - 1);
+}
+
+inline bool IsGuideCellTrained(const PathGuide& _oGuide, uint32_t _uCell)
+{
+  return _oGuide.vBinCdf[(static_cast<size_t>(_uCell) + 1) * g_iGuideBins - 1] > 0.f;
+}
+
+int GetGuideBin(const vec3& _vDirection);
+
+// Only for trained cells
+vec3 SampleGuide(const PathGuide& _oGuide, uint32_t _uCell, float _fRandomBin, float _fRandomU, float _fRandomV);
+
+// Solid angle pdf of SampleGuide
+float GetGuidePdf(const PathGuide& _oGuide, uint32_t _uCell, const vec3& _vDirection);
+
+// _fRadiance is the luminance received over the direction's pdf, relative to the cosine pdf
+void SplatGuide(PathGuide& oGuide_, uint32_t _uCell, int _iBin, float _fRadiance);
@@ -0,0 +1,137 @@
+#include "PerfCounters.h"
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+thread_local RenderCounters t_oRenderCounters;
+
+static std::atomic<uint64_t> g_uTotalRays = 0;
+static std::atomic<uint64_t> g_uTotalShadowRays = 0;
+static std::atomic<uint64_t> g_uTotalNodeVisits = 0;
+static std::atomic<uint64_t> g_uTotalPrimTests = 0;
+static std::atomic<uint64_t> g_uTotalTextureMicroHits = 0;
+
+void FlushRenderCounters()
+{
+  g_uTotalRays += t_oRenderCounters.uRays;
+  g_uTotalShadowRays += t_oRenderCounters.uShadowRays;
+  g_uTotalNodeVisits += t_oRenderCounters.uNodeVisits;
+  g_uTotalPrimTests += t_oRenderCounters.uPrimTests;
+  g_uTotalTextureMicroHits += t_oRenderCounters.uTextureMicroHits;
+  t_oRenderCounters = {};
+}
+
+RenderCounters GetRenderCounters()
+{
+  RenderCounters oCounters = {};
+  oCounters.uRays = g_uTotalRays.load();
+  oCounters.uShadowRays = g_uTotalShadowRays.load();
+  oCounters.uNodeVisits = g_uTotalNodeVisits.load();
+  oCounters.uPrimTests = g_uTotalPrimTests.load();
+  oCounters.uTextureMicroHits = g_uTotalTextureMicroHits.load();
+  return oCounters;
+}
+
+void ResetRenderCounters()
+{
+  g_uTotalRays = 0;
+  g_uTotalShadowRays = 0;
+  g_uTotalNodeVisits = 0;
+  g_uTotalPrimTests = 0;
+  g_uTotalTextureMicroHits = 0;
+}
+
+#if defined(__linux__)
+
+enum HardwareCounter
+{
+  HardwareCounter_L1DReadMisses,
+  HardwareCounter_LLCReferences,
+  HardwareCounter_LLCMisses,
+  HardwareCounter_Count
+};
+
+static int g_aHardwareCounterFds[HardwareCounter_Count] = { -1, -1, -1 };
+
+static int OpenHardwareCounter(uint32_t _uType, uint64_t _uConfig)
+{
+  perf_event_attr oAttr;
+  memset(&oAttr, 0, sizeof(oAttr));
+  oAttr.size = sizeof(oAttr);
+  oAttr.type = _uType;
+  oAttr.config = _uConfig;
+  oAttr.disabled = 1;
+  oAttr.inherit = 1;
+  oAttr.exclude_kernel = 1;
+  oAttr.exclude_hv = 1;
+  return static_cast<int>(syscall(SYS_perf_event_open, &oAttr, 0, -1, -1, 0));
+}
+
+void StartHardwareCounters()
+{
+  StopHardwareCounters();
+
+  g_aHardwareCounterFds[HardwareCounter_L1DReadMisses] = OpenHardwareCounter(PERF_TYPE_HW_CACHE,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  g_aHardwareCounterFds[HardwareCounter_LLCReferences] = OpenHardwareCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+  g_aHardwareCounterFds[HardwareCounter_LLCMisses] = OpenHardwareCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+  for (int iFd : g_aHardwareCounterFds)
+  {
+    if (iFd >= 0)
+    {
+      ioctl(iFd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(iFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+HardwareCounters StopHardwareCounters()
+{
+  HardwareCounters oCounters = {};
+  uint64_t aValues[HardwareCounter_Count] = {};
+
+  oCounters.bAvailable = true;
+  for (int i = 0; i < HardwareCounter_Count; i++)
+  {
+    int& iFd = g_aHardwareCounterFds[i];
+    if (iFd < 0)
+    {
+      oCounters.bAvailable = false;
+      continue;
+    }
+
+    ioctl(iFd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(iFd, &aValues[i], sizeof(aValues[i])) != sizeof(aValues[i]))
+    {
+      oCounters.bAvailable = false;
+    }
+    close(iFd);
+    iFd = -1;
+  }
+
+  oCounters.uL1DReadMisses = aValues[HardwareCounter_L1DReadMisses];
+  oCounters.uLLCReferences = aValues[HardwareCounter_LLCReferences];
+  oCounters.uLLCMisses = aValues[HardwareCounter_LLCMisses];
+  return oCounters;
+}
+
+#else
+
+void StartHardwareCounters()
+{
+}
+
+HardwareCounters StopHardwareCounters()
+{
+  return {};
+}
+
+#endif
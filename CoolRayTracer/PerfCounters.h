@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Software counters, incremented by the traversal kernels on the calling thread
+struct RenderCounters
+{
+  uint64_t uRays = 0;
+  uint64_t uShadowRays = 0; // Occlusion queries, also counted in uRays
+  uint64_t uNodeVisits = 0;
+  uint64_t uPrimTests = 0;
+  uint64_t uTextureMicroHits = 0; // Texture tiles found in the thread's own micro cache
+};
+
+extern thread_local RenderCounters t_oRenderCounters;
+
+// Adds the calling thread's counters to the process totals and resets them
+void FlushRenderCounters();
+
+RenderCounters GetRenderCounters();
+
+void ResetRenderCounters();
+
+// Process wide hardware cache counters. Only available on Linux through perf events,
+// bAvailable is false elsewhere or when the kernel does not allow them.
+struct HardwareCounters
+{
+  bool bAvailable = false;
+  uint64_t uL1DReadMisses = 0;
+  uint64_t uLLCReferences = 0;
+  uint64_t uLLCMisses = 0;
+};
+
+// Must be called before the render threads are created, they inherit the counters
+void StartHardwareCounters();
+
+HardwareCounters StopHardwareCounters();
@@ -0,0 +1,172 @@
+#include "Preview.h"
+
+#include "Parallel.h"
+#include "PerfCounters.h"
+#include "Renderer.h"
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point _oStart)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _oStart).count();
+}
+
+// Traces one ray per block and fills the block with it. Returns false if the camera changed meanwhile.
+static bool RenderPreviewTile(PreviewRenderer& oPreview_, const ScreenTile& _oTile, int _iScale, const CameraFrame& _oFrame, uint32_t _uGeneration)
+{
+  for (int iBlockY = _oTile.iStartY; iBlockY < _oTile.iEndY; iBlockY += _iScale)
+  {
+    if (oPreview_.uGeneration.load(std::memory_order_relaxed) != _uGeneration)
+      return false;
+
+    int iBlockEndY = (iBlockY + _iScale < _oTile.iEndY) ? iBlockY + _iScale : _oTile.iEndY;
+
+    for (int iBlockX = _oTile.iStartX; iBlockX < _oTile.iEndX; iBlockX += _iScale)
+    {
+      int iBlockEndX = (iBlockX + _iScale < _oTile.iEndX) ? iBlockX + _iScale : _oTile.iEndX;
+
+      ray oRay = GetCameraRay(_oFrame, 0.5f * (iBlockX + iBlockEndX - 1), 0.5f * (iBlockY + iBlockEndY - 1));
+      PrimaryHit oPrimaryHit;
+      color vColor = TracePath(*oPreview_.pScene, oRay, oPreview_.oSettings.iMaxBounces, _oFrame.fPixelSpread * _iScale, oPrimaryHit);
+
+      for (int y = iBlockY; y < iBlockEndY; y++)
+      {
+        for (int x = iBlockX; x < iBlockEndX; x++)
+        {
+          StorePixel(&oPreview_.oTarget, x, y, vColor);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+static void PreviewWorker(PreviewRenderer* pPreview)
+{
+  PreviewRenderer& oPreview = *pPreview;
+  t_eMathPrecision = oPreview.oSettings.eMathPrecision;
+  std::unique_lock<std::mutex> oLock(oPreview.oMutex);
+
+  while (true)
+  {
+    oPreview.oCondition.wait(oLock, [&oPreview]()
+      {
+        // Tiles of an older camera must drain first, so two generations never write the same pixels
+        bool bDrained = oPreview.iRunningTiles == 0 || oPreview.uRunningGeneration == oPreview.uGeneration.load();
+        return oPreview.bStop || (bDrained && oPreview.iScale > 0 && oPreview.uNextTile < oPreview.vTiles.size());
+      });
+
+    if (oPreview.bStop)
+      break;
+
+    size_t uTileIdx = oPreview.uNextTile++;
+    uint32_t uGeneration = oPreview.uGeneration.load();
+    int iScale = oPreview.iScale;
+    CameraFrame oFrame = oPreview.oFrame;
+    oPreview.uRunningGeneration = uGeneration;
+    oPreview.iRunningTiles++;
+
+    oLock.unlock();
+    bool bFinished = RenderPreviewTile(oPreview, oPreview.vTiles[uTileIdx], iScale, oFrame, uGeneration);
+    FlushRenderCounters();
+    oLock.lock();
+
+    if (--oPreview.iRunningTiles == 0)
+    {
+      oPreview.oCondition.notify_all();
+    }
+
+    if (!bFinished || uGeneration != oPreview.uGeneration.load())
+      continue;
+
+    if (++oPreview.uDoneTiles == oPreview.vTiles.size())
+    {
+      oPreview.oStats.iCompletedScale = iScale;
+      if (iScale == oPreview.oSettings.iCoarsestScale)
+      {
+        oPreview.oStats.dFirstImageMs = MillisecondsSince(oPreview.oInputTime);
+      }
+
+      if (iScale > 1)
+      {
+        oPreview.iScale = iScale / 2;
+        oPreview.uNextTile = 0;
+        oPreview.uDoneTiles = 0;
+      }
+      else
+      {
+        oPreview.oStats.dFullImageMs = MillisecondsSince(oPreview.oInputTime);
+        oPreview.iScale = 0;
+      }
+
+      oPreview.oCondition.notify_all();
+    }
+  }
+}
+
+void StartPreview(const Scene& _oScene, const GameScreenBuffer& _oTarget, const PreviewSettings& _oSettings, PreviewRenderer& oPreview_)
+{
+  StopPreview(oPreview_);
+
+  oPreview_.pScene = &_oScene;
+  oPreview_.oTarget = _oTarget;
+  oPreview_.oSettings = _oSettings;
+  oPreview_.iScale = 0;
+  oPreview_.bStop = false;
+
+  int iThreadCount = _oSettings.iThreadCount > 0 ? _oSettings.iThreadCount : GetDefaultThreadCount();
+  BuildTileList(_oTarget.iWidth, _oTarget.iHeight, _oSettings.oTileSettings, iThreadCount, oPreview_.vTiles);
+
+  for (int i = 0; i < iThreadCount; i++)
+  {
+    oPreview_.vThreads.emplace_back(PreviewWorker, &oPreview_);
+  }
+}
+
+void SetPreviewCamera(PreviewRenderer& oPreview_, const Camera& _oCamera)
+{
+  std::lock_guard<std::mutex> oLock(oPreview_.oMutex);
+
+  // Bumping the generation makes in-flight tiles bail out at their next block row
+  uint32_t uGeneration = ++oPreview_.uGeneration;
+
+  oPreview_.oFrame = ComputeCameraFrame(_oCamera, oPreview_.oTarget.iWidth, oPreview_.oTarget.iHeight);
+  oPreview_.iScale = oPreview_.oSettings.iCoarsestScale;
+  oPreview_.uNextTile = 0;
+  oPreview_.uDoneTiles = 0;
+  oPreview_.oInputTime = std::chrono::steady_clock::now();
+  oPreview_.oStats = {};
+  oPreview_.oStats.uGeneration = uGeneration;
+
+  oPreview_.oCondition.notify_all();
+}
+
+PreviewStats GetPreviewStats(PreviewRenderer& oPreview_)
+{
+  std::lock_guard<std::mutex> oLock(oPreview_.oMutex);
+  return oPreview_.oStats;
+}
+
+bool WaitForPreview(PreviewRenderer& oPreview_, int _iScale, int _iTimeoutMs)
+{
+  std::unique_lock<std::mutex> oLock(oPreview_.oMutex);
+  return oPreview_.oCondition.wait_for(oLock, std::chrono::milliseconds(_iTimeoutMs), [&oPreview_, _iScale]()
+    {
+      return oPreview_.oStats.iCompletedScale > 0 && oPreview_.oStats.iCompletedScale <= _iScale;
+    });
+}
+
+void StopPreview(PreviewRenderer& oPreview_)
+{
+  {
+    std::lock_guard<std::mutex> oLock(oPreview_.oMutex);
+    oPreview_.bStop = true;
+    oPreview_.uGeneration++;
+  }
+  oPreview_.oCondition.notify_all();
+
+  for (std::thread& oThread : oPreview_.vThreads)
+  {
+    oThread.join();
+  }
+  oPreview_.vThreads.clear();
+}
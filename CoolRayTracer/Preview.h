@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CoolRayTracer.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "TileOrder.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+struct PreviewSettings
+{
+  int iThreadCount = 0;    // 0 uses every hardware thread
+  int iMaxBounces = 4;
+  int iCoarsestScale = 8;  // The first pass traces one ray per 8x8 block, every following pass halves the block size
+  MathPrecision eMathPrecision = MathPrecision_Fast;
+  TileSettings oTileSettings;
+};
+
+struct PreviewStats
+{
+  uint32_t uGeneration = 0;    // Bumped by every camera change
+  int iCompletedScale = 0;     // Block size of the last finished pass of this generation, 0 if none yet
+  double dFirstImageMs = 0.0;  // From the camera change to the end of the coarsest pass
+  double dFullImageMs = 0.0;   // From the camera change to the end of the full resolution pass
+};
+
+// Headless progressive renderer. Every camera change restarts the passes, tiles of the previous camera
+// still in flight stop at their next block row.
+struct PreviewRenderer
+{
+  const Scene* pScene = nullptr;
+  GameScreenBuffer oTarget = {};
+  PreviewSettings oSettings;
+  std::vector<ScreenTile> vTiles;
+  std::vector<std::thread> vThreads;
+
+  std::mutex oMutex;
+  std::condition_variable oCondition;
+  std::atomic<uint32_t> uGeneration = 0;
+  CameraFrame oFrame = {};
+  int iScale = 0; // Block size of the pass in flight, 0 when idle
+  size_t uNextTile = 0;
+  size_t uDoneTiles = 0;
+  int iRunningTiles = 0;
+  uint32_t uRunningGeneration = 0; // Every running tile belongs to this generation
+  bool bStop = false;
+  std::chrono::steady_clock::time_point oInputTime;
+  PreviewStats oStats;
+};
+
+// Spawns the worker threads, which stay idle until the first call to SetPreviewCamera
+void StartPreview(const Scene& _oScene, const GameScreenBuffer& _oTarget, const PreviewSettings& _oSettings, PreviewRenderer& oPreview_);
+
+void SetPreviewCamera(PreviewRenderer& oPreview_, const Camera& _oCamera);
+
+PreviewStats GetPreviewStats(PreviewRenderer& oPreview_);
+
+// Blocks until the current camera has a finished pass of block size _iScale or finer. Returns false on timeout.
+bool WaitForPreview(PreviewRenderer& oPreview_, int _iScale, int _iTimeoutMs);
+
+void StopPreview(PreviewRenderer& oPreview_);
@@ -0,0 +1,242 @@
+#include "ProgressiveRender.h"
+
+#include "Sampler.h"
+
+#include <chrono>
+
+using ProgressiveClock = std::chrono::steady_clock;
+
+// Publishes the means of a tile, pixels with no samples yet are black
+static void PublishAccumulatedTile(const AccumulationBuffers& _oAccum, const ScreenTile& _oTile, uint32_t _uTileIdx,
+  uint32_t _uTargetSamples, LiveFramebuffer& oFramebuffer_)
+{
+  static thread_local std::vector<color> t_vColors;
+  size_t uTileWidth = static_cast<size_t>(_oTile.iEndX - _oTile.iStartX);
+  t_vColors.resize(uTileWidth * (_oTile.iEndY - _oTile.iStartY));
+
+  bool bFinal = true;
+  for (int y = _oTile.iStartY; y < _oTile.iEndY; y++)
+  {
+    size_t uBegin = static_cast<size_t>(y) * _oAccum.iWidth + _oTile.iStartX;
+    color* pRow = t_vColors.data() + (y - _oTile.iStartY) * uTileWidth;
+    LoadVec3Range(_oAccum.oColor, uBegin, uTileWidth, pRow);
+    for (size_t x = 0; x < uTileWidth; x++)
+    {
+      uint32_t uSamples = _oAccum.vSampleCount[uBegin + x];
+      pRow[x] = uSamples > 0 ? pRow[x] : color(0.f, 0.f, 0.f);
+      bFinal = bFinal && uSamples >= _uTargetSamples;
+    }
+  }
+  PublishLiveTile(oFramebuffer_, _uTileIdx, t_vColors.data(), uTileWidth, bFinal);
+}
+
+static double SecondsBetween(ProgressiveClock::time_point _oStart, ProgressiveClock::time_point _oEnd)
+{
+  return std::chrono::duration<double>(_oEnd - _oStart).count();
+}
+
+bool RenderProgressive(const Scene& _oScene, const Camera& _oCamera, int _iWidth, int _iHeight, uint64_t _uSceneHash,
+  const ProgressiveSettings& _oSettings, ProgressiveStart _eStart, AccumulationBuffers& oAccum_, TileDependencies* pDependencies_,
+  RenderBuffers& oBuffers_, std::vector<color>& vResolved_, ProgressiveReport& oReport_, std::string& sError_)
+{
+  ProgressiveClock::time_point oStart = ProgressiveClock::now();
+  oReport_ = {};
+
+  int iThreadCount = _oSettings.iThreadCount > 0 ? _oSettings.iThreadCount : GetDefaultThreadCount();
+
+  CheckpointKey oKey;
+  oKey.uSceneHash = _uSceneHash;
+  oKey.oCamera = _oCamera;
+  oKey.iWidth = _iWidth;
+  oKey.iHeight = _iHeight;
+  oKey.iMaxBounces = _oSettings.iMaxBounces;
+  oKey.iGuideTrainingPasses = _oSettings.iGuideTrainingPasses > 0 ? _oSettings.iGuideTrainingPasses : 0;
+  oKey.fGuideCellSize = oKey.iGuideTrainingPasses > 0 ? _oSettings.fGuideCellSize : 0.f;
+  if (_oSettings.bLightTraceCaustics && !_oScene.oLights.vHittableIdx.empty())
+  {
+    oKey.iLightPathsPerPass = _oSettings.iLightPathsPerPass > 0 ? _oSettings.iLightPathsPerPass : _iWidth * _iHeight;
+  }
+  bool bLightTraced = oKey.iLightPathsPerPass > 0;
+  oKey.eBufferFormat = _oSettings.eBufferFormat;
+
+  if (_eStart == ProgressiveStart_Checkpoint)
+  {
+    if (!_oSettings.sCheckpointPath)
+    {
+      sError_ = "resuming needs a checkpoint path";
+      return false;
+    }
+    if (!LoadCheckpoint(_oSettings.sCheckpointPath, oKey, oAccum_, sError_))
+      return false;
+  }
+  else if (_eStart == ProgressiveStart_Fresh || oAccum_.iWidth != _iWidth || oAccum_.iHeight != _iHeight
+    || oAccum_.eFormat != _oSettings.eBufferFormat)
+  {
+    ResizeAccumulationBuffers(_iWidth, _iHeight, _oSettings.eBufferFormat, oAccum_);
+  }
+
+  uint32_t uDoneSamples = oAccum_.vSampleCount.empty() ? 0u : oAccum_.vSampleCount[0];
+  for (uint32_t uSamples : oAccum_.vSampleCount)
+  {
+    uDoneSamples = uSamples < uDoneSamples ? uSamples : uDoneSamples;
+  }
+  oReport_.uStartSamplesPerPixel = uDoneSamples;
+
+  CameraFrame oFrame = ComputeCameraFrame(_oCamera, _iWidth, _iHeight);
+
+  std::vector<ScreenTile> vTiles;
+  BuildTileList(_iWidth, _iHeight, _oSettings.oTileSettings, iThreadCount, vTiles);
+  if (pDependencies_)
+  {
+    // Only renders continuing in memory know what the samples already taken depended on
+    if (_eStart != ProgressiveStart_Current)
+    {
+      pDependencies_->vTiles.clear();
+    }
+    ResetTileDependencies(vTiles, _oScene.vHittables.size(), *pDependencies_);
+    pDependencies_->bLightTracedCaustics = pDependencies_->bLightTracedCaustics || bLightTraced;
+  }
+
+  // The guide is rebuilt after every training pass. It is not saved, a resumed render traces the passes that
+  // trained it again with the same samples and throws them away.
+  PathGuide oGuide;
+  PathGuide* pGuide = nullptr;
+  uint32_t uGuidePasses = static_cast<uint32_t>(oKey.iGuideTrainingPasses);
+  if (uGuidePasses > 0)
+  {
+    pGuide = &oGuide;
+    InitPathGuide(_oScene, _oCamera, oKey.fGuideCellSize, oGuide);
+    for (uint32_t uPass = 0; uPass < uGuidePasses && uPass < uDoneSamples; uPass++)
+    {
+      RenderTilesInParallel(vTiles.size(), iThreadCount, [&](uint32_t uTileIdx)
+        {
+          const ScreenTile& oTile = vTiles[uTileIdx];
+          t_pPathGuide = pGuide;
+          t_bLightTracedCaustics = bLightTraced;
+          ForEachPixel(oTile.iStartX, oTile.iStartY, oTile.iEndX, oTile.iEndY, _oSettings.oTileSettings.ePixelOrder, [&](int x, int y)
+            {
+              SeedPixelSampler(x, y, uPass);
+              vec2 vOffset = GetPixelSampleOffset(static_cast<int>(uPass));
+              PrimaryHit oPrimaryHit;
+              TracePath(_oScene, GetCameraRay(oFrame, x + vOffset.x(), y + vOffset.y()), _oSettings.iMaxBounces, oFrame.fPixelSpread, oPrimaryHit);
+            });
+          return true;
+        });
+      BuildPathGuide(oGuide);
+    }
+    oGuide.bTraining = uDoneSamples < uGuidePasses;
+  }
+
+  uint32_t uTargetSamples = static_cast<uint32_t>(_oSettings.iSamplesPerPixel > 0 ? _oSettings.iSamplesPerPixel : 0);
+  LiveFramebuffer* pLive = _oSettings.pLiveFramebuffer;
+  if (pLive)
+  {
+    if (!ResetLiveFramebuffer(*pLive, _iWidth, _iHeight, vTiles, uTargetSamples, sError_))
+      return false;
+
+    // A resumed or incremental render starts from the means it already has
+    if (_eStart != ProgressiveStart_Fresh)
+    {
+      for (uint32_t uTileIdx = 0; uTileIdx < vTiles.size(); uTileIdx++)
+      {
+        PublishAccumulatedTile(oAccum_, vTiles[uTileIdx], uTileIdx, uTargetSamples, *pLive);
+      }
+    }
+    SetLiveSamplesPerPixel(*pLive, uDoneSamples);
+  }
+  ProgressiveClock::time_point oLastLivePass = ProgressiveClock::now();
+
+  CheckpointWriter oWriter;
+  if (_oSettings.sCheckpointPath)
+  {
+    StartCheckpointWriter(_oSettings.sCheckpointPath, oKey, oWriter);
+  }
+  ProgressiveClock::time_point oLastCheckpoint = ProgressiveClock::now();
+
+  LightSplatBuffers oSplats;
+  for (uint32_t uPass = uDoneSamples; uPass < uTargetSamples; uPass++)
+  {
+    if (bLightTraced)
+    {
+      uint32_t uLightPaths = static_cast<uint32_t>(oKey.iLightPathsPerPass);
+      TraceLightPass(_oScene, oFrame, _iWidth, _iHeight, _oSettings.iMaxBounces, uPass, uLightPaths, iThreadCount, oSplats);
+      AddLightSplats(oSplats, uLightPaths, uTargetSamples, iThreadCount, oAccum_);
+    }
+
+    // Publishing converts every pixel, throttled so watching a render does not slow it down
+    bool bLastPass = uPass + 1 == uTargetSamples;
+    bool bPublish = pLive && (bLastPass || SecondsBetween(oLastLivePass, ProgressiveClock::now()) >= _oSettings.dLiveIntervalS);
+
+    RenderTilesInParallel(vTiles.size(), iThreadCount, [&](uint32_t uTileIdx)
+      {
+        const ScreenTile& oTile = vTiles[uTileIdx];
+        t_pHittableDependencies = pDependencies_ ? GetTileDependencyBits(*pDependencies_, uTileIdx) : nullptr;
+        t_pPathGuide = pGuide;
+        t_bLightTracedCaustics = bLightTraced;
+        ForEachPixel(oTile.iStartX, oTile.iStartY, oTile.iEndX, oTile.iEndY, _oSettings.oTileSettings.ePixelOrder, [&](int x, int y)
+          {
+            // Pixels kept by an incremental render are already done
+            if (oAccum_.vSampleCount[static_cast<size_t>(y) * _iWidth + x] < uTargetSamples)
+            {
+              AccumulatePixelSample(_oScene, oFrame, x, y, _oSettings.iMaxBounces, oAccum_);
+            }
+          });
+        if (bPublish)
+        {
+          PublishAccumulatedTile(oAccum_, oTile, uTileIdx, uTargetSamples, *pLive);
+        }
+        return true;
+      });
+    oReport_.iCompletedPasses++;
+    if (bPublish)
+    {
+      SetLiveSamplesPerPixel(*pLive, uPass + 1);
+      oLastLivePass = ProgressiveClock::now();
+    }
+
+    if (pGuide && oGuide.bTraining)
+    {
+      BuildPathGuide(oGuide);
+      oGuide.bTraining = uPass + 1 < uGuidePasses;
+    }
+
+    ProgressiveClock::time_point oNow = ProgressiveClock::now();
+    if (_oSettings.sCheckpointPath && (bLastPass || SecondsBetween(oLastCheckpoint, oNow) >= _oSettings.dCheckpointIntervalS))
+    {
+      QueueCheckpoint(oWriter, oAccum_);
+      oLastCheckpoint = oNow;
+    }
+  }
+
+  bool bOk = true;
+  if (_oSettings.sCheckpointPath)
+  {
+    bOk = StopCheckpointWriter(oWriter, sError_);
+    oReport_.iCheckpoints = oWriter.iWritten;
+  }
+
+  ResolveAccumulationBuffers(oAccum_, oBuffers_);
+  if (_oSettings.bDenoise)
+  {
+    DenoiseSettings oDenoiseSettings = _oSettings.oDenoiseSettings;
+    oDenoiseSettings.iThreadCount = iThreadCount;
+    DenoiseATrous(oBuffers_, oDenoiseSettings, vResolved_);
+  }
+  else
+  {
+    UnpackVec3Buffer(oBuffers_.oColor, vResolved_);
+  }
+
+  if (pLive)
+  {
+    for (uint32_t uTileIdx = 0; uTileIdx < vTiles.size(); uTileIdx++)
+    {
+      const ScreenTile& oTile = vTiles[uTileIdx];
+      PublishLiveTile(*pLive, uTileIdx, vResolved_.data() + static_cast<size_t>(oTile.iStartY) * _iWidth + oTile.iStartX, _iWidth, true);
+    }
+    SetLiveRenderState(*pLive, bOk ? LiveRenderState_Done : LiveRenderState_Failed);
+  }
+
+  oReport_.dRenderMs = SecondsBetween(oStart, ProgressiveClock::now()) * 1000.0;
+  return bOk;
+}
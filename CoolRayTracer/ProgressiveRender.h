@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Camera.h"
+#include "Checkpoint.h"
+#include "IncrementalRender.h"
+#include "LightTracing.h"
+#include "LiveFramebuffer.h"
+#include "Parallel.h"
+#include "PathGuide.h"
+#include "PerfCounters.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "TileOrder.h"
+#include "RenderBuffers.h"
+#include "Denoiser.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct ProgressiveSettings
+{
+  int iThreadCount = 0;                   // 0 uses every hardware thread
+  int iSamplesPerPixel = 256;
+  int iMaxBounces = 4;
+  bool bDenoise = true;
+  DenoiseSettings oDenoiseSettings;
+  TileSettings oTileSettings;
+  const char* sCheckpointPath = nullptr; // No checkpoints if null
+  double dCheckpointIntervalS = 60.0;     // Minimum time between two checkpoints, the last pass is always saved
+  int iGuideTrainingPasses = 0;           // First passes train the path guide, 0 turns guiding off
+  float fGuideCellSize = 0.f;             // 0 derives it from the scene bounds
+  bool bLightTraceCaustics = false;       // Caustics of the sphere lights come from light paths splatted to the image
+  int iLightPathsPerPass = 0;             // 0 traces one light path per pixel
+  BufferFormat eBufferFormat = BufferFormat_Float32; // Of the accumulated features and the resolved buffers
+  LiveFramebuffer* pLiveFramebuffer = nullptr; // Receives the tiles as they render, if set
+  double dLiveIntervalS = 0.25;           // Minimum time between two passes published live, the last pass is always published
+};
+
+enum ProgressiveStart
+{
+  ProgressiveStart_Fresh,
+  ProgressiveStart_Checkpoint, // Continues from ProgressiveSettings::sCheckpointPath
+  ProgressiveStart_Current     // Continues from the means already in the buffers, such as after InvalidateEditedTiles
+};
+
+struct ProgressiveReport
+{
+  uint32_t uStartSamplesPerPixel = 0; // Fewest samples a pixel had at the start, 0 for a fresh render
+  int iCompletedPasses = 0;
+  int iCheckpoints = 0;
+  double dRenderMs = 0.0;
+};
+
+// Hands the tiles out to the threads one at a time, a thread stops taking tiles once _fnTile(uTileIdx) returns false.
+// Clears the per thread render state and flushes the render counters of every thread at the end.
+template <typename TileFn>
+void RenderTilesInParallel(size_t _uTileCount, int _iThreadCount, TileFn&& _fnTile)
+{
+  std::atomic<uint32_t> uNextTile = 0;
+  ParallelForChunks(_iThreadCount, _iThreadCount, [&](int, int, int)
+    {
+      while (true)
+      {
+        uint32_t uTileIdx = uNextTile++;
+        if (uTileIdx >= _uTileCount || !_fnTile(uTileIdx))
+          break;
+      }
+      t_pHittableDependencies = nullptr;
+      t_pPathGuide = nullptr;
+      t_bLightTracedCaustics = false;
+      FlushRenderCounters();
+    });
+}
+
+// Long offline render, one sample per pass to every pixel below iSamplesPerPixel. Checkpoints of the means are
+// queued between passes and written in the background. A render continued from a checkpoint ends with exactly
+// the image an uninterrupted render gives. _uSceneHash identifies the scene in the checkpoint. With
+// pDependencies_ the hittables every tile depends on are recorded for InvalidateEditedTiles. With path guiding the
+// training passes rebuild the guide after each pass, a resumed render traces them again to rebuild it. With light
+// traced caustics every pass first traces its light paths and adds their splats to the pixels it samples. A live
+// framebuffer is laid out for the frame and gets the means of every tile as the passes finish it, then the final
+// image.
+// Returns false if the checkpoint cannot be resumed or written, or the live framebuffer cannot be laid out.
+bool RenderProgressive(const Scene& _oScene, const Camera& _oCamera, int _iWidth, int _iHeight, uint64_t _uSceneHash,
+  const ProgressiveSettings& _oSettings, ProgressiveStart _eStart, AccumulationBuffers& oAccum_, TileDependencies* pDependencies_,
+  RenderBuffers& oBuffers_, std::vector<color>& vResolved_, ProgressiveReport& oReport_, std::string& sError_);
@@ -0,0 +1,202 @@
+#include "RayQuery.h"
+
+#include "Parallel.h"
+#include "PerfCounters.h"
+#include "SampleWarp.h"
+#include "Sampler.h"
+
+#include <atomic>
+#include <float.h>
+#include <vector>
+
+// Hands out batches of g_iRayQueryBatch rays to _iThreadCount threads, _fnBatch(iBegin, iEnd) runs once per batch
+template <typename F>
+static void ForEachRayBatch(int _iCount, int _iThreadCount, F&& _fnBatch)
+{
+  int iBatchCount = (_iCount + g_iRayQueryBatch - 1) / g_iRayQueryBatch;
+  int iThreadCount = _iThreadCount < iBatchCount ? _iThreadCount : iBatchCount;
+  iThreadCount = iThreadCount > 1 ? iThreadCount : 1;
+
+  std::atomic<int> iNextBatch = 0;
+  ParallelForChunks(iThreadCount, iThreadCount, [&](int, int, int)
+    {
+      while (true)
+      {
+        int iBatch = iNextBatch++;
+        if (iBatch >= iBatchCount)
+          break;
+
+        int iBegin = iBatch * g_iRayQueryBatch;
+        int iEnd = _iCount - iBegin > g_iRayQueryBatch ? iBegin + g_iRayQueryBatch : _iCount;
+        _fnBatch(iBegin, iEnd);
+      }
+      FlushRenderCounters();
+    });
+}
+
+// Ray i moved to start at its tMin, with the length left before its tMax
+static inline ray GetQueryRay(const RayArrays& _oRays, int _iIdx, float& fMaxT_)
+{
+  vec3 vDir(_oRays.pDirX[_iIdx], _oRays.pDirY[_iIdx], _oRays.pDirZ[_iIdx]);
+  vec3 vOrigin(_oRays.pOriginX[_iIdx], _oRays.pOriginY[_iIdx], _oRays.pOriginZ[_iIdx]);
+  float fTMin = _oRays.pTMin[_iIdx];
+  fMaxT_ = _oRays.pTMax[_iIdx] - fTMin;
+  return ray(fTMin != 0.f ? vOrigin + vDir * fTMin : vOrigin, vDir);
+}
+
+void IntersectRays(const Scene& _oScene, const RayArrays& _oRays, int _iThreadCount, RayHitArrays& oHits_)
+{
+  ForEachRayBatch(_oRays.iCount, _iThreadCount, [&](int _iBegin, int _iEnd)
+    {
+      for (int i = _iBegin; i < _iEnd; i++)
+      {
+        float fMaxT;
+        ray oRay = GetQueryRay(_oRays, i, fMaxT);
+        HitInfo oHitInfo = {};
+        int iHittableIdx = fMaxT >= 0.f ? IntersectWideBVH(_oScene.oBVH, _oScene.vHittables, oRay, oHitInfo) : -1;
+        if (iHittableIdx >= 0 && oHitInfo.fT <= fMaxT)
+        {
+          oHits_.pHittableIdx[i] = iHittableIdx;
+          oHits_.pT[i] = oHitInfo.fT + _oRays.pTMin[i];
+          oHits_.pNormalX[i] = oHitInfo.vNormal.x();
+          oHits_.pNormalY[i] = oHitInfo.vNormal.y();
+          oHits_.pNormalZ[i] = oHitInfo.vNormal.z();
+        }
+        else
+        {
+          oHits_.pHittableIdx[i] = -1;
+          oHits_.pT[i] = FLT_MAX;
+          oHits_.pNormalX[i] = 0.f;
+          oHits_.pNormalY[i] = 0.f;
+          oHits_.pNormalZ[i] = 0.f;
+        }
+      }
+    });
+}
+
+void OccludeRays(const Scene& _oScene, const RayArrays& _oRays, int _iThreadCount, uint64_t* pOccluded_)
+{
+  static_assert(g_iRayQueryBatch % 64 == 0, "Batches must own whole occlusion words");
+
+  ForEachRayBatch(_oRays.iCount, _iThreadCount, [&](int _iBegin, int _iEnd)
+    {
+      for (int iWordBegin = _iBegin; iWordBegin < _iEnd; iWordBegin += 64)
+      {
+        int iWordEnd = _iEnd - iWordBegin > 64 ? iWordBegin + 64 : _iEnd;
+        uint64_t uWord = 0;
+        for (int i = iWordBegin; i < iWordEnd; i++)
+        {
+          float fMaxT;
+          ray oRay = GetQueryRay(_oRays, i, fMaxT);
+          if (fMaxT > 0.f && OccludedWideBVH(_oScene.oBVH, _oScene.vHittables, oRay, fMaxT))
+          {
+            uWord |= 1ull << (i - iWordBegin);
+          }
+        }
+        pOccluded_[iWordBegin / 64] = uWord;
+      }
+    });
+}
+
+// Rays, random numbers and occlusion bits of the point being baked on this thread
+struct OcclusionBakeScratch
+{
+  std::vector<float> vRandom1;
+  std::vector<float> vRandom2;
+  std::vector<float> vOriginX;
+  std::vector<float> vOriginY;
+  std::vector<float> vOriginZ;
+  std::vector<float> vDirX;
+  std::vector<float> vDirY;
+  std::vector<float> vDirZ;
+  std::vector<float> vTMin;
+  std::vector<float> vTMax;
+  std::vector<uint64_t> vOccluded;
+};
+
+static thread_local OcclusionBakeScratch t_oBakeScratch;
+
+static void BakePoint(const Scene& _oScene, const SurfacePointArrays& _oPoints, const OcclusionBakeSettings& _oSettings, int _iIdx,
+  OcclusionBakeArrays& oBake_)
+{
+  OcclusionBakeScratch& oScratch = t_oBakeScratch;
+  size_t uRayCount = static_cast<size_t>(_oSettings.iRayCount);
+  if (oScratch.vDirX.size() != uRayCount)
+  {
+    for (std::vector<float>* pArray : { &oScratch.vRandom1, &oScratch.vRandom2, &oScratch.vOriginX, &oScratch.vOriginY, &oScratch.vOriginZ,
+      &oScratch.vDirX, &oScratch.vDirY, &oScratch.vDirZ, &oScratch.vTMin, &oScratch.vTMax })
+    {
+      pArray->resize(uRayCount);
+    }
+    oScratch.vOccluded.resize(GetOcclusionWordCount(_oSettings.iRayCount));
+  }
+
+  // Bake streams are kept apart from every pixel's and light path's by their top bits
+  t_uSamplerState = MixSamplerBits(MixSamplerBits((1ull << 62) | static_cast<uint32_t>(_iIdx)) + _oSettings.uSeed);
+  for (size_t i = 0; i < uRayCount; i++)
+  {
+    oScratch.vRandom1[i] = SampleRandom();
+    oScratch.vRandom2[i] = SampleRandom();
+  }
+
+  vec3 vNormal(_oPoints.pNormalX[_iIdx], _oPoints.pNormalY[_iIdx], _oPoints.pNormalZ[_iIdx]);
+  vec3 vOrigin = vec3(_oPoints.pPositionX[_iIdx], _oPoints.pPositionY[_iIdx], _oPoints.pPositionZ[_iIdx]) + vNormal * _oSettings.fNormalOffset;
+  SampleHemisphereCosineBatch(oScratch.vRandom1.data(), oScratch.vRandom2.data(), _oSettings.iRayCount, oScratch.vDirX.data(),
+    oScratch.vDirY.data(), oScratch.vDirZ.data());
+  TangentToWorldBatch(oScratch.vDirX.data(), oScratch.vDirY.data(), oScratch.vDirZ.data(), _oSettings.iRayCount, vNormal,
+    oScratch.vDirX.data(), oScratch.vDirY.data(), oScratch.vDirZ.data());
+  for (size_t i = 0; i < uRayCount; i++)
+  {
+    oScratch.vOriginX[i] = vOrigin.x();
+    oScratch.vOriginY[i] = vOrigin.y();
+    oScratch.vOriginZ[i] = vOrigin.z();
+    oScratch.vTMin[i] = 0.f;
+    oScratch.vTMax[i] = _oSettings.fMaxDistance;
+  }
+
+  RayArrays oRays;
+  oRays.pOriginX = oScratch.vOriginX.data();
+  oRays.pOriginY = oScratch.vOriginY.data();
+  oRays.pOriginZ = oScratch.vOriginZ.data();
+  oRays.pDirX = oScratch.vDirX.data();
+  oRays.pDirY = oScratch.vDirY.data();
+  oRays.pDirZ = oScratch.vDirZ.data();
+  oRays.pTMin = oScratch.vTMin.data();
+  oRays.pTMax = oScratch.vTMax.data();
+  oRays.iCount = _oSettings.iRayCount;
+  OccludeRays(_oScene, oRays, 1, oScratch.vOccluded.data());
+
+  int iVisibleCount = 0;
+  vec3 vBent(0.f, 0.f, 0.f);
+  for (size_t i = 0; i < uRayCount; i++)
+  {
+    if ((oScratch.vOccluded[i / 64] >> (i % 64) & 1u) == 0)
+    {
+      iVisibleCount++;
+      vBent += vec3(oScratch.vDirX[i], oScratch.vDirY[i], oScratch.vDirZ[i]);
+    }
+  }
+
+  float fBentLength = vBent.Length();
+  vBent = fBentLength > 0.f ? vBent / fBentLength : vNormal;
+  oBake_.pVisibility[_iIdx] = static_cast<float>(iVisibleCount) / static_cast<float>(_oSettings.iRayCount);
+  oBake_.pBentNormalX[_iIdx] = vBent.x();
+  oBake_.pBentNormalY[_iIdx] = vBent.y();
+  oBake_.pBentNormalZ[_iIdx] = vBent.z();
+}
+
+void BakeOcclusion(const Scene& _oScene, const SurfacePointArrays& _oPoints, const OcclusionBakeSettings& _oSettings,
+  OcclusionBakeArrays& oBake_)
+{
+  if (_oSettings.iRayCount <= 0)
+    return;
+
+  // The points of a batch go one at a time, the rays of each share an origin and stay coherent
+  ForEachRayBatch(_oPoints.iCount, _oSettings.iThreadCount, [&](int _iBegin, int _iEnd)
+    {
+      for (int i = _iBegin; i < _iEnd; i++)
+      {
+        BakePoint(_oScene, _oPoints, _oSettings, i, oBake_);
+      }
+    });
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <stdint.h>
+
+// Rays are traced in batches of this many, one thread at a time, and every batch owns whole words of the occlusion
+// bits, so threads never share a word
+static constexpr int g_iRayQueryBatch = 256;
+
+// Structure of arrays rays for the bulk queries, iCount of each. Directions need not be unit length, t is measured
+// in their lengths. Hits closer than the origin's tMin are skipped by starting the ray there.
+struct RayArrays
+{
+  const float* pOriginX = nullptr;
+  const float* pOriginY = nullptr;
+  const float* pOriginZ = nullptr;
+  const float* pDirX = nullptr;
+  const float* pDirY = nullptr;
+  const float* pDirZ = nullptr;
+  const float* pTMin = nullptr;
+  const float* pTMax = nullptr;
+  int iCount = 0;
+};
+
+// Closest hit of each ray, iCount entries per array. Misses get hittable -1, t FLT_MAX and a zero normal.
+struct RayHitArrays
+{
+  int32_t* pHittableIdx = nullptr;
+  float* pT = nullptr;
+  float* pNormalX = nullptr; // Geometric, facing away from the hittable
+  float* pNormalY = nullptr;
+  float* pNormalZ = nullptr;
+};
+
+inline size_t GetOcclusionWordCount(int _iRayCount)
+{
+  return (static_cast<size_t>(_iRayCount) + 63u) / 64u;
+}
+
+// Closest hits in [tMin, tMax] of every ray, traced by _iThreadCount threads. Same hit rules as the renderer.
+void IntersectRays(const Scene& _oScene, const RayArrays& _oRays, int _iThreadCount, RayHitArrays& oHits_);
+
+// Sets bit i of pOccluded_ when ray i hits anything in [tMin, tMax), clears it otherwise. pOccluded_ holds
+// GetOcclusionWordCount(iCount) words, the bits past iCount are cleared.
+void OccludeRays(const Scene& _oScene, const RayArrays& _oRays, int _iThreadCount, uint64_t* pOccluded_);
+
+struct OcclusionBakeSettings
+{
+  int iRayCount = 64;          // Per point, cosine distributed around its normal
+  float fMaxDistance = 1.f;    // Blockers further away do not count
+  float fNormalOffset = 0.001f; // Rays start this far above the surface
+  uint32_t uSeed = 0;
+  int iThreadCount = 1;
+};
+
+// Surface points to bake, _iCount of each
+struct SurfacePointArrays
+{
+  const float* pPositionX = nullptr;
+  const float* pPositionY = nullptr;
+  const float* pPositionZ = nullptr;
+  const float* pNormalX = nullptr; // Unit length
+  const float* pNormalY = nullptr;
+  const float* pNormalZ = nullptr;
+  int iCount = 0;
+};
+
+// Per point ambient occlusion as the unoccluded fraction of its cosine distributed rays, and the bent normal as the
+// mean of the unoccluded directions, or the normal if every ray is blocked
+struct OcclusionBakeArrays
+{
+  float* pVisibility = nullptr;
+  float* pBentNormalX = nullptr;
+  float* pBentNormalY = nullptr;
+  float* pBentNormalZ = nullptr;
+};
+
+// Traces the rays of every point through OccludeRays. The rays of a point only depend on its index and uSeed, so
+// the bake comes out the same whatever the thread count.
+void BakeOcclusion(const Scene& _oScene, const SurfacePointArrays& _oPoints, const OcclusionBakeSettings& _oSettings,
+  OcclusionBakeArrays& oBake_);
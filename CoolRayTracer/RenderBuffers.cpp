@@ -0,0 +1,238 @@
+#include "RenderBuffers.h"
+
+#include <string.h>
+
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 arrays are converted as float arrays");
+
+void ResizePackedVec3Buffer(size_t _uCount, BufferFormat _eFormat, bool _bSigned, PackedVec3Buffer& oBuffer_)
+{
+  BufferFormat eFormat = _bSigned && _eFormat == BufferFormat_Rgbe ? BufferFormat_Float16 : _eFormat;
+  oBuffer_.eFormat = eFormat;
+
+  // Arrays of the other formats are freed, shrinking is what the packed formats are for
+  if (eFormat == BufferFormat_Float32)
+  {
+    oBuffer_.vFloat.assign(_uCount, vec3(0.f, 0.f, 0.f));
+  }
+  else
+  {
+    std::vector<vec3>().swap(oBuffer_.vFloat);
+  }
+  if (eFormat == BufferFormat_Float16)
+  {
+    oBuffer_.vHalf.assign(_uCount * 3, 0);
+  }
+  else
+  {
+    std::vector<uint16_t>().swap(oBuffer_.vHalf);
+  }
+  if (eFormat == BufferFormat_Rgbe)
+  {
+    oBuffer_.vRgbe.assign(_uCount, 0u);
+  }
+  else
+  {
+    std::vector<uint32_t>().swap(oBuffer_.vRgbe);
+  }
+}
+
+void ResizePackedFloatBuffer(size_t _uCount, BufferFormat _eFormat, PackedFloatBuffer& oBuffer_)
+{
+  oBuffer_.eFormat = _eFormat == BufferFormat_Float32 ? BufferFormat_Float32 : BufferFormat_Float16;
+  if (oBuffer_.eFormat == BufferFormat_Float32)
+  {
+    oBuffer_.vFloat.assign(_uCount, 0.f);
+    std::vector<uint16_t>().swap(oBuffer_.vHalf);
+  }
+  else
+  {
+    oBuffer_.vHalf.assign(_uCount, 0);
+    std::vector<float>().swap(oBuffer_.vFloat);
+  }
+}
+
+size_t GetPackedBufferBytes(const PackedVec3Buffer& _oBuffer)
+{
+  return _oBuffer.vFloat.size() * sizeof(vec3) + _oBuffer.vHalf.size() * sizeof(uint16_t) + _oBuffer.vRgbe.size() * sizeof(uint32_t);
+}
+
+size_t GetPackedBufferBytes(const PackedFloatBuffer& _oBuffer)
+{
+  return _oBuffer.vFloat.size() * sizeof(float) + _oBuffer.vHalf.size() * sizeof(uint16_t);
+}
+
+void LoadVec3Range(const PackedVec3Buffer& _oBuffer, size_t _uBegin, size_t _uCount, vec3* pValues_)
+{
+  switch (_oBuffer.eFormat)
+  {
+  case BufferFormat_Float16:
+    HalfToFloatBatch(_oBuffer.vHalf.data() + _uBegin * 3, _uCount * 3, reinterpret_cast<float*>(pValues_));
+    break;
+  case BufferFormat_Rgbe:
+    for (size_t i = 0; i < _uCount; i++)
+    {
+      pValues_[i] = RgbeToFloat(_oBuffer.vRgbe[_uBegin + i]);
+    }
+    break;
+  default:
+    memcpy(pValues_, _oBuffer.vFloat.data() + _uBegin, _uCount * sizeof(vec3));
+    break;
+  }
+}
+
+void StoreVec3Range(PackedVec3Buffer& oBuffer_, size_t _uBegin, size_t _uCount, const vec3* _pValues)
+{
+  switch (oBuffer_.eFormat)
+  {
+  case BufferFormat_Float16:
+    FloatToHalfBatch(reinterpret_cast<const float*>(_pValues), _uCount * 3, oBuffer_.vHalf.data() + _uBegin * 3);
+    break;
+  case BufferFormat_Rgbe:
+    for (size_t i = 0; i < _uCount; i++)
+    {
+      oBuffer_.vRgbe[_uBegin + i] = FloatToRgbe(_pValues[i]);
+    }
+    break;
+  default:
+    memcpy(oBuffer_.vFloat.data() + _uBegin, _pValues, _uCount * sizeof(vec3));
+    break;
+  }
+}
+
+void LoadFloatRange(const PackedFloatBuffer& _oBuffer, size_t _uBegin, size_t _uCount, float* pValues_)
+{
+  if (_oBuffer.eFormat == BufferFormat_Float32)
+  {
+    memcpy(pValues_, _oBuffer.vFloat.data() + _uBegin, _uCount * sizeof(float));
+  }
+  else
+  {
+    HalfToFloatBatch(_oBuffer.vHalf.data() + _uBegin, _uCount, pValues_);
+  }
+}
+
+void StoreFloatRange(PackedFloatBuffer& oBuffer_, size_t _uBegin, size_t _uCount, const float* _pValues)
+{
+  if (oBuffer_.eFormat == BufferFormat_Float32)
+  {
+    memcpy(oBuffer_.vFloat.data() + _uBegin, _pValues, _uCount * sizeof(float));
+  }
+  else
+  {
+    FloatToHalfBatch(_pValues, _uCount, oBuffer_.vHalf.data() + _uBegin);
+  }
+}
+
+const vec3* GetFloatVec3s(const PackedVec3Buffer& _oBuffer, std::vector<vec3>& vScratch_)
+{
+  if (_oBuffer.eFormat == BufferFormat_Float32)
+    return _oBuffer.vFloat.data();
+
+  UnpackVec3Buffer(_oBuffer, vScratch_);
+  return vScratch_.data();
+}
+
+const float* GetFloats(const PackedFloatBuffer& _oBuffer, std::vector<float>& vScratch_)
+{
+  if (_oBuffer.eFormat == BufferFormat_Float32)
+    return _oBuffer.vFloat.data();
+
+  vScratch_.resize(_oBuffer.vHalf.size());
+  LoadFloatRange(_oBuffer, 0, vScratch_.size(), vScratch_.data());
+  return vScratch_.data();
+}
+
+void UnpackVec3Buffer(const PackedVec3Buffer& _oBuffer, std::vector<vec3>& vValues_)
+{
+  size_t uCount = _oBuffer.vFloat.size() + _oBuffer.vHalf.size() / 3 + _oBuffer.vRgbe.size();
+  vValues_.resize(uCount);
+  LoadVec3Range(_oBuffer, 0, uCount, vValues_.data());
+}
+
+static const char* s_aBufferFormatNames[BufferFormat_Count] = { "f32", "f16", "rgbe" };
+
+const char* GetBufferFormatName(BufferFormat _eFormat)
+{
+  return (_eFormat >= BufferFormat_Float32 && _eFormat < BufferFormat_Count) ? s_aBufferFormatNames[_eFormat] : "unknown";
+}
+
+bool ParseBufferFormat(const char* _sName, BufferFormat& eFormat_)
+{
+  for (int i = 0; i < BufferFormat_Count; i++)
+  {
+    if (strcmp(_sName, s_aBufferFormatNames[i]) == 0)
+    {
+      eFormat_ = static_cast<BufferFormat>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ResizeRenderBuffers(int _iWidth, int _iHeight, BufferFormat _eFormat, RenderBuffers& oBuffers_)
+{
+  size_t uPixelCount = static_cast<size_t>(_iWidth) * _iHeight;
+  oBuffers_.iWidth = _iWidth;
+  oBuffers_.iHeight = _iHeight;
+  oBuffers_.eFormat = _eFormat;
+  ResizePackedVec3Buffer(uPixelCount, _eFormat, false, oBuffers_.oColor);
+  ResizePackedVec3Buffer(uPixelCount, _eFormat, false, oBuffers_.oAlbedo);
+  ResizePackedVec3Buffer(uPixelCount, _eFormat, true, oBuffers_.oNormal);
+  ResizePackedFloatBuffer(uPixelCount, _eFormat, oBuffers_.oDepth);
+}
+
+void ResizeAccumulationBuffers(int _iWidth, int _iHeight, BufferFormat _eFormat, AccumulationBuffers& oAccum_)
+{
+  size_t uPixelCount = static_cast<size_t>(_iWidth) * _iHeight;
+  oAccum_.iWidth = _iWidth;
+  oAccum_.iHeight = _iHeight;
+  oAccum_.eFormat = _eFormat;
+  ResizePackedVec3Buffer(uPixelCount, BufferFormat_Float32, false, oAccum_.oColor);
+  ResizePackedVec3Buffer(uPixelCount, _eFormat, false, oAccum_.oAlbedo);
+  ResizePackedVec3Buffer(uPixelCount, _eFormat, true, oAccum_.oNormal);
+  ResizePackedFloatBuffer(uPixelCount, _eFormat, oAccum_.oDepth);
+  oAccum_.vHitCount.assign(uPixelCount, 0u);
+  oAccum_.vSampleCount.assign(uPixelCount, 0u);
+}
+
+size_t GetAccumulationBufferBytes(const AccumulationBuffers& _oAccum)
+{
+  return GetPackedBufferBytes(_oAccum.oColor) + GetPackedBufferBytes(_oAccum.oAlbedo) + GetPackedBufferBytes(_oAccum.oNormal)
+    + GetPackedBufferBytes(_oAccum.oDepth) + (_oAccum.vHitCount.size() + _oAccum.vSampleCount.size()) * sizeof(uint32_t);
+}
+
+void ResolveAccumulationBuffers(const AccumulationBuffers& _oAccum, RenderBuffers& oBuffers_)
+{
+  ResizeRenderBuffers(_oAccum.iWidth, _oAccum.iHeight, _oAccum.eFormat, oBuffers_);
+
+  // A row at a time, through float copies of the packed values
+  size_t uWidth = static_cast<size_t>(_oAccum.iWidth);
+  std::vector<vec3> vRow(uWidth);
+  std::vector<float> vDepthRow(uWidth);
+  for (int y = 0; y < _oAccum.iHeight; y++)
+  {
+    size_t uBegin = static_cast<size_t>(y) * uWidth;
+    const uint32_t* pSamples = _oAccum.vSampleCount.data() + uBegin;
+    const uint32_t* pHits = _oAccum.vHitCount.data() + uBegin;
+
+    LoadVec3Range(_oAccum.oColor, uBegin, uWidth, vRow.data());
+    for (size_t x = 0; x < uWidth; x++)
+    {
+      vRow[x] = pSamples[x] > 0 ? vRow[x] : color(0.f, 0.f, 0.f);
+    }
+    StoreVec3Range(oBuffers_.oColor, uBegin, uWidth, vRow.data());
+
+    LoadVec3Range(_oAccum.oAlbedo, uBegin, uWidth, vRow.data());
+    StoreVec3Range(oBuffers_.oAlbedo, uBegin, uWidth, vRow.data());
+
+    LoadVec3Range(_oAccum.oNormal, uBegin, uWidth, vRow.data());
+    for (size_t x = 0; x < uWidth; x++)
+    {
+      vRow[x] = pHits[x] > 0 ? Normalize(vRow[x]) : vec3(0.f, 0.f, 0.f);
+    }
+    StoreVec3Range(oBuffers_.oNormal, uBegin, uWidth, vRow.data());
+
+    LoadFloatRange(_oAccum.oDepth, uBegin, uWidth, vDepthRow.data());
+    StoreFloatRange(oBuffers_.oDepth, uBegin, uWidth, vDepthRow.data());
+  }
+}
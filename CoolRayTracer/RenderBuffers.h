@@ -0,0 +1,217 @@
+#pragma once
+
+#include "PackedFloat.h"
+#include "vec3.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+using color = vec3;
+
+// Storage of the per-pixel buffers. The packed formats trade precision for memory, half floats keep about three
+// significant digits and shared exponent colors two.
+enum BufferFormat
+{
+  BufferFormat_Float32,
+  BufferFormat_Float16, // 6 bytes per vector
+  BufferFormat_Rgbe,    // 4 bytes per color, normals and depth fall back to Float16
+  BufferFormat_Count
+};
+
+// One vector per pixel, only the array of eFormat is allocated
+struct PackedVec3Buffer
+{
+  BufferFormat eFormat = BufferFormat_Float32;
+  std::vector<vec3> vFloat;
+  std::vector<uint16_t> vHalf; // Three per pixel
+  std::vector<uint32_t> vRgbe;
+};
+
+// One scalar per pixel, Float32 or Float16
+struct PackedFloatBuffer
+{
+  BufferFormat eFormat = BufferFormat_Float32;
+  std::vector<float> vFloat;
+  std::vector<uint16_t> vHalf;
+};
+
+// Clears the buffer to 0. _bSigned buffers hold vectors with negative components, which Rgbe cannot store.
+void ResizePackedVec3Buffer(size_t _uCount, BufferFormat _eFormat, bool _bSigned, PackedVec3Buffer& oBuffer_);
+
+void ResizePackedFloatBuffer(size_t _uCount, BufferFormat _eFormat, PackedFloatBuffer& oBuffer_);
+
+size_t GetPackedBufferBytes(const PackedVec3Buffer& _oBuffer);
+
+size_t GetPackedBufferBytes(const PackedFloatBuffer& _oBuffer);
+
+inline vec3 LoadVec3(const PackedVec3Buffer& _oBuffer, size_t _uIdx)
+{
+  switch (_oBuffer.eFormat)
+  {
+  case BufferFormat_Float16:
+  {
+    const uint16_t* pHalves = _oBuffer.vHalf.data() + _uIdx * 3;
+    return vec3(HalfToFloat(pHalves[0]), HalfToFloat(pHalves[1]), HalfToFloat(pHalves[2]));
+  }
+  case BufferFormat_Rgbe:
+    return RgbeToFloat(_oBuffer.vRgbe[_uIdx]);
+  default:
+    return _oBuffer.vFloat[_uIdx];
+  }
+}
+
+inline void StoreVec3(PackedVec3Buffer& oBuffer_, size_t _uIdx, const vec3& _vValue)
+{
+  switch (oBuffer_.eFormat)
+  {
+  case BufferFormat_Float16:
+  {
+    uint16_t* pHalves = oBuffer_.vHalf.data() + _uIdx * 3;
+    for (int i = 0; i < 3; i++)
+    {
+      pHalves[i] = FloatToHalf(_vValue[i]);
+    }
+    break;
+  }
+  case BufferFormat_Rgbe:
+    oBuffer_.vRgbe[_uIdx] = FloatToRgbe(_vValue);
+    break;
+  default:
+    oBuffer_.vFloat[_uIdx] = _vValue;
+    break;
+  }
+}
+
+// Stochastic rounding for values updated many times, see FloatToHalfStochastic. _uRandom supplies 13 bits per
+// component, Float32 ignores it.
+inline void StoreVec3Stochastic(PackedVec3Buffer& oBuffer_, size_t _uIdx, const vec3& _vValue, uint64_t _uRandom)
+{
+  switch (oBuffer_.eFormat)
+  {
+  case BufferFormat_Float16:
+  {
+    uint16_t* pHalves = oBuffer_.vHalf.data() + _uIdx * 3;
+    for (int i = 0; i < 3; i++)
+    {
+      pHalves[i] = FloatToHalfStochastic(_vValue[i], static_cast<uint32_t>(_uRandom >> (13 * i)));
+    }
+    break;
+  }
+  case BufferFormat_Rgbe:
+    oBuffer_.vRgbe[_uIdx] = FloatToRgbeStochastic(_vValue, static_cast<uint32_t>(_uRandom));
+    break;
+  default:
+    oBuffer_.vFloat[_uIdx] = _vValue;
+    break;
+  }
+}
+
+inline float LoadFloat(const PackedFloatBuffer& _oBuffer, size_t _uIdx)
+{
+  return _oBuffer.eFormat == BufferFormat_Float32 ? _oBuffer.vFloat[_uIdx] : HalfToFloat(_oBuffer.vHalf[_uIdx]);
+}
+
+inline void StoreFloat(PackedFloatBuffer& oBuffer_, size_t _uIdx, float _fValue)
+{
+  if (oBuffer_.eFormat == BufferFormat_Float32)
+  {
+    oBuffer_.vFloat[_uIdx] = _fValue;
+  }
+  else
+  {
+    oBuffer_.vHalf[_uIdx] = FloatToHalf(_fValue);
+  }
+}
+
+inline void StoreFloatStochastic(PackedFloatBuffer& oBuffer_, size_t _uIdx, float _fValue, uint64_t _uRandom)
+{
+  if (oBuffer_.eFormat == BufferFormat_Float32)
+  {
+    oBuffer_.vFloat[_uIdx] = _fValue;
+  }
+  else
+  {
+    oBuffer_.vHalf[_uIdx] = FloatToHalfStochastic(_fValue, static_cast<uint32_t>(_uRandom));
+  }
+}
+
+// Runs of pixels at once, the half floats convert through the batch kernels
+void LoadVec3Range(const PackedVec3Buffer& _oBuffer, size_t _uBegin, size_t _uCount, vec3* pValues_);
+
+void StoreVec3Range(PackedVec3Buffer& oBuffer_, size_t _uBegin, size_t _uCount, const vec3* _pValues);
+
+void LoadFloatRange(const PackedFloatBuffer& _oBuffer, size_t _uBegin, size_t _uCount, float* pValues_);
+
+void StoreFloatRange(PackedFloatBuffer& oBuffer_, size_t _uBegin, size_t _uCount, const float* _pValues);
+
+// The values as floats, straight from the buffer for Float32 and unpacked into vScratch_ otherwise
+const vec3* GetFloatVec3s(const PackedVec3Buffer& _oBuffer, std::vector<vec3>& vScratch_);
+
+const float* GetFloats(const PackedFloatBuffer& _oBuffer, std::vector<float>& vScratch_);
+
+void UnpackVec3Buffer(const PackedVec3Buffer& _oBuffer, std::vector<vec3>& vValues_);
+
+const char* GetBufferFormatName(BufferFormat _eFormat);
+
+// Accepts the names returned by GetBufferFormatName
+bool ParseBufferFormat(const char* _sName, BufferFormat& eFormat_);
+
+// Per-pixel outputs of the path tracer. Features are the average of the first hit of every sample,
+// a depth of 0 means that the primary ray escaped.
+struct RenderBuffers
+{
+  int iWidth = 0;
+  int iHeight = 0;
+  BufferFormat eFormat = BufferFormat_Float32;
+  PackedVec3Buffer oColor;
+  PackedVec3Buffer oAlbedo;
+  PackedVec3Buffer oNormal;
+  PackedFloatBuffer oDepth;
+};
+
+void ResizeRenderBuffers(int _iWidth, int _iHeight, BufferFormat _eFormat, RenderBuffers& oBuffers_);
+
+// Running means of a progressive render, every pixel keeps its own sample count. The color mean is always in floats,
+// a packed mean is rounded again on every update and its error grows with the sample count. eFormat applies to the
+// features, whose means keep the packed formats at their relative precision and round stochastically so the
+// rounding errors average out over the samples, and to the resolved buffers.
+struct AccumulationBuffers
+{
+  int iWidth = 0;
+  int iHeight = 0;
+  BufferFormat eFormat = BufferFormat_Float32;
+  PackedVec3Buffer oColor;
+  PackedVec3Buffer oAlbedo;
+  PackedVec3Buffer oNormal; // Over the hits, not normalized
+  PackedFloatBuffer oDepth; // Over the hits
+  std::vector<uint32_t> vHitCount;
+  std::vector<uint32_t> vSampleCount;
+};
+
+void ResizeAccumulationBuffers(int _iWidth, int _iHeight, BufferFormat _eFormat, AccumulationBuffers& oAccum_);
+
+size_t GetAccumulationBufferBytes(const AccumulationBuffers& _oAccum);
+
+// Mean of _uCount values and one more. Light splatted ahead of that value by AddToNextValue is part of it, with no
+// values yet the mean holds only that light.
+inline vec3 AddToMean(const vec3& _vMean, uint32_t _uCount, const vec3& _vValue)
+{
+  float fInvCount = 1.f / static_cast<float>(_uCount + 1);
+  return _uCount > 0 ? _vMean * (static_cast<float>(_uCount) * fInvCount) + _vValue * fInvCount : _vMean + _vValue;
+}
+
+inline float AddToMean(float _fMean, uint32_t _uCount, float _fValue)
+{
+  float fInvCount = 1.f / static_cast<float>(_uCount + 1);
+  return _uCount > 0 ? _fMean * (static_cast<float>(_uCount) * fInvCount) + _fValue * fInvCount : _fMean + _fValue;
+}
+
+// Adds to the value AddToMean folds in next. Scaled by 1/_uCount here and by _uCount/(_uCount + 1) there, it
+// ends up with the weight of the value it belongs to.
+inline vec3 AddToNextValue(const vec3& _vMean, uint32_t _uCount, const vec3& _vValue)
+{
+  return _uCount > 0 ? _vMean + _vValue / static_cast<float>(_uCount) : _vMean + _vValue;
+}
+
+void ResolveAccumulationBuffers(const AccumulationBuffers& _oAccum, RenderBuffers& oBuffers_);
@@ -0,0 +1,129 @@
+#include "RenderJob.h"
+
+#include "PerfCounters.h"
+#include "Renderer.h"
+
+#include <utility>
+
+static void ResolveRenderJob(RenderJob& oJob_)
+{
+  if (oJob_.oSettings.bDenoise)
+  {
+    DenoiseATrous(oJob_.oBuffers, oJob_.oSettings.oDenoiseSettings, oJob_.vResolved);
+  }
+  else
+  {
+    UnpackVec3Buffer(oJob_.oBuffers.oColor, oJob_.vResolved);
+  }
+
+  std::lock_guard<std::mutex> oLock(oJob_.oMutex);
+  oJob_.dRenderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oJob_.oStartTime).count();
+  oJob_.bDone = true;
+  oJob_.oCondition.notify_all();
+}
+
+static void RenderJobTile(RenderJob& oJob_, size_t _uTileIdx)
+{
+  // The replica local to this worker's NUMA node, if the scene has any
+  const Scene& oScene = GetNodeScene(*oJob_.pScene, t_iThreadPoolNode);
+  const ScreenTile& oTile = oJob_.vTiles[_uTileIdx];
+
+  // Pool threads are shared by jobs of both precisions
+  t_eMathPrecision = oJob_.oSettings.eMathPrecision;
+
+  ForEachPixel(oTile.iStartX, oTile.iStartY, oTile.iEndX, oTile.iEndY, oJob_.oSettings.oTileSettings.ePixelOrder, [&](int x, int y)
+    {
+      RenderPixel(oScene, oJob_.oFrame, x, y, oJob_.oSettings.iSamplesPerPixel, oJob_.oSettings.iMaxBounces, oJob_.oBuffers);
+    });
+  FlushRenderCounters();
+
+  std::coroutine_handle<> hTileWaiter;
+  if (oJob_.bStreamTiles)
+  {
+    std::lock_guard<std::mutex> oLock(oJob_.oMutex);
+    oJob_.vFinishedTiles.push_back(static_cast<uint32_t>(_uTileIdx));
+    hTileWaiter = std::exchange(oJob_.hTileWaiter, nullptr);
+    oJob_.oCondition.notify_all();
+  }
+
+  if (--oJob_.uRemainingTiles == 0)
+  {
+    ResolveRenderJob(oJob_);
+  }
+
+  // Resumed after this worker's share of the job, so the stream's consumer can wait for the job without
+  // waiting on itself
+  if (hTileWaiter)
+  {
+    hTileWaiter.resume();
+  }
+}
+
+void StartRenderJob(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const Camera& _oCamera, const RenderSettings& _oSettings, RenderJob& oJob_)
+{
+  oJob_.pScene = std::move(_pScene);
+  oJob_.oCamera = _oCamera;
+  oJob_.oSettings = _oSettings;
+  oJob_.oFrame = ComputeCameraFrame(_oCamera, _oSettings.iWidth, _oSettings.iHeight);
+  oJob_.bDone = false;
+  oJob_.vFinishedTiles.clear();
+  oJob_.hTileWaiter = nullptr;
+  oJob_.oStartTime = std::chrono::steady_clock::now();
+
+  ResizeRenderBuffers(_oSettings.iWidth, _oSettings.iHeight, _oSettings.eBufferFormat, oJob_.oBuffers);
+  BuildTileList(_oSettings.iWidth, _oSettings.iHeight, _oSettings.oTileSettings, GetThreadPoolSize(oPool_), oJob_.vTiles);
+
+  if (oJob_.vTiles.empty())
+  {
+    ResolveRenderJob(oJob_);
+    return;
+  }
+
+  oJob_.uRemainingTiles = oJob_.vTiles.size();
+  int iNodeCount = GetThreadPoolNodeCount(oPool_);
+  if (iNodeCount < 2)
+  {
+    for (size_t i = 0; i < oJob_.vTiles.size(); i++)
+    {
+      SubmitTask(oPool_, [&oJob_, i]() { RenderJobTile(oJob_, i); });
+    }
+    return;
+  }
+
+  // Each node gets a contiguous run of the tile order, sized by its thread count. Neighbouring tiles hit the
+  // same geometry, so a node's caches and its scene copy are shared by spatially close work.
+  size_t uTileCount = oJob_.vTiles.size();
+  size_t uPoolSize = static_cast<size_t>(GetThreadPoolSize(oPool_));
+  size_t uThreadsBefore = 0;
+  for (int iNode = 0; iNode < iNodeCount; iNode++)
+  {
+    size_t uBegin = uTileCount * uThreadsBefore / uPoolSize;
+    uThreadsBefore += static_cast<size_t>(oPool_.vNodes[iNode]->iThreadCount);
+    size_t uEnd = uTileCount * uThreadsBefore / uPoolSize;
+    for (size_t i = uBegin; i < uEnd; i++)
+    {
+      SubmitNodeTask(oPool_, iNode, [&oJob_, i]() { RenderJobTile(oJob_, i); });
+    }
+  }
+}
+
+void StartRenderView(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const RenderView& _oView, const RenderSettings& _oSettings,
+  RenderJob& oJob_)
+{
+  RenderSettings oSettings = _oSettings;
+  oSettings.iWidth = _oView.iWidth;
+  oSettings.iHeight = _oView.iHeight;
+  StartRenderJob(oPool_, std::move(_pScene), _oView.oCamera, oSettings, oJob_);
+}
+
+bool IsRenderJobDone(RenderJob& oJob_)
+{
+  std::lock_guard<std::mutex> oLock(oJob_.oMutex);
+  return oJob_.bDone;
+}
+
+void WaitForRenderJob(RenderJob& oJob_)
+{
+  std::unique_lock<std::mutex> oLock(oJob_.oMutex);
+  oJob_.oCondition.wait(oLock, [&oJob_]() { return oJob_.bDone; });
+}
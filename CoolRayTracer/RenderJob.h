@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Camera.h"
+#include "Scene.h"
+#include "TileOrder.h"
+#include "RenderBuffers.h"
+#include "Denoiser.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct RenderSettings
+{
+  int iWidth = 1280;
+  int iHeight = 720;
+  int iSamplesPerPixel = 8;
+  int iMaxBounces = 4;
+  bool bDenoise = true;
+  MathPrecision eMathPrecision = MathPrecision_Accurate;
+  BufferFormat eBufferFormat = BufferFormat_Float32;
+  DenoiseSettings oDenoiseSettings;
+  TileSettings oTileSettings;
+};
+
+// One image of one camera. Jobs only read the scene, so any number of them can share it and run at once.
+struct RenderJob
+{
+  std::shared_ptr<const Scene> pScene;
+  Camera oCamera;
+  RenderSettings oSettings;
+  CameraFrame oFrame = {};
+  std::vector<ScreenTile> vTiles;
+  RenderBuffers oBuffers;
+  std::vector<color> vResolved; // Final linear colors, denoised if requested
+
+  std::atomic<size_t> uRemainingTiles = 0;
+  std::mutex oMutex;
+  std::condition_variable oCondition;
+  bool bDone = false;
+  std::chrono::steady_clock::time_point oStartTime;
+  double dRenderMs = 0.0; // From StartRenderJob to the end of the resolve
+
+  // Set before StartRenderJob by StreamRenderJob, tiles are then listed under oMutex as they finish
+  bool bStreamTiles = false;
+  std::vector<uint32_t> vFinishedTiles;
+  std::coroutine_handle<> hTileWaiter; // Stream suspended until the next tile finishes
+};
+
+// Queues one task per tile on _oPool and returns. The last tile to finish resolves the image.
+void StartRenderJob(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const Camera& _oCamera, const RenderSettings& _oSettings, RenderJob& oJob_);
+
+// One camera of a batch, with its own resolution
+struct RenderView
+{
+  Camera oCamera;
+  int iWidth = 1280;
+  int iHeight = 720;
+};
+
+// Starts oJob_ like StartRenderJob with _oSettings at the view's resolution
+void StartRenderView(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const RenderView& _oView, const RenderSettings& _oSettings,
+  RenderJob& oJob_);
+
+bool IsRenderJobDone(RenderJob& oJob_);
+
+void WaitForRenderJob(RenderJob& oJob_);
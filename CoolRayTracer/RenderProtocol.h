@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire format between the render daemon and its clients, native endianness since both ends share the machine.
+// A client sends a RenderRequestHeader followed by uSceneSize bytes of scene text, then reads a
+// RenderResponseHeader followed by uImageSize bytes of BMP. One request per connection.
+
+static constexpr uint32_t g_uRenderProtocolMagic = 0x52544352u; // "RCTR"
+static constexpr uint32_t g_uRenderProtocolVersion = 1u;
+static constexpr uint32_t g_uMaxSceneBytes = 64u * 1024u * 1024u;
+static constexpr int g_iMaxImageDimension = 8192;
+
+enum RenderPriority
+{
+  RenderPriority_High,   // Interactive previews
+  RenderPriority_Normal,
+  RenderPriority_Low,    // Batch thumbnails
+  RenderPriority_Count
+};
+
+enum RenderStatus
+{
+  RenderStatus_Ok,
+  RenderStatus_Busy,          // Queue full, retry after uRetryAfterMs
+  RenderStatus_UnknownScene,  // Hash-only request for a scene that is not cached, resend with the scene bytes
+  RenderStatus_BadRequest,
+  RenderStatus_BadScene
+};
+
+struct RenderRequestHeader
+{
+  uint32_t uMagic;
+  uint32_t uVersion;
+  uint64_t uSceneHash;        // Only read when uSceneSize is 0, otherwise the daemon hashes the bytes itself
+  uint32_t uSceneSize;
+  uint32_t uPriority;
+  int32_t iWidth;
+  int32_t iHeight;
+  int32_t iSamplesPerPixel;
+  int32_t iMaxBounces;
+  uint32_t uDenoise;
+  float aCameraPosition[3];
+  float fCameraYaw;
+  float fCameraPitch;
+  float fCameraVerticalFOV;
+};
+
+struct RenderResponseHeader
+{
+  uint32_t uMagic;
+  uint32_t uStatus;
+  uint32_t uImageSize;
+  uint32_t uRetryAfterMs;
+  uint32_t uQueueDepth;
+  float fRenderMs;
+};
@@ -0,0 +1,480 @@
+#include "Renderer.h"
+
+#include "MathUtils.h"
+#include "PathGuide.h"
+#include "SampleWarp.h"
+#include "Sampler.h"
+
+#include <float.h>
+#include <math.h>
+
+thread_local uint64_t* t_pHittableDependencies = nullptr;
+thread_local bool t_bLightTracedCaustics = false;
+
+// Only called for occluded shadow rays while dependencies are tracked, the nearest blocker is the one the result
+// depends on
+static void RecordShadowBlocker(const Scene& _oScene, const ray& _oShadowRay)
+{
+  HitInfo oHitInfo = {};
+  int iBlockerIdx = IntersectWideBVH(_oScene.oBVH, _oScene.vHittables, _oShadowRay, oHitInfo);
+  if (iBlockerIdx >= 0)
+  {
+    RecordHittableDependency(static_cast<uint32_t>(iBlockerIdx));
+  }
+}
+
+// Pdf of a diffuse bounce direction, cosine sampling mixed with the guide in cells it has learned
+static float GetDiffuseBouncePdf(const vec3& _vDirection, const vec3& _vNormal, const PathGuide* _pGuide, uint32_t _uGuideCell)
+{
+  float fCosinePdf = max(Dot(_vDirection, _vNormal), 0.f) / fPI;
+  if (!_pGuide)
+    return fCosinePdf;
+  return _pGuide->fGuideFraction * GetGuidePdf(*_pGuide, _uGuideCell, _vDirection) + (1.f - _pGuide->fGuideFraction) * fCosinePdf;
+}
+
+static vec3 Reflect(const vec3& _voutRay, const vec3& _vNormal)
+{
+  return _voutRay - (2 * Dot(_voutRay, _vNormal) * _vNormal);
+}
+
+static vec3 Refract(const vec3& _vOutRay, vec3 _vNormal, float _fEta)
+{
+  float fCosI = Dot(_vOutRay, _vNormal);
+
+  // If ray is inside the medium, flip the normal
+  if (fCosI > 0.0f)
+  {
+    _vNormal = -_vNormal;
+    fCosI = -fCosI;
+  }
+  // Now fCosI is guaranteed <= 0 (ray going against normal)
+  fCosI = -fCosI; // make it positive for the formula
+
+  float fK = 1.0f - _fEta * _fEta * (1.0f - fCosI * fCosI);
+
+  if (fK < 0.0f)
+  {
+    return vec3(0.f, 0.f, 0.f); // TIR
+  }
+
+  return Normalize(_fEta * _vOutRay + (_fEta * fCosI - sqrtf(fK)) * _vNormal);
+}
+
+vec3 GetSpecularDirection(const Scene& _oScene, const Material& _oMaterial, const vec3& _vDir, const vec3& _vNormal)
+{
+  if (_oMaterial.eType != MaterialType_Dielectric)
+    return Reflect(_vDir, _vNormal);
+
+  bool bFromOutside = Dot(_vDir, _vNormal) < 0.0f;
+  float fRelativeRefractionIndex = bFromOutside
+    ? (_oScene.fAirRefractionIndex / _oMaterial.oDielectric.fRefractionIndex)
+    : (_oMaterial.oDielectric.fRefractionIndex / _oScene.fAirRefractionIndex);
+
+  vec3 vRefracted = Refract(_vDir, _vNormal, fRelativeRefractionIndex);
+  if (vRefracted.LengthSqr() == 0.f) // Total internal reflection, fallback to reflection
+    return Reflect(_vDir, _vNormal);
+  return vRefracted;
+}
+
+// Next event estimation from a diffuse vertex: one light picked by power, one direction in its cone,
+// weighted against the chance that the bounce would have found the same light
+static color SampleDirectLight(const Scene& _oScene, const vec3& _vPosition, const vec3& _vNormal, const color& _vAlbedo,
+  const PathGuide* _pGuide, uint32_t _uGuideCell)
+{
+  float fPickPmf;
+  uint32_t uLight = SampleLightTable(_oScene.oLights, Random(), fPickPmf);
+  uint32_t uHittableIdx = _oScene.oLights.vHittableIdx[uLight];
+  RecordHittableDependency(uHittableIdx);
+  const Sphere& oSphere = _oScene.vHittables[uHittableIdx].oSphere;
+
+  vec3 vLightDir;
+  float fLightDistance;
+  float fConePdf;
+  bool bInCone = SampleSphereLight(oSphere, _vPosition, Random(), Random(), vLightDir, fLightDistance, fConePdf);
+  float fCosTheta = Dot(vLightDir, _vNormal);
+  if (!bInCone || fCosTheta <= 0.f)
+    return color(0.f, 0.f, 0.f);
+
+  // Stop short of the light by the origin bias plus a relative margin, grazing hits on the sphere are imprecise
+  // and the light itself must never count as a blocker
+  ray oShadowRay(_vPosition + _vNormal * 0.001f, vLightDir);
+  if (OccludedWideBVH(_oScene.oBVH, _oScene.vHittables, oShadowRay, fLightDistance * 0.999f - 0.001f))
+  {
+    if (t_pHittableDependencies)
+    {
+      RecordShadowBlocker(_oScene, oShadowRay);
+    }
+    return color(0.f, 0.f, 0.f);
+  }
+
+  float fLightPdf = fPickPmf * fConePdf;
+  float fWeight = PowerHeuristic(fLightPdf, GetDiffuseBouncePdf(vLightDir, _vNormal, _pGuide, _uGuideCell));
+  return (_vAlbedo / fPI) * GetEmission(_oScene.vMaterials[uHittableIdx]) * (fCosTheta * fWeight / fLightPdf);
+}
+
+// Same for the environment map, the shadow ray is unbounded
+static color SampleEnvironmentLight(const Scene& _oScene, const vec3& _vPosition, const vec3& _vNormal, const color& _vAlbedo,
+  const PathGuide* _pGuide, uint32_t _uGuideCell)
+{
+  vec3 vLightDir;
+  color vRadiance;
+  float fLightPdf;
+  if (!SampleEnvironment(_oScene.oEnvironment, Random(), Random(), vLightDir, vRadiance, fLightPdf))
+    return color(0.f, 0.f, 0.f);
+
+  float fCosTheta = Dot(vLightDir, _vNormal);
+  if (fCosTheta <= 0.f)
+    return color(0.f, 0.f, 0.f);
+
+  ray oShadowRay(_vPosition + _vNormal * 0.001f, vLightDir);
+  if (OccludedWideBVH(_oScene.oBVH, _oScene.vHittables, oShadowRay, FLT_MAX))
+  {
+    if (t_pHittableDependencies)
+    {
+      RecordShadowBlocker(_oScene, oShadowRay);
+    }
+    return color(0.f, 0.f, 0.f);
+  }
+
+  float fWeight = PowerHeuristic(fLightPdf, GetDiffuseBouncePdf(vLightDir, _vNormal, _pGuide, _uGuideCell));
+  return (_vAlbedo / fPI) * vRadiance * (fCosTheta * fWeight / fLightPdf);
+}
+
+color TracePath(const Scene& _oScene, const ray& _oRay, int _iMaxBounces, float _fPixelSpread, PrimaryHit& oPrimaryHit_)
+{
+  // Rough cone a diffuse lobe leaves with, indirect texture reads only need coarse mips
+  constexpr float fDIFFUSE_SPREAD = 0.25f;
+
+  ray oRay = _oRay;
+  color vThroughput = { 1.f, 1.f, 1.f };
+  color vRadiance = { 0.f, 0.f, 0.f };
+
+  oPrimaryHit_ = {};
+
+  bool bSampleLights = !_oScene.oLights.vHittableIdx.empty();
+  bool bHasEnvironment = !_oScene.oEnvironment.vMips.empty();
+  bool bSampleEnvironment = !_oScene.oEnvironment.vTexelPdf.empty();
+  bool bDiffusePath = false; // Past a diffuse bounce the environment is read from its sampling mip
+  bool bFirstHitDiffuse = false;
+  bool bSpecularBounce = false; // Last bounce was a metal or dielectric
+  float fLastBsdfPdf = 0.f; // 0 for camera rays and specular bounces, lights they hit get the full weight
+  float fConeSpread = _fPixelSpread;
+  float fConeWidth = 0.f; // Width of the ray cone at the current hit, the texture footprint
+
+  // Diffuse vertices of a training path with the luminance their bounce direction received
+  struct GuideVertex
+  {
+    uint32_t uCell;
+    int iBin;
+    float fThroughput;
+    float fBounceWeight;
+    float fRadiance;
+  };
+  constexpr int iMAX_GUIDE_VERTICES = 8;
+  GuideVertex aGuideVertices[iMAX_GUIDE_VERTICES];
+  int iGuideVertexCount = 0;
+  PathGuide* pGuide = t_pPathGuide;
+  bool bTrainGuide = pGuide && pGuide->bTraining;
+  bool bSampleGuide = pGuide && pGuide->bReady;
+
+  auto AddRadiance = [&](const color& _vRadiance)
+  {
+    vRadiance += _vRadiance;
+    if (iGuideVertexCount > 0)
+    {
+      float fLuminance = Luminance(_vRadiance);
+      for (int i = 0; i < iGuideVertexCount; i++)
+      {
+        aGuideVertices[i].fRadiance += fLuminance / aGuideVertices[i].fThroughput;
+      }
+    }
+  };
+
+  int iBounces = 0;
+
+  while (true)
+  {
+    HitInfo oHitInfo = {};
+    int iHittableIdx = IntersectWideBVH(_oScene.oBVH, _oScene.vHittables, oRay, oHitInfo);
+
+    if (iHittableIdx < 0 && bHasEnvironment)
+    {
+      color vEnvironment = bDiffusePath
+        ? GetEnvironmentTexel(_oScene.oEnvironment, oRay.vDir)
+        : LookupEnvironment(_oScene.oEnvironment, oRay.vDir, GetEnvironmentLevel(_oScene.oEnvironment, fConeSpread));
+      float fWeight = 1.f;
+      if (fLastBsdfPdf > 0.f && bSampleEnvironment)
+      {
+        fWeight = PowerHeuristic(fLastBsdfPdf, GetEnvironmentPdf(_oScene.oEnvironment, oRay.vDir));
+      }
+      if (iBounces == 0)
+      {
+        oPrimaryHit_.vAlbedo = vEnvironment;
+      }
+      AddRadiance(vThroughput * vEnvironment * fWeight);
+      break;
+    }
+    else if (iHittableIdx < 0)
+    {
+      // Classic blue-white gradient
+      float t = 0.5f * (oRay.vDir.y() + 1.0f);
+      color vSkyColor = (1.0f - t) * vec3(1, 1, 1) + t * vec3(0.5f, 0.7f, 1.0f);
+      if (iBounces == 0)
+      {
+        oPrimaryHit_.vAlbedo = vSkyColor;
+      }
+      AddRadiance(vThroughput * vSkyColor);
+      //vec3 vSkyGradient = oRay.vDir * 0.5 + 0.5;
+      //vRayColor = vRayColor * vSkyGradient;
+      break;
+    }
+
+    RecordHittableDependency(static_cast<uint32_t>(iHittableIdx));
+    const Material& oMaterial = _oScene.vMaterials[iHittableIdx];
+
+    if (oMaterial.eType == MaterialType_Emissive)
+    {
+      // Light paths bring the light that left a sphere light through specular bounces to a diffuse surface
+      if (t_bLightTracedCaustics && bFirstHitDiffuse && bSpecularBounce && !_oScene.oLights.vHittableIdx.empty()
+        && _oScene.oLights.vLightOfHittable[iHittableIdx] >= 0)
+        break;
+
+      float fWeight = 1.f;
+      int32_t iLight = bSampleLights ? _oScene.oLights.vLightOfHittable[iHittableIdx] : -1;
+      if (fLastBsdfPdf > 0.f && iLight >= 0)
+      {
+        float fLightPdf = _oScene.oLights.vPmf[iLight] * GetSphereLightPdf(_oScene.vHittables[iHittableIdx].oSphere, oRay.vOrigin);
+        fWeight = PowerHeuristic(fLastBsdfPdf, fLightPdf);
+      }
+      if (iBounces == 0)
+      {
+        oPrimaryHit_.vAlbedo = oMaterial.vAlbedo;
+        oPrimaryHit_.vNormal = oHitInfo.vNormal;
+        oPrimaryHit_.fDepth = oHitInfo.fT;
+      }
+      AddRadiance(vThroughput * GetEmission(oMaterial) * fWeight);
+      break;
+    }
+    else if (iBounces > _iMaxBounces)
+    {
+      // No light source found, does not contribute
+      break;
+    }
+
+    vec3 vHitPosition = oRay.vOrigin + (oHitInfo.fT * oRay.vDir);
+    fConeWidth += fConeSpread * oHitInfo.fT;
+
+    color vAlbedo = oMaterial.vAlbedo;
+    if (oMaterial.iAlbedoTexture >= 0)
+    {
+      vec2 vUV = GetHittableUV(_oScene.vHittables[iHittableIdx], vHitPosition) / oMaterial.fTextureScale;
+      vAlbedo = vAlbedo * SampleTexture(*_oScene.pTextures, static_cast<uint32_t>(oMaterial.iAlbedoTexture), vUV.x(), vUV.y(), fConeWidth / oMaterial.fTextureScale);
+    }
+
+    if (iBounces == 0)
+    {
+      oPrimaryHit_.vAlbedo = vAlbedo;
+      oPrimaryHit_.vNormal = oHitInfo.vNormal;
+      oPrimaryHit_.fDepth = oHitInfo.fT;
+    }
+
+    vec3 vInRay = {};
+    float fBounceWeight = 1.f; // Cosine over pdf for guided diffuse bounces
+    bool bDiffuseBounce = false;
+    switch (oMaterial.eType)
+    {
+    case MaterialType_Lambertian:
+    {
+      uint32_t uGuideCell = 0;
+      const PathGuide* pCellGuide = nullptr; // Only set in cells the guide has learned
+      if (bSampleGuide)
+      {
+        uGuideCell = GetGuideCell(*pGuide, vHitPosition);
+        pCellGuide = IsGuideCellTrained(*pGuide, uGuideCell) ? pGuide : nullptr;
+      }
+
+      if (bSampleLights)
+      {
+        AddRadiance(vThroughput * SampleDirectLight(_oScene, vHitPosition, oHitInfo.vNormal, vAlbedo, pCellGuide, uGuideCell));
+      }
+      if (bSampleEnvironment)
+      {
+        AddRadiance(vThroughput * SampleEnvironmentLight(_oScene, vHitPosition, oHitInfo.vNormal, vAlbedo, pCellGuide, uGuideCell));
+      }
+      bDiffusePath = true;
+      bDiffuseBounce = true;
+      bFirstHitDiffuse = bFirstHitDiffuse || iBounces == 0;
+      fConeSpread = max(fConeSpread, fDIFFUSE_SPREAD);
+      if (pCellGuide && Random() < pCellGuide->fGuideFraction)
+      {
+        float fRandomBin = Random();
+        float fRandomU = Random();
+        float fRandomV = Random();
+        vInRay = SampleGuide(*pCellGuide, uGuideCell, fRandomBin, fRandomU, fRandomV);
+      }
+      else
+      {
+        vInRay = TangentToWorld(Normalize(SampleHemisphereCosinePolynomial(Random(), Random())), oHitInfo.vNormal);
+      }
+      if (pCellGuide)
+      {
+        // Guided directions below the surface end the path, their pdf still counts
+        fLastBsdfPdf = GetDiffuseBouncePdf(vInRay, oHitInfo.vNormal, pCellGuide, uGuideCell);
+        float fCosTheta = Dot(vInRay, oHitInfo.vNormal);
+        fBounceWeight = (fCosTheta > 0.f && fLastBsdfPdf > 0.f) ? fCosTheta / (fPI * fLastBsdfPdf) : 0.f;
+      }
+      else
+      {
+        fLastBsdfPdf = Dot(vInRay, oHitInfo.vNormal) / fPI;
+      }
+      break;
+    }
+    case MaterialType_Metal:
+    case MaterialType_Dielectric:
+      vInRay = GetSpecularDirection(_oScene, oMaterial, oRay.vDir, oHitInfo.vNormal);
+      fLastBsdfPdf = 0.f;
+      break;
+    default:
+      break;
+    }
+
+    vec3 vBias = Dot(vInRay, oHitInfo.vNormal) > 0.0f
+      ? oHitInfo.vNormal * 0.001f
+      : -oHitInfo.vNormal * 0.001f;
+    oRay = ray(vHitPosition + vBias, vInRay);
+    vThroughput = vThroughput * vAlbedo;
+    bSpecularBounce = !bDiffuseBounce;
+    if (fBounceWeight != 1.f)
+    {
+      if (fBounceWeight <= 0.f)
+        break;
+      vThroughput = vThroughput * fBounceWeight;
+    }
+
+    if (bTrainGuide && bDiffuseBounce && iGuideVertexCount < iMAX_GUIDE_VERTICES)
+    {
+      float fThroughput = Luminance(vThroughput);
+      if (fThroughput > 0.f)
+      {
+        aGuideVertices[iGuideVertexCount++] = { GetGuideCell(*pGuide, vHitPosition), GetGuideBin(vInRay), fThroughput, fBounceWeight, 0.f };
+      }
+    }
+
+    iBounces++;
+  }
+
+  for (int i = 0; i < iGuideVertexCount; i++)
+  {
+    SplatGuide(*pGuide, aGuideVertices[i].uCell, aGuideVertices[i].iBin, aGuideVertices[i].fRadiance * aGuideVertices[i].fBounceWeight);
+  }
+
+  return vRadiance;
+}
+
+vec2 GetPixelSampleOffset(int _iSampleIdx)
+{
+  // Halved from the n-rooks pattern over [-1, 1] so the first samples stay inside the pixel like the later ones
+  static const vec2 s_aOffsets[] = {
+      { 0.5f / 1,  0.5f / -3 },
+      { 0.5f / -1,  0.5f / 3 },
+      { 0.5f / 5,  0.5f / 1 },
+      { 0.5f / -3,  0.5f / -5 },
+      { 0.5f / -5,  0.5f / 5 },
+      { 0.5f / -7,  0.5f / -1 },
+      { 0.5f / 3,  0.5f / 7 },
+      { 0.5f / 7,  0.5f / -7 }
+  };
+  constexpr int iFIXED_COUNT = static_cast<int>(sizeof(s_aOffsets) / sizeof(s_aOffsets[0]));
+
+  if (_iSampleIdx < iFIXED_COUNT)
+    return s_aOffsets[_iSampleIdx];
+
+  // R2 sequence, 1/g and 1/g^2 with g the plastic number
+  double dX = 0.5 + 0.7548776662466927 * _iSampleIdx;
+  double dY = 0.5 + 0.5698402909980532 * _iSampleIdx;
+  return vec2(static_cast<float>(dX - floor(dX)) - 0.5f, static_cast<float>(dY - floor(dY)) - 0.5f);
+}
+
+color RenderPixel(const Scene& _oScene, const CameraFrame& _oFrame, int _iX, int _iY, int _iSampleCount, int _iMaxBounces, RenderBuffers& oBuffers_)
+{
+  color vPixelColor = { 0.f, 0.f, 0.f };
+  color vPixelAlbedo = { 0.f, 0.f, 0.f };
+  vec3 vPixelNormal = { 0.f, 0.f, 0.f };
+  float fPixelDepth = 0.f;
+  int iPrimaryHitCount = 0;
+
+  for (int iSample = 0; iSample < _iSampleCount; iSample++)
+  {
+    SeedPixelSampler(_iX, _iY, static_cast<uint32_t>(iSample));
+    vec2 vOffset = GetPixelSampleOffset(iSample);
+    ray oRay = GetCameraRay(_oFrame, _iX + vOffset.x(), _iY + vOffset.y());
+
+    PrimaryHit oPrimaryHit;
+    vPixelColor += TracePath(_oScene, oRay, _iMaxBounces, _oFrame.fPixelSpread, oPrimaryHit);
+
+    vPixelAlbedo += oPrimaryHit.vAlbedo;
+    if (oPrimaryHit.fDepth > 0.f)
+    {
+      vPixelNormal += oPrimaryHit.vNormal;
+      fPixelDepth += oPrimaryHit.fDepth;
+      iPrimaryHitCount++;
+    }
+  }
+
+  vPixelColor /= static_cast<float>(_iSampleCount);
+
+  size_t uPixelIdx = static_cast<size_t>(_iY) * oBuffers_.iWidth + _iX;
+  StoreVec3(oBuffers_.oColor, uPixelIdx, vPixelColor);
+  StoreVec3(oBuffers_.oAlbedo, uPixelIdx, vPixelAlbedo / static_cast<float>(_iSampleCount));
+  StoreVec3(oBuffers_.oNormal, uPixelIdx, iPrimaryHitCount > 0 ? Normalize(vPixelNormal) : vec3(0.f, 0.f, 0.f));
+  StoreFloat(oBuffers_.oDepth, uPixelIdx, iPrimaryHitCount > 0 ? fPixelDepth / iPrimaryHitCount : 0.f);
+
+  return vPixelColor;
+}
+
+void AccumulatePixelSample(const Scene& _oScene, const CameraFrame& _oFrame, int _iX, int _iY, int _iMaxBounces, AccumulationBuffers& oAccum_)
+{
+  size_t uPixelIdx = static_cast<size_t>(_iY) * oAccum_.iWidth + _iX;
+  uint32_t uSampleIdx = oAccum_.vSampleCount[uPixelIdx];
+
+  SeedPixelSampler(_iX, _iY, uSampleIdx);
+  vec2 vOffset = GetPixelSampleOffset(static_cast<int>(uSampleIdx));
+  ray oRay = GetCameraRay(_oFrame, _iX + vOffset.x(), _iY + vOffset.y());
+
+  PrimaryHit oPrimaryHit;
+  color vColor = TracePath(_oScene, oRay, _iMaxBounces, _oFrame.fPixelSpread, oPrimaryHit);
+
+  // Every buffer rounds with bits of its own
+  uint64_t uRounding = GetRoundingBits(uPixelIdx, uSampleIdx);
+  StoreVec3Stochastic(oAccum_.oColor, uPixelIdx, AddToMean(LoadVec3(oAccum_.oColor, uPixelIdx), uSampleIdx, vColor), uRounding);
+  StoreVec3Stochastic(oAccum_.oAlbedo, uPixelIdx, AddToMean(LoadVec3(oAccum_.oAlbedo, uPixelIdx), uSampleIdx, oPrimaryHit.vAlbedo),
+    MixSamplerBits(uRounding + 1));
+  if (oPrimaryHit.fDepth > 0.f)
+  {
+    uint32_t uHitIdx = oAccum_.vHitCount[uPixelIdx];
+    StoreVec3Stochastic(oAccum_.oNormal, uPixelIdx, AddToMean(LoadVec3(oAccum_.oNormal, uPixelIdx), uHitIdx, oPrimaryHit.vNormal),
+      MixSamplerBits(uRounding + 2));
+    StoreFloatStochastic(oAccum_.oDepth, uPixelIdx, AddToMean(LoadFloat(oAccum_.oDepth, uPixelIdx), uHitIdx, oPrimaryHit.fDepth),
+      MixSamplerBits(uRounding + 3));
+    oAccum_.vHitCount[uPixelIdx]++;
+  }
+  oAccum_.vSampleCount[uPixelIdx]++;
+}
+
+float LinearToGamma(float _fValue)
+{
+  return Pow(_fValue, 1.0f / 2.2f);
+}
+
+void StorePixel(GameScreenBuffer* Buffer, int _iX, int _iY, const color& _vColor)
+{
+  uint8_t* pPixel = ((uint8_t*)Buffer->pData) + (static_cast<size_t>(_iY) * Buffer->iWidth + _iX) * g_uBytesPerPixel;
+
+  *pPixel++ = static_cast<uint8_t>(LinearToGamma(clamp(_vColor.b(), 0.f, 1.f)) * 255.f);
+
+  *pPixel++ = static_cast<uint8_t>(LinearToGamma(clamp(_vColor.g(), 0.f, 1.f)) * 255.f);
+
+  *pPixel++ = static_cast<uint8_t>(LinearToGamma(clamp(_vColor.r(), 0.f, 1.f)) * 255.f);
+
+  *pPixel++ = 0u;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "CoolRayTracer.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "RenderBuffers.h"
+#include "Ray.h"
+#include "Vec2.h"
+
+// First hit of a camera path, written to the feature buffers. fDepth is 0 when the path escapes.
+struct PrimaryHit
+{
+  color vAlbedo;
+  vec3 vNormal;
+  float fDepth;
+};
+
+// One bit per hittable, set for every hittable a path of the calling thread hits, samples as a light or is shadowed
+// by. Renders that track which tiles depend on which hittables point it at the bits of the tile being traced,
+// it is nullptr otherwise.
+extern thread_local uint64_t* t_pHittableDependencies;
+
+inline void RecordHittableDependency(uint32_t _uHittableIdx)
+{
+  if (t_pHittableDependencies)
+  {
+    t_pHittableDependencies[_uHittableIdx >> 6] |= 1ull << (_uHittableIdx & 63u);
+  }
+}
+
+// Set on render threads whose caustics come from light paths, see TraceLightPass. Camera paths that start on a
+// diffuse surface then leave out sphere lights hit right after a specular bounce, those paths are the light
+// paths' share.
+extern thread_local bool t_bLightTracedCaustics;
+
+// Mirror reflection for metals, refraction for dielectrics
+vec3 GetSpecularDirection(const Scene& _oScene, const Material& _oMaterial, const vec3& _vDir, const vec3& _vNormal);
+
+// Radiance carried back along one path started by _oRay. _fPixelSpread is CameraFrame::fPixelSpread, it sizes
+// the texture footprint and the environment mip seen by camera rays and specular bounces.
+color TracePath(const Scene& _oScene, const ray& _oRay, int _iMaxBounces, float _fPixelSpread, PrimaryHit& oPrimaryHit_);
+
+// Sub-pixel offset of the _iSampleIdx-th camera sample. The first 8 match the fixed pattern of the tiled frame,
+// later ones follow the R2 low discrepancy sequence. All of them lie in [-0.5, 0.5], so every pixel is a box filter
+// over its own square, the same footprint light path splats are binned into.
+vec2 GetPixelSampleOffset(int _iSampleIdx);
+
+// Averages _iSampleCount paths through pixel (_iX, _iY) into the color and feature buffers. Returns the color.
+color RenderPixel(const Scene& _oScene, const CameraFrame& _oFrame, int _iX, int _iY, int _iSampleCount, int _iMaxBounces, RenderBuffers& oBuffers_);
+
+// Adds the next camera sample of pixel (_iX, _iY) to the running means. The sample only depends on the pixel and
+// its sample count, so the means do not depend on which thread traced them or when.
+void AccumulatePixelSample(const Scene& _oScene, const CameraFrame& _oFrame, int _iX, int _iY, int _iMaxBounces, AccumulationBuffers& oAccum_);
+
+float LinearToGamma(float _fValue);
+
+void StorePixel(GameScreenBuffer* Buffer, int _iX, int _iY, const color& _vColor);
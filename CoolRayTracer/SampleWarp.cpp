@@ -0,0 +1,426 @@
+#include "SampleWarp.h"
+
+#include "CpuDispatch.h"
+#include "MathUtils.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAMPLE_WARP_SSE 1
+#include <emmintrin.h>
+#else
+#define SAMPLE_WARP_SSE 0
+#endif
+
+#if SAMPLE_WARP_SSE && CPU_DISPATCH_X86
+#define SAMPLE_WARP_AVX 1
+#include <immintrin.h>
+#else
+#define SAMPLE_WARP_AVX 0
+#endif
+
+// The scalar and SIMD paths below must evaluate in the same order, the batch tail relies on it
+
+vec2 SampleDiskPolynomial(float _fRandom1, float _fRandom2)
+{
+  float fOffsetX = 2.0f * _fRandom1 - 1.0f;
+  float fOffsetY = 2.0f * _fRandom2 - 1.0f;
+
+  // theta = pi/4 * minor/major around the major axis. Around Y, cos(pi/2 - a) and sin(pi/2 - a) swap sin and cos.
+  bool bMajorX = fabsf(fOffsetX) > fabsf(fOffsetY);
+  float fMajor = bMajorX ? fOffsetX : fOffsetY;
+  float fMinor = bMajorX ? fOffsetY : fOffsetX;
+  float fRatio = fMajor != 0.f ? fMinor / fMajor : 0.f;
+
+  float fSin, fCos;
+  SinCosQuarterPi(fPI_4 * fRatio, fSin, fCos);
+  return vec2((bMajorX ? fCos : fSin) * fMajor, (bMajorX ? fSin : fCos) * fMajor);
+}
+
+vec3 SampleHemisphereCosinePolynomial(float _fRandom1, float _fRandom2)
+{
+  vec2 vDiskSample = SampleDiskPolynomial(_fRandom1, _fRandom2);
+  float fZ = sqrtf(max(0.0f, 1.0f - vDiskSample.x() * vDiskSample.x() - vDiskSample.y() * vDiskSample.y()));
+  return vec3(vDiskSample.x(), vDiskSample.y(), fZ);
+}
+
+#if SAMPLE_WARP_SSE
+
+static inline __m128 Select(__m128 _vMask, __m128 _vTrue, __m128 _vFalse)
+{
+  return _mm_or_ps(_mm_and_ps(_vMask, _vTrue), _mm_andnot_ps(_vMask, _vFalse));
+}
+
+static inline void SinCosQuarterPi4(__m128 _vAngle, __m128& vSin_, __m128& vCos_)
+{
+  __m128 vA2 = _mm_mul_ps(_vAngle, _vAngle);
+
+  __m128 vSin = _mm_set1_ps(g_fSinC7);
+  vSin = _mm_add_ps(_mm_mul_ps(vSin, vA2), _mm_set1_ps(g_fSinC5));
+  vSin = _mm_add_ps(_mm_mul_ps(vSin, vA2), _mm_set1_ps(g_fSinC3));
+  vSin_ = _mm_add_ps(_vAngle, _mm_mul_ps(_mm_mul_ps(_vAngle, vA2), vSin));
+
+  __m128 vCos = _mm_set1_ps(g_fCosC8);
+  vCos = _mm_add_ps(_mm_mul_ps(vCos, vA2), _mm_set1_ps(g_fCosC6));
+  vCos = _mm_add_ps(_mm_mul_ps(vCos, vA2), _mm_set1_ps(g_fCosC4));
+  vCos = _mm_add_ps(_mm_mul_ps(vCos, vA2), _mm_set1_ps(g_fCosC2));
+  vCos_ = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(vA2, vCos));
+}
+
+static inline void SampleDisk4(const float* _pRandom1, const float* _pRandom2, __m128& vX_, __m128& vY_)
+{
+  const __m128 vOne = _mm_set1_ps(1.f);
+  const __m128 vTwo = _mm_set1_ps(2.f);
+  const __m128 vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  __m128 vOffsetX = _mm_sub_ps(_mm_mul_ps(vTwo, _mm_loadu_ps(_pRandom1)), vOne);
+  __m128 vOffsetY = _mm_sub_ps(_mm_mul_ps(vTwo, _mm_loadu_ps(_pRandom2)), vOne);
+
+  __m128 vMajorX = _mm_cmpgt_ps(_mm_and_ps(vOffsetX, vAbsMask), _mm_and_ps(vOffsetY, vAbsMask));
+  __m128 vMajor = Select(vMajorX, vOffsetX, vOffsetY);
+  __m128 vMinor = Select(vMajorX, vOffsetY, vOffsetX);
+
+  __m128 vNonZero = _mm_cmpneq_ps(vMajor, _mm_setzero_ps());
+  __m128 vRatio = _mm_and_ps(vNonZero, _mm_div_ps(vMinor, Select(vNonZero, vMajor, vOne)));
+
+  __m128 vSin, vCos;
+  SinCosQuarterPi4(_mm_mul_ps(_mm_set1_ps(fPI_4), vRatio), vSin, vCos);
+  vX_ = _mm_mul_ps(Select(vMajorX, vCos, vSin), vMajor);
+  vY_ = _mm_mul_ps(Select(vMajorX, vSin, vCos), vMajor);
+}
+
+static inline __m128 HemisphereZ4(__m128 _vX, __m128 _vY)
+{
+  __m128 vZSqr = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_vX, _vX)), _mm_mul_ps(_vY, _vY));
+  return _mm_sqrt_ps(_mm_max_ps(vZSqr, _mm_setzero_ps()));
+}
+
+// Each wide kernel returns how many leading entries it warped, the scalar tail does the rest
+
+static int SampleDiskBatchSSE2(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_)
+{
+  int i = 0;
+  for (; i + g_iSampleWarpBatch <= _iCount; i += g_iSampleWarpBatch)
+  {
+    __m128 vX0, vY0, vX1, vY1;
+    SampleDisk4(_pRandom1 + i, _pRandom2 + i, vX0, vY0);
+    SampleDisk4(_pRandom1 + i + 4, _pRandom2 + i + 4, vX1, vY1);
+    _mm_storeu_ps(pX_ + i, vX0);
+    _mm_storeu_ps(pY_ + i, vY0);
+    _mm_storeu_ps(pX_ + i + 4, vX1);
+    _mm_storeu_ps(pY_ + i + 4, vY1);
+  }
+  return i;
+}
+
+static int SampleHemisphereCosineBatchSSE2(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_, float* pZ_)
+{
+  int i = 0;
+  for (; i + g_iSampleWarpBatch <= _iCount; i += g_iSampleWarpBatch)
+  {
+    __m128 vX0, vY0, vX1, vY1;
+    SampleDisk4(_pRandom1 + i, _pRandom2 + i, vX0, vY0);
+    SampleDisk4(_pRandom1 + i + 4, _pRandom2 + i + 4, vX1, vY1);
+    _mm_storeu_ps(pX_ + i, vX0);
+    _mm_storeu_ps(pY_ + i, vY0);
+    _mm_storeu_ps(pZ_ + i, HemisphereZ4(vX0, vY0));
+    _mm_storeu_ps(pX_ + i + 4, vX1);
+    _mm_storeu_ps(pY_ + i + 4, vY1);
+    _mm_storeu_ps(pZ_ + i + 4, HemisphereZ4(vX1, vY1));
+  }
+  return i;
+}
+
+static int TangentToWorldBatchSSE2(const float* _pX, const float* _pY, const float* _pZ, int _iCount, const float _aBasis[3][3], float* pX_, float* pY_, float* pZ_)
+{
+  __m128 aBasis[3][3];
+  for (int iAxis = 0; iAxis < 3; iAxis++)
+  {
+    for (int iVector = 0; iVector < 3; iVector++)
+    {
+      aBasis[iAxis][iVector] = _mm_set1_ps(_aBasis[iAxis][iVector]);
+    }
+  }
+
+  float* aOut[3] = { pX_, pY_, pZ_ };
+  int i = 0;
+  for (; i + 4 <= _iCount; i += 4)
+  {
+    __m128 vX = _mm_loadu_ps(_pX + i);
+    __m128 vY = _mm_loadu_ps(_pY + i);
+    __m128 vZ = _mm_loadu_ps(_pZ + i);
+    for (int iAxis = 0; iAxis < 3; iAxis++)
+    {
+      __m128 vWorld = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vX, aBasis[iAxis][0]), _mm_mul_ps(vY, aBasis[iAxis][1])), _mm_mul_ps(vZ, aBasis[iAxis][2]));
+      _mm_storeu_ps(aOut[iAxis] + i, vWorld);
+    }
+  }
+  return i;
+}
+
+#endif
+
+#if SAMPLE_WARP_AVX
+
+CPU_TARGET_AVX2 static inline void SinCosQuarterPi8(__m256 _vAngle, __m256& vSin_, __m256& vCos_)
+{
+  __m256 vA2 = _mm256_mul_ps(_vAngle, _vAngle);
+
+  __m256 vSin = _mm256_set1_ps(g_fSinC7);
+  vSin = _mm256_add_ps(_mm256_mul_ps(vSin, vA2), _mm256_set1_ps(g_fSinC5));
+  vSin = _mm256_add_ps(_mm256_mul_ps(vSin, vA2), _mm256_set1_ps(g_fSinC3));
+  vSin_ = _mm256_add_ps(_vAngle, _mm256_mul_ps(_mm256_mul_ps(_vAngle, vA2), vSin));
+
+  __m256 vCos = _mm256_set1_ps(g_fCosC8);
+  vCos = _mm256_add_ps(_mm256_mul_ps(vCos, vA2), _mm256_set1_ps(g_fCosC6));
+  vCos = _mm256_add_ps(_mm256_mul_ps(vCos, vA2), _mm256_set1_ps(g_fCosC4));
+  vCos = _mm256_add_ps(_mm256_mul_ps(vCos, vA2), _mm256_set1_ps(g_fCosC2));
+  vCos_ = _mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(vA2, vCos));
+}
+
+CPU_TARGET_AVX2 static inline void SampleDisk8(const float* _pRandom1, const float* _pRandom2, __m256& vX_, __m256& vY_)
+{
+  const __m256 vOne = _mm256_set1_ps(1.f);
+  const __m256 vTwo = _mm256_set1_ps(2.f);
+  const __m256 vAbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+  __m256 vOffsetX = _mm256_sub_ps(_mm256_mul_ps(vTwo, _mm256_loadu_ps(_pRandom1)), vOne);
+  __m256 vOffsetY = _mm256_sub_ps(_mm256_mul_ps(vTwo, _mm256_loadu_ps(_pRandom2)), vOne);
+
+  __m256 vMajorX = _mm256_cmp_ps(_mm256_and_ps(vOffsetX, vAbsMask), _mm256_and_ps(vOffsetY, vAbsMask), _CMP_GT_OQ);
+  __m256 vMajor = _mm256_blendv_ps(vOffsetY, vOffsetX, vMajorX);
+  __m256 vMinor = _mm256_blendv_ps(vOffsetX, vOffsetY, vMajorX);
+
+  __m256 vNonZero = _mm256_cmp_ps(vMajor, _mm256_setzero_ps(), _CMP_NEQ_UQ);
+  __m256 vRatio = _mm256_and_ps(vNonZero, _mm256_div_ps(vMinor, _mm256_blendv_ps(vOne, vMajor, vNonZero)));
+
+  __m256 vSin, vCos;
+  SinCosQuarterPi8(_mm256_mul_ps(_mm256_set1_ps(fPI_4), vRatio), vSin, vCos);
+  vX_ = _mm256_mul_ps(_mm256_blendv_ps(vSin, vCos, vMajorX), vMajor);
+  vY_ = _mm256_mul_ps(_mm256_blendv_ps(vCos, vSin, vMajorX), vMajor);
+}
+
+CPU_TARGET_AVX2 static inline __m256 HemisphereZ8(__m256 _vX, __m256 _vY)
+{
+  __m256 vZSqr = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(_vX, _vX)), _mm256_mul_ps(_vY, _vY));
+  return _mm256_sqrt_ps(_mm256_max_ps(vZSqr, _mm256_setzero_ps()));
+}
+
+CPU_TARGET_AVX2 static int SampleDiskBatchAVX2(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_)
+{
+  int i = 0;
+  for (; i + 8 <= _iCount; i += 8)
+  {
+    __m256 vX, vY;
+    SampleDisk8(_pRandom1 + i, _pRandom2 + i, vX, vY);
+    _mm256_storeu_ps(pX_ + i, vX);
+    _mm256_storeu_ps(pY_ + i, vY);
+  }
+  return i;
+}
+
+CPU_TARGET_AVX2 static int SampleHemisphereCosineBatchAVX2(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_, float* pZ_)
+{
+  int i = 0;
+  for (; i + 8 <= _iCount; i += 8)
+  {
+    __m256 vX, vY;
+    SampleDisk8(_pRandom1 + i, _pRandom2 + i, vX, vY);
+    _mm256_storeu_ps(pX_ + i, vX);
+    _mm256_storeu_ps(pY_ + i, vY);
+    _mm256_storeu_ps(pZ_ + i, HemisphereZ8(vX, vY));
+  }
+  return i;
+}
+
+CPU_TARGET_AVX2 static int TangentToWorldBatchAVX2(const float* _pX, const float* _pY, const float* _pZ, int _iCount, const float _aBasis[3][3], float* pX_, float* pY_, float* pZ_)
+{
+  float* aOut[3] = { pX_, pY_, pZ_ };
+  int i = 0;
+  for (; i + 8 <= _iCount; i += 8)
+  {
+    __m256 vX = _mm256_loadu_ps(_pX + i);
+    __m256 vY = _mm256_loadu_ps(_pY + i);
+    __m256 vZ = _mm256_loadu_ps(_pZ + i);
+    for (int iAxis = 0; iAxis < 3; iAxis++)
+    {
+      __m256 vWorld = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vX, _mm256_set1_ps(_aBasis[iAxis][0])), _mm256_mul_ps(vY, _mm256_set1_ps(_aBasis[iAxis][1]))),
+        _mm256_mul_ps(vZ, _mm256_set1_ps(_aBasis[iAxis][2])));
+      _mm256_storeu_ps(aOut[iAxis] + i, vWorld);
+    }
+  }
+  return i;
+}
+
+CPU_TARGET_AVX512 static inline void SinCosQuarterPi16(__m512 _vAngle, __m512& vSin_, __m512& vCos_)
+{
+  __m512 vA2 = _mm512_mul_ps(_vAngle, _vAngle);
+
+  __m512 vSin = _mm512_set1_ps(g_fSinC7);
+  vSin = _mm512_add_ps(_mm512_mul_ps(vSin, vA2), _mm512_set1_ps(g_fSinC5));
+  vSin = _mm512_add_ps(_mm512_mul_ps(vSin, vA2), _mm512_set1_ps(g_fSinC3));
+  vSin_ = _mm512_add_ps(_vAngle, _mm512_mul_ps(_mm512_mul_ps(_vAngle, vA2), vSin));
+
+  __m512 vCos = _mm512_set1_ps(g_fCosC8);
+  vCos = _mm512_add_ps(_mm512_mul_ps(vCos, vA2), _mm512_set1_ps(g_fCosC6));
+  vCos = _mm512_add_ps(_mm512_mul_ps(vCos, vA2), _mm512_set1_ps(g_fCosC4));
+  vCos = _mm512_add_ps(_mm512_mul_ps(vCos, vA2), _mm512_set1_ps(g_fCosC2));
+  vCos_ = _mm512_add_ps(_mm512_set1_ps(1.f), _mm512_mul_ps(vA2, vCos));
+}
+
+CPU_TARGET_AVX512 static inline void SampleDisk16(const float* _pRandom1, const float* _pRandom2, __m512& vX_, __m512& vY_)
+{
+  const __m512 vOne = _mm512_set1_ps(1.f);
+  const __m512 vTwo = _mm512_set1_ps(2.f);
+
+  __m512 vOffsetX = _mm512_sub_ps(_mm512_mul_ps(vTwo, _mm512_loadu_ps(_pRandom1)), vOne);
+  __m512 vOffsetY = _mm512_sub_ps(_mm512_mul_ps(vTwo, _mm512_loadu_ps(_pRandom2)), vOne);
+
+  __mmask16 uMajorX = _mm512_cmp_ps_mask(_mm512_abs_ps(vOffsetX), _mm512_abs_ps(vOffsetY), _CMP_GT_OQ);
+  __m512 vMajor = _mm512_mask_blend_ps(uMajorX, vOffsetY, vOffsetX);
+  __m512 vMinor = _mm512_mask_blend_ps(uMajorX, vOffsetX, vOffsetY);
+
+  __mmask16 uNonZero = _mm512_cmp_ps_mask(vMajor, _mm512_setzero_ps(), _CMP_NEQ_UQ);
+  __m512 vRatio = _mm512_maskz_div_ps(uNonZero, vMinor, vMajor);
+
+  __m512 vSin, vCos;
+  SinCosQuarterPi16(_mm512_mul_ps(_mm512_set1_ps(fPI_4), vRatio), vSin, vCos);
+  vX_ = _mm512_mul_ps(_mm512_mask_blend_ps(uMajorX, vSin, vCos), vMajor);
+  vY_ = _mm512_mul_ps(_mm512_mask_blend_ps(uMajorX, vCos, vSin), vMajor);
+}
+
+CPU_TARGET_AVX512 static inline __m512 HemisphereZ16(__m512 _vX, __m512 _vY)
+{
+  // Zero masked forms, the unmasked ones trip a false maybe-uninitialized warning in GCC 12 headers
+  const __mmask16 uAll = 0xffff;
+  __m512 vZSqr = _mm512_sub_ps(_mm512_sub_ps(_mm512_set1_ps(1.f), _mm512_mul_ps(_vX, _vX)), _mm512_mul_ps(_vY, _vY));
+  return _mm512_maskz_sqrt_ps(uAll, _mm512_maskz_max_ps(uAll, vZSqr, _mm512_setzero_ps()));
+}
+
+CPU_TARGET_AVX512 static int SampleDiskBatchAVX512(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_)
+{
+  int i = 0;
+  for (; i + 16 <= _iCount; i += 16)
+  {
+    __m512 vX, vY;
+    SampleDisk16(_pRandom1 + i, _pRandom2 + i, vX, vY);
+    _mm512_storeu_ps(pX_ + i, vX);
+    _mm512_storeu_ps(pY_ + i, vY);
+  }
+  return i + SampleDiskBatchAVX2(_pRandom1 + i, _pRandom2 + i, _iCount - i, pX_ + i, pY_ + i);
+}
+
+CPU_TARGET_AVX512 static int SampleHemisphereCosineBatchAVX512(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_, float* pZ_)
+{
+  int i = 0;
+  for (; i + 16 <= _iCount; i += 16)
+  {
+    __m512 vX, vY;
+    SampleDisk16(_pRandom1 + i, _pRandom2 + i, vX, vY);
+    _mm512_storeu_ps(pX_ + i, vX);
+    _mm512_storeu_ps(pY_ + i, vY);
+    _mm512_storeu_ps(pZ_ + i, HemisphereZ16(vX, vY));
+  }
+  return i + SampleHemisphereCosineBatchAVX2(_pRandom1 + i, _pRandom2 + i, _iCount - i, pX_ + i, pY_ + i, pZ_ + i);
+}
+
+CPU_TARGET_AVX512 static int TangentToWorldBatchAVX512(const float* _pX, const float* _pY, const float* _pZ, int _iCount, const float _aBasis[3][3], float* pX_, float* pY_, float* pZ_)
+{
+  float* aOut[3] = { pX_, pY_, pZ_ };
+  int i = 0;
+  for (; i + 16 <= _iCount; i += 16)
+  {
+    __m512 vX = _mm512_loadu_ps(_pX + i);
+    __m512 vY = _mm512_loadu_ps(_pY + i);
+    __m512 vZ = _mm512_loadu_ps(_pZ + i);
+    for (int iAxis = 0; iAxis < 3; iAxis++)
+    {
+      __m512 vWorld = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(vX, _mm512_set1_ps(_aBasis[iAxis][0])), _mm512_mul_ps(vY, _mm512_set1_ps(_aBasis[iAxis][1]))),
+        _mm512_mul_ps(vZ, _mm512_set1_ps(_aBasis[iAxis][2])));
+      _mm512_storeu_ps(aOut[iAxis] + i, vWorld);
+    }
+  }
+  return i + TangentToWorldBatchAVX2(_pX + i, _pY + i, _pZ + i, _iCount - i, _aBasis, pX_ + i, pY_ + i, pZ_ + i);
+}
+
+#endif
+
+void SampleDiskBatch(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_)
+{
+  int i = 0;
+#if SAMPLE_WARP_AVX
+  if (g_eCpuIsa == CpuIsa_AVX512)
+    i = SampleDiskBatchAVX512(_pRandom1, _pRandom2, _iCount, pX_, pY_);
+  else if (g_eCpuIsa == CpuIsa_AVX2)
+    i = SampleDiskBatchAVX2(_pRandom1, _pRandom2, _iCount, pX_, pY_);
+  else
+#endif
+#if SAMPLE_WARP_SSE
+    i = SampleDiskBatchSSE2(_pRandom1, _pRandom2, _iCount, pX_, pY_);
+#endif
+
+  for (; i < _iCount; i++)
+  {
+    vec2 vSample = SampleDiskPolynomial(_pRandom1[i], _pRandom2[i]);
+    pX_[i] = vSample.x();
+    pY_[i] = vSample.y();
+  }
+}
+
+void SampleHemisphereCosineBatch(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_, float* pZ_)
+{
+  int i = 0;
+#if SAMPLE_WARP_AVX
+  if (g_eCpuIsa == CpuIsa_AVX512)
+    i = SampleHemisphereCosineBatchAVX512(_pRandom1, _pRandom2, _iCount, pX_, pY_, pZ_);
+  else if (g_eCpuIsa == CpuIsa_AVX2)
+    i = SampleHemisphereCosineBatchAVX2(_pRandom1, _pRandom2, _iCount, pX_, pY_, pZ_);
+  else
+#endif
+#if SAMPLE_WARP_SSE
+    i = SampleHemisphereCosineBatchSSE2(_pRandom1, _pRandom2, _iCount, pX_, pY_, pZ_);
+#endif
+
+  for (; i < _iCount; i++)
+  {
+    vec3 vSample = SampleHemisphereCosinePolynomial(_pRandom1[i], _pRandom2[i]);
+    pX_[i] = vSample.x();
+    pY_[i] = vSample.y();
+    pZ_[i] = vSample.z();
+  }
+}
+
+void TangentToWorldBatch(const float* _pX, const float* _pY, const float* _pZ, int _iCount, const vec3& _vNormal, float* pX_, float* pY_, float* pZ_)
+{
+  vec3 vT, vB;
+  TBN(vT, vB, _vNormal);
+
+  // Rows are world axes, columns the tangent, bitangent and normal
+  float aBasis[3][3];
+  for (int iAxis = 0; iAxis < 3; iAxis++)
+  {
+    aBasis[iAxis][0] = vT[iAxis];
+    aBasis[iAxis][1] = vB[iAxis];
+    aBasis[iAxis][2] = _vNormal[iAxis];
+  }
+
+  int i = 0;
+#if SAMPLE_WARP_AVX
+  if (g_eCpuIsa == CpuIsa_AVX512)
+    i = TangentToWorldBatchAVX512(_pX, _pY, _pZ, _iCount, aBasis, pX_, pY_, pZ_);
+  else if (g_eCpuIsa == CpuIsa_AVX2)
+    i = TangentToWorldBatchAVX2(_pX, _pY, _pZ, _iCount, aBasis, pX_, pY_, pZ_);
+  else
+#endif
+#if SAMPLE_WARP_SSE
+    i = TangentToWorldBatchSSE2(_pX, _pY, _pZ, _iCount, aBasis, pX_, pY_, pZ_);
+#endif
+
+  for (; i < _iCount; i++)
+  {
+    vec3 vWorld = _pX[i] * vT + _pY[i] * vB + _pZ[i] * _vNormal;
+    pX_[i] = vWorld.x();
+    pY_[i] = vWorld.y();
+    pZ_[i] = vWorld.z();
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "FastMath.h"
+#include "vec3.h"
+#include "Vec2.h"
+
+// Batched versions of the sample warps in MathUtils.h over structure of arrays inputs. Each kernel handles
+// g_iSampleWarpBatch pairs per iteration with branch free SSE2 code and falls back to the scalar polynomial
+// versions below for the remainder, so every lane and the tail produce the same bits.
+static constexpr int g_iSampleWarpBatch = 8;
+
+// Same concentric mapping as SampleDisk, with the octant picked by selects and the polynomial sincos
+vec2 SampleDiskPolynomial(float _fRandom1, float _fRandom2);
+
+vec3 SampleHemisphereCosinePolynomial(float _fRandom1, float _fRandom2);
+
+void SampleDiskBatch(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_);
+
+// Unit directions around +Z, cosine distributed
+void SampleHemisphereCosineBatch(const float* _pRandom1, const float* _pRandom2, int _iCount, float* pX_, float* pY_, float* pZ_);
+
+// Rotates _iCount tangent space directions around one normal, the basis is built once for the whole batch.
+// The outputs may alias the inputs.
+void TangentToWorldBatch(const float* _pX, const float* _pY, const float* _pZ, int _iCount, const vec3& _vNormal, float* pX_, float* pY_, float* pZ_);
@@ -0,0 +1,3 @@
+#include "Sampler.h"
+
+thread_local uint64_t t_uSamplerState = 0;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Increased whenever the streams below change, checkpoints of older versions cannot be resumed
+static constexpr uint32_t g_uSamplerVersion = 2;
+
+// Random stream of the calling thread. Every camera sample reseeds it from its pixel and sample index, so an image
+// comes out the same whatever the thread count, the tile order or the interruptions of the render.
+extern thread_local uint64_t t_uSamplerState;
+
+// splitmix64 finalizer
+inline uint64_t MixSamplerBits(uint64_t _uValue)
+{
+  _uValue = (_uValue ^ (_uValue >> 30)) * 0xbf58476d1ce4e5b9ull;
+  _uValue = (_uValue ^ (_uValue >> 27)) * 0x94d049bb133111ebull;
+  return _uValue ^ (_uValue >> 31);
+}
+
+inline void SeedPixelSampler(int _iX, int _iY, uint32_t _uSampleIdx)
+{
+  uint64_t uPixel = (static_cast<uint64_t>(static_cast<uint32_t>(_iY)) << 32) | static_cast<uint32_t>(_iX);
+  t_uSamplerState = MixSamplerBits(MixSamplerBits(uPixel) + _uSampleIdx);
+}
+
+// Uniform in [0, 1), from the top 24 bits of the next splitmix64 output
+inline float SampleRandom()
+{
+  t_uSamplerState += 0x9e3779b97f4a7c15ull;
+  return static_cast<float>(MixSamplerBits(t_uSamplerState) >> 40) * (1.f / 16777216.f);
+}
+
+// Light paths draw from streams of their own, the top bit keeps them apart from every pixel's
+inline void SeedLightPathSampler(uint32_t _uPathIdx, uint32_t _uPassIdx)
+{
+  t_uSamplerState = MixSamplerBits(MixSamplerBits((1ull << 63) | _uPathIdx) + _uPassIdx);
+}
+
+// Bits for the stochastic rounding of a pixel's packed running means, apart from every sampling stream
+inline uint64_t GetRoundingBits(size_t _uPixelIdx, uint32_t _uSampleIdx)
+{
+  return MixSamplerBits(MixSamplerBits((3ull << 62) | _uPixelIdx) + _uSampleIdx);
+}
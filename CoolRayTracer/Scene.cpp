@@ -0,0 +1,137 @@
+#include "Scene.h"
+
+#include "MathUtils.h"
+#include "Numa.h"
+#include "ThreadPool.h"
+
+BVHBuildStats BuildSceneBVH(const BVHBuildSettings& _oSettings, Scene& oScene_)
+{
+  BVH oBinaryBVH = {};
+  BVHBuildStats oStats = BuildBVH(oScene_.vHittables, _oSettings, oBinaryBVH);
+  BuildWideBVH(oBinaryBVH, oScene_.oBVH);
+  return oStats;
+}
+
+void BuildSceneLights(Scene& oScene_)
+{
+  std::vector<uint32_t> vLightIdx;
+  std::vector<float> vPower;
+  for (size_t i = 0; i < oScene_.vHittables.size(); i++)
+  {
+    const Hittable& oHittable = oScene_.vHittables[i];
+    if (oHittable.eType != HittableType_Sphere || oScene_.vMaterials[i].eType != MaterialType_Emissive)
+      continue;
+
+    // Radiant power of a diffuse emitter, pi * Le * area
+    float fRadius = oHittable.oSphere.fRadius;
+    vLightIdx.push_back(static_cast<uint32_t>(i));
+    vPower.push_back(Luminance(GetEmission(oScene_.vMaterials[i])) * fPI * 4.f * fPI * fRadius * fRadius);
+  }
+  BuildLightTable(vLightIdx, vPower, oScene_.vHittables.size(), oScene_.oLights);
+}
+
+void ReplicateSceneAcrossNodes(ThreadPool& oPool_, bool _bHugePages, Scene& oScene_)
+{
+  int iNodeCount = GetThreadPoolNodeCount(oPool_);
+  oScene_.vNodeCopies.clear();
+  if (iNodeCount < 2)
+    return;
+
+  std::vector<std::shared_ptr<Scene>> vCopies(iNodeCount);
+  std::mutex oMutex;
+  std::condition_variable oCondition;
+  int iRemaining = iNodeCount;
+
+  const Scene& oSource = oScene_;
+  for (int i = 0; i < iNodeCount; i++)
+  {
+    SubmitNodeTask(oPool_, i, [&, i]()
+      {
+        // Workers usually run their own node's tasks, but an idle worker of another node may steal this one.
+        // The copy is still valid then, it is only placed on the wrong node.
+        std::shared_ptr<Scene> pCopy = std::make_shared<Scene>();
+        CopyToLocalMemory(oSource.vHittables, _bHugePages, pCopy->vHittables);
+        CopyToLocalMemory(oSource.vMaterials, _bHugePages, pCopy->vMaterials);
+        CopyToLocalMemory(oSource.oBVH.vNodes, _bHugePages, pCopy->oBVH.vNodes);
+        CopyToLocalMemory(oSource.oBVH.vPrimIndices, _bHugePages, pCopy->oBVH.vPrimIndices);
+        CopyToLocalMemory(oSource.oBVH.vUnbounded, _bHugePages, pCopy->oBVH.vUnbounded);
+        pCopy->fAirRefractionIndex = oSource.fAirRefractionIndex;
+        pCopy->oLights = oSource.oLights;
+        pCopy->oEnvironment = oSource.oEnvironment;
+        pCopy->pTextures = oSource.pTextures;
+        vCopies[i] = std::move(pCopy);
+
+        std::lock_guard<std::mutex> oLock(oMutex);
+        if (--iRemaining == 0)
+        {
+          oCondition.notify_one();
+        }
+      });
+  }
+
+  std::unique_lock<std::mutex> oLock(oMutex);
+  oCondition.wait(oLock, [&iRemaining]() { return iRemaining == 0; });
+
+  oScene_.vNodeCopies.assign(vCopies.begin(), vCopies.end());
+}
+
+void BuildDemoScene(Scene& oScene_)
+{
+  {
+    Hittable oSphere = {};
+    oSphere.eType = HittableType_Sphere;
+    oSphere.oSphere.vCenter = vec3(0, 0, -5);
+    oSphere.oSphere.fRadius = 1.0f;
+
+    Material oMaterial = {};
+    oMaterial.eType = MaterialType_Dielectric;
+    oMaterial.oDielectric.fRefractionIndex = 1.5f;
+    oMaterial.vAlbedo = vec3(1, 1, 1);
+
+    oScene_.vHittables.push_back(oSphere);
+    oScene_.vMaterials.push_back(oMaterial);
+  }
+
+  {
+    Hittable oSphere = {};
+    oSphere.eType = HittableType_Sphere;
+    oSphere.oSphere.vCenter = vec3(2, 0, -5);
+    oSphere.oSphere.fRadius = 1.0f;
+
+    Material oMaterial = {};
+    oMaterial.eType = MaterialType_Metal;
+    oMaterial.oMetal.fRoughness = 0.2f;
+    oMaterial.vAlbedo = vec3(1, 1, 1);
+
+    oScene_.vHittables.push_back(oSphere);
+    oScene_.vMaterials.push_back(oMaterial);
+  }
+
+  {
+    Hittable oSphere = {};
+    oSphere.eType = HittableType_Sphere;
+    oSphere.oSphere.vCenter = vec3(-2.f, -0.75f, -4.f);
+    oSphere.oSphere.fRadius = 0.25f;
+
+    Material oMaterial = {};
+    oMaterial.eType = MaterialType_Lambertian;    
+    oMaterial.vAlbedo = vec3(0.35f, 0.2f, 0.5f);
+
+    oScene_.vHittables.push_back(oSphere);
+    oScene_.vMaterials.push_back(oMaterial);
+  }
+
+  {
+    Hittable oPlane = {};
+    oPlane.eType = HittableType_Plane;
+    oPlane.oPlane.vNormal = vec3(0, 1, 0);
+    oPlane.oPlane.fPoint = -1.0f;
+
+    Material oMaterial = {};
+    oMaterial.eType = MaterialType_Lambertian;
+    oMaterial.vAlbedo = vec3(0.5, 0.5, 0.5);
+
+    oScene_.vHittables.push_back(oPlane);
+    oScene_.vMaterials.push_back(oMaterial);
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "vec3.h"
+#include "Hittable.h"
+#include "BVH.h"
+#include "WideBVH.h"
+#include "Lights.h"
+#include "EnvironmentMap.h"
+#include "TextureCache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using color = vec3;
+
+struct ThreadPool;
+
+enum MaterialType
+{
+  MaterialType_Lambertian,
+  MaterialType_Metal,
+  MaterialType_Dielectric,
+  MaterialType_Emissive   // Emits vAlbedo * fIntensity, does not scatter
+};
+
+struct Material
+{
+  MaterialType eType;
+  color vAlbedo;
+  union{
+    struct
+    {
+      float fRoughness;
+    } oMetal;
+    struct
+    {
+      float fRefractionIndex;
+    } oDielectric;
+    struct
+    {
+      float fIntensity;
+    } oEmissive;
+  };
+  int32_t iAlbedoTexture = -1; // Multiplies vAlbedo, id in Scene::pTextures
+  float fTextureScale = 1.f;   // World size of one texture repeat
+};
+
+// File a scene was parsed with, uFileStamp is its GetFileStamp from before it was read
+struct SceneAsset
+{
+  std::string sPath;
+  uint64_t uFileStamp;
+};
+
+// Filled once, then only read. Render jobs share it through a pointer to const, so any number of them can
+// trace against one copy of the geometry and its BVH.
+struct Scene
+{
+  std::vector<Hittable> vHittables;
+  std::vector<Material> vMaterials;
+  float fAirRefractionIndex = 1.0f;
+  WideBVH oBVH; // Built by BuildSceneBVH once every hittable is added
+  LightTable oLights; // Built by BuildSceneLights, same as the BVH
+  EnvironmentMap oEnvironment; // No mips means the default sky gradient
+  std::shared_ptr<TextureCache> pTextures; // Shared between scenes, tiles are loaded while rendering
+  std::vector<SceneAsset> vAssets; // Environment and texture files, each listed once
+  std::vector<std::shared_ptr<const Scene>> vNodeCopies; // One per node of a NUMA thread pool, empty unless replicated
+};
+
+inline void AddHittable(Hittable&& _oHittable, Material&& _oMaterial, Scene& oScene_)
+{
+  oScene_.vHittables.emplace_back(_oHittable);
+  oScene_.vMaterials.emplace_back(_oMaterial);
+}
+
+BVHBuildStats BuildSceneBVH(const BVHBuildSettings& _oSettings, Scene& oScene_);
+
+inline color GetEmission(const Material& _oMaterial)
+{
+  return _oMaterial.eType == MaterialType_Emissive ? _oMaterial.vAlbedo * _oMaterial.oEmissive.fIntensity : color(0.f, 0.f, 0.f);
+}
+
+// Emissive spheres become sampled lights. Emissive planes are infinite, so they are only found by BSDF rays.
+void BuildSceneLights(Scene& oScene_);
+
+// Gives every node of _oPool its own copy of the geometry, BVH, lights and environment, allocated by one of the
+// node's workers so the pages land in its local memory. Blocks until done, so it must not run on a pool worker.
+// Does nothing on pools with a single node.
+void ReplicateSceneAcrossNodes(ThreadPool& oPool_, bool _bHugePages, Scene& oScene_);
+
+// The copy for pool node _iNode if the scene was replicated, the scene itself otherwise
+inline const Scene& GetNodeScene(const Scene& _oScene, int _iNode)
+{
+  return static_cast<size_t>(_iNode) < _oScene.vNodeCopies.size() ? *_oScene.vNodeCopies[_iNode] : _oScene;
+}
+
+// Glass, metal and diffuse spheres over a ground plane. The BVH is left to the caller.
+void BuildDemoScene(Scene& oScene_);
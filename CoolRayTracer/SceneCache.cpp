@@ -0,0 +1,115 @@
+#include "SceneCache.h"
+
+#include "SceneFile.h"
+#include "WideBVH.h"
+
+size_t GetSceneMemoryUsage(const Scene& _oScene)
+{
+  size_t uCopyBytes = 0;
+  for (const std::shared_ptr<const Scene>& pCopy : _oScene.vNodeCopies)
+  {
+    uCopyBytes += GetSceneMemoryUsage(*pCopy);
+  }
+
+  return uCopyBytes + sizeof(Scene)
+    + _oScene.vHittables.capacity() * sizeof(Hittable)
+    + _oScene.vMaterials.capacity() * sizeof(Material)
+    + GetWideBVHMemoryUsage(_oScene.oBVH)
+    + _oScene.oLights.vHittableIdx.capacity() * (sizeof(uint32_t) + sizeof(float) + sizeof(LightAliasEntry))
+    + _oScene.oLights.vLightOfHittable.capacity() * sizeof(int32_t)
+    + GetEnvironmentMapMemoryUsage(_oScene.oEnvironment);
+}
+
+void ClearSceneCache(SceneCache& oCache_)
+{
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+  oCache_.lEntries.clear();
+  oCache_.mEntries.clear();
+  oCache_.uUsedBytes = 0;
+}
+
+static void EraseCachedSceneLocked(SceneCache& oCache_, std::unordered_map<uint64_t, std::list<SceneCache::Entry>::iterator>::iterator _it)
+{
+  oCache_.uUsedBytes -= _it->second->uBytes;
+  oCache_.lEntries.erase(_it->second);
+  oCache_.mEntries.erase(_it);
+}
+
+std::shared_ptr<const Scene> FindCachedScene(SceneCache& oCache_, uint64_t _uHash)
+{
+  std::shared_ptr<const Scene> pScene;
+  {
+    std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+    auto it = oCache_.mEntries.find(_uHash);
+    if (it == oCache_.mEntries.end())
+      return nullptr;
+
+    oCache_.lEntries.splice(oCache_.lEntries.begin(), oCache_.lEntries, it->second);
+    pScene = it->second->pScene;
+  }
+
+  // The asset files are checked outside the lock. A scene whose files changed is dropped, unless another request
+  // already replaced it.
+  if (!AreSceneAssetsCurrent(*pScene))
+  {
+    std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+    auto it = oCache_.mEntries.find(_uHash);
+    if (it != oCache_.mEntries.end() && it->second->pScene == pScene)
+    {
+      EraseCachedSceneLocked(oCache_, it);
+    }
+    return nullptr;
+  }
+
+  oCache_.uHits++;
+  return pScene;
+}
+
+std::shared_ptr<const Scene> AcquireCachedScene(SceneCache& oCache_, uint64_t _uHash, const char* _pData, size_t _uSize, std::string& sError_)
+{
+  std::shared_ptr<const Scene> pCached = FindCachedScene(oCache_, _uHash);
+  if (pCached)
+    return pCached;
+  oCache_.uMisses++;
+
+  // Built outside the lock, two requests racing on the same new scene both build it and the second one wins.
+  // Its textures are released once it is evicted and the last job holding it is done.
+  std::shared_ptr<Scene> pScene(new Scene(), [](Scene* _pScene)
+    {
+      ReleaseSceneTextures(*_pScene);
+      delete _pScene;
+    });
+  if (!ParseScene(_pData, _uSize, oCache_.pTextures, oCache_.sAssetRoot.c_str(), *pScene, sError_))
+    return nullptr;
+  BuildSceneBVH(BVHBuildSettings{}, *pScene);
+  BuildSceneLights(*pScene);
+  if (oCache_.pReplicationPool)
+  {
+    ReplicateSceneAcrossNodes(*oCache_.pReplicationPool, oCache_.bHugePages, *pScene);
+  }
+
+  size_t uBytes = GetSceneMemoryUsage(*pScene);
+
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+
+  auto it = oCache_.mEntries.find(_uHash);
+  if (it != oCache_.mEntries.end())
+  {
+    EraseCachedSceneLocked(oCache_, it);
+  }
+
+  oCache_.lEntries.push_front({ _uHash, pScene, uBytes });
+  oCache_.mEntries[_uHash] = oCache_.lEntries.begin();
+  oCache_.uUsedBytes += uBytes;
+
+  // The newest entry always stays, even if it alone is over budget
+  while (oCache_.uUsedBytes > oCache_.uBudgetBytes && oCache_.lEntries.size() > 1)
+  {
+    const SceneCache::Entry& oOldest = oCache_.lEntries.back();
+    oCache_.uUsedBytes -= oOldest.uBytes;
+    oCache_.mEntries.erase(oOldest.uHash);
+    oCache_.lEntries.pop_back();
+  }
+
+  return pScene;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+// Parsed scenes with their BVH, keyed by the hash of the scene bytes and evicted least recently used first
+// once the memory budget is exceeded. Entries whose environment or texture files changed on disk are dropped when
+// looked up. Evicted scenes stay alive while a job still holds them, their textures are released in pTextures when
+// the last holder drops them.
+struct SceneCache
+{
+  struct Entry
+  {
+    uint64_t uHash;
+    std::shared_ptr<const Scene> pScene;
+    size_t uBytes;
+  };
+
+  size_t uBudgetBytes = 256u * 1024u * 1024u;
+  size_t uUsedBytes = 0;
+  std::list<Entry> lEntries; // Most recently used first
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> mEntries;
+  std::mutex oMutex;
+
+  std::shared_ptr<TextureCache> pTextures; // Handed to every parsed scene, its tiles are budgeted on their own
+  std::string sAssetRoot = ".";            // Scenes come from clients, the files they name must be below it
+  ThreadPool* pReplicationPool = nullptr;  // New scenes are copied to every node of this pool, see ReplicateSceneAcrossNodes
+  bool bHugePages = false;
+
+  std::atomic<uint64_t> uHits = 0;
+  std::atomic<uint64_t> uMisses = 0; // Scenes parsed, a probe that is answered with an upload counts once
+};
+
+// Approximate heap footprint of the scene, its BVH, light table, environment and node copies, textures excluded
+size_t GetSceneMemoryUsage(const Scene& _oScene);
+
+// Drops every entry, scenes still held by jobs live on until those finish
+void ClearSceneCache(SceneCache& oCache_);
+
+// Returns nullptr on a miss, and drops the entry if its asset files changed. Misses are not counted here, the
+// AcquireCachedScene that follows with the scene bytes counts them.
+std::shared_ptr<const Scene> FindCachedScene(SceneCache& oCache_, uint64_t _uHash);
+
+// Parses and builds the BVH and light table on a miss, then replicates the scene if the cache has a pool. Returns nullptr and fills sError_ if the scene data is malformed.
+std::shared_ptr<const Scene> AcquireCachedScene(SceneCache& oCache_, uint64_t _uHash, const char* _pData, size_t _uSize, std::string& sError_);
@@ -0,0 +1,352 @@
+#include "SceneFile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads the next whitespace separated token of the line, returns false at the end of the line
+static bool NextToken(const char*& pCursor_, const char* _pEnd, std::string& sToken_)
+{
+  while (pCursor_ < _pEnd && (*pCursor_ == ' ' || *pCursor_ == '\t' || *pCursor_ == '\r'))
+  {
+    pCursor_++;
+  }
+
+  if (pCursor_ >= _pEnd || *pCursor_ == '#')
+    return false;
+
+  const char* pStart = pCursor_;
+  while (pCursor_ < _pEnd && *pCursor_ != ' ' && *pCursor_ != '\t' && *pCursor_ != '\r')
+  {
+    pCursor_++;
+  }
+
+  sToken_.assign(pStart, pCursor_);
+  return true;
+}
+
+// Larger values are rejected with NaN and infinities, so squared distances in the BVH build and hit tests stay finite
+static constexpr float fMAX_SCENE_VALUE = 1e18f;
+
+static bool NextFloat(const char*& pCursor_, const char* _pEnd, float& fValue_)
+{
+  std::string sToken;
+  if (!NextToken(pCursor_, _pEnd, sToken))
+    return false;
+
+  char* pParseEnd = nullptr;
+  fValue_ = strtof(sToken.c_str(), &pParseEnd);
+  return pParseEnd == sToken.c_str() + sToken.size() && fabsf(fValue_) <= fMAX_SCENE_VALUE;
+}
+
+// Joins _sPath to _sAssetRoot, or keeps it as written without a root. Rooted paths must be relative, without a drive and
+// free of '..' components, so a scene cannot name files outside the root.
+static bool ResolveAssetPath(const char* _sAssetRoot, const std::string& _sPath, std::string& sResolved_)
+{
+  if (!_sAssetRoot)
+  {
+    sResolved_ = _sPath;
+    return true;
+  }
+
+  if (_sPath.empty() || _sPath[0] == '/' || _sPath[0] == '\\' || _sPath.find(':') != std::string::npos)
+    return false;
+
+  size_t uStart = 0;
+  while (uStart <= _sPath.size())
+  {
+    size_t uEnd = _sPath.find_first_of("/\\", uStart);
+    uEnd = uEnd == std::string::npos ? _sPath.size() : uEnd;
+    if (_sPath.compare(uStart, uEnd - uStart, "..") == 0)
+      return false;
+    uStart = uEnd + 1;
+  }
+
+  sResolved_ = _sAssetRoot;
+  if (!sResolved_.empty() && sResolved_.back() != '/')
+  {
+    sResolved_ += '/';
+  }
+  sResolved_ += _sPath;
+  return true;
+}
+
+static void AddSceneAsset(const std::string& _sPath, uint64_t _uFileStamp, Scene& oScene_)
+{
+  for (const SceneAsset& oAsset : oScene_.vAssets)
+  {
+    if (oAsset.sPath == _sPath)
+      return;
+  }
+  oScene_.vAssets.push_back({ _sPath, _uFileStamp });
+}
+
+static bool ParseMaterialType(const char*& pCursor_, const char* _pEnd, Material& oMaterial_)
+{
+  std::string sType;
+  if (!NextToken(pCursor_, _pEnd, sType))
+    return false;
+
+  oMaterial_ = {};
+
+  float fR, fG, fB;
+  if (!NextFloat(pCursor_, _pEnd, fR) || !NextFloat(pCursor_, _pEnd, fG) || !NextFloat(pCursor_, _pEnd, fB))
+    return false;
+  oMaterial_.vAlbedo = color(fR, fG, fB);
+
+  if (sType == "lambertian")
+  {
+    oMaterial_.eType = MaterialType_Lambertian;
+    return true;
+  }
+  if (sType == "metal")
+  {
+    oMaterial_.eType = MaterialType_Metal;
+    return NextFloat(pCursor_, _pEnd, oMaterial_.oMetal.fRoughness);
+  }
+  if (sType == "dielectric")
+  {
+    oMaterial_.eType = MaterialType_Dielectric;
+    return NextFloat(pCursor_, _pEnd, oMaterial_.oDielectric.fRefractionIndex) && oMaterial_.oDielectric.fRefractionIndex > 0.f;
+  }
+  if (sType == "emissive")
+  {
+    oMaterial_.eType = MaterialType_Emissive;
+    return NextFloat(pCursor_, _pEnd, oMaterial_.oEmissive.fIntensity);
+  }
+
+  return false;
+}
+
+// sLoadError_ is only filled when the statement is well formed but its texture cannot be opened
+static bool ParseMaterial(const char*& pCursor_, const char* _pEnd, TextureCache* _pTextures, const char* _sAssetRoot, Material& oMaterial_,
+  Scene& oScene_, std::string& sLoadError_)
+{
+  if (!ParseMaterialType(pCursor_, _pEnd, oMaterial_))
+    return false;
+
+  const char* pTextureCursor = pCursor_;
+  std::string sKeyword;
+  if (!NextToken(pTextureCursor, _pEnd, sKeyword) || sKeyword != "texture")
+    return true;
+
+  std::string sPath;
+  if (!NextToken(pTextureCursor, _pEnd, sPath) || !NextFloat(pTextureCursor, _pEnd, oMaterial_.fTextureScale) || oMaterial_.fTextureScale <= 0.f)
+    return false;
+  pCursor_ = pTextureCursor;
+
+  uint32_t uTexture;
+  std::string sError;
+  std::string sResolvedPath;
+  if (!_pTextures)
+  {
+    sLoadError_ = "no texture cache for '" + sPath + "'";
+    return false;
+  }
+  if (!ResolveAssetPath(_sAssetRoot, sPath, sResolvedPath))
+  {
+    sLoadError_ = "'" + sPath + "' is outside the asset root";
+    return false;
+  }
+  uint64_t uFileStamp = GetFileStamp(sResolvedPath.c_str());
+  if (!RegisterTexture(*_pTextures, sResolvedPath.c_str(), uTexture, sError))
+  {
+    sLoadError_ = "could not load '" + sPath + "', " + sError;
+    return false;
+  }
+  AddSceneAsset(sResolvedPath, uFileStamp, oScene_);
+
+  oMaterial_.iAlbedoTexture = static_cast<int32_t>(uTexture);
+  return true;
+}
+
+bool ParseScene(const char* _pData, size_t _uSize, const std::shared_ptr<TextureCache>& _pTextures, const char* _sAssetRoot, Scene& oScene_,
+  std::string& sError_)
+{
+  oScene_ = {};
+  oScene_.pTextures = _pTextures;
+
+  const char* pCursor = _pData;
+  const char* pDataEnd = _pData + _uSize;
+  int iLine = 0;
+
+  while (pCursor < pDataEnd)
+  {
+    iLine++;
+
+    const char* pLineEnd = static_cast<const char*>(memchr(pCursor, '\n', pDataEnd - pCursor));
+    if (pLineEnd == nullptr)
+    {
+      pLineEnd = pDataEnd;
+    }
+
+    std::string sKeyword;
+    std::string sLoadError;
+    bool bValid = true;
+    if (NextToken(pCursor, pLineEnd, sKeyword))
+    {
+      if (sKeyword == "air")
+      {
+        bValid = NextFloat(pCursor, pLineEnd, oScene_.fAirRefractionIndex) && oScene_.fAirRefractionIndex > 0.f;
+      }
+      else if (sKeyword == "environment")
+      {
+        std::string sPath;
+        float fIntensity;
+        bValid = NextToken(pCursor, pLineEnd, sPath) && NextFloat(pCursor, pLineEnd, fIntensity);
+
+        std::string sError;
+        std::string sResolvedPath;
+        if (bValid && !ResolveAssetPath(_sAssetRoot, sPath, sResolvedPath))
+        {
+          sLoadError = "'" + sPath + "' is outside the asset root";
+          bValid = false;
+        }
+        uint64_t uFileStamp = bValid ? GetFileStamp(sResolvedPath.c_str()) : 0;
+        if (bValid && !LoadEnvironmentMap(sResolvedPath.c_str(), fIntensity, oScene_.oEnvironment, sError))
+        {
+          sLoadError = "could not load '" + sPath + "', " + sError;
+          bValid = false;
+        }
+        if (bValid)
+        {
+          AddSceneAsset(sResolvedPath, uFileStamp, oScene_);
+        }
+      }
+      else if (sKeyword == "sphere")
+      {
+        Hittable oSphere = {};
+        oSphere.eType = HittableType_Sphere;
+        float fX, fY, fZ;
+        Material oMaterial;
+        bValid = NextFloat(pCursor, pLineEnd, fX) && NextFloat(pCursor, pLineEnd, fY) && NextFloat(pCursor, pLineEnd, fZ)
+          && NextFloat(pCursor, pLineEnd, oSphere.oSphere.fRadius) && oSphere.oSphere.fRadius > 0.f
+          && ParseMaterial(pCursor, pLineEnd, _pTextures.get(), _sAssetRoot, oMaterial, oScene_, sLoadError);
+        oSphere.oSphere.vCenter = vec3(fX, fY, fZ);
+        if (bValid)
+        {
+          AddHittable(std::move(oSphere), std::move(oMaterial), oScene_);
+        }
+      }
+      else if (sKeyword == "plane")
+      {
+        Hittable oPlane = {};
+        oPlane.eType = HittableType_Plane;
+        float fX = 0.f, fY = 0.f, fZ = 0.f;
+        Material oMaterial;
+        bValid = NextFloat(pCursor, pLineEnd, fX) && NextFloat(pCursor, pLineEnd, fY) && NextFloat(pCursor, pLineEnd, fZ)
+          && NextFloat(pCursor, pLineEnd, oPlane.oPlane.fPoint);
+        // Normals too short to normalize reliably are rejected. Checked before the material, which may register a
+        // texture only a hittable added to the scene releases.
+        vec3 vNormal = vec3(fX, fY, fZ);
+        bValid = bValid && vNormal.LengthSqr() > 1e-12f
+          && ParseMaterial(pCursor, pLineEnd, _pTextures.get(), _sAssetRoot, oMaterial, oScene_, sLoadError);
+        oPlane.oPlane.vNormal = bValid ? Normalize(vNormal) : vec3(0.f, 1.f, 0.f);
+        if (bValid)
+        {
+          AddHittable(std::move(oPlane), std::move(oMaterial), oScene_);
+        }
+      }
+      else
+      {
+        bValid = false;
+      }
+
+      std::string sExtra;
+      if (bValid && NextToken(pCursor, pLineEnd, sExtra))
+      {
+        bValid = false;
+      }
+    }
+
+    if (!bValid && !sLoadError.empty())
+    {
+      sError_ = "Line " + std::to_string(iLine) + ": " + sLoadError;
+      ReleaseSceneTextures(oScene_);
+      return false;
+    }
+    if (!bValid)
+    {
+      char aBuffer[128];
+      snprintf(aBuffer, sizeof(aBuffer), "Line %d: malformed '%s' statement", iLine, sKeyword.c_str());
+      sError_ = aBuffer;
+      ReleaseSceneTextures(oScene_);
+      return false;
+    }
+
+    pCursor = pLineEnd + 1;
+  }
+
+  return true;
+}
+
+void ReleaseSceneTextures(Scene& oScene_)
+{
+  for (Material& oMaterial : oScene_.vMaterials)
+  {
+    if (oMaterial.iAlbedoTexture >= 0)
+    {
+      ReleaseTexture(*oScene_.pTextures, static_cast<uint32_t>(oMaterial.iAlbedoTexture));
+      oMaterial.iAlbedoTexture = -1;
+    }
+  }
+}
+
+uint64_t HashSceneData(const void* _pData, size_t _uSize)
+{
+  const uint8_t* pBytes = static_cast<const uint8_t*>(_pData);
+  uint64_t uHash = 14695981039346656037ull;
+  for (size_t i = 0; i < _uSize; i++)
+  {
+    uHash ^= pBytes[i];
+    uHash *= 1099511628211ull;
+  }
+  return uHash;
+}
+
+bool AreSceneAssetsCurrent(const Scene& _oScene)
+{
+  for (const SceneAsset& oAsset : _oScene.vAssets)
+  {
+    if (GetFileStamp(oAsset.sPath.c_str()) != oAsset.uFileStamp)
+      return false;
+  }
+  return true;
+}
+
+bool ReadFileData(const char* _sPath, std::vector<char>& vData_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+    return false;
+
+  char aBuffer[65536];
+  size_t uRead;
+  vData_.clear();
+  while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0)
+  {
+    vData_.insert(vData_.end(), aBuffer, aBuffer + uRead);
+  }
+  bool bOk = ferror(pFile) == 0;
+  fclose(pFile);
+  return bOk;
+}
+
+bool LoadSceneFile(const char* _sPath, const std::shared_ptr<TextureCache>& _pTextures, const char* _sAssetRoot, Scene& oScene_,
+  uint64_t& uHash_, std::string& sError_)
+{
+  std::vector<char> vSceneData;
+  if (!ReadFileData(_sPath, vSceneData))
+  {
+    sError_ = "could not read file";
+    return false;
+  }
+  if (!ParseScene(vSceneData.data(), vSceneData.size(), _pTextures, _sAssetRoot, oScene_, sError_))
+    return false;
+
+  BuildSceneBVH(BVHBuildSettings{}, oScene_);
+  BuildSceneLights(oScene_);
+  uHash_ = HashSceneData(vSceneData.data(), vSceneData.size());
+  return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Scene.h"
+#include "TextureCache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Text scene description, one statement per line, '#' starts a comment:
+//   air <refraction index>
+//   environment <path to .hdr or .pfm> <intensity>
+//   sphere <cx> <cy> <cz> <radius> <material>
+//   plane <nx> <ny> <nz> <offset> <material>
+// where <material> is one of
+//   lambertian <r> <g> <b>
+//   metal <r> <g> <b> <roughness>
+//   dielectric <r> <g> <b> <refraction index>
+//   emissive <r> <g> <b> <intensity>
+// optionally followed by 'texture <path to .ctex> <world size of one repeat>', which multiplies the color.
+// Textures are registered in _pTextures, scenes using them fail to parse without one. A scene that fails to parse
+// has released them already.
+// With an _sAssetRoot, texture and environment paths are relative to it and may not be absolute or contain '..',
+// scenes from untrusted sources must get one. Without it they are opened as written.
+// Numbers must be finite and within +-1e18, radii and refraction indices positive and plane normals non zero.
+// Returns false and a line numbered message in sError_ on malformed input. The BVH and light table are not built.
+bool ParseScene(const char* _pData, size_t _uSize, const std::shared_ptr<TextureCache>& _pTextures, const char* _sAssetRoot, Scene& oScene_,
+  std::string& sError_);
+
+// Releases the texture registrations ParseScene took for the materials of oScene_, and unsets the textures
+void ReleaseSceneTextures(Scene& oScene_);
+
+// 64-bit FNV-1a of the raw scene bytes, identifies a scene in caches together with AreSceneAssetsCurrent
+uint64_t HashSceneData(const void* _pData, size_t _uSize);
+
+// False once an environment or texture file of the scene changed size or write time since ParseScene read it
+bool AreSceneAssetsCurrent(const Scene& _oScene);
+
+// Whole file into vData_, returns false if it cannot be opened or read
+bool ReadFileData(const char* _sPath, std::vector<char>& vData_);
+
+// Reads and parses the scene file at _sPath like ParseScene, then builds its BVH with the default settings and its
+// light table. uHash_ is HashSceneData of the file. Returns false with the reason in sError_.
+bool LoadSceneFile(const char* _sPath, const std::shared_ptr<TextureCache>& _pTextures, const char* _sAssetRoot, Scene& oScene_,
+  uint64_t& uHash_, std::string& sError_);
@@ -0,0 +1,463 @@
+#include "TextureCache.h"
+
+#include "MathUtils.h"
+#include "PerfCounters.h"
+
+#include <filesystem>
+#include <math.h>
+#include <string.h>
+
+static std::atomic<uint32_t> g_uNextTextureCacheId = 1;
+
+static float SRGBToLinear(float _fValue)
+{
+  return _fValue <= 0.04045f ? _fValue / 12.92f : powf((_fValue + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float _fValue)
+{
+  return _fValue <= 0.0031308f ? _fValue * 12.92f : 1.055f * powf(_fValue, 1.f / 2.4f) - 0.055f;
+}
+
+static const float* GetSRGBTable()
+{
+  static const struct SRGBTable
+  {
+    float aValues[256];
+    SRGBTable()
+    {
+      for (int i = 0; i < 256; i++)
+      {
+        aValues[i] = SRGBToLinear(i / 255.f);
+      }
+    }
+  } s_oTable;
+  return s_oTable.aValues;
+}
+
+static bool SeekFile(FILE* _pFile, uint64_t _uOffset)
+{
+#if defined(_WIN32)
+  return _fseeki64(_pFile, static_cast<__int64>(_uOffset), SEEK_SET) == 0;
+#else
+  return fseeko(_pFile, static_cast<off_t>(_uOffset), SEEK_SET) == 0;
+#endif
+}
+
+static void GetLevelLayout(int _iWidth, int _iHeight, std::vector<TextureLevel>& vLevels_)
+{
+  vLevels_.clear();
+  uint64_t uOffset = sizeof(TiledTextureHeader);
+  int iWidth = _iWidth;
+  int iHeight = _iHeight;
+  while (true)
+  {
+    TextureLevel oLevel;
+    oLevel.iWidth = iWidth;
+    oLevel.iHeight = iHeight;
+    oLevel.iTilesX = (iWidth + g_iTextureTileSize - 1) / g_iTextureTileSize;
+    oLevel.iTilesY = (iHeight + g_iTextureTileSize - 1) / g_iTextureTileSize;
+    oLevel.uFileOffset = uOffset;
+    vLevels_.push_back(oLevel);
+    uOffset += static_cast<uint64_t>(oLevel.iTilesX) * oLevel.iTilesY * g_uTextureTileBytes;
+
+    if (iWidth == 1 && iHeight == 1)
+      break;
+    iWidth = max(1, iWidth / 2);
+    iHeight = max(1, iHeight / 2);
+  }
+}
+
+bool WriteTiledTexture(const char* _sPath, int _iWidth, int _iHeight, const std::vector<uint8_t>& _vRGBA, std::string& sError_)
+{
+  if (_iWidth <= 0 || _iHeight <= 0 || _vRGBA.size() != static_cast<size_t>(_iWidth) * _iHeight * 4)
+  {
+    sError_ = "image size does not match its data";
+    return false;
+  }
+
+  std::vector<TextureLevel> vLevels;
+  GetLevelLayout(_iWidth, _iHeight, vLevels);
+
+  FILE* pFile = fopen(_sPath, "wb");
+  if (!pFile)
+  {
+    sError_ = "could not create file";
+    return false;
+  }
+
+  TiledTextureHeader oHeader = { g_uTiledTextureMagic, static_cast<uint32_t>(g_iTextureTileSize),
+    static_cast<uint32_t>(_iWidth), static_cast<uint32_t>(_iHeight), static_cast<uint32_t>(vLevels.size()) };
+  bool bOk = fwrite(&oHeader, sizeof(oHeader), 1, pFile) == 1;
+
+  // Filtered in linear space, alpha is linear already
+  const float* aSRGB = GetSRGBTable();
+  std::vector<float> vLinear(_vRGBA.size());
+  for (size_t i = 0; i < _vRGBA.size(); i++)
+  {
+    vLinear[i] = (i % 4) == 3 ? _vRGBA[i] / 255.f : aSRGB[_vRGBA[i]];
+  }
+
+  std::vector<uint8_t> vTile(g_uTextureTileBytes);
+  for (size_t uLevel = 0; uLevel < vLevels.size() && bOk; uLevel++)
+  {
+    const TextureLevel& oLevel = vLevels[uLevel];
+    if (uLevel > 0)
+    {
+      const TextureLevel& oSource = vLevels[uLevel - 1];
+      std::vector<float> vNext(static_cast<size_t>(oLevel.iWidth) * oLevel.iHeight * 4);
+      for (int y = 0; y < oLevel.iHeight; y++)
+      {
+        for (int x = 0; x < oLevel.iWidth; x++)
+        {
+          int iX0 = min(2 * x, oSource.iWidth - 1), iX1 = min(2 * x + 1, oSource.iWidth - 1);
+          int iY0 = min(2 * y, oSource.iHeight - 1), iY1 = min(2 * y + 1, oSource.iHeight - 1);
+          for (int iChannel = 0; iChannel < 4; iChannel++)
+          {
+            float fSum = vLinear[(static_cast<size_t>(iY0) * oSource.iWidth + iX0) * 4 + iChannel]
+              + vLinear[(static_cast<size_t>(iY0) * oSource.iWidth + iX1) * 4 + iChannel]
+              + vLinear[(static_cast<size_t>(iY1) * oSource.iWidth + iX0) * 4 + iChannel]
+              + vLinear[(static_cast<size_t>(iY1) * oSource.iWidth + iX1) * 4 + iChannel];
+            vNext[(static_cast<size_t>(y) * oLevel.iWidth + x) * 4 + iChannel] = fSum * 0.25f;
+          }
+        }
+      }
+      vLinear.swap(vNext);
+    }
+
+    for (int iTileY = 0; iTileY < oLevel.iTilesY && bOk; iTileY++)
+    {
+      for (int iTileX = 0; iTileX < oLevel.iTilesX && bOk; iTileX++)
+      {
+        for (int y = 0; y < g_iTextureTileSize; y++)
+        {
+          int iY = min(iTileY * g_iTextureTileSize + y, oLevel.iHeight - 1);
+          for (int x = 0; x < g_iTextureTileSize; x++)
+          {
+            int iX = min(iTileX * g_iTextureTileSize + x, oLevel.iWidth - 1);
+            const float* pTexel = &vLinear[(static_cast<size_t>(iY) * oLevel.iWidth + iX) * 4];
+            uint8_t* pOut = &vTile[(static_cast<size_t>(y) * g_iTextureTileSize + x) * 4];
+            for (int iChannel = 0; iChannel < 3; iChannel++)
+            {
+              pOut[iChannel] = static_cast<uint8_t>(clamp(LinearToSRGB(pTexel[iChannel]), 0.f, 1.f) * 255.f + 0.5f);
+            }
+            pOut[3] = static_cast<uint8_t>(clamp(pTexel[3], 0.f, 1.f) * 255.f + 0.5f);
+          }
+        }
+        bOk = fwrite(vTile.data(), vTile.size(), 1, pFile) == 1;
+      }
+    }
+  }
+
+  bOk = (fclose(pFile) == 0) && bOk;
+  if (!bOk)
+  {
+    sError_ = "write failed";
+  }
+  return bOk;
+}
+
+static uint64_t MakeTileKey(uint32_t _uTexture, int _iLevel, int _iTileX, int _iTileY)
+{
+  return (static_cast<uint64_t>(_uTexture) << 44) | (static_cast<uint64_t>(_iLevel) << 38)
+    | (static_cast<uint64_t>(_iTileY) << 19) | static_cast<uint64_t>(_iTileX);
+}
+
+static uint32_t GetTileKeyTexture(uint64_t _uKey)
+{
+  return static_cast<uint32_t>(_uKey >> 44);
+}
+
+void InitTextureCache(size_t _uBudgetBytes, TextureCache& oCache_)
+{
+  ReleaseTextureCache(oCache_);
+  oCache_.uCacheId = g_uNextTextureCacheId++;
+  oCache_.uBudgetBytes = _uBudgetBytes;
+}
+
+void ReleaseTextureCache(TextureCache& oCache_)
+{
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+  uint32_t uTextureCount = oCache_.uTextureCount.load();
+  for (uint32_t i = 0; i < uTextureCount; i++)
+  {
+    if (oCache_.aTextures[i] && oCache_.aTextures[i]->pFile)
+    {
+      fclose(oCache_.aTextures[i]->pFile);
+    }
+    oCache_.aTextures[i].reset();
+  }
+  oCache_.uTextureCount = 0;
+  oCache_.vFreeSlots.clear();
+  oCache_.lEntries.clear();
+  oCache_.mEntries.clear();
+  oCache_.uUsedBytes = 0;
+
+  // Tiles still in the micro caches belong to the old id
+  oCache_.uCacheId = g_uNextTextureCacheId++;
+}
+
+uint64_t GetFileStamp(const char* _sPath)
+{
+  std::error_code oError;
+  uintmax_t uSize = std::filesystem::file_size(_sPath, oError);
+  if (oError)
+    return 0;
+  std::filesystem::file_time_type oWriteTime = std::filesystem::last_write_time(_sPath, oError);
+  if (oError)
+    return 0;
+
+  uint64_t aValues[2] = { static_cast<uint64_t>(uSize), static_cast<uint64_t>(oWriteTime.time_since_epoch().count()) };
+  const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(aValues);
+  uint64_t uStamp = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(aValues); i++)
+  {
+    uStamp ^= pBytes[i];
+    uStamp *= 1099511628211ull;
+  }
+  return uStamp;
+}
+
+bool RegisterTexture(TextureCache& oCache_, const char* _sPath, uint32_t& uTexture_, std::string& sError_)
+{
+  // Taken before the file is read, so a write racing with the registration shows up as a changed stamp later
+  uint64_t uFileStamp = GetFileStamp(_sPath);
+
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+  uint32_t uTextureCount = oCache_.uTextureCount.load();
+  for (uint32_t i = 0; i < uTextureCount; i++)
+  {
+    // Scenes still holding an older version of the file keep reading it through its old id
+    if (oCache_.aTextures[i] && oCache_.aTextures[i]->sPath == _sPath && oCache_.aTextures[i]->uFileStamp == uFileStamp)
+    {
+      oCache_.aTextures[i]->uRefCount++;
+      uTexture_ = i;
+      return true;
+    }
+  }
+  if (oCache_.vFreeSlots.empty() && uTextureCount == g_uMaxTextureCount)
+  {
+    sError_ = "too many textures";
+    return false;
+  }
+
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+  {
+    sError_ = "could not open file";
+    return false;
+  }
+
+  TiledTextureHeader oHeader;
+  if (fread(&oHeader, sizeof(oHeader), 1, pFile) != 1 || oHeader.uMagic != g_uTiledTextureMagic
+    || oHeader.uTileSize != static_cast<uint32_t>(g_iTextureTileSize) || oHeader.uWidth == 0 || oHeader.uHeight == 0)
+  {
+    fclose(pFile);
+    sError_ = "not a .ctex file";
+    return false;
+  }
+
+  std::unique_ptr<TextureFile> pTexture = std::make_unique<TextureFile>();
+  pTexture->sPath = _sPath;
+  pTexture->uFileStamp = uFileStamp;
+  pTexture->uRefCount = 1;
+  pTexture->pFile = pFile;
+  GetLevelLayout(static_cast<int>(oHeader.uWidth), static_cast<int>(oHeader.uHeight), pTexture->vLevels);
+  if (pTexture->vLevels.size() != oHeader.uLevelCount)
+  {
+    fclose(pFile);
+    sError_ = "unexpected mip count";
+    return false;
+  }
+
+  if (!oCache_.vFreeSlots.empty())
+  {
+    uTexture_ = oCache_.vFreeSlots.back();
+    oCache_.vFreeSlots.pop_back();
+    oCache_.aTextures[uTexture_] = std::move(pTexture);
+    return true;
+  }
+
+  // The slot is filled before the count publishes it
+  oCache_.aTextures[uTextureCount] = std::move(pTexture);
+  oCache_.uTextureCount.store(uTextureCount + 1);
+  uTexture_ = uTextureCount;
+  return true;
+}
+
+void ReleaseTexture(TextureCache& oCache_, uint32_t _uTexture)
+{
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+  // Scenes outliving ReleaseTextureCache find their slot empty
+  std::unique_ptr<TextureFile>& pTexture = oCache_.aTextures[_uTexture];
+  if (!pTexture || --pTexture->uRefCount > 0)
+    return;
+
+  fclose(pTexture->pFile);
+  pTexture.reset();
+  for (auto it = oCache_.lEntries.begin(); it != oCache_.lEntries.end();)
+  {
+    if (GetTileKeyTexture(it->uKey) == _uTexture)
+    {
+      oCache_.uUsedBytes -= sizeof(TextureTile);
+      oCache_.mEntries.erase(it->uKey);
+      it = oCache_.lEntries.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  oCache_.vFreeSlots.push_back(_uTexture);
+
+  // The micro caches may still hold tiles of the old texture under this id
+  oCache_.uCacheId = g_uNextTextureCacheId++;
+}
+
+int GetTextureWidth(const TextureCache& _oCache, uint32_t _uTexture)
+{
+  return _oCache.aTextures[_uTexture]->vLevels[0].iWidth;
+}
+
+static std::shared_ptr<const TextureTile> LoadTile(TextureFile& oTexture_, int _iLevel, int _iTileX, int _iTileY)
+{
+  const TextureLevel& oLevel = oTexture_.vLevels[_iLevel];
+  uint64_t uOffset = oLevel.uFileOffset + (static_cast<uint64_t>(_iTileY) * oLevel.iTilesX + _iTileX) * g_uTextureTileBytes;
+
+  std::shared_ptr<TextureTile> pTile = std::make_shared<TextureTile>();
+  std::lock_guard<std::mutex> oLock(oTexture_.oFileMutex);
+  if (!SeekFile(oTexture_.pFile, uOffset) || fread(pTile->aTexels, g_uTextureTileBytes, 1, oTexture_.pFile) != 1)
+    return nullptr;
+  return pTile;
+}
+
+// Shared LRU lookup, reads the tile from disk on a miss. The file read happens outside the cache lock,
+// two threads missing the same tile both read it and the second one adopts the first one's copy.
+static std::shared_ptr<const TextureTile> AcquireTile(TextureCache& oCache_, uint32_t _uTexture, int _iLevel, int _iTileX, int _iTileY, uint64_t _uKey)
+{
+  {
+    std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+    auto it = oCache_.mEntries.find(_uKey);
+    if (it != oCache_.mEntries.end())
+    {
+      oCache_.lEntries.splice(oCache_.lEntries.begin(), oCache_.lEntries, it->second);
+      oCache_.uHits++;
+      return it->second->pTile;
+    }
+  }
+
+  oCache_.uMisses++;
+  std::shared_ptr<const TextureTile> pTile = LoadTile(*oCache_.aTextures[_uTexture], _iLevel, _iTileX, _iTileY);
+  if (!pTile)
+    return nullptr;
+
+  std::lock_guard<std::mutex> oLock(oCache_.oMutex);
+  auto it = oCache_.mEntries.find(_uKey);
+  if (it != oCache_.mEntries.end())
+    return it->second->pTile;
+
+  oCache_.lEntries.push_front({ _uKey, pTile });
+  oCache_.mEntries[_uKey] = oCache_.lEntries.begin();
+  oCache_.uUsedBytes += sizeof(TextureTile);
+
+  while (oCache_.uUsedBytes > oCache_.uBudgetBytes && oCache_.lEntries.size() > 1)
+  {
+    oCache_.uUsedBytes -= sizeof(TextureTile);
+    oCache_.mEntries.erase(oCache_.lEntries.back().uKey);
+    oCache_.lEntries.pop_back();
+    oCache_.uEvictions++;
+  }
+
+  return pTile;
+}
+
+struct TextureMicroCacheSlot
+{
+  uint32_t uCacheId = 0;
+  uint64_t uKey = 0;
+  std::shared_ptr<const TextureTile> pTile;
+};
+
+// Direct mapped, a hit only compares two integers and never touches the shared cache or a reference count. Hits
+// are counted in the thread's render counters.
+static thread_local TextureMicroCacheSlot t_aTextureMicroCache[g_iTextureMicroCacheSize];
+
+static const TextureTile* GetTile(TextureCache& oCache_, uint32_t _uTexture, int _iLevel, int _iTileX, int _iTileY)
+{
+  uint64_t uKey = MakeTileKey(_uTexture, _iLevel, _iTileX, _iTileY);
+  TextureMicroCacheSlot& oSlot = t_aTextureMicroCache[(uKey ^ (uKey >> 19) ^ (uKey >> 38) ^ (uKey >> 44)) % g_iTextureMicroCacheSize];
+  uint32_t uCacheId = oCache_.uCacheId.load(std::memory_order_relaxed);
+  if (oSlot.uCacheId == uCacheId && oSlot.uKey == uKey)
+  {
+    t_oRenderCounters.uTextureMicroHits++;
+    return oSlot.pTile.get();
+  }
+
+  std::shared_ptr<const TextureTile> pTile = AcquireTile(oCache_, _uTexture, _iLevel, _iTileX, _iTileY, uKey);
+  if (!pTile)
+    return nullptr;
+
+  oSlot.uCacheId = uCacheId;
+  oSlot.uKey = uKey;
+  oSlot.pTile = std::move(pTile);
+  return oSlot.pTile.get();
+}
+
+static bool FetchTexel(TextureCache& oCache_, uint32_t _uTexture, int _iLevel, int _iX, int _iY, color& vTexel_)
+{
+  const TextureTile* pTile = GetTile(oCache_, _uTexture, _iLevel, _iX / g_iTextureTileSize, _iY / g_iTextureTileSize);
+  if (!pTile)
+    return false;
+
+  const float* aSRGB = GetSRGBTable();
+  const uint8_t* pTexel = &pTile->aTexels[((_iY % g_iTextureTileSize) * g_iTextureTileSize + (_iX % g_iTextureTileSize)) * 4];
+  vTexel_ = color(aSRGB[pTexel[0]], aSRGB[pTexel[1]], aSRGB[pTexel[2]]);
+  return true;
+}
+
+static bool SampleTextureLevel(TextureCache& oCache_, uint32_t _uTexture, int _iLevel, float _fU, float _fV, color& vValue_)
+{
+  const TextureLevel& oLevel = oCache_.aTextures[_uTexture]->vLevels[_iLevel];
+  float fX = (_fU - floorf(_fU)) * oLevel.iWidth - 0.5f;
+  float fY = (_fV - floorf(_fV)) * oLevel.iHeight - 0.5f;
+  int iX0 = static_cast<int>(floorf(fX));
+  int iY0 = static_cast<int>(floorf(fY));
+  float fTx = fX - iX0;
+  float fTy = fY - iY0;
+
+  iX0 = (iX0 + oLevel.iWidth) % oLevel.iWidth;
+  iY0 = (iY0 + oLevel.iHeight) % oLevel.iHeight;
+  int iX1 = (iX0 + 1) % oLevel.iWidth;
+  int iY1 = (iY0 + 1) % oLevel.iHeight;
+
+  color v00, v10, v01, v11;
+  if (!FetchTexel(oCache_, _uTexture, _iLevel, iX0, iY0, v00) || !FetchTexel(oCache_, _uTexture, _iLevel, iX1, iY0, v10)
+    || !FetchTexel(oCache_, _uTexture, _iLevel, iX0, iY1, v01) || !FetchTexel(oCache_, _uTexture, _iLevel, iX1, iY1, v11))
+    return false;
+
+  vValue_ = (v00 * (1.f - fTx) + v10 * fTx) * (1.f - fTy) + (v01 * (1.f - fTx) + v11 * fTx) * fTy;
+  return true;
+}
+
+color SampleTexture(TextureCache& oCache_, uint32_t _uTexture, float _fU, float _fV, float _fFootprint)
+{
+  const TextureFile& oTexture = *oCache_.aTextures[_uTexture];
+  int iLastLevel = static_cast<int>(oTexture.vLevels.size()) - 1;
+
+  float fLevel = clamp(Log2(max(_fFootprint * oTexture.vLevels[0].iWidth, 1.f)), 0.f, static_cast<float>(iLastLevel));
+  int iLevel0 = static_cast<int>(fLevel);
+  int iLevel1 = min(iLevel0 + 1, iLastLevel);
+  float fT = fLevel - iLevel0;
+
+  color vValue, vCoarser;
+  if (!SampleTextureLevel(oCache_, _uTexture, iLevel0, _fU, _fV, vValue))
+    return color(1.f, 0.f, 1.f);
+
+  if (fT > 0.f)
+  {
+    if (!SampleTextureLevel(oCache_, _uTexture, iLevel1, _fU, _fV, vCoarser))
+      return color(1.f, 0.f, 1.f);
+    vValue = vValue * (1.f - fT) + vCoarser * fT;
+  }
+  return vValue;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "vec3.h"
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using color = vec3;
+
+// Textures live on disk as .ctex files: a TiledTextureHeader followed by every mip level, largest first, each
+// cut into g_iTextureTileSize square tiles in row major order. Tiles are RGBA8 in sRGB, the ones on the right and
+// bottom edges are padded with their last texel so every tile has the same size and file offsets are implicit.
+static constexpr uint32_t g_uTiledTextureMagic = 0x58455443u; // "CTEX"
+static constexpr int g_iTextureTileSize = 64;
+static constexpr size_t g_uTextureTileBytes = g_iTextureTileSize * g_iTextureTileSize * 4;
+static constexpr int g_iTextureMicroCacheSize = 16; // Tiles each thread keeps without touching the shared cache
+static constexpr uint32_t g_uMaxTextureCount = 4096;
+
+struct TiledTextureHeader
+{
+  uint32_t uMagic;
+  uint32_t uTileSize;
+  uint32_t uWidth;
+  uint32_t uHeight;
+  uint32_t uLevelCount;
+};
+
+// Builds the mips of an sRGB RGBA8 image with a box filter in linear space and writes them as a .ctex file
+bool WriteTiledTexture(const char* _sPath, int _iWidth, int _iHeight, const std::vector<uint8_t>& _vRGBA, std::string& sError_);
+
+struct TextureLevel
+{
+  int iWidth;
+  int iHeight;
+  int iTilesX;
+  int iTilesY;
+  uint64_t uFileOffset;
+};
+
+struct TextureFile
+{
+  std::string sPath;
+  uint64_t uFileStamp = 0; // GetFileStamp from before the file was opened
+  uint32_t uRefCount = 0; // Registrations not yet released, changed under TextureCache::oMutex
+  std::vector<TextureLevel> vLevels;
+  FILE* pFile = nullptr;
+  std::mutex oFileMutex; // Tile reads seek the shared handle
+};
+
+struct TextureTile
+{
+  uint8_t aTexels[g_uTextureTileBytes];
+};
+
+// Tiles of every registered texture, loaded on first use and evicted least recently used first once the budget is
+// exceeded. Tiles handed to a thread's micro cache stay alive until that thread replaces them, so the resident
+// footprint is bounded by the budget plus g_iTextureMicroCacheSize tiles per rendering thread.
+struct TextureCache
+{
+  struct Entry
+  {
+    uint64_t uKey;
+    std::shared_ptr<const TextureTile> pTile;
+  };
+
+  std::atomic<uint32_t> uCacheId = 0; // Tells the micro caches apart, changes whenever a texture id may be reused
+  size_t uBudgetBytes = 256u * 1024u * 1024u;
+  size_t uUsedBytes = 0;
+
+  // Registration may run while other jobs sample, so the slots never move. Slots are set and cleared under oMutex,
+  // a slot stays set while any registration of its texture is not released. Released slots are reused first.
+  std::array<std::unique_ptr<TextureFile>, g_uMaxTextureCount> aTextures;
+  std::atomic<uint32_t> uTextureCount = 0; // Slots used so far, set or released
+  std::vector<uint32_t> vFreeSlots;
+  std::list<Entry> lEntries; // Most recently used first
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> mEntries;
+  std::mutex oMutex;
+
+  // Hits in the per thread micro caches are counted in RenderCounters::uTextureMicroHits
+  std::atomic<uint64_t> uHits = 0;
+  std::atomic<uint64_t> uMisses = 0;
+  std::atomic<uint64_t> uEvictions = 0;
+};
+
+void InitTextureCache(size_t _uBudgetBytes, TextureCache& oCache_);
+
+// Closes the files and drops every tile
+void ReleaseTextureCache(TextureCache& oCache_);
+
+// Size and last write time of the file at _sPath folded into one value, 0 if it cannot be read
+uint64_t GetFileStamp(const char* _sPath);
+
+// Opens a .ctex file and returns its texture id in uTexture_. Registering the same path twice returns the first id
+// unless the file's stamp changed in between, then the new file gets its own id. Every successful call must be matched by one ReleaseTexture. Safe while other threads sample registered textures,
+// fails past g_uMaxTextureCount textures registered at once.
+bool RegisterTexture(TextureCache& oCache_, const char* _sPath, uint32_t& uTexture_, std::string& sError_);
+
+// Drops one registration. The last one closes the file, drops its tiles and frees the id for another texture, so
+// nothing may sample it afterwards.
+void ReleaseTexture(TextureCache& oCache_, uint32_t _uTexture);
+
+int GetTextureWidth(const TextureCache& _oCache, uint32_t _uTexture);
+
+// Trilinear lookup with wrapping, in linear color. _fFootprint is the size of the filtered area in uv units,
+// it picks the mip level. Returns magenta if a tile cannot be read.
+color SampleTexture(TextureCache& oCache_, uint32_t _uTexture, float _fU, float _fV, float _fFootprint);
@@ -0,0 +1,153 @@
+#include "ThreadPool.h"
+
+#include "Parallel.h"
+
+thread_local int t_iThreadPoolNode = 0;
+
+// Own node first, then any other one. Called with the pool mutex held.
+static bool PopTask(ThreadPool& oPool_, int _iNode, std::function<void()>& fnTask_)
+{
+  int iNodeCount = GetThreadPoolNodeCount(oPool_);
+  for (int i = 0; i < iNodeCount; i++)
+  {
+    std::deque<std::function<void()>>& vTasks = oPool_.vNodes[(_iNode + i) % iNodeCount]->vTasks;
+    if (!vTasks.empty())
+    {
+      fnTask_ = std::move(vTasks.front());
+      vTasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+static void ThreadPoolWorker(ThreadPool* pPool, int _iNode)
+{
+  ThreadPool& oPool = *pPool;
+  ThreadPoolNode& oNode = *oPool.vNodes[_iNode];
+
+  t_iThreadPoolNode = _iNode;
+  if (!oPool.oTopology.vNodes.empty())
+  {
+    PinThreadToNumaNode(oPool.oTopology.vNodes[_iNode]);
+  }
+
+  // A worker only sleeps once every node is out of tasks, and is only woken for its own node. Tasks of a busy
+  // node are picked up by the workers of other nodes as they run out of their own.
+  std::unique_lock<std::mutex> oLock(oPool.oMutex);
+  while (true)
+  {
+    std::function<void()> fnTask;
+    if (!PopTask(oPool, _iNode, fnTask))
+    {
+      if (oPool.bStop)
+        break;
+      oNode.oCondition.wait(oLock);
+      continue;
+    }
+
+    oLock.unlock();
+    fnTask();
+    oLock.lock();
+  }
+}
+
+static void StartWorkers(ThreadPool& oPool_)
+{
+  oPool_.bStop = false;
+  oPool_.uNextNode = 0;
+  for (int iNode = 0; iNode < GetThreadPoolNodeCount(oPool_); iNode++)
+  {
+    for (int i = 0; i < oPool_.vNodes[iNode]->iThreadCount; i++)
+    {
+      oPool_.vThreads.emplace_back(ThreadPoolWorker, &oPool_, iNode);
+    }
+  }
+}
+
+void StartThreadPool(int _iThreadCount, ThreadPool& oPool_)
+{
+  oPool_.oTopology.vNodes.clear();
+  oPool_.vNodes.clear();
+  oPool_.vNodes.push_back(std::make_unique<ThreadPoolNode>());
+  oPool_.vNodes[0]->iThreadCount = _iThreadCount > 0 ? _iThreadCount : GetDefaultThreadCount();
+  StartWorkers(oPool_);
+}
+
+void StartNumaThreadPool(int _iThreadCount, const NumaTopology& _oTopology, ThreadPool& oPool_)
+{
+  if (_oTopology.vNodes.empty())
+  {
+    StartThreadPool(_iThreadCount, oPool_);
+    return;
+  }
+
+  size_t uCpuCount = 0;
+  for (const NumaNode& oNode : _oTopology.vNodes)
+  {
+    uCpuCount += oNode.vCpus.size();
+  }
+
+  // Nodes left without workers are dropped, nothing would run their tasks
+  oPool_.oTopology.vNodes.clear();
+  oPool_.vNodes.clear();
+  size_t uCpusBefore = 0;
+  for (const NumaNode& oNode : _oTopology.vNodes)
+  {
+    int iThreadCount = static_cast<int>(oNode.vCpus.size());
+    if (_iThreadCount > 0)
+    {
+      // Cumulative rounding, so the counts add up to _iThreadCount
+      size_t uBegin = static_cast<size_t>(_iThreadCount) * uCpusBefore / uCpuCount;
+      size_t uEnd = static_cast<size_t>(_iThreadCount) * (uCpusBefore + oNode.vCpus.size()) / uCpuCount;
+      iThreadCount = static_cast<int>(uEnd - uBegin);
+    }
+    uCpusBefore += oNode.vCpus.size();
+
+    if (iThreadCount > 0)
+    {
+      oPool_.oTopology.vNodes.push_back(oNode);
+      oPool_.vNodes.push_back(std::make_unique<ThreadPoolNode>());
+      oPool_.vNodes.back()->iThreadCount = iThreadCount;
+    }
+  }
+  StartWorkers(oPool_);
+}
+
+void SubmitNodeTask(ThreadPool& oPool_, int _iNode, std::function<void()>&& _fnTask)
+{
+  ThreadPoolNode& oNode = *oPool_.vNodes[_iNode];
+  {
+    std::lock_guard<std::mutex> oLock(oPool_.oMutex);
+    oNode.vTasks.push_back(std::move(_fnTask));
+  }
+  oNode.oCondition.notify_one();
+}
+
+void SubmitTask(ThreadPool& oPool_, std::function<void()>&& _fnTask)
+{
+  int iNode;
+  {
+    std::lock_guard<std::mutex> oLock(oPool_.oMutex);
+    iNode = static_cast<int>(oPool_.uNextNode++ % oPool_.vNodes.size());
+  }
+  SubmitNodeTask(oPool_, iNode, std::move(_fnTask));
+}
+
+void StopThreadPool(ThreadPool& oPool_)
+{
+  {
+    std::lock_guard<std::mutex> oLock(oPool_.oMutex);
+    oPool_.bStop = true;
+  }
+  for (std::unique_ptr<ThreadPoolNode>& pNode : oPool_.vNodes)
+  {
+    pNode->oCondition.notify_all();
+  }
+
+  for (std::thread& oThread : oPool_.vThreads)
+  {
+    oThread.join();
+  }
+  oPool_.vThreads.clear();
+}
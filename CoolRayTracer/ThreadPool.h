@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Numa.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Queue and workers of one NUMA node. Without NUMA placement the pool has a single one.
+struct ThreadPoolNode
+{
+  std::deque<std::function<void()>> vTasks;
+  std::condition_variable oCondition;
+  int iThreadCount = 0;
+};
+
+// Fixed set of workers pulling tasks in submission order. Render jobs submit one task per tile, so tiles of
+// concurrent jobs interleave on the same threads instead of oversubscribing the machine.
+// Workers take tasks from their own node first and only take another node's tasks once theirs is empty.
+struct ThreadPool
+{
+  std::vector<std::thread> vThreads;
+  std::vector<std::unique_ptr<ThreadPoolNode>> vNodes;
+  NumaTopology oTopology; // Node i of the pool runs on oTopology.vNodes[i], empty unless started with StartNumaThreadPool
+  std::mutex oMutex;
+  size_t uNextNode = 0;   // Round robin target of SubmitTask
+  bool bStop = false;
+};
+
+// Index in ThreadPool::vNodes of the node running the calling worker, 0 on other threads
+extern thread_local int t_iThreadPoolNode;
+
+// _iThreadCount of 0 uses every hardware thread
+void StartThreadPool(int _iThreadCount, ThreadPool& oPool_);
+
+// One node per entry of _oTopology, with workers pinned to its CPUs. _iThreadCount of 0 starts one worker per
+// CPU, other counts are split between the nodes by their CPU count and nodes left without a worker are skipped.
+void StartNumaThreadPool(int _iThreadCount, const NumaTopology& _oTopology, ThreadPool& oPool_);
+
+// Spreads tasks over the nodes in turn
+void SubmitTask(ThreadPool& oPool_, std::function<void()>&& _fnTask);
+
+void SubmitNodeTask(ThreadPool& oPool_, int _iNode, std::function<void()>&& _fnTask);
+
+// Runs the tasks already queued, then joins the workers
+void StopThreadPool(ThreadPool& oPool_);
+
+inline int GetThreadPoolSize(const ThreadPool& _oPool)
+{
+  return static_cast<int>(_oPool.vThreads.size());
+}
+
+inline int GetThreadPoolNodeCount(const ThreadPool& _oPool)
+{
+  return static_cast<int>(_oPool.vNodes.size());
+}
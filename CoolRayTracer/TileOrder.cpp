@@ -0,0 +1,100 @@
+#include "TileOrder.h"
+
+// Keeps every other bit of _uValue, packed into the low 16 bits
+static uint32_t CompactBits(uint32_t _uValue)
+{
+  _uValue &= 0x55555555u;
+  _uValue = (_uValue | (_uValue >> 1)) & 0x33333333u;
+  _uValue = (_uValue | (_uValue >> 2)) & 0x0F0F0F0Fu;
+  _uValue = (_uValue | (_uValue >> 4)) & 0x00FF00FFu;
+  _uValue = (_uValue | (_uValue >> 8)) & 0x0000FFFFu;
+  return _uValue;
+}
+
+void CurveIndexToXY(TraversalOrder _eOrder, uint32_t _uOrderLog2, uint32_t _uIndex, uint32_t& uX_, uint32_t& uY_)
+{
+  switch (_eOrder)
+  {
+  case TraversalOrder_RowMajor:
+  {
+    uX_ = _uIndex & ((1u << _uOrderLog2) - 1u);
+    uY_ = _uIndex >> _uOrderLog2;
+  } break;
+  case TraversalOrder_Morton:
+  {
+    uX_ = CompactBits(_uIndex);
+    uY_ = CompactBits(_uIndex >> 1);
+  } break;
+  case TraversalOrder_Hilbert:
+  {
+    uint32_t uX = 0;
+    uint32_t uY = 0;
+    uint32_t uRemaining = _uIndex;
+    for (uint32_t uSize = 1; uSize < (1u << _uOrderLog2); uSize <<= 1)
+    {
+      uint32_t uRx = 1u & (uRemaining >> 1);
+      uint32_t uRy = 1u & (uRemaining ^ uRx);
+
+      // Rotate the quadrant so the sub-curves connect
+      if (uRy == 0)
+      {
+        if (uRx == 1)
+        {
+          uX = uSize - 1 - uX;
+          uY = uSize - 1 - uY;
+        }
+        uint32_t uTmp = uX;
+        uX = uY;
+        uY = uTmp;
+      }
+
+      uX += uSize * uRx;
+      uY += uSize * uRy;
+      uRemaining >>= 2;
+    }
+    uX_ = uX;
+    uY_ = uY;
+  } break;
+  }
+}
+
+int SelectTileSize(int _iWidth, int _iHeight, int _iThreadCount)
+{
+  // 32x32 tiles keep the rays of a tile within a small part of the BVH, smaller tiles are
+  // only used when there would not be enough of them to keep every thread busy until the end
+  constexpr int iMAX_TILE_SIZE = 32;
+  constexpr int iMIN_TILE_SIZE = 8;
+  constexpr int iTILES_PER_THREAD = 8;
+
+  int iTileSize = iMAX_TILE_SIZE;
+  while (iTileSize > iMIN_TILE_SIZE)
+  {
+    int iTileCount = ((_iWidth + iTileSize - 1) / iTileSize) * ((_iHeight + iTileSize - 1) / iTileSize);
+    if (iTileCount >= _iThreadCount * iTILES_PER_THREAD)
+      break;
+    iTileSize /= 2;
+  }
+  return iTileSize;
+}
+
+void BuildTileList(int _iWidth, int _iHeight, const TileSettings& _oSettings, int _iThreadCount, std::vector<ScreenTile>& vTiles_)
+{
+  vTiles_.clear();
+
+  int iTileSize = _oSettings.iTileSize > 0 ? _oSettings.iTileSize : SelectTileSize(_iWidth, _iHeight, _iThreadCount);
+  int iTileCountX = (_iWidth + iTileSize - 1) / iTileSize;
+  int iTileCountY = (_iHeight + iTileSize - 1) / iTileSize;
+
+  vTiles_.reserve(static_cast<size_t>(iTileCountX) * iTileCountY);
+
+  ForEachPixel(0, 0, iTileCountX, iTileCountY, _oSettings.eTileOrder,
+    [&](int iTileX, int iTileY)
+    {
+      ScreenTile oTile = {};
+      oTile.iStartX = iTileX * iTileSize;
+      oTile.iStartY = iTileY * iTileSize;
+      oTile.iEndX = (oTile.iStartX + iTileSize < _iWidth) ? oTile.iStartX + iTileSize : _iWidth;
+      oTile.iEndY = (oTile.iStartY + iTileSize < _iHeight) ? oTile.iStartY + iTileSize : _iHeight;
+      vTiles_.push_back(oTile);
+    });
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+enum TraversalOrder
+{
+  TraversalOrder_RowMajor,
+  TraversalOrder_Morton,
+  TraversalOrder_Hilbert
+};
+
+struct ScreenTile
+{
+  int iStartX;
+  int iStartY;
+  int iEndX;
+  int iEndY;
+};
+
+struct TileSettings
+{
+  TraversalOrder eTileOrder = TraversalOrder_Hilbert;
+  TraversalOrder ePixelOrder = TraversalOrder_Morton;
+  int iTileSize = 0; // 0 picks a size from the resolution and thread count
+};
+
+// Maps an index along a curve covering a (1 << _uOrderLog2)^2 grid to its cell
+void CurveIndexToXY(TraversalOrder _eOrder, uint32_t _uOrderLog2, uint32_t _uIndex, uint32_t& uX_, uint32_t& uY_);
+
+int SelectTileSize(int _iWidth, int _iHeight, int _iThreadCount);
+
+// Splits the screen into square tiles listed in _oSettings.eTileOrder, so consecutive tiles are neighbours
+void BuildTileList(int _iWidth, int _iHeight, const TileSettings& _oSettings, int _iThreadCount, std::vector<ScreenTile>& vTiles_);
+
+// Calls _fnVisit(x, y) for every pixel of the rectangle, in the given order
+template <typename F>
+void ForEachPixel(int _iStartX, int _iStartY, int _iEndX, int _iEndY, TraversalOrder _eOrder, F&& _fnVisit)
+{
+  const uint32_t uWidth = static_cast<uint32_t>(_iEndX - _iStartX);
+  const uint32_t uHeight = static_cast<uint32_t>(_iEndY - _iStartY);
+
+  if (_eOrder == TraversalOrder_RowMajor)
+  {
+    for (int y = _iStartY; y < _iEndY; y++)
+    {
+      for (int x = _iStartX; x < _iEndX; x++)
+      {
+        _fnVisit(x, y);
+      }
+    }
+    return;
+  }
+
+  uint32_t uOrderLog2 = 0;
+  while ((1u << uOrderLog2) < uWidth || (1u << uOrderLog2) < uHeight)
+  {
+    uOrderLog2++;
+  }
+
+  // Walk the power of two square covering the rectangle and skip the cells that fall outside
+  const uint32_t uCellCount = 1u << (2 * uOrderLog2);
+  for (uint32_t uIndex = 0; uIndex < uCellCount; uIndex++)
+  {
+    uint32_t uX, uY;
+    CurveIndexToXY(_eOrder, uOrderLog2, uIndex, uX, uY);
+    if (uX < uWidth && uY < uHeight)
+    {
+      _fnVisit(_iStartX + static_cast<int>(uX), _iStartY + static_cast<int>(uY));
+    }
+  }
+}
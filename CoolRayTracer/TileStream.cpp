@@ -0,0 +1,96 @@
+#include "TileStream.h"
+
+// Suspends the stream until the job finished _uOrder + 1 tiles, then gives the index of the last one
+struct FinishedTileAwaiter
+{
+  RenderJob& oJob;
+  size_t uOrder;
+
+  bool await_ready()
+  {
+    std::lock_guard<std::mutex> oLock(oJob.oMutex);
+    return oJob.vFinishedTiles.size() > uOrder;
+  }
+  bool await_suspend(std::coroutine_handle<> _hStream)
+  {
+    // Checked again under the lock the workers list their tiles with, so no tile slips in between
+    std::lock_guard<std::mutex> oLock(oJob.oMutex);
+    if (oJob.vFinishedTiles.size() > uOrder)
+      return false;
+    oJob.hTileWaiter = _hStream;
+    return true;
+  }
+  uint32_t await_resume()
+  {
+    std::lock_guard<std::mutex> oLock(oJob.oMutex);
+    return oJob.vFinishedTiles[uOrder];
+  }
+};
+
+static TileStream YieldFinishedTiles(RenderJob& oJob_)
+{
+  RenderedTile oTile;
+  oTile.uSamplesPerPixel = static_cast<uint32_t>(oJob_.oSettings.iSamplesPerPixel);
+  for (size_t i = 0; i < oJob_.vTiles.size(); i++)
+  {
+    oTile.uTileIdx = co_await FinishedTileAwaiter{ oJob_, i };
+    oTile.oRegion = oJob_.vTiles[oTile.uTileIdx];
+
+    const ScreenTile& oRegion = oTile.oRegion;
+    size_t uTileWidth = static_cast<size_t>(oRegion.iEndX - oRegion.iStartX);
+    oTile.vColors.resize(uTileWidth * (oRegion.iEndY - oRegion.iStartY));
+    for (int y = oRegion.iStartY; y < oRegion.iEndY; y++)
+    {
+      size_t uBegin = static_cast<size_t>(y) * oJob_.oSettings.iWidth + oRegion.iStartX;
+      LoadVec3Range(oJob_.oBuffers.oColor, uBegin, uTileWidth, oTile.vColors.data() + (y - oRegion.iStartY) * uTileWidth);
+    }
+    co_yield oTile;
+  }
+}
+
+TileStream StreamRenderJob(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const Camera& _oCamera,
+  const RenderSettings& _oSettings, RenderJob& oJob_)
+{
+  oJob_.bStreamTiles = true;
+  StartRenderJob(oPool_, std::move(_pScene), _oCamera, _oSettings, oJob_);
+
+  TileStream oStream = YieldFinishedTiles(oJob_);
+  oStream.pJob = &oJob_;
+  return oStream;
+}
+
+void TileStream::Destroy()
+{
+  if (!hStream)
+    return;
+
+  if (pJob)
+  {
+    std::lock_guard<std::mutex> oLock(pJob->oMutex);
+    if (pJob->hTileWaiter == hStream)
+    {
+      pJob->hTileWaiter = nullptr;
+    }
+  }
+  hStream.destroy();
+  hStream = nullptr;
+}
+
+const RenderedTile* WaitForNextTile(TileStream& oStream_)
+{
+  if (oStream_.hStream.done())
+    return nullptr;
+
+  // Once a tile is listed the stream runs to its yield without suspending, here on the calling thread
+  RenderJob& oJob = *oStream_.pJob;
+  {
+    std::unique_lock<std::mutex> oLock(oJob.oMutex);
+    oJob.oCondition.wait(oLock, [&]()
+      {
+        return oJob.vFinishedTiles.size() > oStream_.uTakenTiles || oStream_.uTakenTiles >= oJob.vTiles.size();
+      });
+  }
+  oStream_.uTakenTiles++;
+  oStream_.hStream.resume();
+  return oStream_.hStream.promise().pTile;
+}
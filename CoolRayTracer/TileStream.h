@@ -0,0 +1,136 @@
+#pragma once
+
+#include "RenderJob.h"
+
+#include <coroutine>
+#include <exception>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Tile of a render job as it finished tracing, before the frame is denoised
+struct RenderedTile
+{
+  ScreenTile oRegion = {};
+  uint32_t uTileIdx = 0;
+  uint32_t uSamplesPerPixel = 0;
+  std::vector<color> vColors; // Linear, row major over oRegion
+};
+
+// Async generator of the tiles of one job, in the order they finish. Coroutines take them with
+// co_await Next(), other threads with WaitForNextTile. Only one consumer at a time.
+struct TileStream
+{
+  struct promise_type
+  {
+    const RenderedTile* pTile = nullptr; // Null once the stream ended
+    std::coroutine_handle<> hConsumer;   // Coroutine waiting in Next, null for WaitForNextTile
+
+    // Hands control straight back to the consumer, or to whoever resumed the stream
+    struct ReturnToConsumer
+    {
+      std::coroutine_handle<> hConsumer;
+
+      bool await_ready() noexcept
+      {
+        return false;
+      }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+      {
+        return hConsumer ? hConsumer : std::noop_coroutine();
+      }
+      void await_resume() noexcept
+      {
+      }
+    };
+
+    TileStream get_return_object()
+    {
+      return TileStream{ std::coroutine_handle<promise_type>::from_promise(*this) };
+    }
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+    ReturnToConsumer final_suspend() noexcept
+    {
+      pTile = nullptr;
+      return { std::exchange(hConsumer, nullptr) };
+    }
+    ReturnToConsumer yield_value(const RenderedTile& _oTile) noexcept
+    {
+      pTile = &_oTile;
+      return { std::exchange(hConsumer, nullptr) };
+    }
+    void return_void()
+    {
+    }
+    // The renderer does not throw
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+
+  struct NextAwaiter
+  {
+    std::coroutine_handle<promise_type> hStream;
+
+    bool await_ready() noexcept
+    {
+      return hStream.done();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> _hConsumer) noexcept
+    {
+      hStream.promise().hConsumer = _hConsumer;
+      return hStream;
+    }
+    // Null once every tile was taken
+    const RenderedTile* await_resume() noexcept
+    {
+      return hStream.promise().pTile;
+    }
+  };
+
+  std::coroutine_handle<promise_type> hStream;
+  RenderJob* pJob = nullptr;
+  size_t uTakenTiles = 0; // By WaitForNextTile
+
+  TileStream() = default;
+  explicit TileStream(std::coroutine_handle<promise_type> _hStream) : hStream(_hStream) {}
+  TileStream(TileStream&& _oOther) noexcept
+    : hStream(std::exchange(_oOther.hStream, nullptr)), pJob(_oOther.pJob), uTakenTiles(_oOther.uTakenTiles) {}
+  TileStream& operator=(TileStream&& _oOther) noexcept
+  {
+    Destroy();
+    hStream = std::exchange(_oOther.hStream, nullptr);
+    pJob = _oOther.pJob;
+    uTakenTiles = _oOther.uTakenTiles;
+    return *this;
+  }
+  TileStream(const TileStream&) = delete;
+  TileStream& operator=(const TileStream&) = delete;
+  ~TileStream()
+  {
+    Destroy();
+  }
+
+  // Unregisters the stream from its job before destroying it, so no worker resumes it after. Safe between two
+  // tiles, and while a consumer waits in Next until a worker finishes the tile it waits for.
+  void Destroy();
+
+  // The tile stays valid until the next call. The consumer continues on the worker that finished the tile, work
+  // done there before the next co_await keeps that worker from tracing.
+  NextAwaiter Next()
+  {
+    return NextAwaiter{ hStream };
+  }
+};
+
+// Starts oJob_ like StartRenderJob and streams its tiles. The consumer may wait for the job once the stream ended.
+// oJob_ and oPool_ must outlive the stream.
+TileStream StreamRenderJob(ThreadPool& oPool_, std::shared_ptr<const Scene> _pScene, const Camera& _oCamera,
+  const RenderSettings& _oSettings, RenderJob& oJob_);
+
+// Blocks until the next tile finished, null once every tile was taken
+const RenderedTile* WaitForNextTile(TileStream& oStream_);
@@ -0,0 +1,471 @@
+#include "WideBVH.h"
+
+#include "CpuDispatch.h"
+#include "PerfCounters.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIDE_BVH_SSE 1
+#include <emmintrin.h>
+#else
+#define WIDE_BVH_SSE 0
+#endif
+
+#if WIDE_BVH_SSE && CPU_DISPATCH_X86
+#define WIDE_BVH_AVX 1
+#include <immintrin.h>
+#else
+#define WIDE_BVH_AVX 0
+#endif
+
+static constexpr int iTRAVERSAL_STACK_SIZE = 256;
+
+static float ExponentToScale(int _iExponent)
+{
+  return ldexpf(1.0f, _iExponent);
+}
+
+// Smallest power of two step that covers _fExtent in 255 steps
+static int8_t ComputeQuantizationExponent(float _fExtent)
+{
+  int iExponent = -126;
+  if (_fExtent > 0.f)
+  {
+    iExponent = static_cast<int>(ceilf(log2f(_fExtent / 255.f)));
+    iExponent = std::clamp(iExponent, -126, 127);
+    while (iExponent < 127 && 255.f * ExponentToScale(iExponent) < _fExtent)
+    {
+      iExponent++;
+    }
+  }
+  return static_cast<int8_t>(iExponent);
+}
+
+static uint8_t QuantizeMin(float _fValue, float _fOrigin, float _fScale)
+{
+  int iQuant = std::clamp(static_cast<int>(floorf((_fValue - _fOrigin) / _fScale)), 0, 255);
+  while (iQuant > 0 && _fOrigin + iQuant * _fScale > _fValue)
+  {
+    iQuant--;
+  }
+  return static_cast<uint8_t>(iQuant);
+}
+
+static uint8_t QuantizeMax(float _fValue, float _fOrigin, float _fScale)
+{
+  int iQuant = std::clamp(static_cast<int>(ceilf((_fValue - _fOrigin) / _fScale)), 0, 255);
+  while (iQuant < 255 && _fOrigin + iQuant * _fScale < _fValue)
+  {
+    iQuant++;
+  }
+  return static_cast<uint8_t>(iQuant);
+}
+
+static uint32_t CollapseNode(const BVH& _oBVH, uint32_t _uBinaryIdx, WideBVH& oWideBVH_)
+{
+  // Open the inner child with the largest surface area until the node is full
+  uint32_t aChildren[iWIDE_BVH_WIDTH];
+  int iChildCount = 0;
+
+  const BVHNode& oBinaryNode = _oBVH.vNodes[_uBinaryIdx];
+  if (oBinaryNode.IsLeaf())
+  {
+    aChildren[iChildCount++] = _uBinaryIdx;
+  }
+  else
+  {
+    aChildren[iChildCount++] = oBinaryNode.uFirst;
+    aChildren[iChildCount++] = oBinaryNode.uFirst + 1;
+  }
+
+  while (iChildCount < iWIDE_BVH_WIDTH)
+  {
+    int iBest = -1;
+    float fBestArea = -1.f;
+    for (int i = 0; i < iChildCount; i++)
+    {
+      const BVHNode& oChild = _oBVH.vNodes[aChildren[i]];
+      if (!oChild.IsLeaf() && oChild.oBounds.SurfaceArea() > fBestArea)
+      {
+        iBest = i;
+        fBestArea = oChild.oBounds.SurfaceArea();
+      }
+    }
+
+    if (iBest < 0)
+      break;
+
+    uint32_t uOpened = aChildren[iBest];
+    aChildren[iBest] = _oBVH.vNodes[uOpened].uFirst;
+    aChildren[iChildCount++] = _oBVH.vNodes[uOpened].uFirst + 1;
+  }
+
+  uint32_t uWideIdx = static_cast<uint32_t>(oWideBVH_.vNodes.size());
+  oWideBVH_.vNodes.emplace_back();
+
+  AABB oBounds = {};
+  for (int i = 0; i < iChildCount; i++)
+  {
+    oBounds.Grow(_oBVH.vNodes[aChildren[i]].oBounds);
+  }
+
+  WideBVHNode oNode = {};
+  float aScale[3];
+  for (int iAxis = 0; iAxis < 3; iAxis++)
+  {
+    oNode.aOrigin[iAxis] = oBounds.vMin[iAxis];
+    oNode.aExponent[iAxis] = ComputeQuantizationExponent(oBounds.vMax[iAxis] - oBounds.vMin[iAxis]);
+    aScale[iAxis] = ExponentToScale(oNode.aExponent[iAxis]);
+  }
+
+  for (int i = 0; i < iChildCount; i++)
+  {
+    const BVHNode& oChild = _oBVH.vNodes[aChildren[i]];
+
+    oNode.aQuantMinX[i] = QuantizeMin(oChild.oBounds.vMin.x(), oNode.aOrigin[0], aScale[0]);
+    oNode.aQuantMinY[i] = QuantizeMin(oChild.oBounds.vMin.y(), oNode.aOrigin[1], aScale[1]);
+    oNode.aQuantMinZ[i] = QuantizeMin(oChild.oBounds.vMin.z(), oNode.aOrigin[2], aScale[2]);
+    oNode.aQuantMaxX[i] = QuantizeMax(oChild.oBounds.vMax.x(), oNode.aOrigin[0], aScale[0]);
+    oNode.aQuantMaxY[i] = QuantizeMax(oChild.oBounds.vMax.y(), oNode.aOrigin[1], aScale[1]);
+    oNode.aQuantMaxZ[i] = QuantizeMax(oChild.oBounds.vMax.z(), oNode.aOrigin[2], aScale[2]);
+    oNode.uValidMask |= static_cast<uint8_t>(1u << i);
+
+    if (oChild.IsLeaf())
+    {
+      oNode.aChild[i] = oChild.uFirst;
+      static_assert(iMAX_BVH_LEAF_SIZE <= UINT8_MAX, "Leaf counts must fit WideBVHNode::aPrimCount");
+      oNode.aPrimCount[i] = static_cast<uint8_t>(oChild.uCount);
+    }
+    else
+    {
+      oNode.aChild[i] = CollapseNode(_oBVH, aChildren[i], oWideBVH_);
+      oNode.uInnerMask |= static_cast<uint8_t>(1u << i);
+    }
+  }
+
+  oWideBVH_.vNodes[uWideIdx] = oNode;
+  return uWideIdx;
+}
+
+void BuildWideBVH(const BVH& _oBVH, WideBVH& oWideBVH_)
+{
+  oWideBVH_.vNodes.clear();
+  oWideBVH_.vPrimIndices = _oBVH.vPrimIndices;
+  oWideBVH_.vUnbounded = _oBVH.vUnbounded;
+
+  if (_oBVH.vNodes.empty())
+    return;
+
+  oWideBVH_.vNodes.reserve(_oBVH.vNodes.size() / 3 + 1);
+  CollapseNode(_oBVH, 0, oWideBVH_);
+  oWideBVH_.vNodes.shrink_to_fit();
+}
+
+size_t GetWideBVHMemoryUsage(const WideBVH& _oWideBVH)
+{
+  return _oWideBVH.vNodes.size() * sizeof(WideBVHNode)
+    + _oWideBVH.vPrimIndices.size() * sizeof(uint32_t)
+    + _oWideBVH.vUnbounded.size() * sizeof(uint32_t);
+}
+
+#if WIDE_BVH_SSE
+
+static inline __m128 LoadQuantized(const uint8_t* _pQuantized)
+{
+  int32_t iPacked;
+  memcpy(&iPacked, _pQuantized, sizeof(iPacked));
+  __m128i vZero = _mm_setzero_si128();
+  __m128i vValues = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(iPacked), vZero), vZero);
+  return _mm_cvtepi32_ps(vValues);
+}
+
+static inline __m128 LoadScale(int8_t _iExponent)
+{
+  return _mm_castsi128_ps(_mm_set1_epi32((_iExponent + 127) << 23));
+}
+
+static inline void IntersectSlabs(const uint8_t* _pQuantMin, const uint8_t* _pQuantMax, float _fOrigin, int8_t _iExponent,
+  __m128 _vRayOrigin, __m128 _vInvDir, __m128& vEntry_, __m128& vExit_)
+{
+  __m128 vOrigin = _mm_set1_ps(_fOrigin);
+  __m128 vScale = LoadScale(_iExponent);
+  __m128 vMin = _mm_add_ps(vOrigin, _mm_mul_ps(LoadQuantized(_pQuantMin), vScale));
+  __m128 vMax = _mm_add_ps(vOrigin, _mm_mul_ps(LoadQuantized(_pQuantMax), vScale));
+  __m128 vT0 = _mm_mul_ps(_mm_sub_ps(vMin, _vRayOrigin), _vInvDir);
+  __m128 vT1 = _mm_mul_ps(_mm_sub_ps(vMax, _vRayOrigin), _vInvDir);
+  vEntry_ = _mm_max_ps(vEntry_, _mm_min_ps(vT0, vT1));
+  vExit_ = _mm_min_ps(vExit_, _mm_max_ps(vT0, vT1));
+}
+
+#endif
+
+#if WIDE_BVH_AVX
+
+// Min and max offsets of one axis in the low and high halves
+CPU_TARGET_AVX2 static inline __m256 LoadQuantizedPair(const uint8_t* _pQuantMin, const uint8_t* _pQuantMax)
+{
+  int32_t iPackedMin, iPackedMax;
+  memcpy(&iPackedMin, _pQuantMin, sizeof(iPackedMin));
+  memcpy(&iPackedMax, _pQuantMax, sizeof(iPackedMax));
+  __m128i vPacked = _mm_unpacklo_epi32(_mm_cvtsi32_si128(iPackedMin), _mm_cvtsi32_si128(iPackedMax));
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(vPacked));
+}
+
+// Same operations as IntersectSlabs, with both planes of the slab in one register
+CPU_TARGET_AVX2 static inline void IntersectSlabsAVX2(const uint8_t* _pQuantMin, const uint8_t* _pQuantMax, float _fOrigin, int8_t _iExponent,
+  float _fRayOrigin, float _fInvDir, __m128& vEntry_, __m128& vExit_)
+{
+  __m256 vScale = _mm256_castsi256_ps(_mm256_set1_epi32((_iExponent + 127) << 23));
+  __m256 vBounds = _mm256_add_ps(_mm256_set1_ps(_fOrigin), _mm256_mul_ps(LoadQuantizedPair(_pQuantMin, _pQuantMax), vScale));
+  __m256 vT = _mm256_mul_ps(_mm256_sub_ps(vBounds, _mm256_set1_ps(_fRayOrigin)), _mm256_set1_ps(_fInvDir));
+  __m128 vT0 = _mm256_castps256_ps128(vT);
+  __m128 vT1 = _mm256_extractf128_ps(vT, 1);
+  vEntry_ = _mm_max_ps(vEntry_, _mm_min_ps(vT0, vT1));
+  vExit_ = _mm_min_ps(vExit_, _mm_max_ps(vT0, vT1));
+}
+
+CPU_TARGET_AVX2 static inline int IntersectChildrenAVX2(const WideBVHNode& _oNode, const ray& _oRay, const vec3& _vInvDir, float _fTMax, float* aEntryT_)
+{
+  __m128 vEntry = _mm_setzero_ps();
+  __m128 vExit = _mm_set1_ps(_fTMax);
+
+  IntersectSlabsAVX2(_oNode.aQuantMinX, _oNode.aQuantMaxX, _oNode.aOrigin[0], _oNode.aExponent[0], _oRay.vOrigin.x(), _vInvDir.x(), vEntry, vExit);
+  IntersectSlabsAVX2(_oNode.aQuantMinY, _oNode.aQuantMaxY, _oNode.aOrigin[1], _oNode.aExponent[1], _oRay.vOrigin.y(), _vInvDir.y(), vEntry, vExit);
+  IntersectSlabsAVX2(_oNode.aQuantMinZ, _oNode.aQuantMaxZ, _oNode.aOrigin[2], _oNode.aExponent[2], _oRay.vOrigin.z(), _vInvDir.z(), vEntry, vExit);
+
+  _mm_storeu_ps(aEntryT_, vEntry);
+  return _mm_movemask_ps(_mm_cmple_ps(vEntry, vExit)) & _oNode.uValidMask;
+}
+
+#endif
+
+// Returns a bit mask of the children hit before _fTMax, with their entry distances in aEntryT_
+template <CpuIsa eIsa>
+static inline int IntersectChildren(const WideBVHNode& _oNode, const ray& _oRay, const vec3& _vInvDir, float _fTMax, float* aEntryT_)
+{
+#if WIDE_BVH_AVX
+  if constexpr (eIsa != CpuIsa_SSE2)
+  {
+    return IntersectChildrenAVX2(_oNode, _oRay, _vInvDir, _fTMax, aEntryT_);
+  }
+#endif
+#if WIDE_BVH_SSE
+  __m128 vEntry = _mm_setzero_ps();
+  __m128 vExit = _mm_set1_ps(_fTMax);
+
+  IntersectSlabs(_oNode.aQuantMinX, _oNode.aQuantMaxX, _oNode.aOrigin[0], _oNode.aExponent[0], _mm_set1_ps(_oRay.vOrigin.x()), _mm_set1_ps(_vInvDir.x()), vEntry, vExit);
+  IntersectSlabs(_oNode.aQuantMinY, _oNode.aQuantMaxY, _oNode.aOrigin[1], _oNode.aExponent[1], _mm_set1_ps(_oRay.vOrigin.y()), _mm_set1_ps(_vInvDir.y()), vEntry, vExit);
+  IntersectSlabs(_oNode.aQuantMinZ, _oNode.aQuantMaxZ, _oNode.aOrigin[2], _oNode.aExponent[2], _mm_set1_ps(_oRay.vOrigin.z()), _mm_set1_ps(_vInvDir.z()), vEntry, vExit);
+
+  _mm_storeu_ps(aEntryT_, vEntry);
+  return _mm_movemask_ps(_mm_cmple_ps(vEntry, vExit)) & _oNode.uValidMask;
+#else
+  const uint8_t* aQuantMin[3] = { _oNode.aQuantMinX, _oNode.aQuantMinY, _oNode.aQuantMinZ };
+  const uint8_t* aQuantMax[3] = { _oNode.aQuantMaxX, _oNode.aQuantMaxY, _oNode.aQuantMaxZ };
+
+  int iMask = 0;
+  for (int i = 0; i < iWIDE_BVH_WIDTH; i++)
+  {
+    float fEntry = 0.f;
+    float fExit = _fTMax;
+    for (int iAxis = 0; iAxis < 3; iAxis++)
+    {
+      float fScale = ExponentToScale(_oNode.aExponent[iAxis]);
+      float fT0 = (_oNode.aOrigin[iAxis] + aQuantMin[iAxis][i] * fScale - _oRay.vOrigin[iAxis]) * _vInvDir[iAxis];
+      float fT1 = (_oNode.aOrigin[iAxis] + aQuantMax[iAxis][i] * fScale - _oRay.vOrigin[iAxis]) * _vInvDir[iAxis];
+      fEntry = std::max(fEntry, std::min(fT0, fT1));
+      fExit = std::min(fExit, std::max(fT0, fT1));
+    }
+    aEntryT_[i] = fEntry;
+    iMask |= (fEntry <= fExit) ? (1 << i) : 0;
+  }
+  return iMask & _oNode.uValidMask;
+#endif
+}
+
+template <CpuIsa eIsa>
+static inline int IntersectWideBVHKernel(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_)
+{
+  int iHittableIdx = -1;
+  float fClosestT = FLT_MAX;
+
+  RenderCounters& oCounters = t_oRenderCounters;
+  oCounters.uRays++;
+
+  auto fnTestHittable = [&](uint32_t uIdx)
+  {
+    oCounters.uPrimTests++;
+    HitInfo oCandidateHitInfo = {};
+    if (HitHittable(_oRay, _vHittables[uIdx], oCandidateHitInfo) && oCandidateHitInfo.fT < fClosestT)
+    {
+      fClosestT = oCandidateHitInfo.fT;
+      oHitInfo_ = oCandidateHitInfo;
+      iHittableIdx = static_cast<int>(uIdx);
+    }
+  };
+
+  for (uint32_t uIdx : _oWideBVH.vUnbounded)
+  {
+    fnTestHittable(uIdx);
+  }
+
+  if (_oWideBVH.vNodes.empty())
+    return iHittableIdx;
+
+  vec3 vInvDir = vec3(1.0f / _oRay.vDir.x(), 1.0f / _oRay.vDir.y(), 1.0f / _oRay.vDir.z());
+
+  struct StackEntry
+  {
+    uint32_t uNode;
+    float fEntryT;
+  };
+
+  StackEntry aStack[iTRAVERSAL_STACK_SIZE];
+  int iStackSize = 0;
+  aStack[iStackSize++] = { 0u, 0.f };
+
+  while (iStackSize > 0)
+  {
+    StackEntry oEntry = aStack[--iStackSize];
+    if (oEntry.fEntryT > fClosestT)
+      continue;
+
+    const WideBVHNode& oNode = _oWideBVH.vNodes[oEntry.uNode];
+    oCounters.uNodeVisits++;
+
+    float aEntryT[iWIDE_BVH_WIDTH];
+    int iHitMask = IntersectChildren<eIsa>(oNode, _oRay, vInvDir, fClosestT, aEntryT);
+
+    int iLeafMask = iHitMask & ~oNode.uInnerMask;
+    while (iLeafMask != 0)
+    {
+      int iChild = std::countr_zero(static_cast<unsigned int>(iLeafMask));
+      iLeafMask &= iLeafMask - 1;
+      for (uint32_t i = 0; i < oNode.aPrimCount[iChild]; i++)
+      {
+        fnTestHittable(_oWideBVH.vPrimIndices[oNode.aChild[iChild] + i]);
+      }
+    }
+
+    // Push inner children far to near, so the nearest one is traversed next
+    int aInner[iWIDE_BVH_WIDTH];
+    int iInnerCount = 0;
+    int iInnerMask = iHitMask & oNode.uInnerMask;
+    while (iInnerMask != 0)
+    {
+      int iChild = std::countr_zero(static_cast<unsigned int>(iInnerMask));
+      iInnerMask &= iInnerMask - 1;
+
+      int iPos = iInnerCount++;
+      while (iPos > 0 && aEntryT[aInner[iPos - 1]] < aEntryT[iChild])
+      {
+        aInner[iPos] = aInner[iPos - 1];
+        iPos--;
+      }
+      aInner[iPos] = iChild;
+    }
+
+    for (int i = 0; i < iInnerCount; i++)
+    {
+      aStack[iStackSize++] = { oNode.aChild[aInner[i]], aEntryT[aInner[i]] };
+    }
+  }
+
+  return iHittableIdx;
+}
+
+template <CpuIsa eIsa>
+static inline bool OccludedWideBVHKernel(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, float _fMaxT)
+{
+  RenderCounters& oCounters = t_oRenderCounters;
+  oCounters.uRays++;
+  oCounters.uShadowRays++;
+
+  // Planes first, in closed rooms they are the usual blockers
+  for (uint32_t uIdx : _oWideBVH.vUnbounded)
+  {
+    oCounters.uPrimTests++;
+    if (OccludeHittable(_oRay, _vHittables[uIdx], _fMaxT))
+      return true;
+  }
+
+  if (_oWideBVH.vNodes.empty())
+    return false;
+
+  vec3 vInvDir = vec3(1.0f / _oRay.vDir.x(), 1.0f / _oRay.vDir.y(), 1.0f / _oRay.vDir.z());
+
+  uint32_t aStack[iTRAVERSAL_STACK_SIZE];
+  int iStackSize = 0;
+  aStack[iStackSize++] = 0u;
+
+  while (iStackSize > 0)
+  {
+    const WideBVHNode& oNode = _oWideBVH.vNodes[aStack[--iStackSize]];
+    oCounters.uNodeVisits++;
+
+    float aEntryT[iWIDE_BVH_WIDTH];
+    int iHitMask = IntersectChildren<eIsa>(oNode, _oRay, vInvDir, _fMaxT, aEntryT);
+
+    int iLeafMask = iHitMask & ~oNode.uInnerMask;
+    while (iLeafMask != 0)
+    {
+      int iChild = std::countr_zero(static_cast<unsigned int>(iLeafMask));
+      iLeafMask &= iLeafMask - 1;
+      for (uint32_t i = 0; i < oNode.aPrimCount[iChild]; i++)
+      {
+        oCounters.uPrimTests++;
+        if (OccludeHittable(_oRay, _vHittables[_oWideBVH.vPrimIndices[oNode.aChild[iChild] + i]], _fMaxT))
+          return true;
+      }
+    }
+
+    // Any blocker will do, so inner children are pushed in slot order
+    int iInnerMask = iHitMask & oNode.uInnerMask;
+    while (iInnerMask != 0)
+    {
+      int iChild = std::countr_zero(static_cast<unsigned int>(iInnerMask));
+      iInnerMask &= iInnerMask - 1;
+      aStack[iStackSize++] = oNode.aChild[iChild];
+    }
+  }
+
+  return false;
+}
+
+#if WIDE_BVH_AVX
+
+// A node only has four children, so the AVX-512 path measured no faster than AVX2 and both use these
+CPU_TARGET_AVX2 CPU_FLATTEN static int IntersectWideBVHAVX2(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_)
+{
+  return IntersectWideBVHKernel<CpuIsa_AVX2>(_oWideBVH, _vHittables, _oRay, oHitInfo_);
+}
+
+CPU_TARGET_AVX2 CPU_FLATTEN static bool OccludedWideBVHAVX2(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, float _fMaxT)
+{
+  return OccludedWideBVHKernel<CpuIsa_AVX2>(_oWideBVH, _vHittables, _oRay, _fMaxT);
+}
+
+#endif
+
+int IntersectWideBVH(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_)
+{
+#if WIDE_BVH_AVX
+  if (g_eCpuIsa >= CpuIsa_AVX2)
+    return IntersectWideBVHAVX2(_oWideBVH, _vHittables, _oRay, oHitInfo_);
+#endif
+  return IntersectWideBVHKernel<CpuIsa_SSE2>(_oWideBVH, _vHittables, _oRay, oHitInfo_);
+}
+
+bool OccludedWideBVH(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, float _fMaxT)
+{
+#if WIDE_BVH_AVX
+  if (g_eCpuIsa >= CpuIsa_AVX2)
+    return OccludedWideBVHAVX2(_oWideBVH, _vHittables, _oRay, _fMaxT);
+#endif
+  return OccludedWideBVHKernel<CpuIsa_SSE2>(_oWideBVH, _vHittables, _oRay, _fMaxT);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "BVH.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+static constexpr int iWIDE_BVH_WIDTH = 4;
+
+// One cache line per node. Child boxes are stored as 8 bit offsets from aOrigin in steps of
+// 2^aExponent per axis, rounded outwards so the quantized boxes always contain the real ones.
+struct alignas(64) WideBVHNode
+{
+  float aOrigin[3];
+  int8_t aExponent[3];
+  uint8_t uInnerMask;                    // Bit i is set when child i is an inner node
+  uint32_t aChild[iWIDE_BVH_WIDTH];      // Inner: node index. Leaf: first entry in WideBVH::vPrimIndices
+  uint8_t aPrimCount[iWIDE_BVH_WIDTH];   // Leaf primitive count, 0 for inner children
+  uint8_t aQuantMinX[iWIDE_BVH_WIDTH];
+  uint8_t aQuantMinY[iWIDE_BVH_WIDTH];
+  uint8_t aQuantMinZ[iWIDE_BVH_WIDTH];
+  uint8_t aQuantMaxX[iWIDE_BVH_WIDTH];
+  uint8_t aQuantMaxY[iWIDE_BVH_WIDTH];
+  uint8_t aQuantMaxZ[iWIDE_BVH_WIDTH];
+  uint8_t uValidMask;                    // Bit i is set when slot i holds a child
+  uint8_t aPadding[3];
+};
+
+static_assert(sizeof(WideBVHNode) == 64, "WideBVHNode is expected to fill a cache line");
+
+struct WideBVH
+{
+  std::vector<WideBVHNode> vNodes;
+  std::vector<uint32_t> vPrimIndices;
+  std::vector<uint32_t> vUnbounded;
+};
+
+// Collapses a binary BVH into a 4-wide one. The binary BVH can be released afterwards.
+void BuildWideBVH(const BVH& _oBVH, WideBVH& oWideBVH_);
+
+size_t GetWideBVHMemoryUsage(const WideBVH& _oWideBVH);
+
+// Closest hit query, tests the four children of a node at once. Returns the index of the hit hittable, or -1.
+int IntersectWideBVH(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, HitInfo& oHitInfo_);
+
+// Any hit query for shadow and visibility rays. Returns true as soon as any hittable is hit before _fMaxT,
+// without ordering children or computing normals.
+bool OccludedWideBVH(const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const ray& _oRay, float _fMaxT);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "FastMath.h"
+
 #include <cmath>
 #include <iostream>
 
@@ -143,5 +145,9 @@ inline vec3 Cross(const vec3& u, const vec3& v)
 
 inline vec3 Normalize(const vec3& v)
 {
+  if (IsFastMath())
+  {
+    return v * FastRsqrt(v.LengthSqr());
+  }
   return v / v.Length();
 }
\ No newline at end of file
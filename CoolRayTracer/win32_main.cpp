@@ -6,6 +6,11 @@
 #include <cmath>
 
 #include "CoolRayTracer.h"
+#include "TileOrder.h"
+#include "PerfCounters.h"
+
+#include <stdio.h>
+#include <vector>
 
 static bool g_bRunning = true;
 
@@ -35,6 +40,10 @@ static bool g_bSoundStarted = false;
 
 GameInput g_oGameInput = {};
 
+static TileSettings g_oTileSettings = {};
+static std::vector<ScreenTile> g_vTiles;
+static volatile LONG g_lNextTile = 0;
+
 // XInput
 
 typedef DWORD WINAPI XInputGetState_t(_In_ DWORD dwUserIndex, _Out_ XINPUT_STATE* pState);
@@ -292,6 +301,8 @@ void Win32ResizeDIBSection(int _iWidth, int _iHeight)
   oGameBuffer.iWidth = g_oBackBuffer.iWidth;
   oGameBuffer.iHeight = g_oBackBuffer.iHeight;
 
+  ResizeGameBuffers(_iWidth, _iHeight);
+
   //UpdateGameBackBuffer(&oGameBuffer, g_oGameInput);
 }
 
@@ -420,35 +431,48 @@ LRESULT WndProc(
     //bool bPress = bIsDown && !bWasDown;
     bool bRelease = !bIsDown && bWasDown;
 
+    // Bit 31 is the transition state, 0 while the key goes or stays down
+    float fKeyValue = (_lParam & (1u << 31)) == 0 ? 1.f : 0.f;
+
     if (uVKCode == 'W')
     {
+      g_oGameInput.fMoveForward = fKeyValue;
     }
     if (uVKCode == 'A')
     {
+      g_oGameInput.fMoveRight = -fKeyValue;
     }
     if (uVKCode == 'S')
     {
+      g_oGameInput.fMoveForward = -fKeyValue;
     }
     if (uVKCode == 'D')
     {
+      g_oGameInput.fMoveRight = fKeyValue;
     }
     if (uVKCode == 'Q')
     {
+      g_oGameInput.fMoveUp = -fKeyValue;
     }
     if (uVKCode == 'E')
     {
+      g_oGameInput.fMoveUp = fKeyValue;
     }
     if (uVKCode == VK_UP)
     {
+      g_oGameInput.fTurnUp = fKeyValue;
     }
     if (uVKCode == VK_DOWN)
     {
+      g_oGameInput.fTurnUp = -fKeyValue;
     }
     if (uVKCode == VK_RIGHT)
     {
+      g_oGameInput.fTurnRight = fKeyValue;
     }
-    if (uVKCode == VK_UP)
+    if (uVKCode == VK_LEFT)
     {
+      g_oGameInput.fTurnRight = -fKeyValue;
     }
     if (uVKCode == VK_ESCAPE)
     {
@@ -478,28 +502,21 @@ struct vec2
 
 DWORD WINAPI MyThreadFunction(LPVOID /*lpParam*/)
 {
-  //int iIdx = *((int*)lpParam);
-
   GameScreenBuffer oGameBuffer = {};
   oGameBuffer.pData = g_oBackBuffer.pData;
   oGameBuffer.iWidth = g_oBackBuffer.iWidth;
   oGameBuffer.iHeight = g_oBackBuffer.iHeight;
 
-  /*int iTileX = iIdx % 3;
-  int iTileY = iIdx / 3;
-
-  int iTileWidth = oGameBuffer.iWidth / 3;
-  int iTileHeight = oGameBuffer.iHeight / 3;
-
-  int iStartX = iTileX * iTileWidth;
-  int iStartY = iTileY * iTileHeight;
-
-  int iEndX = iTileX >= 2 ? oGameBuffer.iWidth : iStartX + iTileWidth;
-  int iEndY = iTileY >= 2 ? oGameBuffer.iHeight : iStartY + iTileHeight;
-
-  UpdateScreenBufferPartial(&oGameBuffer, iStartX, iStartY, iEndX, iEndY);*/
+  // Threads pull tiles in curve order, so the tiles in flight at any time are close together on screen
+  while (true)
+  {
+    LONG lTileIdx = InterlockedIncrement(&g_lNextTile) - 1;
+    if (lTileIdx >= static_cast<LONG>(g_vTiles.size()))
+      break;
 
-  UpdateScreenBufferPartial(&oGameBuffer, 0, 0, oGameBuffer.iWidth, oGameBuffer.iHeight);
+    const ScreenTile& oTile = g_vTiles[lTileIdx];
+    UpdateScreenBufferPartial(&oGameBuffer, oTile.iStartX, oTile.iStartY, oTile.iEndX, oTile.iEndY);
+  }
 
   return 0;
 }
@@ -572,20 +589,27 @@ int WINAPI WinMain(
   oGameBuffer.iWidth = g_oBackBuffer.iWidth;
   oGameBuffer.iHeight = g_oBackBuffer.iHeight;
 
-  constexpr int THREAD_COUNT = 1;
+  SYSTEM_INFO oSystemInfo = {};
+  GetSystemInfo(&oSystemInfo);
 
-  HANDLE  hThreadArray[THREAD_COUNT];
-  int  iThreadIdxArray[THREAD_COUNT];
+  const DWORD THREAD_COUNT = min(oSystemInfo.dwNumberOfProcessors, static_cast<DWORD>(MAXIMUM_WAIT_OBJECTS));
+
+  std::vector<HANDLE> hThreadArray(THREAD_COUNT);
+
+  BuildTileList(oGameBuffer.iWidth, oGameBuffer.iHeight, g_oTileSettings, static_cast<int>(THREAD_COUNT), g_vTiles);
+  g_lNextTile = 0;
+
+  ResetRenderCounters();
+  StartHardwareCounters();
 
   LARGE_INTEGER ilDrawStartTime;
   QueryPerformanceCounter(&ilDrawStartTime);
 
-  for (int i = 0; i < THREAD_COUNT; i++)
+  for (DWORD i = 0; i < THREAD_COUNT; i++)
   {
-    iThreadIdxArray[i] = i;
     hThreadArray[i] = CreateThread(0, 0,
       MyThreadFunction,
-      iThreadIdxArray + i,
+      0,
       0, 0);
   }      
 
@@ -606,19 +630,19 @@ int WINAPI WinMain(
       TranslateMessage(&msg);
       DispatchMessage(&msg);
     }
-    DWORD ulWaitResult = WaitForMultipleObjects(THREAD_COUNT, hThreadArray, TRUE, 0);
+    DWORD ulWaitResult = WaitForMultipleObjects(THREAD_COUNT, hThreadArray.data(), TRUE, 0);
 
-    if (ulWaitResult == WAIT_TIMEOUT || ulWaitResult == WAIT_FAILED)
-    {
-      HandleGamepadInput();
+    LARGE_INTEGER ilFrameTime;
+    QueryPerformanceCounter(&ilFrameTime);
+    g_oGameInput.fDeltaTime = static_cast<float>(ilFrameTime.QuadPart - ilBeginTime.QuadPart) / ilPerfFrequency.QuadPart;
+    ilBeginTime = ilFrameTime;
 
-      /*GameScreenBuffer oGameBuffer = {};
-      oGameBuffer.pData = g_oBackBuffer.pData;
-      oGameBuffer.iWidth = g_oBackBuffer.iWidth;
-      oGameBuffer.iHeight = g_oBackBuffer.iHeight;
+    HandleGamepadInput();
 
-      UpdateGameBackBuffer(&oGameBuffer, g_oGameInput);*/
+    UpdateGameBackBuffer(&oGameBuffer, g_oGameInput);
 
+    if (ulWaitResult == WAIT_TIMEOUT || ulWaitResult == WAIT_FAILED || !bProcessRunning)
+    {
       UpdateSoundBuffer();
 
       HDC hDeviceCtx = GetDC(hWnd);
@@ -668,11 +692,34 @@ int WINAPI WinMain(
       wsprintf(aBuffer, "Draw Time: %ld\n", static_cast<long long>(ilDrawElapsedTime));
       OutputDebugStringA(aBuffer);      
 
-      SaveBitmap("output.bmp", g_oBackBuffer.pData, g_oBackBuffer.iWidth, g_oBackBuffer.iHeight);
+      RenderCounters oRenderCounters = GetRenderCounters();
+      snprintf(aBuffer, sizeof(aBuffer), "Rays: %llu Shadow Rays: %llu Nodes/Ray: %.2f Prims/Ray: %.2f\n",
+        static_cast<unsigned long long>(oRenderCounters.uRays),
+        static_cast<unsigned long long>(oRenderCounters.uShadowRays),
+        static_cast<double>(oRenderCounters.uNodeVisits) / max(oRenderCounters.uRays, 1ull),
+        static_cast<double>(oRenderCounters.uPrimTests) / max(oRenderCounters.uRays, 1ull));
+      OutputDebugStringA(aBuffer);
+
+      HardwareCounters oHardwareCounters = StopHardwareCounters();
+      if (oHardwareCounters.bAvailable)
+      {
+        snprintf(aBuffer, sizeof(aBuffer), "L1D Read Misses: %llu LLC References: %llu LLC Misses: %llu\n",
+          static_cast<unsigned long long>(oHardwareCounters.uL1DReadMisses),
+          static_cast<unsigned long long>(oHardwareCounters.uLLCReferences),
+          static_cast<unsigned long long>(oHardwareCounters.uLLCMisses));
+        OutputDebugStringA(aBuffer);
+      }
+
+      if (ResolveScreenBuffer(&oGameBuffer))
+      {
+        SaveBitmap("output.bmp", g_oBackBuffer.pData, g_oBackBuffer.iWidth, g_oBackBuffer.iHeight);
+      }
     }
   }  
 
-  for (int i = 0; i < THREAD_COUNT; i++)
+  ShutdownGame();
+
+  for (DWORD i = 0; i < THREAD_COUNT; i++)
   {
     CloseHandle(hThreadArray[i]);
   }
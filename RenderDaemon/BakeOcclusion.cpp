@@ -0,0 +1,290 @@
+// Bakes ambient occlusion and bent normals for surface points of a scene through the bulk ray queries, for lightmap
+// and asset pipelines, and reports the ray throughput.
+//
+// Points file, one point per line, '#' starts a comment:
+//   <x> <y> <z> <normal x> <normal y> <normal z>
+// Without one, --count points are spread uniformly over the scene's spheres. The output has one line per point:
+//   <visibility> <bent normal x> <bent normal y> <bent normal z>
+
+#include "Parallel.h"
+#include "RayQuery.h"
+#include "Sampler.h"
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BakeToolSettings
+{
+  const char* sScenePath = nullptr;
+  const char* sPointsPath = nullptr;
+  const char* sOutputPath = nullptr;
+  int iPointCount = 100000;
+  size_t uTextureCacheBytes = 64u * 1024u * 1024u;
+  OcclusionBakeSettings oBake;
+};
+
+struct PointList
+{
+  std::vector<float> vPositionX;
+  std::vector<float> vPositionY;
+  std::vector<float> vPositionZ;
+  std::vector<float> vNormalX;
+  std::vector<float> vNormalY;
+  std::vector<float> vNormalZ;
+};
+
+static bool ReadFile(const char* _sPath, std::vector<char>& vData_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+    return false;
+
+  char aBuffer[65536];
+  size_t uRead;
+  vData_.clear();
+  while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0)
+  {
+    vData_.insert(vData_.end(), aBuffer, aBuffer + uRead);
+  }
+  fclose(pFile);
+  return true;
+}
+
+static void PrintUsage()
+{
+  fprintf(stderr,
+    "Usage: BakeOcclusion <scene> [--points <file> | --count <n>] [--rays <n>] [--distance <d>] [--seed <n>]\n"
+    "                     [--threads <n>] [--output <file>]\n");
+}
+
+static bool ParseArguments(int _iArgCount, char** _aArgs, BakeToolSettings& oSettings_)
+{
+  if (_iArgCount < 2)
+    return false;
+
+  oSettings_.sScenePath = _aArgs[1];
+  oSettings_.oBake.iThreadCount = GetDefaultThreadCount();
+
+  for (int i = 2; i < _iArgCount; i++)
+  {
+    int iValuesLeft = _iArgCount - i - 1;
+    if (strcmp(_aArgs[i], "--points") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.sPointsPath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--count") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.iPointCount = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--rays") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oBake.iRayCount = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--distance") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oBake.fMaxDistance = static_cast<float>(atof(_aArgs[++i]));
+    }
+    else if (strcmp(_aArgs[i], "--seed") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oBake.uSeed = static_cast<uint32_t>(strtoul(_aArgs[++i], nullptr, 10));
+    }
+    else if (strcmp(_aArgs[i], "--threads") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oBake.iThreadCount = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--output") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.sOutputPath = _aArgs[++i];
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return oSettings_.iPointCount > 0 && oSettings_.oBake.iRayCount > 0 && oSettings_.oBake.fMaxDistance > 0.f &&
+    oSettings_.oBake.iThreadCount > 0;
+}
+
+static void AddPoint(const vec3& _vPosition, const vec3& _vNormal, PointList& oPoints_)
+{
+  oPoints_.vPositionX.push_back(_vPosition.x());
+  oPoints_.vPositionY.push_back(_vPosition.y());
+  oPoints_.vPositionZ.push_back(_vPosition.z());
+  oPoints_.vNormalX.push_back(_vNormal.x());
+  oPoints_.vNormalY.push_back(_vNormal.y());
+  oPoints_.vNormalZ.push_back(_vNormal.z());
+}
+
+static bool ReadPoints(const char* _sPath, PointList& oPoints_)
+{
+  FILE* pFile = fopen(_sPath, "r");
+  if (!pFile)
+  {
+    fprintf(stderr, "Could not read %s\n", _sPath);
+    return false;
+  }
+
+  char aLine[1024];
+  int iLine = 0;
+  bool bOk = true;
+  while (fgets(aLine, sizeof(aLine), pFile))
+  {
+    iLine++;
+    char* pComment = strchr(aLine, '#');
+    if (pComment)
+    {
+      *pComment = '\0';
+    }
+
+    float aValues[6];
+    int iFields = sscanf(aLine, "%f %f %f %f %f %f", &aValues[0], &aValues[1], &aValues[2], &aValues[3], &aValues[4], &aValues[5]);
+    if (iFields <= 0)
+      continue;
+
+    vec3 vNormal(aValues[3], aValues[4], aValues[5]);
+    if (iFields < 6 || vNormal.LengthSqr() == 0.f)
+    {
+      fprintf(stderr, "%s:%d: expected <x> <y> <z> <normal x> <normal y> <normal z>\n", _sPath, iLine);
+      bOk = false;
+      break;
+    }
+    AddPoint(vec3(aValues[0], aValues[1], aValues[2]), Normalize(vNormal), oPoints_);
+  }
+  fclose(pFile);
+  return bOk && !oPoints_.vPositionX.empty();
+}
+
+// Uniform over the total area of the spheres, planes are infinite and left out
+static bool SpreadPointsOverSpheres(const Scene& _oScene, int _iCount, PointList& oPoints_)
+{
+  std::vector<uint32_t> vSpheres;
+  std::vector<float> vAreaCdf;
+  float fTotalArea = 0.f;
+  for (uint32_t i = 0; i < _oScene.vHittables.size(); i++)
+  {
+    if (_oScene.vHittables[i].eType == HittableType_Sphere)
+    {
+      float fRadius = _oScene.vHittables[i].oSphere.fRadius;
+      fTotalArea += fRadius * fRadius;
+      vSpheres.push_back(i);
+      vAreaCdf.push_back(fTotalArea);
+    }
+  }
+  if (vSpheres.empty())
+  {
+    fprintf(stderr, "The scene has no spheres to spread points over, pass --points\n");
+    return false;
+  }
+
+  t_uSamplerState = MixSamplerBits(0x5eedull);
+  for (int i = 0; i < _iCount; i++)
+  {
+    float fPick = SampleRandom() * fTotalArea;
+    size_t uSphere = static_cast<size_t>(std::lower_bound(vAreaCdf.begin(), vAreaCdf.end(), fPick) - vAreaCdf.begin());
+    const Sphere& oSphere = _oScene.vHittables[vSpheres[uSphere < vSpheres.size() ? uSphere : vSpheres.size() - 1]].oSphere;
+
+    float fZ = 1.f - 2.f * SampleRandom();
+    float fRadiusXY = sqrtf(fmaxf(0.f, 1.f - fZ * fZ));
+    float fPhi = 6.28318531f * SampleRandom();
+    vec3 vNormal(fRadiusXY * cosf(fPhi), fRadiusXY * sinf(fPhi), fZ);
+    AddPoint(oSphere.vCenter + vNormal * oSphere.fRadius, vNormal, oPoints_);
+  }
+  return true;
+}
+
+static bool WriteBake(const char* _sPath, const std::vector<float>& _vVisibility, const std::vector<float>& _vBentX,
+  const std::vector<float>& _vBentY, const std::vector<float>& _vBentZ)
+{
+  FILE* pOutput = fopen(_sPath, "w");
+  if (!pOutput)
+    return false;
+
+  bool bOk = true;
+  for (size_t i = 0; i < _vVisibility.size() && bOk; i++)
+  {
+    bOk = fprintf(pOutput, "%.6f %.6f %.6f %.6f\n", _vVisibility[i], _vBentX[i], _vBentY[i], _vBentZ[i]) > 0;
+  }
+  return fclose(pOutput) == 0 && bOk;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  BakeToolSettings oSettings;
+  if (!ParseArguments(_iArgCount, _aArgs, oSettings))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  std::shared_ptr<TextureCache> pTextures = std::make_shared<TextureCache>();
+  InitTextureCache(oSettings.uTextureCacheBytes, *pTextures);
+
+  std::vector<char> vSceneData;
+  if (!ReadFile(oSettings.sScenePath, vSceneData))
+  {
+    fprintf(stderr, "Could not read %s\n", oSettings.sScenePath);
+    return 1;
+  }
+  Scene oScene;
+  std::string sError;
+  if (!ParseScene(vSceneData.data(), vSceneData.size(), pTextures, nullptr, oScene, sError))
+  {
+    fprintf(stderr, "Rejected scene %s: %s\n", oSettings.sScenePath, sError.c_str());
+    return 1;
+  }
+  BuildSceneBVH(BVHBuildSettings{}, oScene);
+
+  PointList oPointList;
+  bool bPointsOk = oSettings.sPointsPath ? ReadPoints(oSettings.sPointsPath, oPointList) :
+    SpreadPointsOverSpheres(oScene, oSettings.iPointCount, oPointList);
+  if (!bPointsOk)
+    return 1;
+
+  SurfacePointArrays oPoints;
+  oPoints.pPositionX = oPointList.vPositionX.data();
+  oPoints.pPositionY = oPointList.vPositionY.data();
+  oPoints.pPositionZ = oPointList.vPositionZ.data();
+  oPoints.pNormalX = oPointList.vNormalX.data();
+  oPoints.pNormalY = oPointList.vNormalY.data();
+  oPoints.pNormalZ = oPointList.vNormalZ.data();
+  oPoints.iCount = static_cast<int>(oPointList.vPositionX.size());
+
+  std::vector<float> vVisibility(oPoints.iCount);
+  std::vector<float> vBentX(oPoints.iCount);
+  std::vector<float> vBentY(oPoints.iCount);
+  std::vector<float> vBentZ(oPoints.iCount);
+  OcclusionBakeArrays oBake;
+  oBake.pVisibility = vVisibility.data();
+  oBake.pBentNormalX = vBentX.data();
+  oBake.pBentNormalY = vBentY.data();
+  oBake.pBentNormalZ = vBentZ.data();
+
+  std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+  BakeOcclusion(oScene, oPoints, oSettings.oBake, oBake);
+  double dBakeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+
+  double dRayCount = static_cast<double>(oPoints.iCount) * oSettings.oBake.iRayCount;
+  double dMeanVisibility = 0.0;
+  for (float fVisibility : vVisibility)
+  {
+    dMeanVisibility += fVisibility;
+  }
+  printf("Baked %d points with %d rays each in %.1f ms on %d threads, %.2f Mrays/s, mean visibility %.4f\n", oPoints.iCount,
+    oSettings.oBake.iRayCount, dBakeMs, oSettings.oBake.iThreadCount, dRayCount / (dBakeMs * 1000.0), dMeanVisibility / oPoints.iCount);
+
+  bool bOk = !oSettings.sOutputPath || WriteBake(oSettings.sOutputPath, vVisibility, vBentX, vBentY, vBentZ);
+  if (!bOk)
+  {
+    fprintf(stderr, "Could not write %s\n", oSettings.sOutputPath);
+  }
+  ReleaseTextureCache(*pTextures);
+  return bOk ? 0 : 1;
+}
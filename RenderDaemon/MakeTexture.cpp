@@ -0,0 +1,87 @@
+// Converts a binary PPM (P6, 8 bit) into the tiled, mipmapped .ctex format the texture cache streams from.
+
+#include "TextureCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Skips whitespace and '#' comments between PPM header fields
+static bool ReadPPMField(FILE* _pFile, int& iValue_)
+{
+  int c = fgetc(_pFile);
+  while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#')
+  {
+    if (c == '#')
+    {
+      while (c != '\n' && c != EOF)
+      {
+        c = fgetc(_pFile);
+      }
+    }
+    c = fgetc(_pFile);
+  }
+  ungetc(c, _pFile);
+  return fscanf(_pFile, "%d", &iValue_) == 1;
+}
+
+static bool ReadPPM(const char* _sPath, int& iWidth_, int& iHeight_, std::vector<uint8_t>& vRGBA_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+    return false;
+
+  char aMagic[3] = {};
+  int iMaxValue = 0;
+  bool bOk = fread(aMagic, 1, 2, pFile) == 2 && strcmp(aMagic, "P6") == 0
+    && ReadPPMField(pFile, iWidth_) && ReadPPMField(pFile, iHeight_) && ReadPPMField(pFile, iMaxValue)
+    && iWidth_ > 0 && iHeight_ > 0 && iMaxValue == 255 && fgetc(pFile) != EOF;
+
+  std::vector<uint8_t> vRGB;
+  if (bOk)
+  {
+    vRGB.resize(static_cast<size_t>(iWidth_) * iHeight_ * 3);
+    bOk = fread(vRGB.data(), 1, vRGB.size(), pFile) == vRGB.size();
+  }
+  fclose(pFile);
+
+  if (bOk)
+  {
+    vRGBA_.resize(static_cast<size_t>(iWidth_) * iHeight_ * 4);
+    for (size_t i = 0; i < static_cast<size_t>(iWidth_) * iHeight_; i++)
+    {
+      vRGBA_[i * 4 + 0] = vRGB[i * 3 + 0];
+      vRGBA_[i * 4 + 1] = vRGB[i * 3 + 1];
+      vRGBA_[i * 4 + 2] = vRGB[i * 3 + 2];
+      vRGBA_[i * 4 + 3] = 255;
+    }
+  }
+  return bOk;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  if (_iArgCount != 3)
+  {
+    fprintf(stderr, "Usage: MakeTexture <input.ppm> <output.ctex>\n");
+    return 1;
+  }
+
+  int iWidth, iHeight;
+  std::vector<uint8_t> vRGBA;
+  if (!ReadPPM(_aArgs[1], iWidth, iHeight, vRGBA))
+  {
+    fprintf(stderr, "Could not read %s as an 8 bit binary PPM\n", _aArgs[1]);
+    return 1;
+  }
+
+  std::string sError;
+  if (!WriteTiledTexture(_aArgs[2], iWidth, iHeight, vRGBA, sError))
+  {
+    fprintf(stderr, "Could not write %s: %s\n", _aArgs[2], sError.c_str());
+    return 1;
+  }
+
+  printf("Wrote %dx%d texture to %s\n", iWidth, iHeight, _aArgs[2]);
+  return 0;
+}
@@ -0,0 +1,220 @@
+// Renders many views of one scene in one run, for product shots. The scene is loaded and its BVH built once and
+// the tiles of the views in flight share one queue, each view is written to its own BMP and freed as it finishes.
+//
+// Views file, one view per line, '#' starts a comment, angles in radians:
+//   <output.bmp> <width> <height> <x> <y> <z> <yaw> <pitch> [<vertical fov>]
+
+#include "ImageEncode.h"
+#include "RenderJob.h"
+#include "SceneFile.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BatchSettings
+{
+  const char* sScenePath = nullptr;
+  const char* sViewsPath = nullptr;
+  int iThreadCount = 0;
+  size_t uTextureCacheBytes = 512u * 1024u * 1024u;
+  int iViewsInFlight = 4; // Views rendering at once, each holds its buffers until it is written. 1 renders them one after the other.
+  RenderSettings oRender;
+};
+
+static void PrintUsage()
+{
+  fprintf(stderr,
+    "Usage: RenderBatch <scene> <views> [--spp <n>] [--bounces <n>] [--threads <n>] [--no-denoise]\n"
+    "                   [--buffer-format f32|f16|rgbe] [--in-flight <views>] [--sequential]\n");
+}
+
+static bool ParseArguments(int _iArgCount, char** _aArgs, BatchSettings& oSettings_)
+{
+  if (_iArgCount < 3)
+    return false;
+
+  oSettings_.sScenePath = _aArgs[1];
+  oSettings_.sViewsPath = _aArgs[2];
+
+  for (int i = 3; i < _iArgCount; i++)
+  {
+    int iValuesLeft = _iArgCount - i - 1;
+    if (strcmp(_aArgs[i], "--spp") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oRender.iSamplesPerPixel = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--bounces") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oRender.iMaxBounces = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--threads") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.iThreadCount = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--no-denoise") == 0)
+    {
+      oSettings_.oRender.bDenoise = false;
+    }
+    else if (strcmp(_aArgs[i], "--buffer-format") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseBufferFormat(_aArgs[++i], oSettings_.oRender.eBufferFormat))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--in-flight") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.iViewsInFlight = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--sequential") == 0)
+    {
+      oSettings_.iViewsInFlight = 1;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return oSettings_.oRender.iSamplesPerPixel > 0 && oSettings_.oRender.iMaxBounces >= 0 && oSettings_.iThreadCount >= 0
+    && oSettings_.iViewsInFlight > 0;
+}
+
+static bool ReadViews(const char* _sPath, std::vector<RenderView>& vViews_, std::vector<std::string>& vOutputs_)
+{
+  FILE* pFile = fopen(_sPath, "r");
+  if (!pFile)
+  {
+    fprintf(stderr, "Could not read %s\n", _sPath);
+    return false;
+  }
+
+  char aLine[1024];
+  int iLine = 0;
+  bool bOk = true;
+  while (bOk && fgets(aLine, sizeof(aLine), pFile))
+  {
+    iLine++;
+    char* pComment = strchr(aLine, '#');
+    if (pComment)
+    {
+      *pComment = '\0';
+    }
+
+    char aOutput[512];
+    RenderView oView;
+    float aPosition[3];
+    int iFields = sscanf(aLine, "%511s %d %d %f %f %f %f %f %f", aOutput, &oView.iWidth, &oView.iHeight, &aPosition[0],
+      &aPosition[1], &aPosition[2], &oView.oCamera.fYaw, &oView.oCamera.fPitch, &oView.oCamera.fVerticalFOV);
+    if (iFields <= 0)
+      continue;
+
+    if (iFields < 8 || oView.iWidth <= 0 || oView.iHeight <= 0 || oView.oCamera.fVerticalFOV <= 0.f)
+    {
+      fprintf(stderr, "%s:%d: expected <output.bmp> <width> <height> <x> <y> <z> <yaw> <pitch> [<vertical fov>]\n", _sPath, iLine);
+      bOk = false;
+      break;
+    }
+    oView.oCamera.vPosition = vec3(aPosition[0], aPosition[1], aPosition[2]);
+    vViews_.push_back(oView);
+    vOutputs_.push_back(aOutput);
+  }
+  fclose(pFile);
+  return bOk && !vViews_.empty();
+}
+
+static bool WriteView(const char* _sPath, const RenderJob& _oJob)
+{
+  std::vector<uint8_t> vImage;
+  EncodeBMP(_oJob.vResolved, _oJob.oSettings.iWidth, _oJob.oSettings.iHeight, vImage);
+  FILE* pOutput = fopen(_sPath, "wb");
+  bool bOk = pOutput && fwrite(vImage.data(), 1, vImage.size(), pOutput) == vImage.size();
+  if (pOutput)
+  {
+    fclose(pOutput);
+  }
+  return bOk;
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point _oStart)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _oStart).count();
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  BatchSettings oSettings;
+  if (!ParseArguments(_iArgCount, _aArgs, oSettings))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  std::vector<RenderView> vViews;
+  std::vector<std::string> vOutputs;
+  if (!ReadViews(oSettings.sViewsPath, vViews, vOutputs))
+    return 1;
+
+  std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+
+  std::shared_ptr<TextureCache> pTextures = std::make_shared<TextureCache>();
+  InitTextureCache(oSettings.uTextureCacheBytes, *pTextures);
+
+  std::shared_ptr<Scene> pScene = std::make_shared<Scene>();
+  uint64_t uSceneHash;
+  std::string sError;
+  if (!LoadSceneFile(oSettings.sScenePath, pTextures, nullptr, *pScene, uSceneHash, sError))
+  {
+    fprintf(stderr, "Could not load scene %s: %s\n", oSettings.sScenePath, sError.c_str());
+    return 1;
+  }
+  double dSetupMs = MillisecondsSince(oStart);
+
+  ThreadPool oPool;
+  StartThreadPool(oSettings.iThreadCount, oPool);
+
+  // Resolves run on a pool thread each, the tiles of the other views keep the remaining threads busy
+  oSettings.oRender.oDenoiseSettings.iThreadCount = 1;
+
+  std::chrono::steady_clock::time_point oRenderStart = std::chrono::steady_clock::now();
+  std::vector<std::unique_ptr<RenderJob>> vJobs(vViews.size());
+  size_t uViewsInFlight = static_cast<size_t>(oSettings.iViewsInFlight);
+  for (size_t i = 0; i < vViews.size() && i < uViewsInFlight; i++)
+  {
+    vJobs[i] = std::make_unique<RenderJob>();
+    StartRenderView(oPool, pScene, vViews[i], oSettings.oRender, *vJobs[i]);
+  }
+
+  // Views finish in order, each is written and freed while the later ones still render, and makes room for the
+  // next view to start
+  double dSamples = 0.0;
+  bool bOk = true;
+  for (size_t i = 0; i < vJobs.size(); i++)
+  {
+    WaitForRenderJob(*vJobs[i]);
+    dSamples += static_cast<double>(vViews[i].iWidth) * vViews[i].iHeight * oSettings.oRender.iSamplesPerPixel;
+    if (!WriteView(vOutputs[i].c_str(), *vJobs[i]))
+    {
+      fprintf(stderr, "Could not write %s\n", vOutputs[i].c_str());
+      bOk = false;
+    }
+    vJobs[i].reset();
+
+    size_t uNext = i + uViewsInFlight;
+    if (uNext < vJobs.size())
+    {
+      vJobs[uNext] = std::make_unique<RenderJob>();
+      StartRenderView(oPool, pScene, vViews[uNext], oSettings.oRender, *vJobs[uNext]);
+    }
+  }
+  double dRenderMs = MillisecondsSince(oRenderStart);
+  StopThreadPool(oPool);
+
+  printf("Rendered %zu views at %d spp in %.1f ms after %.1f ms of scene setup, %.2f views/s, %.2f Msamples/s\n",
+    vViews.size(), oSettings.oRender.iSamplesPerPixel, dRenderMs, dSetupMs, vViews.size() * 1000.0 / dRenderMs,
+    dSamples / (dRenderMs * 1000.0));
+  ReleaseTextureCache(*pTextures);
+  return bOk ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Sends one render request to a running RenderDaemon and writes the returned BMP, for local testing.
+
+#include "SocketIO.h"
+
+#include "RenderProtocol.h"
+#include "SceneFile.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct ClientSettings
+{
+  const char* sSocketPath = "/tmp/coolraytracer.sock";
+  const char* sScenePath = nullptr;
+  const char* sOutputPath = nullptr;
+  int iRetryCount = 20;
+};
+
+static bool ReadFile(const char* _sPath, std::vector<char>& vData_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+    return false;
+
+  char aBuffer[65536];
+  size_t uRead;
+  vData_.clear();
+  while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0)
+  {
+    vData_.insert(vData_.end(), aBuffer, aBuffer + uRead);
+  }
+  fclose(pFile);
+  return true;
+}
+
+// Returns false if the daemon could not be reached or hung up mid response
+static bool SendRequest(const char* _sSocketPath, const RenderRequestHeader& _oHeader, const std::vector<char>* _pSceneData,
+  RenderResponseHeader& oResponse_, std::vector<uint8_t>& vImage_)
+{
+  sockaddr_un oAddress;
+  if (!MakeSocketAddress(_sSocketPath, oAddress))
+    return false;
+
+  int iSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (iSocket < 0)
+    return false;
+
+  bool bOk = connect(iSocket, reinterpret_cast<sockaddr*>(&oAddress), sizeof(oAddress)) == 0
+    && SendAll(iSocket, &_oHeader, sizeof(_oHeader))
+    && (!_pSceneData || SendAll(iSocket, _pSceneData->data(), _pSceneData->size()))
+    && RecvAll(iSocket, &oResponse_, sizeof(oResponse_))
+    && oResponse_.uMagic == g_uRenderProtocolMagic;
+
+  if (bOk)
+  {
+    vImage_.resize(oResponse_.uImageSize);
+    bOk = RecvAll(iSocket, vImage_.data(), vImage_.size());
+  }
+
+  close(iSocket);
+  return bOk;
+}
+
+static void PrintUsage()
+{
+  fprintf(stderr,
+    "Usage: RenderClient <scene> <output.bmp> [--socket <path>] [--size <w> <h>] [--spp <n>] [--bounces <n>]\n"
+    "                    [--priority high|normal|low] [--no-denoise] [--camera <x> <y> <z> <yaw> <pitch>]\n");
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  if (_iArgCount < 3)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  ClientSettings oSettings;
+  oSettings.sScenePath = _aArgs[1];
+  oSettings.sOutputPath = _aArgs[2];
+
+  RenderRequestHeader oHeader = {};
+  oHeader.uMagic = g_uRenderProtocolMagic;
+  oHeader.uVersion = g_uRenderProtocolVersion;
+  oHeader.uPriority = RenderPriority_Normal;
+  oHeader.iWidth = 320;
+  oHeader.iHeight = 180;
+  oHeader.iSamplesPerPixel = 8;
+  oHeader.iMaxBounces = 4;
+  oHeader.uDenoise = 1;
+
+  for (int i = 3; i < _iArgCount; i++)
+  {
+    int iValuesLeft = _iArgCount - i - 1;
+    if (strcmp(_aArgs[i], "--socket") == 0 && iValuesLeft >= 1)
+    {
+      oSettings.sSocketPath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--size") == 0 && iValuesLeft >= 2)
+    {
+      oHeader.iWidth = atoi(_aArgs[++i]);
+      oHeader.iHeight = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--spp") == 0 && iValuesLeft >= 1)
+    {
+      oHeader.iSamplesPerPixel = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--bounces") == 0 && iValuesLeft >= 1)
+    {
+      oHeader.iMaxBounces = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--priority") == 0 && iValuesLeft >= 1)
+    {
+      const char* sPriority = _aArgs[++i];
+      oHeader.uPriority = strcmp(sPriority, "high") == 0 ? RenderPriority_High
+        : (strcmp(sPriority, "low") == 0 ? RenderPriority_Low : RenderPriority_Normal);
+    }
+    else if (strcmp(_aArgs[i], "--no-denoise") == 0)
+    {
+      oHeader.uDenoise = 0;
+    }
+    else if (strcmp(_aArgs[i], "--camera") == 0 && iValuesLeft >= 5)
+    {
+      oHeader.aCameraPosition[0] = static_cast<float>(atof(_aArgs[++i]));
+      oHeader.aCameraPosition[1] = static_cast<float>(atof(_aArgs[++i]));
+      oHeader.aCameraPosition[2] = static_cast<float>(atof(_aArgs[++i]));
+      oHeader.fCameraYaw = static_cast<float>(atof(_aArgs[++i]));
+      oHeader.fCameraPitch = static_cast<float>(atof(_aArgs[++i]));
+    }
+    else
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  std::vector<char> vSceneData;
+  if (!ReadFile(oSettings.sScenePath, vSceneData))
+  {
+    fprintf(stderr, "Could not read %s\n", oSettings.sScenePath);
+    return 1;
+  }
+  oHeader.uSceneHash = HashSceneData(vSceneData.data(), vSceneData.size());
+
+  std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+
+  // Try the cached scene first, the bytes are only sent if the daemon does not know the hash
+  bool bSendScene = false;
+  RenderResponseHeader oResponse = {};
+  std::vector<uint8_t> vImage;
+
+  for (int iAttempt = 0; iAttempt <= oSettings.iRetryCount; iAttempt++)
+  {
+    oHeader.uSceneSize = bSendScene ? static_cast<uint32_t>(vSceneData.size()) : 0u;
+    if (!SendRequest(oSettings.sSocketPath, oHeader, bSendScene ? &vSceneData : nullptr, oResponse, vImage))
+    {
+      fprintf(stderr, "Could not reach the daemon at %s\n", oSettings.sSocketPath);
+      return 1;
+    }
+
+    if (oResponse.uStatus == RenderStatus_UnknownScene && !bSendScene)
+    {
+      bSendScene = true;
+      continue;
+    }
+    if (oResponse.uStatus == RenderStatus_Busy)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(oResponse.uRetryAfterMs > 0 ? oResponse.uRetryAfterMs : 50u));
+      continue;
+    }
+    break;
+  }
+
+  if (oResponse.uStatus != RenderStatus_Ok)
+  {
+    fprintf(stderr, "Render failed with status %u\n", oResponse.uStatus);
+    return 1;
+  }
+
+  FILE* pOutput = fopen(oSettings.sOutputPath, "wb");
+  if (!pOutput || fwrite(vImage.data(), 1, vImage.size(), pOutput) != vImage.size())
+  {
+    fprintf(stderr, "Could not write %s\n", oSettings.sOutputPath);
+    return 1;
+  }
+  fclose(pOutput);
+
+  double dTotalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+  printf("Rendered %dx%d at %d spp: render %.1f ms, round trip %.1f ms, scene %s\n",
+    oHeader.iWidth, oHeader.iHeight, oHeader.iSamplesPerPixel, oResponse.fRenderMs, dTotalMs, bSendScene ? "uploaded" : "cached");
+
+  return 0;
+}
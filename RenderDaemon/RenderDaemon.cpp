@@ -0,0 +1,506 @@
+// Long running render server. Keeps scenes and their BVH cached across requests so small renders only pay for
+// tracing, and schedules requests by priority on one shared thread pool.
+
+#include "SocketIO.h"
+
+#include "Camera.h"
+#include "CpuDispatch.h"
+#include "ImageEncode.h"
+#include "PerfCounters.h"
+#include "RenderJob.h"
+#include "RenderProtocol.h"
+#include "Renderer.h"
+#include "SceneCache.h"
+#include "SceneFile.h"
+#include "ThreadPool.h"
+#include "TileStream.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <limits.h>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct DaemonSettings
+{
+  const char* sSocketPath = "/tmp/coolraytracer.sock";
+  int iThreadCount = 0;        // Render threads, 0 uses every hardware thread
+  int iConcurrentJobs = 2;     // Requests rendered at once, their tiles interleave on the pool
+  int iMaxQueuedRequests = 32; // Beyond this new requests are answered with RenderStatus_Busy
+  int iMaxConnections = 64;    // Connections still sending their request
+  size_t uCacheBytes = 256u * 1024u * 1024u;
+  size_t uTextureCacheBytes = 512u * 1024u * 1024u;
+  const char* sAssetRoot = ".";  // Textures and environments named by scenes are looked up below it
+  const char* sCpuIsa = nullptr; // Kernel instruction set, nullptr picks the best one the CPU supports
+  bool bNuma = false;            // Pins the render threads per NUMA node and gives each node its own scene copy
+  bool bHugePages = false;       // Transparent huge pages for the scene copies, only with bNuma
+  BufferFormat eBufferFormat = BufferFormat_Float32; // Of the feature buffers of every job, packed ones fit more jobs in memory
+};
+
+struct PendingRequest
+{
+  int iSocket = -1;
+  RenderRequestHeader oHeader = {};
+  std::vector<char> vSceneData;
+};
+
+struct RenderDaemon
+{
+  DaemonSettings oSettings;
+  ThreadPool oPool;
+  SceneCache oCache;
+
+  std::mutex oMutex;
+  std::condition_variable oCondition;
+  std::deque<PendingRequest> aQueues[RenderPriority_Count];
+  int iQueuedRequests = 0;
+  bool bStop = false;
+
+  std::atomic<int> iOpenConnections = 0;
+  std::atomic<uint64_t> uServedRequests = 0;
+  std::atomic<uint64_t> uRejectedRequests = 0;
+  std::atomic<float> fAverageRenderMs = 100.f; // Running average, sizes the retry delay of rejected clients
+};
+
+static volatile sig_atomic_t g_bStopRequested = 0;
+
+static void HandleStopSignal(int)
+{
+  g_bStopRequested = 1;
+}
+
+static void SendResponse(int _iSocket, RenderStatus _eStatus, const std::vector<uint8_t>* _pImage, uint32_t _uRetryAfterMs, uint32_t _uQueueDepth, float _fRenderMs)
+{
+  RenderResponseHeader oResponse = {};
+  oResponse.uMagic = g_uRenderProtocolMagic;
+  oResponse.uStatus = _eStatus;
+  oResponse.uImageSize = _pImage ? static_cast<uint32_t>(_pImage->size()) : 0u;
+  oResponse.uRetryAfterMs = _uRetryAfterMs;
+  oResponse.uQueueDepth = _uQueueDepth;
+  oResponse.fRenderMs = _fRenderMs;
+
+  if (SendAll(_iSocket, &oResponse, sizeof(oResponse)) && _pImage)
+  {
+    SendAll(_iSocket, _pImage->data(), _pImage->size());
+  }
+  close(_iSocket);
+}
+
+static bool IsValidRequest(const RenderRequestHeader& _oHeader)
+{
+  return _oHeader.uMagic == g_uRenderProtocolMagic
+    && _oHeader.uVersion == g_uRenderProtocolVersion
+    && _oHeader.uSceneSize <= g_uMaxSceneBytes
+    && _oHeader.uPriority < RenderPriority_Count
+    && _oHeader.iWidth > 0 && _oHeader.iWidth <= g_iMaxImageDimension
+    && _oHeader.iHeight > 0 && _oHeader.iHeight <= g_iMaxImageDimension
+    && _oHeader.iSamplesPerPixel > 0 && _oHeader.iSamplesPerPixel <= 4096
+    && _oHeader.iMaxBounces >= 0 && _oHeader.iMaxBounces <= 64;
+}
+
+// Reads one request and queues it, or answers right away when it is malformed or the queue is full
+static void ReadRequest(RenderDaemon* pDaemon, int _iSocket)
+{
+  RenderDaemon& oDaemon = *pDaemon;
+
+  // A stalled client must not pin a connection slot forever
+  timeval oTimeout = {};
+  oTimeout.tv_sec = 5;
+  setsockopt(_iSocket, SOL_SOCKET, SO_RCVTIMEO, &oTimeout, sizeof(oTimeout));
+
+  PendingRequest oRequest = {};
+  oRequest.iSocket = _iSocket;
+
+  bool bValid = RecvAll(_iSocket, &oRequest.oHeader, sizeof(oRequest.oHeader)) && IsValidRequest(oRequest.oHeader);
+  if (bValid && oRequest.oHeader.uSceneSize > 0)
+  {
+    oRequest.vSceneData.resize(oRequest.oHeader.uSceneSize);
+    bValid = RecvAll(_iSocket, oRequest.vSceneData.data(), oRequest.vSceneData.size());
+  }
+
+  if (!bValid)
+  {
+    SendResponse(_iSocket, RenderStatus_BadRequest, nullptr, 0, 0, 0.f);
+    oDaemon.iOpenConnections--;
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> oLock(oDaemon.oMutex);
+    if (oDaemon.iQueuedRequests >= oDaemon.oSettings.iMaxQueuedRequests)
+    {
+      uint32_t uQueueDepth = static_cast<uint32_t>(oDaemon.iQueuedRequests);
+      oLock.unlock();
+
+      // Roughly when the queue will have drained enough to take the request
+      float fRetryAfterMs = oDaemon.fAverageRenderMs.load() * uQueueDepth / oDaemon.oSettings.iConcurrentJobs;
+
+      oDaemon.uRejectedRequests++;
+      SendResponse(_iSocket, RenderStatus_Busy, nullptr, static_cast<uint32_t>(fRetryAfterMs), uQueueDepth, 0.f);
+    }
+    else
+    {
+      oDaemon.aQueues[oRequest.oHeader.uPriority].push_back(std::move(oRequest));
+      oDaemon.iQueuedRequests++;
+      oDaemon.oCondition.notify_one();
+    }
+  }
+
+  oDaemon.iOpenConnections--;
+}
+
+static void ServeRequest(RenderDaemon& oDaemon_, PendingRequest& oRequest_, uint32_t _uQueueDepth)
+{
+  const RenderRequestHeader& oHeader = oRequest_.oHeader;
+
+  std::shared_ptr<const Scene> pScene;
+  if (oRequest_.vSceneData.empty())
+  {
+    pScene = FindCachedScene(oDaemon_.oCache, oHeader.uSceneHash);
+    if (!pScene)
+    {
+      SendResponse(oRequest_.iSocket, RenderStatus_UnknownScene, nullptr, 0, _uQueueDepth, 0.f);
+      return;
+    }
+  }
+  else
+  {
+    std::string sError;
+    uint64_t uHash = HashSceneData(oRequest_.vSceneData.data(), oRequest_.vSceneData.size());
+    pScene = AcquireCachedScene(oDaemon_.oCache, uHash, oRequest_.vSceneData.data(), oRequest_.vSceneData.size(), sError);
+    if (!pScene)
+    {
+      fprintf(stderr, "Rejected scene: %s\n", sError.c_str());
+      SendResponse(oRequest_.iSocket, RenderStatus_BadScene, nullptr, 0, _uQueueDepth, 0.f);
+      return;
+    }
+  }
+
+  Camera oCamera = {};
+  oCamera.vPosition = vec3(oHeader.aCameraPosition[0], oHeader.aCameraPosition[1], oHeader.aCameraPosition[2]);
+  oCamera.fYaw = oHeader.fCameraYaw;
+  oCamera.fPitch = oHeader.fCameraPitch;
+  if (oHeader.fCameraVerticalFOV > 0.f)
+  {
+    oCamera.fVerticalFOV = oHeader.fCameraVerticalFOV;
+  }
+
+  RenderSettings oSettings = {};
+  oSettings.iWidth = oHeader.iWidth;
+  oSettings.iHeight = oHeader.iHeight;
+  oSettings.iSamplesPerPixel = oHeader.iSamplesPerPixel;
+  oSettings.iMaxBounces = oHeader.iMaxBounces;
+  oSettings.bDenoise = oHeader.uDenoise != 0;
+  oSettings.eBufferFormat = oDaemon_.oSettings.eBufferFormat;
+  oSettings.oDenoiseSettings.iThreadCount = 1; // The other tiles of the pool keep the remaining threads busy
+
+  RenderJob oJob;
+  std::vector<uint8_t> vImage;
+  if (oSettings.bDenoise)
+  {
+    StartRenderJob(oDaemon_.oPool, std::move(pScene), oCamera, oSettings, oJob);
+    WaitForRenderJob(oJob);
+    EncodeBMP(oJob.vResolved, oSettings.iWidth, oSettings.iHeight, vImage);
+  }
+  else
+  {
+    // Tiles are final as they finish, encoding them meanwhile takes the encode off the end of the job
+    GameScreenBuffer oPixels;
+    StartBMP(oSettings.iWidth, oSettings.iHeight, vImage, oPixels);
+    TileStream oTiles = StreamRenderJob(oDaemon_.oPool, std::move(pScene), oCamera, oSettings, oJob);
+    while (const RenderedTile* pTile = WaitForNextTile(oTiles))
+    {
+      const ScreenTile& oRegion = pTile->oRegion;
+      const color* pColor = pTile->vColors.data();
+      for (int y = oRegion.iStartY; y < oRegion.iEndY; y++)
+      {
+        for (int x = oRegion.iStartX; x < oRegion.iEndX; x++)
+        {
+          StorePixel(&oPixels, x, y, *pColor++);
+        }
+      }
+    }
+    WaitForRenderJob(oJob);
+  }
+  SendResponse(oRequest_.iSocket, RenderStatus_Ok, &vImage, 0, _uQueueDepth, static_cast<float>(oJob.dRenderMs));
+
+  oDaemon_.uServedRequests++;
+  // Dispatchers finish jobs concurrently, so the average is updated with a compare exchange loop
+  float fAverageMs = oDaemon_.fAverageRenderMs.load();
+  while (!oDaemon_.fAverageRenderMs.compare_exchange_weak(fAverageMs, 0.8f * fAverageMs + 0.2f * static_cast<float>(oJob.dRenderMs)))
+  {
+  }
+}
+
+static void DispatchRequests(RenderDaemon* pDaemon)
+{
+  RenderDaemon& oDaemon = *pDaemon;
+
+  while (true)
+  {
+    PendingRequest oRequest;
+    uint32_t uQueueDepth;
+    {
+      std::unique_lock<std::mutex> oLock(oDaemon.oMutex);
+      oDaemon.oCondition.wait(oLock, [&oDaemon]() { return oDaemon.bStop || oDaemon.iQueuedRequests > 0; });
+
+      if (oDaemon.iQueuedRequests == 0)
+        break;
+
+      // Strict priority, FIFO within a priority level
+      for (std::deque<PendingRequest>& oQueue : oDaemon.aQueues)
+      {
+        if (!oQueue.empty())
+        {
+          oRequest = std::move(oQueue.front());
+          oQueue.pop_front();
+          break;
+        }
+      }
+      uQueueDepth = static_cast<uint32_t>(--oDaemon.iQueuedRequests);
+    }
+
+    ServeRequest(oDaemon, oRequest, uQueueDepth);
+  }
+}
+
+static void PrintUsage()
+{
+  fprintf(stderr,
+    "Usage: RenderDaemon [--socket <path>] [--threads <n>] [--jobs <n>] [--queue <n>] [--cache-mb <n>] [--texture-mb <n>]\n"
+    "                    [--assets <dir>] [--isa sse2|avx2|avx512] [--numa] [--huge-pages] [--buffer-format f32|f16|rgbe]\n");
+}
+
+// Whole number in [1, _lMax], anything else is rejected rather than wrapped into a huge size
+static bool ParsePositive(const char* _sValue, long _lMax, long& lValue_)
+{
+  char* pEnd = nullptr;
+  errno = 0;
+  long lValue = strtol(_sValue, &pEnd, 10);
+  if (pEnd == _sValue || *pEnd != '\0' || errno == ERANGE || lValue <= 0 || lValue > _lMax)
+    return false;
+
+  lValue_ = lValue;
+  return true;
+}
+
+static bool ParseArguments(int _iArgCount, char** _aArgs, DaemonSettings& oSettings_)
+{
+  constexpr long lMAX_CACHE_MB = 1l << 24;
+
+  long lValue = 0;
+  for (int i = 1; i < _iArgCount; i++)
+  {
+    bool bHasValue = i + 1 < _iArgCount;
+    if (strcmp(_aArgs[i], "--socket") == 0 && bHasValue)
+    {
+      oSettings_.sSocketPath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--threads") == 0 && bHasValue)
+    {
+      if (!ParsePositive(_aArgs[++i], INT_MAX, lValue))
+        return false;
+      oSettings_.iThreadCount = static_cast<int>(lValue);
+    }
+    else if (strcmp(_aArgs[i], "--jobs") == 0 && bHasValue)
+    {
+      if (!ParsePositive(_aArgs[++i], INT_MAX, lValue))
+        return false;
+      oSettings_.iConcurrentJobs = static_cast<int>(lValue);
+    }
+    else if (strcmp(_aArgs[i], "--queue") == 0 && bHasValue)
+    {
+      if (!ParsePositive(_aArgs[++i], INT_MAX, lValue))
+        return false;
+      oSettings_.iMaxQueuedRequests = static_cast<int>(lValue);
+    }
+    else if (strcmp(_aArgs[i], "--cache-mb") == 0 && bHasValue)
+    {
+      if (!ParsePositive(_aArgs[++i], lMAX_CACHE_MB, lValue))
+        return false;
+      oSettings_.uCacheBytes = static_cast<size_t>(lValue) * 1024u * 1024u;
+    }
+    else if (strcmp(_aArgs[i], "--texture-mb") == 0 && bHasValue)
+    {
+      if (!ParsePositive(_aArgs[++i], lMAX_CACHE_MB, lValue))
+        return false;
+      oSettings_.uTextureCacheBytes = static_cast<size_t>(lValue) * 1024u * 1024u;
+    }
+    else if (strcmp(_aArgs[i], "--assets") == 0 && bHasValue)
+    {
+      oSettings_.sAssetRoot = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--isa") == 0 && bHasValue)
+    {
+      oSettings_.sCpuIsa = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--numa") == 0)
+    {
+      oSettings_.bNuma = true;
+    }
+    else if (strcmp(_aArgs[i], "--huge-pages") == 0)
+    {
+      oSettings_.bHugePages = true;
+    }
+    else if (strcmp(_aArgs[i], "--buffer-format") == 0 && bHasValue)
+    {
+      if (!ParseBufferFormat(_aArgs[++i], oSettings_.eBufferFormat))
+        return false;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return oSettings_.iConcurrentJobs > 0 && oSettings_.iMaxQueuedRequests > 0;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  RenderDaemon oDaemon;
+  if (!ParseArguments(_iArgCount, _aArgs, oDaemon.oSettings))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  if (oDaemon.oSettings.sCpuIsa)
+  {
+    CpuIsa eIsa;
+    if (!ParseCpuIsa(oDaemon.oSettings.sCpuIsa, eIsa))
+    {
+      PrintUsage();
+      return 1;
+    }
+    if (!SelectCpuIsa(eIsa))
+    {
+      fprintf(stderr, "This CPU cannot run the %s kernels\n", GetCpuIsaName(eIsa));
+      return 1;
+    }
+  }
+
+  sockaddr_un oAddress;
+  if (!MakeSocketAddress(oDaemon.oSettings.sSocketPath, oAddress))
+  {
+    fprintf(stderr, "Socket path too long\n");
+    return 1;
+  }
+
+  int iListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(oDaemon.oSettings.sSocketPath);
+  if (iListenSocket < 0
+    || bind(iListenSocket, reinterpret_cast<sockaddr*>(&oAddress), sizeof(oAddress)) != 0
+    || listen(iListenSocket, 128) != 0)
+  {
+    perror("RenderDaemon");
+    return 1;
+  }
+
+  signal(SIGINT, HandleStopSignal);
+  signal(SIGTERM, HandleStopSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  oDaemon.oCache.uBudgetBytes = oDaemon.oSettings.uCacheBytes;
+  oDaemon.oCache.pTextures = std::make_shared<TextureCache>();
+  oDaemon.oCache.sAssetRoot = oDaemon.oSettings.sAssetRoot;
+  InitTextureCache(oDaemon.oSettings.uTextureCacheBytes, *oDaemon.oCache.pTextures);
+  NumaTopology oTopology;
+  if (oDaemon.oSettings.bNuma && DetectNumaTopology(oTopology))
+  {
+    StartNumaThreadPool(oDaemon.oSettings.iThreadCount, oTopology, oDaemon.oPool);
+    oDaemon.oCache.pReplicationPool = &oDaemon.oPool;
+    oDaemon.oCache.bHugePages = oDaemon.oSettings.bHugePages;
+  }
+  else
+  {
+    if (oDaemon.oSettings.bNuma)
+    {
+      fprintf(stderr, "No NUMA topology found, running as a single node\n");
+    }
+    StartThreadPool(oDaemon.oSettings.iThreadCount, oDaemon.oPool);
+  }
+
+  std::vector<std::thread> vDispatchers;
+  for (int i = 0; i < oDaemon.oSettings.iConcurrentJobs; i++)
+  {
+    vDispatchers.emplace_back(DispatchRequests, &oDaemon);
+  }
+
+  printf("Listening on %s with %d render threads on %d nodes, %s kernels\n", oDaemon.oSettings.sSocketPath, GetThreadPoolSize(oDaemon.oPool),
+    GetThreadPoolNodeCount(oDaemon.oPool), GetCpuIsaName(g_eCpuIsa));
+  fflush(stdout);
+
+  while (!g_bStopRequested)
+  {
+    pollfd oPoll = {};
+    oPoll.fd = iListenSocket;
+    oPoll.events = POLLIN;
+    if (poll(&oPoll, 1, 200) <= 0)
+      continue;
+
+    int iSocket = accept(iListenSocket, nullptr, nullptr);
+    if (iSocket < 0)
+      continue;
+
+    if (oDaemon.iOpenConnections >= oDaemon.oSettings.iMaxConnections)
+    {
+      oDaemon.uRejectedRequests++;
+      SendResponse(iSocket, RenderStatus_Busy, nullptr, 100u, 0u, 0.f);
+      continue;
+    }
+
+    oDaemon.iOpenConnections++;
+    std::thread(ReadRequest, &oDaemon, iSocket).detach();
+  }
+
+  close(iListenSocket);
+  unlink(oDaemon.oSettings.sSocketPath);
+
+  // Readers still in flight only touch the queues, wait for them before draining
+  while (oDaemon.iOpenConnections > 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  {
+    std::lock_guard<std::mutex> oLock(oDaemon.oMutex);
+    oDaemon.bStop = true;
+  }
+  oDaemon.oCondition.notify_all();
+
+  for (std::thread& oThread : vDispatchers)
+  {
+    oThread.join();
+  }
+  StopThreadPool(oDaemon.oPool);
+
+  printf("Served %llu requests, rejected %llu, scene cache hits %llu misses %llu\n",
+    static_cast<unsigned long long>(oDaemon.uServedRequests.load()),
+    static_cast<unsigned long long>(oDaemon.uRejectedRequests.load()),
+    static_cast<unsigned long long>(oDaemon.oCache.uHits),
+    static_cast<unsigned long long>(oDaemon.oCache.uMisses));
+
+  const TextureCache& oTextures = *oDaemon.oCache.pTextures;
+  printf("Texture tiles: %llu thread hits, %llu shared hits, %llu loads, %llu evictions\n",
+    static_cast<unsigned long long>(GetRenderCounters().uTextureMicroHits),
+    static_cast<unsigned long long>(oTextures.uHits.load()),
+    static_cast<unsigned long long>(oTextures.uMisses.load()),
+    static_cast<unsigned long long>(oTextures.uEvictions.load()));
+  ClearSceneCache(oDaemon.oCache);
+  ReleaseTextureCache(*oDaemon.oCache.pTextures);
+
+  return 0;
+}
@@ -0,0 +1,375 @@
+// Renders one scene file to a BMP without the daemon, for long renders. Progress is checkpointed to disk so a
+// killed render can be resumed with --resume and still give the same image as an uninterrupted one.
+// With --edit the edited version of the scene is rendered next, re-tracing only the tiles the edit affects.
+// With --live the image is published to a shared memory segment while it renders, RenderWatch reads it.
+// With --deadline-ms the render takes as many passes as fit in the budget, up to --spp, and is not checkpointed.
+
+#include "Camera.h"
+#include "DeadlineRender.h"
+#include "ImageEncode.h"
+#include "ProgressiveRender.h"
+#include "SceneFile.h"
+
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct OfflineSettings
+{
+  const char* sScenePath = nullptr;
+  const char* sOutputPath = nullptr;
+  const char* sEditedScenePath = nullptr;
+  const char* sLiveName = nullptr;
+  LivePixelFormat eLiveFormat = LivePixelFormat_Bgra8;
+  int iWidth = 1280;
+  int iHeight = 720;
+  int iDeadlineMs = 0; // 0 renders every sample of oRender.iSamplesPerPixel
+  size_t uTextureCacheBytes = 512u * 1024u * 1024u;
+  bool bResume = false;
+  Camera oCamera;
+  ProgressiveSettings oRender;
+};
+
+static bool ReadFile(const char* _sPath, std::vector<char>& vData_)
+{
+  FILE* pFile = fopen(_sPath, "rb");
+  if (!pFile)
+    return false;
+
+  char aBuffer[65536];
+  size_t uRead;
+  vData_.clear();
+  while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0)
+  {
+    vData_.insert(vData_.end(), aBuffer, aBuffer + uRead);
+  }
+  fclose(pFile);
+  return true;
+}
+
+static void PrintUsage()
+{
+  fprintf(stderr,
+    "Usage: RenderOffline <scene> <output.bmp> [--size <w> <h>] [--spp <n>] [--bounces <n>] [--threads <n>] [--no-denoise]\n"
+    "                     [--camera <x> <y> <z> <yaw> <pitch>] [--checkpoint <path>] [--checkpoint-seconds <n>] [--resume]\n"
+    "                     [--edit <edited scene>] [--guide <training passes>] [--guide-cell <size>]\n"
+    "                     [--caustics] [--light-paths <per pass>] [--buffer-format f32|f16|rgbe]\n"
+    "                     [--live <shared memory name>] [--live-format bgra8|float] [--live-seconds <n>]\n"
+    "                     [--deadline-ms <n>]\n");
+}
+
+static bool ParseInteger(const char* _sValue, long _lMin, long _lMax, int& iValue_)
+{
+  char* pEnd = nullptr;
+  errno = 0;
+  long lValue = strtol(_sValue, &pEnd, 10);
+  if (pEnd == _sValue || *pEnd != '\0' || errno == ERANGE || lValue < _lMin || lValue > _lMax)
+    return false;
+
+  iValue_ = static_cast<int>(lValue);
+  return true;
+}
+
+static bool ParseNumber(const char* _sValue, double _dMin, double& dValue_)
+{
+  char* pEnd = nullptr;
+  errno = 0;
+  double dValue = strtod(_sValue, &pEnd);
+  if (pEnd == _sValue || *pEnd != '\0' || errno == ERANGE || !isfinite(dValue) || dValue < _dMin)
+    return false;
+
+  dValue_ = dValue;
+  return true;
+}
+
+static bool ParseNumber(const char* _sValue, double _dMin, float& fValue_)
+{
+  double dValue = 0.0;
+  if (!ParseNumber(_sValue, _dMin, dValue) || fabs(dValue) > FLT_MAX)
+    return false;
+
+  fValue_ = static_cast<float>(dValue);
+  return true;
+}
+
+static bool ParseArguments(int _iArgCount, char** _aArgs, OfflineSettings& oSettings_)
+{
+  constexpr long lMAX_SIZE = 1l << 16;
+
+  if (_iArgCount < 3)
+    return false;
+
+  oSettings_.sScenePath = _aArgs[1];
+  oSettings_.sOutputPath = _aArgs[2];
+
+  for (int i = 3; i < _iArgCount; i++)
+  {
+    int iValuesLeft = _iArgCount - i - 1;
+    if (strcmp(_aArgs[i], "--size") == 0 && iValuesLeft >= 2)
+    {
+      if (!ParseInteger(_aArgs[++i], 1, lMAX_SIZE, oSettings_.iWidth) || !ParseInteger(_aArgs[++i], 1, lMAX_SIZE, oSettings_.iHeight))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--spp") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 1, INT_MAX, oSettings_.oRender.iSamplesPerPixel))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--bounces") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 0, INT_MAX, oSettings_.oRender.iMaxBounces))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--threads") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 1, INT_MAX, oSettings_.oRender.iThreadCount))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--no-denoise") == 0)
+    {
+      oSettings_.oRender.bDenoise = false;
+    }
+    else if (strcmp(_aArgs[i], "--camera") == 0 && iValuesLeft >= 5)
+    {
+      float aValues[5];
+      for (float& fValue : aValues)
+      {
+        if (!ParseNumber(_aArgs[++i], -HUGE_VAL, fValue))
+          return false;
+      }
+      oSettings_.oCamera.vPosition = vec3(aValues[0], aValues[1], aValues[2]);
+      oSettings_.oCamera.fYaw = aValues[3];
+      oSettings_.oCamera.fPitch = aValues[4];
+    }
+    else if (strcmp(_aArgs[i], "--checkpoint") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.oRender.sCheckpointPath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--checkpoint-seconds") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseNumber(_aArgs[++i], 0.0, oSettings_.oRender.dCheckpointIntervalS))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--resume") == 0)
+    {
+      oSettings_.bResume = true;
+    }
+    else if (strcmp(_aArgs[i], "--edit") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.sEditedScenePath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--guide") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 0, INT_MAX, oSettings_.oRender.iGuideTrainingPasses))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--guide-cell") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseNumber(_aArgs[++i], 0.0, oSettings_.oRender.fGuideCellSize))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--caustics") == 0)
+    {
+      oSettings_.oRender.bLightTraceCaustics = true;
+    }
+    else if (strcmp(_aArgs[i], "--light-paths") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 0, INT_MAX, oSettings_.oRender.iLightPathsPerPass))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--buffer-format") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseBufferFormat(_aArgs[++i], oSettings_.oRender.eBufferFormat))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--live") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.sLiveName = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--live-format") == 0 && iValuesLeft >= 1)
+    {
+      const char* sFormat = _aArgs[++i];
+      if (strcmp(sFormat, "bgra8") == 0)
+      {
+        oSettings_.eLiveFormat = LivePixelFormat_Bgra8;
+      }
+      else if (strcmp(sFormat, "float") == 0)
+      {
+        oSettings_.eLiveFormat = LivePixelFormat_RgbFloat32;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    else if (strcmp(_aArgs[i], "--live-seconds") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseNumber(_aArgs[++i], 0.0, oSettings_.oRender.dLiveIntervalS))
+        return false;
+    }
+    else if (strcmp(_aArgs[i], "--deadline-ms") == 0 && iValuesLeft >= 1)
+    {
+      if (!ParseInteger(_aArgs[++i], 1, INT_MAX, oSettings_.iDeadlineMs))
+        return false;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  // A deadline render is one uncheckpointed frame of the plain path tracer
+  const ProgressiveSettings& oRender = oSettings_.oRender;
+  bool bProgressiveOnly = oSettings_.bResume || oSettings_.sEditedScenePath || oSettings_.sLiveName || oRender.sCheckpointPath
+    || oRender.iGuideTrainingPasses > 0 || oRender.bLightTraceCaustics;
+  return (!oSettings_.bResume || oRender.sCheckpointPath) && (oSettings_.iDeadlineMs == 0 || !bProgressiveOnly);
+}
+
+static bool LoadScene(const char* _sPath, const std::shared_ptr<TextureCache>& _pTextures, Scene& oScene_, uint64_t& uHash_)
+{
+  std::vector<char> vSceneData;
+  if (!ReadFile(_sPath, vSceneData))
+  {
+    fprintf(stderr, "Could not read %s\n", _sPath);
+    return false;
+  }
+
+  std::string sError;
+  if (!ParseScene(vSceneData.data(), vSceneData.size(), _pTextures, nullptr, oScene_, sError))
+  {
+    fprintf(stderr, "Rejected scene %s: %s\n", _sPath, sError.c_str());
+    return false;
+  }
+  BuildSceneBVH(BVHBuildSettings{}, oScene_);
+  BuildSceneLights(oScene_);
+  uHash_ = HashSceneData(vSceneData.data(), vSceneData.size());
+  return true;
+}
+
+static void RenderDeadlineFrame(const Scene& _oScene, const OfflineSettings& _oSettings, std::vector<color>& vResolved_)
+{
+  const ProgressiveSettings& oRender = _oSettings.oRender;
+  DeadlineSettings oDeadlineSettings;
+  oDeadlineSettings.iThreadCount = oRender.iThreadCount;
+  oDeadlineSettings.iMaxBounces = oRender.iMaxBounces;
+  oDeadlineSettings.iMaxSamplesPerPixel = oRender.iSamplesPerPixel;
+  oDeadlineSettings.bDenoise = oRender.bDenoise;
+  oDeadlineSettings.eBufferFormat = oRender.eBufferFormat;
+  oDeadlineSettings.oDenoiseSettings = oRender.oDenoiseSettings;
+  oDeadlineSettings.oTileSettings = oRender.oTileSettings;
+
+  AccumulationBuffers oAccum;
+  RenderBuffers oBuffers;
+  std::chrono::steady_clock::time_point oDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_oSettings.iDeadlineMs);
+  DeadlineReport oReport = RenderWithDeadline(_oScene, _oSettings.oCamera, _oSettings.iWidth, _oSettings.iHeight, oDeadlineSettings,
+    oDeadline, oAccum, oBuffers, vResolved_);
+  printf("Rendered %dx%d in %.1f of %d ms, %d passes, %u to %u spp (%.2f mean), %s\n", _oSettings.iWidth, _oSettings.iHeight,
+    oReport.dTotalMs, _oSettings.iDeadlineMs, oReport.iCompletedPasses, oReport.uMinSamplesPerPixel, oReport.uMaxSamplesPerPixel,
+    oReport.dMeanSamplesPerPixel, oReport.bMissedDeadline ? "MISSED the deadline" : "met the deadline");
+}
+
+static bool WriteImage(const OfflineSettings& _oSettings, const std::vector<color>& _vResolved)
+{
+  std::vector<uint8_t> vImage;
+  EncodeBMP(_vResolved, _oSettings.iWidth, _oSettings.iHeight, vImage);
+  FILE* pOutput = fopen(_oSettings.sOutputPath, "wb");
+  bool bWritten = pOutput && fwrite(vImage.data(), 1, vImage.size(), pOutput) == vImage.size();
+  if (pOutput && fclose(pOutput) != 0)
+  {
+    bWritten = false;
+  }
+  if (!bWritten)
+  {
+    fprintf(stderr, "Could not write %s\n", _oSettings.sOutputPath);
+  }
+  return bWritten;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  OfflineSettings oSettings;
+  if (!ParseArguments(_iArgCount, _aArgs, oSettings))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  std::shared_ptr<TextureCache> pTextures = std::make_shared<TextureCache>();
+  InitTextureCache(oSettings.uTextureCacheBytes, *pTextures);
+
+  Scene oScene;
+  uint64_t uSceneHash;
+  if (!LoadScene(oSettings.sScenePath, pTextures, oScene, uSceneHash))
+    return 1;
+
+  std::string sError;
+  std::vector<color> vResolved;
+  if (oSettings.iDeadlineMs > 0)
+  {
+    RenderDeadlineFrame(oScene, oSettings, vResolved);
+    bool bWritten = WriteImage(oSettings, vResolved);
+    ReleaseTextureCache(*pTextures);
+    return bWritten ? 0 : 1;
+  }
+
+  LiveFramebuffer oLive;
+  if (oSettings.sLiveName)
+  {
+    if (!CreateLiveFramebuffer(oSettings.sLiveName, oSettings.eLiveFormat, oLive, sError))
+    {
+      fprintf(stderr, "Live framebuffer %s: %s\n", oSettings.sLiveName, sError.c_str());
+      return 1;
+    }
+    oSettings.oRender.pLiveFramebuffer = &oLive;
+  }
+
+  AccumulationBuffers oAccum;
+  TileDependencies oDependencies;
+  RenderBuffers oBuffers;
+  ProgressiveReport oReport;
+  ProgressiveStart eStart = oSettings.bResume ? ProgressiveStart_Checkpoint : ProgressiveStart_Fresh;
+  TileDependencies* pDependencies = oSettings.sEditedScenePath ? &oDependencies : nullptr;
+  if (!RenderProgressive(oScene, oSettings.oCamera, oSettings.iWidth, oSettings.iHeight, uSceneHash, oSettings.oRender,
+    eStart, oAccum, pDependencies, oBuffers, vResolved, oReport, sError))
+  {
+    fprintf(stderr, "Render failed: %s\n", sError.c_str());
+    CloseLiveFramebuffer(oLive);
+    return 1;
+  }
+  printf("Rendered %dx%d at %d spp in %.1f ms, %u spp resumed, %d checkpoints written\n", oSettings.iWidth, oSettings.iHeight,
+    oSettings.oRender.iSamplesPerPixel, oReport.dRenderMs, oReport.uStartSamplesPerPixel, oReport.iCheckpoints);
+  printf("Accumulation buffers: %.1f MB in %s\n", GetAccumulationBufferBytes(oAccum) / (1024.0 * 1024.0),
+    GetBufferFormatName(oAccum.eFormat));
+
+  if (oSettings.sEditedScenePath)
+  {
+    Scene oEdited;
+    if (!LoadScene(oSettings.sEditedScenePath, pTextures, oEdited, uSceneHash))
+    {
+      CloseLiveFramebuffer(oLive);
+      return 1;
+    }
+
+    size_t uInvalidTiles = InvalidateEditedTiles(oScene, oEdited, oSettings.oCamera, oDependencies, oAccum);
+    if (!RenderProgressive(oEdited, oSettings.oCamera, oSettings.iWidth, oSettings.iHeight, uSceneHash, oSettings.oRender,
+      ProgressiveStart_Current, oAccum, &oDependencies, oBuffers, vResolved, oReport, sError))
+    {
+      fprintf(stderr, "Render failed: %s\n", sError.c_str());
+      CloseLiveFramebuffer(oLive);
+      return 1;
+    }
+    printf("Edit re-rendered %zu of %zu tiles in %.1f ms\n", uInvalidTiles, oDependencies.vTiles.size(), oReport.dRenderMs);
+  }
+
+  bool bWritten = WriteImage(oSettings, vResolved);
+  CloseLiveFramebuffer(oLive);
+  ReleaseTextureCache(*pTextures);
+
+  return bWritten ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+// Follows renders published with RenderOffline --live through their shared memory segments, printing their
+// progress until they are done. Reads never block the renders, many of them can be watched at once.
+
+#include "ImageEncode.h"
+#include "LiveFramebuffer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct WatchSettings
+{
+  std::vector<const char*> vNames;
+  const char* sSnapshotPath = nullptr; // Only with a single render
+  int iIntervalMs = 1000;
+  int iOpenRetryCount = 20;
+  bool bOnce = false;
+};
+
+struct WatchedRender
+{
+  const char* sName = nullptr;
+  LiveFramebufferView oView;
+  LiveFramebufferHeader oHeader = {};
+  uint64_t uPrintedUpdate = ~0ull;
+  bool bDone = false;
+  bool bAbandoned = false;
+};
+
+static void PrintUsage()
+{
+  fprintf(stderr, "Usage: RenderWatch <shared memory name>... [--interval-ms <n>] [--snapshot <output.bmp>] [--once]\n");
+}
+
+static bool ParseArguments(int _iArgCount, char** _aArgs, WatchSettings& oSettings_)
+{
+  for (int i = 1; i < _iArgCount; i++)
+  {
+    int iValuesLeft = _iArgCount - i - 1;
+    if (strcmp(_aArgs[i], "--interval-ms") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.iIntervalMs = atoi(_aArgs[++i]);
+    }
+    else if (strcmp(_aArgs[i], "--snapshot") == 0 && iValuesLeft >= 1)
+    {
+      oSettings_.sSnapshotPath = _aArgs[++i];
+    }
+    else if (strcmp(_aArgs[i], "--once") == 0)
+    {
+      oSettings_.bOnce = true;
+    }
+    else if (_aArgs[i][0] == '-' && _aArgs[i][1] == '-')
+    {
+      return false;
+    }
+    else
+    {
+      oSettings_.vNames.push_back(_aArgs[i]);
+    }
+  }
+
+  return !oSettings_.vNames.empty() && oSettings_.iIntervalMs > 0 && (!oSettings_.sSnapshotPath || oSettings_.vNames.size() == 1);
+}
+
+static const char* GetStateName(uint32_t _uState, bool _bAbandoned)
+{
+  if (_bAbandoned)
+    return "abandoned";
+
+  switch (_uState)
+  {
+  case LiveRenderState_Rendering:
+    return "rendering";
+  case LiveRenderState_Done:
+    return "done";
+  default:
+    return "failed";
+  }
+}
+
+// Copies every tile, retrying the ones being written. False if the frame was laid out again meanwhile.
+static bool ReadLiveImage(const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader, std::vector<uint8_t>& vPixels_)
+{
+  constexpr int iTILE_RETRY_COUNT = 100;
+
+  vPixels_.resize(static_cast<size_t>(_oHeader.iWidth) * _oHeader.iHeight * GetLivePixelBytes(static_cast<LivePixelFormat>(_oHeader.uFormat)));
+  for (uint32_t uTileIdx = 0; uTileIdx < _oHeader.uTileCount; uTileIdx++)
+  {
+    int iTry = 0;
+    while (!ReadLiveTile(_oView, _oHeader, uTileIdx, vPixels_.data()))
+    {
+      if (++iTry == iTILE_RETRY_COUNT)
+        return false;
+      std::this_thread::yield();
+    }
+  }
+  return true;
+}
+
+static bool WriteSnapshot(const char* _sPath, const LiveFramebufferView& _oView, const LiveFramebufferHeader& _oHeader)
+{
+  std::vector<uint8_t> vPixels;
+  if (!ReadLiveImage(_oView, _oHeader, vPixels))
+    return false;
+
+  std::vector<uint8_t> vImage;
+  if (_oHeader.uFormat == LivePixelFormat_Bgra8)
+  {
+    EncodeBMP(vPixels.data(), _oHeader.iWidth, _oHeader.iHeight, vImage);
+  }
+  else
+  {
+    std::vector<color> vColors(static_cast<size_t>(_oHeader.iWidth) * _oHeader.iHeight);
+    memcpy(vColors.data(), vPixels.data(), vColors.size() * sizeof(color));
+    EncodeBMP(vColors, _oHeader.iWidth, _oHeader.iHeight, vImage);
+  }
+
+  FILE* pOutput = fopen(_sPath, "wb");
+  bool bOk = pOutput && fwrite(vImage.data(), 1, vImage.size(), pOutput) == vImage.size();
+  if (pOutput)
+  {
+    fclose(pOutput);
+  }
+  return bOk;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  WatchSettings oSettings;
+  if (!ParseArguments(_iArgCount, _aArgs, oSettings))
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  // The renders may still be loading their scenes
+  std::vector<WatchedRender> vRenders(oSettings.vNames.size());
+  for (size_t i = 0; i < vRenders.size(); i++)
+  {
+    vRenders[i].sName = oSettings.vNames[i];
+    std::string sError;
+    int iTry = 0;
+    while (!OpenLiveFramebuffer(vRenders[i].sName, vRenders[i].oView, sError))
+    {
+      if (++iTry == oSettings.iOpenRetryCount)
+      {
+        fprintf(stderr, "Could not open %s: %s\n", vRenders[i].sName, sError.c_str());
+        return 1;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+  }
+
+  size_t uDoneCount = 0;
+  while (uDoneCount < vRenders.size())
+  {
+    for (WatchedRender& oRender : vRenders)
+    {
+      if (oRender.bDone)
+        continue;
+
+      // Checked first, the last header of a render that finished and exited is read as done
+      bool bWriterAlive = IsLiveWriterAlive(oRender.oView);
+      bool bRead = ReadLiveHeader(oRender.oView, oRender.oHeader);
+      const LiveFramebufferHeader& oHeader = oRender.oHeader;
+      oRender.bAbandoned = !bWriterAlive && (!bRead || oHeader.uState == LiveRenderState_Rendering);
+      if (!bRead && !oRender.bAbandoned)
+        continue;
+
+      oRender.bDone = oHeader.uState != LiveRenderState_Rendering || oRender.bAbandoned || oSettings.bOnce;
+      if (oHeader.uUpdateCount == oRender.uPrintedUpdate && !oRender.bDone)
+        continue;
+
+      printf("%s: %dx%d, %u of %u tiles complete, %u of %u spp, %llu updates, %s\n", oRender.sName, oHeader.iWidth,
+        oHeader.iHeight, oHeader.uCompletedTiles, oHeader.uTileCount, oHeader.uSamplesPerPixel, oHeader.uTargetSamplesPerPixel,
+        static_cast<unsigned long long>(oHeader.uUpdateCount), GetStateName(oHeader.uState, oRender.bAbandoned));
+      fflush(stdout);
+      oRender.uPrintedUpdate = oHeader.uUpdateCount;
+
+      if (oRender.bDone)
+      {
+        uDoneCount++;
+        if (oSettings.sSnapshotPath && !oRender.bAbandoned && !WriteSnapshot(oSettings.sSnapshotPath, oRender.oView, oHeader))
+        {
+          fprintf(stderr, "Could not write %s\n", oSettings.sSnapshotPath);
+          return 1;
+        }
+      }
+    }
+
+    if (uDoneCount < vRenders.size())
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(oSettings.iIntervalMs));
+    }
+  }
+
+  for (WatchedRender& oRender : vRenders)
+  {
+    CloseLiveFramebufferView(oRender.oView);
+  }
+  return 0;
+}
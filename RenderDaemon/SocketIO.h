@@ -0,0 +1,53 @@
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+inline bool SendAll(int _iSocket, const void* _pData, size_t _uSize)
+{
+  const char* pCursor = static_cast<const char*>(_pData);
+  while (_uSize > 0)
+  {
+    ssize_t iSent = send(_iSocket, pCursor, _uSize, MSG_NOSIGNAL);
+    if (iSent < 0 && errno == EINTR)
+      continue;
+    if (iSent <= 0)
+      return false;
+
+    pCursor += iSent;
+    _uSize -= static_cast<size_t>(iSent);
+  }
+  return true;
+}
+
+inline bool RecvAll(int _iSocket, void* _pData, size_t _uSize)
+{
+  char* pCursor = static_cast<char*>(_pData);
+  while (_uSize > 0)
+  {
+    ssize_t iReceived = recv(_iSocket, pCursor, _uSize, 0);
+    if (iReceived < 0 && errno == EINTR)
+      continue;
+    if (iReceived <= 0)
+      return false;
+
+    pCursor += iReceived;
+    _uSize -= static_cast<size_t>(iReceived);
+  }
+  return true;
+}
+
+inline bool MakeSocketAddress(const char* _sPath, sockaddr_un& oAddress_)
+{
+  oAddress_ = {};
+  oAddress_.sun_family = AF_UNIX;
+  if (strlen(_sPath) >= sizeof(oAddress_.sun_path))
+    return false;
+
+  strcpy(oAddress_.sun_path, _sPath);
+  return true;
+}
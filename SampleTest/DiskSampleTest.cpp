@@ -1,9 +1,10 @@
 #include "../CoolRayTracer/CoolRayTracer.h"
 
-#include "../CoolRayTracer/Vec3.h"
+#include "../CoolRayTracer/vec3.h"
 #include "../CoolRayTracer/Vec2.h"
 #include "../CoolRayTracer/Ray.h"
 #include "../CoolRayTracer/MathUtils.h"
+#include "../CoolRayTracer/SampleWarp.h"
 
 #include <math.h>
 #include <cmath>
@@ -14,28 +15,63 @@ using color = vec3;
 constexpr int SAMPLE_COUNT = 10000;
 
 vec2 aSamplePoints[SAMPLE_COUNT];
+vec2 aBatchSamplePoints[SAMPLE_COUNT];
+
+// Batch kernel results are drawn green when they match the scalar warp, red otherwise
+bool g_bBatchMatchesScalar = true;
 
 void InitGame()
 {
+  static float aRandom1[SAMPLE_COUNT];
+  static float aRandom2[SAMPLE_COUNT];
+  static float aBatchX[SAMPLE_COUNT];
+  static float aBatchY[SAMPLE_COUNT];
+
   for(int i = 0; i < SAMPLE_COUNT; i++)
   {
-    aSamplePoints[i] = SampleDisk(Random(), Random());
+    aRandom1[i] = Random();
+    aRandom2[i] = Random();
+    aSamplePoints[i] = SampleDisk(aRandom1[i], aRandom2[i]);
+  }
+
+  SampleDiskBatch(aRandom1, aRandom2, SAMPLE_COUNT, aBatchX, aBatchY);
+
+  // Same inputs, so the distributions are equivalent when every pair agrees up to the polynomial sincos error
+  // and the batch lanes are bit identical to the scalar polynomial path
+  for (int i = 0; i < SAMPLE_COUNT; i++)
+  {
+    aBatchSamplePoints[i] = vec2(aBatchX[i], aBatchY[i]);
+
+    vec2 vPolynomial = SampleDiskPolynomial(aRandom1[i], aRandom2[i]);
+    bool bBitExact = vPolynomial.x() == aBatchX[i] && vPolynomial.y() == aBatchY[i];
+    bool bClose = fabsf(aSamplePoints[i].x() - aBatchX[i]) < 1e-6f && fabsf(aSamplePoints[i].y() - aBatchY[i]) < 1e-6f;
+    g_bBatchMatchesScalar = g_bBatchMatchesScalar && bBitExact && bClose;
   }
 }
 
+void ResizeGameBuffers(int /*_iWidth*/, int /*_iHeight*/)
+{
+}
+
 void UpdateScreenBufferPartial(GameScreenBuffer* Buffer, int _iStartX, int _iStartY, int _iEndX, int _iEndY)
 {
   const int iPointPixelHalfSize = 1;
 
-  for (int i = 0; i < SAMPLE_COUNT; i++)
+  for (int i = 0; i < 2 * SAMPLE_COUNT; i++)
   {
-    vec2 vSamplePoint = aSamplePoints[i];
+    bool bBatch = i >= SAMPLE_COUNT;
+    vec2 vSamplePoint = bBatch ? aBatchSamplePoints[i - SAMPLE_COUNT] : aSamplePoints[i];
 
     float fAspectRatio = static_cast<float>(Buffer->iHeight) / Buffer->iWidth;
 
     // Remap to account for the point pixel radius, so that the points are not cut off at the edges of the screen.
-    int iScreenX = static_cast<int>((vSamplePoint.x + 1.f) * 0.5f * (Buffer->iWidth * fAspectRatio - 2 * iPointPixelHalfSize) + iPointPixelHalfSize);
-    int iScreenY = static_cast<int>((vSamplePoint.y + 1.f) * 0.5f * (Buffer->iHeight - 2 * iPointPixelHalfSize) + iPointPixelHalfSize);
+    // Batch results go in the right half of the screen
+    int iScreenX = static_cast<int>((vSamplePoint.x() + 1.f) * 0.5f * (Buffer->iWidth * fAspectRatio - 2 * iPointPixelHalfSize) + iPointPixelHalfSize);
+    int iScreenY = static_cast<int>((vSamplePoint.y() + 1.f) * 0.5f * (Buffer->iHeight - 2 * iPointPixelHalfSize) + iPointPixelHalfSize);
+    if (bBatch)
+    {
+      iScreenX += Buffer->iWidth / 2;
+    }
 
     int iMinX = std::max(iScreenX - iPointPixelHalfSize, _iStartX);
     int iMaxX = std::min(iScreenX + iPointPixelHalfSize, _iEndX);
@@ -50,9 +86,9 @@ void UpdateScreenBufferPartial(GameScreenBuffer* Buffer, int _iStartX, int _iSta
       uint8_t* pPixel = ((uint8_t*)pRow) + iMinX * g_uBytesPerPixel;
       for (int x = iMinX; x < iMaxX; x++)
       {
-        *pPixel++ = 255u; // Blue
-        *pPixel++ = 255u; // Green
-        *pPixel++ = 255u; // Red
+        *pPixel++ = bBatch ? 0u : 255u; // Blue
+        *pPixel++ = (bBatch && !g_bBatchMatchesScalar) ? 0u : 255u; // Green
+        *pPixel++ = (bBatch && g_bBatchMatchesScalar) ? 0u : 255u; // Red
         *pPixel++ = 0u;   // Alpha (unused)
       }
       pRow += uPitch;
@@ -60,6 +96,19 @@ void UpdateScreenBufferPartial(GameScreenBuffer* Buffer, int _iStartX, int _iSta
   }
 }
 
+bool ResolveScreenBuffer(GameScreenBuffer* /*Buffer*/)
+{
+  return true;
+}
+
+void UpdateGameBackBuffer(GameScreenBuffer* /*Buffer*/, const GameInput& /*GameInput*/)
+{
+}
+
+void ShutdownGame()
+{
+}
+
 void UpdateGameSoundBuffer(
   uint32_t& uCurrSampleIdx,
   void* pRegion1,
@@ -0,0 +1,117 @@
+// Compares the binary and the 4-wide BVH over random spheres: memory, closest hit throughput on the same rays, and
+// that both find the same hits. Also builds with a leaf size above what the wide nodes can hold.
+//   BVHBenchmark [<sphere count> [<ray count>]]
+
+#include "BVH.h"
+#include "Sampler.h"
+#include "WideBVH.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static vec3 RandomInBox(float _fHalfSize)
+{
+  return vec3(SampleRandom() * 2.f - 1.f, SampleRandom() * 2.f - 1.f, SampleRandom() * 2.f - 1.f) * _fHalfSize;
+}
+
+// Hits may only differ between hittables at the same distance
+static int CountMismatches(const BVH& _oBVH, const WideBVH& _oWideBVH, const std::vector<Hittable>& _vHittables, const std::vector<ray>& _vRays)
+{
+  int iMismatches = 0;
+  for (const ray& oRay : _vRays)
+  {
+    HitInfo oBinaryHit = {};
+    HitInfo oWideHit = {};
+    int iBinaryIdx = IntersectBVH(_oBVH, _vHittables, oRay, oBinaryHit);
+    int iWideIdx = IntersectWideBVH(_oWideBVH, _vHittables, oRay, oWideHit);
+    bool bSame = iBinaryIdx == iWideIdx || (iBinaryIdx >= 0 && iWideIdx >= 0 && oBinaryHit.fT == oWideHit.fT);
+    iMismatches += bSame ? 0 : 1;
+  }
+  return iMismatches;
+}
+
+template <typename F>
+static double TimeRays(const std::vector<ray>& _vRays, F&& _fnIntersect, int& iHits_)
+{
+  std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+  iHits_ = 0;
+  for (const ray& oRay : _vRays)
+  {
+    HitInfo oHitInfo = {};
+    iHits_ += _fnIntersect(oRay, oHitInfo) >= 0 ? 1 : 0;
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  int iSphereCount = _iArgCount > 1 ? atoi(_aArgs[1]) : 200000;
+  int iRayCount = _iArgCount > 2 ? atoi(_aArgs[2]) : 500000;
+  if (iSphereCount <= 0 || iRayCount <= 0)
+  {
+    fprintf(stderr, "Usage: BVHBenchmark [<sphere count> [<ray count>]]\n");
+    return 1;
+  }
+
+  t_uSamplerState = MixSamplerBits(27);
+  std::vector<Hittable> vHittables;
+  vHittables.reserve(iSphereCount);
+  for (int i = 0; i < iSphereCount; i++)
+  {
+    Hittable oHittable = {};
+    oHittable.eType = HittableType_Sphere;
+    oHittable.oSphere.vCenter = RandomInBox(50.f);
+    oHittable.oSphere.fRadius = 0.05f + 0.45f * SampleRandom();
+    vHittables.push_back(oHittable);
+  }
+
+  std::vector<ray> vRays(iRayCount);
+  for (ray& oRay : vRays)
+  {
+    oRay = ray(RandomInBox(50.f), Normalize(RandomInBox(1.f)));
+  }
+
+  BVH oBVH;
+  BVHBuildStats oStats = BuildBVH(vHittables, BVHBuildSettings{}, oBVH);
+  WideBVH oWideBVH;
+  BuildWideBVH(oBVH, oWideBVH);
+
+  size_t uBinaryBytes = oBVH.vNodes.size() * sizeof(BVHNode) + oBVH.vPrimIndices.size() * sizeof(uint32_t);
+  size_t uWideBytes = GetWideBVHMemoryUsage(oWideBVH);
+  printf("%d spheres: binary BVH %u nodes %.2f MB, wide BVH %zu nodes %.2f MB (%.2fx)\n", iSphereCount, oStats.uNodeCount,
+    uBinaryBytes / 1048576.0, oWideBVH.vNodes.size(), uWideBytes / 1048576.0, static_cast<double>(uWideBytes) / uBinaryBytes);
+
+  int iBinaryHits;
+  int iWideHits;
+  double dBinaryMs = TimeRays(vRays, [&](const ray& _oRay, HitInfo& oHitInfo_) { return IntersectBVH(oBVH, vHittables, _oRay, oHitInfo_); }, iBinaryHits);
+  double dWideMs = TimeRays(vRays, [&](const ray& _oRay, HitInfo& oHitInfo_) { return IntersectWideBVH(oWideBVH, vHittables, _oRay, oHitInfo_); }, iWideHits);
+  printf("%d rays: binary %.1f ms (%.2f Mrays/s), wide %.1f ms (%.2f Mrays/s), %.2fx, %d hits\n", iRayCount, dBinaryMs,
+    iRayCount / (dBinaryMs * 1000.0), dWideMs, iRayCount / (dWideMs * 1000.0), dBinaryMs / dWideMs, iWideHits);
+
+  int iMismatches = CountMismatches(oBVH, oWideBVH, vHittables, vRays);
+
+  // Leaves this large would overflow the 8 bit counts of the wide nodes unless the build clamps them
+  BVHBuildSettings oLargeLeaves;
+  oLargeLeaves.iMaxLeafSize = 1000;
+  oLargeLeaves.fTraversalCost = 10000.f;
+  BVH oLargeLeafBVH;
+  BuildBVH(vHittables, oLargeLeaves, oLargeLeafBVH);
+  WideBVH oLargeLeafWideBVH;
+  BuildWideBVH(oLargeLeafBVH, oLargeLeafWideBVH);
+  uint32_t uMaxLeafCount = 0;
+  for (const BVHNode& oNode : oLargeLeafBVH.vNodes)
+  {
+    uMaxLeafCount = oNode.uCount > uMaxLeafCount ? oNode.uCount : uMaxLeafCount;
+  }
+  int iLargeLeafMismatches = CountMismatches(oLargeLeafBVH, oLargeLeafWideBVH, vHittables, vRays);
+  printf("Leaf size 1000 built leaves of up to %u hittables\n", uMaxLeafCount);
+
+  if (iMismatches != 0 || iLargeLeafMismatches != 0 || iBinaryHits != iWideHits || uMaxLeafCount > static_cast<uint32_t>(iMAX_BVH_LEAF_SIZE))
+  {
+    printf("FAILED: %d and %d rays hit different hittables in the binary and wide BVH\n", iMismatches, iLargeLeafMismatches);
+    return 1;
+  }
+  return 0;
+}
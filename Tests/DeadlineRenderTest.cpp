@@ -0,0 +1,66 @@
+// Renders the demo scene against a deadline several times into the same buffers, from two cameras, and checks that
+// the frames end within the budget, that no pixel is more than one sample ahead of another and that every frame
+// starts from empty buffers rather than adding to the one before. The last frame has no safety margin, so its final
+// pass is cut by the deadline and may overrun it by a tile.
+//   DeadlineRenderTest [<budget in ms> [<thread count>]]
+
+#include "DeadlineRender.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static bool RenderFrame(const char* _sName, const Scene& _oScene, const Camera& _oCamera, const DeadlineSettings& _oSettings,
+  int _iBudgetMs, bool _bCheckDeadline, AccumulationBuffers& oAccum_)
+{
+  constexpr int iWIDTH = 96;
+  constexpr int iHEIGHT = 54;
+
+  RenderBuffers oBuffers;
+  std::vector<color> vResolved;
+  std::chrono::steady_clock::time_point oDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_iBudgetMs);
+  DeadlineReport oReport = RenderWithDeadline(_oScene, _oCamera, iWIDTH, iHEIGHT, _oSettings, oDeadline, oAccum_, oBuffers, vResolved);
+
+  // A cut pass adds one sample to a part of the screen, on top of the passes every pixel got
+  bool bEven = oReport.uMaxSamplesPerPixel - oReport.uMinSamplesPerPixel <= 1;
+  bool bFresh = oReport.uMinSamplesPerPixel == static_cast<uint32_t>(oReport.iCompletedPasses);
+  bool bOk = (!_bCheckDeadline || !oReport.bMissedDeadline) && bEven && bFresh && oReport.iCompletedPasses > 0;
+  printf("%-8s %6.1f of %d ms, %3d passes, %u to %u spp, %.1f ms resolve estimate%s%s%s\n", _sName, oReport.dTotalMs, _iBudgetMs,
+    oReport.iCompletedPasses, oReport.uMinSamplesPerPixel, oReport.uMaxSamplesPerPixel, oReport.dResolveEstimateMs,
+    oReport.bMissedDeadline ? ", MISSED the deadline" : "", bEven ? "" : ", UNEVEN samples", bFresh ? "" : ", NOT fresh");
+  return bOk;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  int iBudgetMs = _iArgCount > 1 ? atoi(_aArgs[1]) : 1000;
+  int iThreadCount = _iArgCount > 2 ? atoi(_aArgs[2]) : 0;
+  if (iBudgetMs <= 0 || iThreadCount < 0)
+  {
+    fprintf(stderr, "Usage: DeadlineRenderTest [<budget in ms> [<thread count>]]\n");
+    return 1;
+  }
+
+  Scene oScene;
+  BuildDemoScene(oScene);
+  BuildSceneBVH(BVHBuildSettings{}, oScene);
+  BuildSceneLights(oScene);
+
+  DeadlineSettings oSettings;
+  oSettings.iThreadCount = iThreadCount;
+  oSettings.oTileSettings.iTileSize = 8;
+
+  Camera oMoved;
+  oMoved.vPosition = vec3(1.f, 0.5f, 0.f);
+  oMoved.fYaw = 0.2f;
+
+  AccumulationBuffers oAccum;
+  bool bOk = RenderFrame("first", oScene, Camera{}, oSettings, iBudgetMs, true, oAccum);
+  bOk = RenderFrame("moved", oScene, oMoved, oSettings, iBudgetMs, true, oAccum) && bOk;
+  oSettings.bDenoise = false;
+  bOk = RenderFrame("raw", oScene, Camera{}, oSettings, iBudgetMs, true, oAccum) && bOk;
+  oSettings.fSafetyMargin = 0.f;
+  bOk = RenderFrame("cut", oScene, oMoved, oSettings, iBudgetMs, false, oAccum) && bOk;
+
+  return bOk ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Renders a scene, edits it, re-renders only the tiles InvalidateEditedTiles clears, and checks the result against a
+// full render of the edited scene bit for bit. Each edit starts again from a full render of the original scene.
+//   IncrementalRenderTest [<samples per pixel> [<thread count>]]
+
+#include "ProgressiveRender.h"
+#include "SceneFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const char* s_sBaseScene =
+  "plane 0 1 0 -1 lambertian 0.5 0.5 0.5\n"
+  "sphere 0 0 -5 1 lambertian 0.7 0.3 0.3\n"
+  "sphere 2 0 -5 1 metal 0.9 0.9 0.9 0.1\n"
+  "sphere -2 0 -5 1 dielectric 1 1 1 1.5\n"
+  "sphere 0 4 -4 0.5 emissive 1 1 1 10\n"
+  "sphere -3 1.5 -7 0.4 lambertian 0.2 0.6 0.2\n";
+
+struct SceneEdit
+{
+  const char* sName;
+  const char* sOld; // Line of s_sBaseScene replaced by sNew
+  const char* sNew;
+  bool bLightTraceCaustics;
+};
+
+static bool BuildScene(const std::string& _sText, Scene& oScene_)
+{
+  std::string sError;
+  if (!ParseScene(_sText.data(), _sText.size(), nullptr, nullptr, oScene_, sError))
+  {
+    fprintf(stderr, "%s\n", sError.c_str());
+    return false;
+  }
+  BuildSceneBVH(BVHBuildSettings{}, oScene_);
+  BuildSceneLights(oScene_);
+  return true;
+}
+
+static bool IsSameVec3Buffer(const PackedVec3Buffer& _oA, const PackedVec3Buffer& _oB)
+{
+  std::vector<vec3> vA, vB;
+  UnpackVec3Buffer(_oA, vA);
+  UnpackVec3Buffer(_oB, vB);
+  return vA.size() == vB.size() && memcmp(vA.data(), vB.data(), vA.size() * sizeof(vec3)) == 0;
+}
+
+// Every accumulated value and count, as stored
+static bool IsSameAccumulation(const AccumulationBuffers& _oA, const AccumulationBuffers& _oB)
+{
+  std::vector<float> vScratchA, vScratchB;
+  size_t uPixelCount = _oA.vSampleCount.size();
+  return uPixelCount == _oB.vSampleCount.size() && _oA.vSampleCount == _oB.vSampleCount && _oA.vHitCount == _oB.vHitCount
+    && IsSameVec3Buffer(_oA.oColor, _oB.oColor) && IsSameVec3Buffer(_oA.oAlbedo, _oB.oAlbedo) && IsSameVec3Buffer(_oA.oNormal, _oB.oNormal)
+    && memcmp(GetFloats(_oA.oDepth, vScratchA), GetFloats(_oB.oDepth, vScratchB), uPixelCount * sizeof(float)) == 0;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  constexpr int iWIDTH = 128;
+  constexpr int iHEIGHT = 72;
+
+  int iSamplesPerPixel = _iArgCount > 1 ? atoi(_aArgs[1]) : 4;
+  int iThreadCount = _iArgCount > 2 ? atoi(_aArgs[2]) : 0;
+  if (iSamplesPerPixel <= 0 || iThreadCount < 0)
+  {
+    fprintf(stderr, "Usage: IncrementalRenderTest [<samples per pixel> [<thread count>]]\n");
+    return 1;
+  }
+
+  const SceneEdit aEdits[] =
+  {
+    { "moved sphere", "sphere -3 1.5 -7 0.4", "sphere -2.5 1.5 -6 0.4", false },
+    { "material", "sphere 0 0 -5 1 lambertian 0.7 0.3 0.3", "sphere 0 0 -5 1 lambertian 0.3 0.3 0.7", false },
+    { "light power", "emissive 1 1 1 10", "emissive 1 1 1 12", false },
+    { "glass index with caustics", "dielectric 1 1 1 1.5", "dielectric 1 1 1 1.3", true },
+    { "moved metal with caustics", "sphere 2 0 -5 1 metal", "sphere 2 0.3 -5 1 metal", true },
+  };
+
+  Scene oBase;
+  if (!BuildScene(s_sBaseScene, oBase))
+    return 1;
+
+  Camera oCamera;
+  bool bOk = true;
+  for (const SceneEdit& oEdit : aEdits)
+  {
+    std::string sEdited = s_sBaseScene;
+    sEdited.replace(sEdited.find(oEdit.sOld), strlen(oEdit.sOld), oEdit.sNew);
+    Scene oEdited;
+    if (!BuildScene(sEdited, oEdited))
+      return 1;
+
+    ProgressiveSettings oSettings;
+    oSettings.iThreadCount = iThreadCount;
+    oSettings.iSamplesPerPixel = iSamplesPerPixel;
+    oSettings.bDenoise = false;
+    oSettings.oTileSettings.iTileSize = 8; // Small enough that the sky above the scene keeps some tiles
+    oSettings.bLightTraceCaustics = oEdit.bLightTraceCaustics;
+
+    AccumulationBuffers oIncremental, oFull;
+    TileDependencies oDependencies;
+    RenderBuffers oBuffers;
+    std::vector<color> vResolved;
+    ProgressiveReport oReport;
+    std::string sError;
+    if (!RenderProgressive(oBase, oCamera, iWIDTH, iHEIGHT, 0, oSettings, ProgressiveStart_Fresh, oIncremental, &oDependencies, oBuffers,
+      vResolved, oReport, sError))
+    {
+      fprintf(stderr, "%s\n", sError.c_str());
+      return 1;
+    }
+
+    size_t uInvalidTiles = InvalidateEditedTiles(oBase, oEdited, oCamera, oDependencies, oIncremental);
+    if (!RenderProgressive(oEdited, oCamera, iWIDTH, iHEIGHT, 0, oSettings, ProgressiveStart_Current, oIncremental, &oDependencies,
+      oBuffers, vResolved, oReport, sError)
+      || !RenderProgressive(oEdited, oCamera, iWIDTH, iHEIGHT, 0, oSettings, ProgressiveStart_Fresh, oFull, nullptr, oBuffers, vResolved,
+        oReport, sError))
+    {
+      fprintf(stderr, "%s\n", sError.c_str());
+      return 1;
+    }
+
+    bool bSame = IsSameAccumulation(oIncremental, oFull);
+    printf("%-28s %3zu of %3zu tiles re-rendered, %s\n", oEdit.sName, uInvalidTiles, oDependencies.vTiles.size(),
+      bSame ? "matches the full render" : "DIFFERS from the full render");
+    bOk = bOk && bSame;
+  }
+
+  return bOk ? 0 : 1;
+}
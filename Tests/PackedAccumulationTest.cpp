@@ -0,0 +1,96 @@
+// Renders the demo scene progressively with every packed buffer format and compares the resolved colors with a
+// Float32 render of the same samples. The packed error has to stay at the rounding of the resolved buffer whatever
+// the sample count, an error that grows with the samples means the running means drift.
+//   PackedAccumulationTest [<largest samples per pixel> [<thread count>]]
+
+#include "ProgressiveRender.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static bool RenderColors(const Scene& _oScene, int _iWidth, int _iHeight, int _iSamplesPerPixel, int _iThreadCount, BufferFormat _eFormat,
+  std::vector<vec3>& vColors_)
+{
+  ProgressiveSettings oSettings;
+  oSettings.iThreadCount = _iThreadCount;
+  oSettings.iSamplesPerPixel = _iSamplesPerPixel;
+  oSettings.bDenoise = false;
+  oSettings.eBufferFormat = _eFormat;
+
+  AccumulationBuffers oAccum;
+  RenderBuffers oBuffers;
+  std::vector<color> vResolved;
+  ProgressiveReport oReport;
+  std::string sError;
+  if (!RenderProgressive(_oScene, Camera{}, _iWidth, _iHeight, 0, oSettings, ProgressiveStart_Fresh, oAccum, nullptr, oBuffers, vResolved,
+    oReport, sError))
+  {
+    fprintf(stderr, "%s\n", sError.c_str());
+    return false;
+  }
+
+  UnpackVec3Buffer(oBuffers.oColor, vColors_);
+  return true;
+}
+
+// Root mean square of the per channel errors relative to the reference, dark channels count in absolute terms
+static double GetRelativeError(const std::vector<vec3>& _vColors, const std::vector<vec3>& _vReference)
+{
+  double dSum = 0.0;
+  for (size_t i = 0; i < _vColors.size(); i++)
+  {
+    for (int iChannel = 0; iChannel < 3; iChannel++)
+    {
+      double dReference = _vReference[i][iChannel];
+      double dError = (_vColors[i][iChannel] - dReference) / (fabs(dReference) > 0.01 ? fabs(dReference) : 0.01);
+      dSum += dError * dError;
+    }
+  }
+  return sqrt(dSum / (3.0 * static_cast<double>(_vColors.size())));
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  constexpr int iWIDTH = 64;
+  constexpr int iHEIGHT = 36;
+  constexpr int iFIRST_SAMPLES = 4;
+  constexpr double dMAX_GROWTH = 1.5; // A drifting mean grows 4x from 4 to 64 samples
+
+  int iMaxSamples = _iArgCount > 1 ? atoi(_aArgs[1]) : 64;
+  int iThreadCount = _iArgCount > 2 ? atoi(_aArgs[2]) : 0;
+  if (iMaxSamples < iFIRST_SAMPLES * 4 || iThreadCount < 0)
+  {
+    fprintf(stderr, "Usage: PackedAccumulationTest [<largest samples per pixel, at least 16> [<thread count>]]\n");
+    return 1;
+  }
+
+  Scene oScene;
+  BuildDemoScene(oScene);
+  BuildSceneBVH(BVHBuildSettings{}, oScene);
+  BuildSceneLights(oScene);
+
+  bool bOk = true;
+  for (int iFormat = BufferFormat_Float32 + 1; iFormat < BufferFormat_Count; iFormat++)
+  {
+    BufferFormat eFormat = static_cast<BufferFormat>(iFormat);
+    double dFirstError = 0.0;
+    for (int iSamples = iFIRST_SAMPLES; iSamples <= iMaxSamples; iSamples *= 4)
+    {
+      std::vector<vec3> vReference, vPacked;
+      if (!RenderColors(oScene, iWIDTH, iHEIGHT, iSamples, iThreadCount, BufferFormat_Float32, vReference)
+        || !RenderColors(oScene, iWIDTH, iHEIGHT, iSamples, iThreadCount, eFormat, vPacked))
+        return 1;
+
+      double dError = GetRelativeError(vPacked, vReference);
+      dFirstError = iSamples == iFIRST_SAMPLES ? dError : dFirstError;
+      bool bGrew = dError > dFirstError * dMAX_GROWTH;
+      printf("%-8s %4d spp  relative rms error %.2e%s\n", GetBufferFormatName(eFormat), iSamples, dError, bGrew ? "  GREW" : "");
+      bOk = bOk && !bGrew;
+    }
+  }
+
+  return bOk ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// Drives the progressive preview along a scripted camera path and records the input to photon latency of every
+// camera change: the time to the first coarse image and to the full resolution one. Every third change is replaced
+// by the next one a millisecond later, while its passes are still in flight, so cancellation is exercised too.
+//   PreviewLatencyTest [<step count> [<thread count>]]
+
+#include "Preview.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static double GetPercentile(std::vector<double> _vValues, double _dFraction)
+{
+  std::sort(_vValues.begin(), _vValues.end());
+  size_t uIdx = static_cast<size_t>(_dFraction * (_vValues.size() - 1) + 0.5);
+  return _vValues[uIdx];
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  constexpr int iWIDTH = 320;
+  constexpr int iHEIGHT = 180;
+  constexpr int iTIMEOUT_MS = 60000;
+
+  int iStepCount = _iArgCount > 1 ? atoi(_aArgs[1]) : 24;
+  int iThreadCount = _iArgCount > 2 ? atoi(_aArgs[2]) : 0;
+  if (iStepCount <= 0 || iThreadCount < 0)
+  {
+    fprintf(stderr, "Usage: PreviewLatencyTest [<step count> [<thread count>]]\n");
+    return 1;
+  }
+
+  Scene oScene;
+  BuildDemoScene(oScene);
+  BuildSceneBVH(BVHBuildSettings{}, oScene);
+  BuildSceneLights(oScene);
+
+  std::vector<uint8_t> vPixels(static_cast<size_t>(iWIDTH) * iHEIGHT * g_uBytesPerPixel);
+  GameScreenBuffer oTarget = { vPixels.data(), iWIDTH, iHEIGHT };
+  PreviewSettings oSettings;
+  oSettings.iThreadCount = iThreadCount;
+  PreviewRenderer oPreview;
+  StartPreview(oScene, oTarget, oSettings, oPreview);
+
+  // Walks forward while turning right and looking slightly up and down, like a user exploring the scene
+  Camera oCamera;
+  std::vector<double> vFirstImageMs;
+  std::vector<double> vFullImageMs;
+  uint32_t uExpectedGeneration = oPreview.uGeneration.load();
+  bool bOk = true;
+  for (int iStep = 0; iStep < iStepCount && bOk; iStep++)
+  {
+    MoveCamera(oCamera, vec3(0.02f, 0.f, -0.05f));
+    RotateCamera(oCamera, 0.03f, (iStep % 8 < 4) ? 0.01f : -0.01f);
+    SetPreviewCamera(oPreview, oCamera);
+    uExpectedGeneration++;
+
+    if (iStep % 3 == 2)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    bool bFirst = WaitForPreview(oPreview, oSettings.iCoarsestScale, iTIMEOUT_MS);
+    bool bFull = bFirst && WaitForPreview(oPreview, 1, iTIMEOUT_MS);
+    PreviewStats oStats = GetPreviewStats(oPreview);
+    if (!bFull || oStats.uGeneration != uExpectedGeneration || oStats.iCompletedScale != 1 || oStats.dFirstImageMs > oStats.dFullImageMs)
+    {
+      printf("FAILED at step %d: waited %d, generation %u of %u, completed scale %d, first %.2f ms, full %.2f ms\n", iStep, bFull,
+        oStats.uGeneration, uExpectedGeneration, oStats.iCompletedScale, oStats.dFirstImageMs, oStats.dFullImageMs);
+      bOk = false;
+      break;
+    }
+    vFirstImageMs.push_back(oStats.dFirstImageMs);
+    vFullImageMs.push_back(oStats.dFullImageMs);
+  }
+  StopPreview(oPreview);
+
+  if (!bOk || vFirstImageMs.empty())
+    return 1;
+
+  printf("%zu camera changes at %dx%d: first image median %.2f ms, p90 %.2f ms, max %.2f ms\n", vFirstImageMs.size(), iWIDTH, iHEIGHT,
+    GetPercentile(vFirstImageMs, 0.5), GetPercentile(vFirstImageMs, 0.9), GetPercentile(vFirstImageMs, 1.0));
+  printf("%zu camera changes at %dx%d: full image median %.2f ms, p90 %.2f ms, max %.2f ms\n", vFullImageMs.size(), iWIDTH, iHEIGHT,
+    GetPercentile(vFullImageMs, 0.5), GetPercentile(vFullImageMs, 0.9), GetPercentile(vFullImageMs, 1.0));
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Runs the batched disk and cosine hemisphere warps with every instruction set the CPU supports and checks them bit
+// for bit against the scalar polynomial warps, and within the polynomial sincos error against SampleDisk and
+// SampleHemisphereCosine. The batch counts include odd ones, so the scalar tail after the wide lanes is covered.
+//   SampleWarpTest
+
+#include "CpuDispatch.h"
+#include "MathUtils.h"
+#include "SampleWarp.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+struct WarpResult
+{
+  int iBitMismatches = 0;
+  float fMaxScalarError = 0.f; // Against the libm warps in MathUtils.h
+};
+
+static void CheckDiskBatch(const std::vector<float>& _vRandom1, const std::vector<float>& _vRandom2, int _iCount, WarpResult& oResult_)
+{
+  // One past the end stays untouched, a wide lane writing past _iCount shows up as a mismatch
+  std::vector<float> vX(_iCount + 1, -2.f), vY(_iCount + 1, -2.f);
+  SampleDiskBatch(_vRandom1.data(), _vRandom2.data(), _iCount, vX.data(), vY.data());
+  oResult_.iBitMismatches += vX[_iCount] != -2.f || vY[_iCount] != -2.f;
+
+  for (int i = 0; i < _iCount; i++)
+  {
+    vec2 vPolynomial = SampleDiskPolynomial(_vRandom1[i], _vRandom2[i]);
+    oResult_.iBitMismatches += vPolynomial.x() != vX[i] || vPolynomial.y() != vY[i];
+
+    vec2 vScalar = SampleDisk(_vRandom1[i], _vRandom2[i]);
+    oResult_.fMaxScalarError = fmaxf(oResult_.fMaxScalarError, fmaxf(fabsf(vScalar.x() - vX[i]), fabsf(vScalar.y() - vY[i])));
+  }
+}
+
+static void CheckHemisphereBatch(const std::vector<float>& _vRandom1, const std::vector<float>& _vRandom2, int _iCount, WarpResult& oResult_)
+{
+  std::vector<float> vX(_iCount + 1, -2.f), vY(_iCount + 1, -2.f), vZ(_iCount + 1, -2.f);
+  SampleHemisphereCosineBatch(_vRandom1.data(), _vRandom2.data(), _iCount, vX.data(), vY.data(), vZ.data());
+  oResult_.iBitMismatches += vX[_iCount] != -2.f || vY[_iCount] != -2.f || vZ[_iCount] != -2.f;
+
+  for (int i = 0; i < _iCount; i++)
+  {
+    vec3 vPolynomial = SampleHemisphereCosinePolynomial(_vRandom1[i], _vRandom2[i]);
+    oResult_.iBitMismatches += vPolynomial.x() != vX[i] || vPolynomial.y() != vY[i] || vPolynomial.z() != vZ[i];
+
+    // z is a square root of the disk radius, near the rim it amplifies the sincos error
+    vec3 vScalar = SampleHemisphereCosine(_vRandom1[i], _vRandom2[i]);
+    float fError = fmaxf(fabsf(vScalar.x() - vX[i]), fabsf(vScalar.y() - vY[i]));
+    oResult_.fMaxScalarError = fmaxf(oResult_.fMaxScalarError, fmaxf(fError, fabsf(vScalar.z() * vScalar.z() - vZ[i] * vZ[i])));
+  }
+}
+
+int main()
+{
+  constexpr int iRANDOM_COUNT = 4099;
+  constexpr float fMAX_SCALAR_ERROR = 1e-6f;
+
+  // Corners, centre, both diagonals and the axes first, where the octant selects and the zero major axis matter
+  std::vector<float> vRandom1 = { 0.f, 1.f, 0.5f, 0.f, 1.f, 0.25f, 0.75f, 0.5f, 0.5f, 0.9999999f, 0.f, 0.3f };
+  std::vector<float> vRandom2 = { 0.f, 1.f, 0.5f, 1.f, 0.f, 0.25f, 0.25f, 0.f, 1.f, 0.5f, 0.5f, 0.7f };
+  uint32_t uState = 12345u;
+  while (vRandom1.size() < iRANDOM_COUNT)
+  {
+    uState = uState * 1664525u + 1013904223u;
+    vRandom1.push_back(static_cast<float>(uState >> 8) * (1.f / 16777216.f));
+    uState = uState * 1664525u + 1013904223u;
+    vRandom2.push_back(static_cast<float>(uState >> 8) * (1.f / 16777216.f));
+  }
+
+  const int aCounts[] = { 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 63, iRANDOM_COUNT };
+
+  CpuIsa eDefaultIsa = g_eCpuIsa;
+  bool bOk = true;
+  for (int iIsa = 0; iIsa < CpuIsa_Count; iIsa++)
+  {
+    CpuIsa eIsa = static_cast<CpuIsa>(iIsa);
+    if (!SelectCpuIsa(eIsa))
+    {
+      printf("%-7s not supported by this CPU, skipped\n", GetCpuIsaName(eIsa));
+      continue;
+    }
+
+    WarpResult oDisk, oHemisphere;
+    for (int iCount : aCounts)
+    {
+      CheckDiskBatch(vRandom1, vRandom2, iCount, oDisk);
+      CheckHemisphereBatch(vRandom1, vRandom2, iCount, oHemisphere);
+    }
+
+    bool bIsaOk = oDisk.iBitMismatches == 0 && oHemisphere.iBitMismatches == 0 && oDisk.fMaxScalarError <= fMAX_SCALAR_ERROR
+      && oHemisphere.fMaxScalarError <= fMAX_SCALAR_ERROR;
+    printf("%-7s disk %d bit mismatches, %.1e from SampleDisk; hemisphere %d bit mismatches, %.1e from SampleHemisphereCosine%s\n",
+      GetCpuIsaName(eIsa), oDisk.iBitMismatches, oDisk.fMaxScalarError, oHemisphere.iBitMismatches, oHemisphere.fMaxScalarError,
+      bIsaOk ? "" : "  FAILED");
+    bOk = bOk && bIsaOk;
+  }
+  SelectCpuIsa(eDefaultIsa);
+
+  return bOk ? 0 : 1;
+}
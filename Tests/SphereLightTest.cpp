@@ -0,0 +1,72 @@
+// Samples sphere lights from near to tiny and far away, and checks the cone pdf against a double precision solid
+// angle, that SampleSphereLight and GetSphereLightPdf agree, and that the sampled directions hit the sphere.
+//   SphereLightTest
+
+#include "Lights.h"
+
+#include <math.h>
+#include <stdio.h>
+
+struct SphereLightCase
+{
+  const char* sName;
+  float fRadius;
+  float fDistance;
+};
+
+static bool CheckSphereLight(const SphereLightCase& _oCase)
+{
+  constexpr int iSAMPLES_PER_SIDE = 16;
+  constexpr double dTOLERANCE = 1e-3;
+
+  vec3 vPosition(0.5f, -0.25f, 1.f);
+  vec3 vAxis = Normalize(vec3(1.f, 2.f, -2.f));
+  Sphere oSphere = { vPosition + _oCase.fDistance * vAxis, _oCase.fRadius };
+
+  double dSinSqr = (static_cast<double>(_oCase.fRadius) * _oCase.fRadius) / (static_cast<double>(_oCase.fDistance) * _oCase.fDistance);
+  double dReferencePdf = 1.0 / (2.0 * 3.14159265358979323846 * (1.0 - sqrt(1.0 - dSinSqr)));
+  double dPdf = GetSphereLightPdf(oSphere, vPosition);
+  bool bOk = isfinite(dPdf) && fabs(dPdf - dReferencePdf) <= dTOLERANCE * dReferencePdf;
+
+  // Misses are measured as the closest approach of the ray to the center, relative to the radius
+  double dWorstMiss = 0.0;
+  int iSamePdf = 0;
+  for (int i = 0; i < iSAMPLES_PER_SIDE * iSAMPLES_PER_SIDE; i++)
+  {
+    float fRandom1 = ((i % iSAMPLES_PER_SIDE) + 0.5f) / iSAMPLES_PER_SIDE;
+    float fRandom2 = ((i / iSAMPLES_PER_SIDE) + 0.5f) / iSAMPLES_PER_SIDE;
+    vec3 vDir;
+    float fDistance = 0.f, fPdf = 0.f;
+    if (!SampleSphereLight(oSphere, vPosition, fRandom1, fRandom2, vDir, fDistance, fPdf))
+      return false;
+
+    iSamePdf += fPdf == static_cast<float>(dPdf);
+    vec3 vToCenter = oSphere.vCenter - vPosition;
+    double dPerp = (vToCenter - Dot(vToCenter, vDir) * vDir).Length();
+    dWorstMiss = fmax(dWorstMiss, dPerp / _oCase.fRadius);
+    bOk = bOk && isfinite(fDistance) && fDistance > 0.f && fDistance <= _oCase.fDistance;
+  }
+  bOk = bOk && iSamePdf == iSAMPLES_PER_SIDE * iSAMPLES_PER_SIDE && dWorstMiss <= 1.0 + dTOLERANCE;
+
+  printf("%-8s r/d %.0e  pdf %.4e, reference %.4e, %d same pdfs, worst ray at %.4f radii%s\n", _oCase.sName,
+    _oCase.fRadius / _oCase.fDistance, dPdf, dReferencePdf, iSamePdf, dWorstMiss, bOk ? "" : "  FAILED");
+  return bOk;
+}
+
+int main()
+{
+  const SphereLightCase aCases[] =
+  {
+    { "near", 1.f, 4.f },
+    { "small", 0.05f, 20.f },
+    { "tiny", 0.01f, 1000.f }, // 1 - cos of the cone is below the float spacing at 1
+    { "distant", 2.f, 2.0e5f },
+  };
+
+  bool bOk = true;
+  for (const SphereLightCase& oCase : aCases)
+  {
+    bOk = CheckSphereLight(oCase) && bOk;
+  }
+  return bOk ? 0 : 1;
+}
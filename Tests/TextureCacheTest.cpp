@@ -0,0 +1,129 @@
+// Streams more textured scenes through a scene cache than the texture cache has slots, as a long running daemon does,
+// and checks that every scene still loads, that evicted scenes free their texture slots and that a texture loaded
+// into a reused slot never shows the tiles of the one before. The scenes switch between a red and a blue texture
+// every second scene, so each reused slot changes color. Every texture has a path of its own.
+// Then rewrites the texture of a cached scene and checks that the scene is parsed again with the new texture, and
+// that a hash-only lookup followed by its upload counts a single miss.
+//   TextureCacheTest
+
+#include "SceneCache.h"
+#include "SceneFile.h"
+
+#include <filesystem>
+#include <stdio.h>
+#include <string>
+#include <system_error>
+#include <vector>
+
+static bool WriteSolidTexture(const std::filesystem::path& _oPath, uint8_t _uRed, uint8_t _uBlue)
+{
+  std::vector<uint8_t> vRGBA = { _uRed, 0, _uBlue, 255 };
+  std::string sError;
+  if (!WriteTiledTexture(_oPath.string().c_str(), 1, 1, vRGBA, sError))
+  {
+    fprintf(stderr, "%s: %s\n", _oPath.string().c_str(), sError.c_str());
+    return false;
+  }
+  return true;
+}
+
+static bool IsRed(const Scene& _oScene)
+{
+  color vTexel = SampleTexture(*_oScene.pTextures, static_cast<uint32_t>(_oScene.vMaterials[0].iAlbedoTexture), 0.5f, 0.5f, 0.f);
+  return vTexel.x() > 0.9f && vTexel.z() < 0.1f;
+}
+
+static bool CheckChangedTexture(const std::filesystem::path& _oRoot, SceneCache& oCache_)
+{
+  std::string sScene = "sphere 0 0 -5 1 lambertian 1 1 1 texture changed.ctex 1\n";
+  uint64_t uHash = HashSceneData(sScene.data(), sScene.size());
+  if (!WriteSolidTexture(_oRoot / "changed.ctex", 255, 0))
+    return false;
+
+  // Probe, upload and probe again, as a client does the first time
+  uint64_t uFirstHits = oCache_.uHits, uFirstMisses = oCache_.uMisses;
+  std::string sError;
+  bool bProbeMissed = !FindCachedScene(oCache_, uHash);
+  std::shared_ptr<const Scene> pRed = AcquireCachedScene(oCache_, uHash, sScene.data(), sScene.size(), sError);
+  bool bRed = pRed && IsRed(*pRed);
+  bool bCached = FindCachedScene(oCache_, uHash) == pRed;
+  bool bCounted = oCache_.uHits - uFirstHits == 1 && oCache_.uMisses - uFirstMisses == 1;
+
+  // A different size, so the change shows even where write times are coarse. Rewritten in place, so the tiles
+  // pRed has not loaded yet now read blue too.
+  std::vector<uint8_t> vBlue = { 0, 0, 255, 255, 0, 0, 255, 255 };
+  bool bWritten = WriteTiledTexture((_oRoot / "changed.ctex").string().c_str(), 2, 1, vBlue, sError);
+  bool bDropped = bWritten && !FindCachedScene(oCache_, uHash);
+  std::shared_ptr<const Scene> pBlue = AcquireCachedScene(oCache_, uHash, sScene.data(), sScene.size(), sError);
+
+  bool bOk = bProbeMissed && bRed && bCached && bCounted && bDropped && pBlue && pBlue != pRed && !IsRed(*pBlue);
+  printf("changed texture: probe %s, %s, %s, reloaded %s, %llu hits %llu misses%s\n", bProbeMissed ? "missed" : "HIT",
+    bCached ? "cached" : "NOT cached", bDropped ? "dropped once changed" : "NOT dropped", pBlue && !IsRed(*pBlue) ? "blue" : "WRONG",
+    static_cast<unsigned long long>(oCache_.uHits - uFirstHits), static_cast<unsigned long long>(oCache_.uMisses - uFirstMisses),
+    bOk ? "" : "  FAILED");
+  return bOk;
+}
+
+int main()
+{
+  constexpr uint32_t uSCENE_COUNT = g_uMaxTextureCount + 100;
+
+  std::error_code oError;
+  std::filesystem::path oRoot = std::filesystem::temp_directory_path(oError) / "TextureCacheTest";
+  std::filesystem::remove_all(oRoot, oError);
+  std::filesystem::create_directories(oRoot, oError);
+  if (oError || !WriteSolidTexture(oRoot / "red.ctex", 255, 0) || !WriteSolidTexture(oRoot / "blue.ctex", 0, 255))
+  {
+    fprintf(stderr, "Could not write the textures to %s\n", oRoot.string().c_str());
+    return 1;
+  }
+
+  SceneCache oCache;
+  oCache.uBudgetBytes = 1; // Every new scene evicts the one before
+  oCache.sAssetRoot = oRoot.string();
+  oCache.pTextures = std::make_shared<TextureCache>();
+  InitTextureCache(1024u * 1024u, *oCache.pTextures);
+
+  uint32_t uLoaded = 0, uWrongColors = 0;
+  for (uint32_t i = 0; i < uSCENE_COUNT; i++)
+  {
+    // Links keep the textures on disk to two files while every path stays distinct
+    bool bRed = ((i >> 1) & 1u) == 0;
+    std::string sName = "texture" + std::to_string(i) + ".ctex";
+    std::filesystem::create_hard_link(oRoot / (bRed ? "red.ctex" : "blue.ctex"), oRoot / sName, oError);
+    if (oError)
+    {
+      fprintf(stderr, "Could not link %s: %s\n", sName.c_str(), oError.message().c_str());
+      break;
+    }
+
+    std::string sScene = "sphere 0 0 -5 1 lambertian 1 1 1 texture " + sName + " 1\n";
+    std::string sError;
+    std::shared_ptr<const Scene> pScene = AcquireCachedScene(oCache, HashSceneData(sScene.data(), sScene.size()), sScene.data(),
+      sScene.size(), sError);
+    if (!pScene)
+    {
+      fprintf(stderr, "Scene %u: %s\n", i, sError.c_str());
+      break;
+    }
+    uLoaded++;
+
+    uint32_t uTexture = static_cast<uint32_t>(pScene->vMaterials[0].iAlbedoTexture);
+    color vTexel = SampleTexture(*pScene->pTextures, uTexture, 0.5f, 0.5f, 0.f);
+    bool bRight = bRed ? vTexel.x() > 0.9f && vTexel.z() < 0.1f : vTexel.x() < 0.1f && vTexel.z() > 0.9f;
+    uWrongColors += bRight ? 0u : 1u;
+  }
+
+  uint32_t uSlots = oCache.pTextures->uTextureCount.load();
+  bool bOk = uLoaded == uSCENE_COUNT && uWrongColors == 0 && uSlots <= 2;
+  printf("%u of %u textured scenes loaded, %u showed the wrong texture, %u texture slots used%s\n", uLoaded, uSCENE_COUNT, uWrongColors,
+    uSlots, bOk ? "" : "  FAILED");
+
+  oCache.uBudgetBytes = 256u * 1024u * 1024u;
+  bOk = CheckChangedTexture(oRoot, oCache) && bOk;
+
+  ClearSceneCache(oCache);
+  ReleaseTextureCache(*oCache.pTextures);
+  std::filesystem::remove_all(oRoot, oError);
+  return bOk ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Renders a field of random spheres with the tiles and their pixels visited in row-major, Morton and Hilbert order,
+// and prints the time, the traversal counters and the hardware cache counters of each. The orders have to give the
+// same image, only the cache behaviour may change. Hardware counters need Linux perf events, without them only the
+// software counters are printed.
+//   TileOrderBenchmark [<sphere count> [<width> <height> [<thread count>]]]
+
+#include "PerfCounters.h"
+#include "ProgressiveRender.h"
+#include "Sampler.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct OrderCase
+{
+  const char* sName;
+  TraversalOrder eOrder;
+};
+
+static void BuildSphereField(int _iSphereCount, Scene& oScene_)
+{
+  t_uSamplerState = MixSamplerBits(28);
+  for (int i = 0; i < _iSphereCount; i++)
+  {
+    Hittable oSphere = {};
+    oSphere.eType = HittableType_Sphere;
+    oSphere.oSphere.vCenter = vec3((SampleRandom() * 2.f - 1.f) * 60.f, SampleRandom() * 30.f - 1.f, -5.f - SampleRandom() * 100.f);
+    oSphere.oSphere.fRadius = 0.05f + 0.3f * SampleRandom();
+
+    Material oMaterial = {};
+    oMaterial.eType = MaterialType_Lambertian;
+    oMaterial.vAlbedo = vec3(SampleRandom(), SampleRandom(), SampleRandom());
+    AddHittable(std::move(oSphere), std::move(oMaterial), oScene_);
+  }
+
+  Hittable oGround = {};
+  oGround.eType = HittableType_Plane;
+  oGround.oPlane.vNormal = vec3(0.f, 1.f, 0.f);
+  oGround.oPlane.fPoint = -1.f;
+  Material oGroundMaterial = {};
+  oGroundMaterial.eType = MaterialType_Lambertian;
+  oGroundMaterial.vAlbedo = vec3(0.5f, 0.5f, 0.5f);
+  AddHittable(std::move(oGround), std::move(oGroundMaterial), oScene_);
+
+  BuildSceneBVH(BVHBuildSettings{}, oScene_);
+  BuildSceneLights(oScene_);
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  int iSphereCount = _iArgCount > 1 ? atoi(_aArgs[1]) : 500000;
+  int iWidth = _iArgCount > 3 ? atoi(_aArgs[2]) : 1920;
+  int iHeight = _iArgCount > 3 ? atoi(_aArgs[3]) : 1080;
+  int iThreadCount = _iArgCount > 4 ? atoi(_aArgs[4]) : 0;
+  if (iSphereCount <= 0 || iWidth <= 0 || iHeight <= 0 || iThreadCount < 0 || _iArgCount == 3)
+  {
+    fprintf(stderr, "Usage: TileOrderBenchmark [<sphere count> [<width> <height> [<thread count>]]]\n");
+    return 1;
+  }
+
+  Scene oScene;
+  BuildSphereField(iSphereCount, oScene);
+  Camera oCamera;
+  oCamera.vPosition = vec3(0.f, 2.f, 0.f);
+
+  const OrderCase aCases[] =
+  {
+    { "row-major", TraversalOrder_RowMajor },
+    { "Morton", TraversalOrder_Morton },
+    { "Hilbert", TraversalOrder_Hilbert },
+  };
+
+  ProgressiveSettings oSettings;
+  oSettings.iThreadCount = iThreadCount;
+  oSettings.iSamplesPerPixel = 1;
+  oSettings.bDenoise = false;
+
+  AccumulationBuffers oAccum;
+  RenderBuffers oBuffers;
+  std::vector<color> vResolved, vFirstResolved;
+  ProgressiveReport oReport;
+  std::string sError;
+
+  // Faults the scene and the buffers in before anything is measured
+  if (!RenderProgressive(oScene, oCamera, iWidth, iHeight, 0, oSettings, ProgressiveStart_Fresh, oAccum, nullptr, oBuffers, vResolved,
+    oReport, sError))
+  {
+    fprintf(stderr, "%s\n", sError.c_str());
+    return 1;
+  }
+
+  printf("%d spheres, %dx%d, 1 spp\n", iSphereCount, iWidth, iHeight);
+  bool bOk = true;
+  for (const OrderCase& oCase : aCases)
+  {
+    oSettings.oTileSettings.eTileOrder = oCase.eOrder;
+    oSettings.oTileSettings.ePixelOrder = oCase.eOrder;
+
+    ResetRenderCounters();
+    StartHardwareCounters();
+    std::chrono::steady_clock::time_point oStart = std::chrono::steady_clock::now();
+    bool bRendered = RenderProgressive(oScene, oCamera, iWidth, iHeight, 0, oSettings, ProgressiveStart_Fresh, oAccum, nullptr, oBuffers,
+      vResolved, oReport, sError);
+    double dMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - oStart).count();
+    HardwareCounters oHardware = StopHardwareCounters();
+    RenderCounters oCounters = GetRenderCounters();
+    if (!bRendered)
+    {
+      fprintf(stderr, "%s\n", sError.c_str());
+      return 1;
+    }
+
+    // The samples only depend on the pixel, not on when it is visited
+    if (vFirstResolved.empty())
+    {
+      vFirstResolved = vResolved;
+    }
+    bool bSame = vResolved.size() == vFirstResolved.size() && memcmp(vResolved.data(), vFirstResolved.data(), vResolved.size() * sizeof(color)) == 0;
+    bOk = bOk && bSame;
+
+    double dRays = oCounters.uRays > 0 ? static_cast<double>(oCounters.uRays) : 1.0;
+    printf("%-10s %8.1f ms  %6.2f nodes/ray", oCase.sName, dMs, oCounters.uNodeVisits / dRays);
+    if (oHardware.bAvailable)
+    {
+      printf("  L1D read misses %6.2f/ray  LLC references %6.3f/ray  LLC misses %6.3f/ray", oHardware.uL1DReadMisses / dRays,
+        oHardware.uLLCReferences / dRays, oHardware.uLLCMisses / dRays);
+    }
+    else
+    {
+      printf("  hardware counters not available");
+    }
+    printf("%s\n", bSame ? "" : "  DIFFERENT image");
+  }
+
+  return bOk ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+// Streams the tiles of render jobs to both kinds of consumer, a coroutine awaiting Next and a thread calling
+// WaitForNextTile, and checks that every tile comes exactly once and matches the finished image bit for bit. Streams
+// dropped between two tiles and while their consumer waits for a tile must leave the job to finish on its own.
+//   TileStreamTest [<thread count>]
+
+#include "TileStream.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Coroutine that starts right away and frees itself at the end
+struct DetachedTask
+{
+  struct promise_type
+  {
+    DetachedTask get_return_object()
+    {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept
+    {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept
+    {
+      return {};
+    }
+    void return_void()
+    {
+    }
+    void unhandled_exception()
+    {
+      std::terminate();
+    }
+  };
+};
+
+// Tiles received per tile index and the image they add up to
+struct ReceivedTiles
+{
+  std::vector<int> vCounts;
+  std::vector<color> vImage;
+  bool bBadSamples = false;
+};
+
+static void ReceiveTile(const RenderedTile& _oTile, const RenderSettings& _oSettings, ReceivedTiles& oReceived_)
+{
+  oReceived_.vCounts[_oTile.uTileIdx]++;
+  oReceived_.bBadSamples = oReceived_.bBadSamples || _oTile.uSamplesPerPixel != static_cast<uint32_t>(_oSettings.iSamplesPerPixel);
+
+  const ScreenTile& oRegion = _oTile.oRegion;
+  size_t uTileWidth = static_cast<size_t>(oRegion.iEndX - oRegion.iStartX);
+  for (int y = oRegion.iStartY; y < oRegion.iEndY; y++)
+  {
+    memcpy(&oReceived_.vImage[static_cast<size_t>(y) * _oSettings.iWidth + oRegion.iStartX], &_oTile.vColors[(y - oRegion.iStartY) * uTileWidth],
+      uTileWidth * sizeof(color));
+  }
+}
+
+static DetachedTask ConsumeTiles(TileStream& oStream_, RenderJob& oJob_, const RenderSettings& _oSettings, ReceivedTiles& oReceived_,
+  std::atomic<bool>& bDone_)
+{
+  while (const RenderedTile* pTile = co_await oStream_.Next())
+  {
+    ReceiveTile(*pTile, _oSettings, oReceived_);
+  }
+
+  // The consumer runs on a worker here, which has already finished its share of the job
+  WaitForRenderJob(oJob_);
+  bDone_ = true;
+  bDone_.notify_all();
+}
+
+// Waits in Next for a tile it never gets once its stream is dropped
+static DetachedTask AwaitOneTile(TileStream& oStream_, std::atomic<int>& iTiles_)
+{
+  if (co_await oStream_.Next())
+  {
+    iTiles_++;
+  }
+}
+
+static bool CheckTiles(const char* _sName, const RenderJob& _oJob, const ReceivedTiles& _oReceived)
+{
+  int iWrongCounts = 0;
+  for (int iCount : _oReceived.vCounts)
+  {
+    iWrongCounts += iCount != 1;
+  }
+  bool bSameImage = _oReceived.vImage.size() == _oJob.vResolved.size()
+    && memcmp(_oReceived.vImage.data(), _oJob.vResolved.data(), _oJob.vResolved.size() * sizeof(color)) == 0;
+
+  bool bOk = iWrongCounts == 0 && bSameImage && !_oReceived.bBadSamples;
+  printf("%-10s %3zu tiles, %d not received exactly once, %s%s\n", _sName, _oReceived.vCounts.size(), iWrongCounts,
+    bSameImage ? "same image" : "DIFFERENT image", _oReceived.bBadSamples ? ", wrong sample count" : "");
+  return bOk;
+}
+
+int main(int _iArgCount, char** _aArgs)
+{
+  int iThreadCount = _iArgCount > 1 ? atoi(_aArgs[1]) : 2;
+  if (iThreadCount <= 0)
+  {
+    fprintf(stderr, "Usage: TileStreamTest [<thread count>]\n");
+    return 1;
+  }
+
+  std::shared_ptr<Scene> pScene = std::make_shared<Scene>();
+  BuildDemoScene(*pScene);
+  BuildSceneBVH(BVHBuildSettings{}, *pScene);
+  BuildSceneLights(*pScene);
+
+  ThreadPool oPool;
+  StartThreadPool(iThreadCount, oPool);
+
+  RenderSettings oSettings;
+  oSettings.iWidth = 160;
+  oSettings.iHeight = 90;
+  oSettings.iSamplesPerPixel = 2;
+  oSettings.bDenoise = false; // The tiles are streamed before denoising
+  oSettings.oTileSettings.iTileSize = 16;
+  size_t uPixelCount = static_cast<size_t>(oSettings.iWidth) * oSettings.iHeight;
+
+  bool bOk = true;
+  {
+    RenderJob oJob;
+    TileStream oStream = StreamRenderJob(oPool, pScene, Camera{}, oSettings, oJob);
+    ReceivedTiles oReceived;
+    oReceived.vCounts.assign(oJob.vTiles.size(), 0);
+    oReceived.vImage.assign(uPixelCount, color(-1.f, -1.f, -1.f));
+    std::atomic<bool> bDone = false;
+    ConsumeTiles(oStream, oJob, oSettings, oReceived, bDone);
+    bDone.wait(false);
+    bOk = CheckTiles("co_await", oJob, oReceived) && bOk;
+  }
+
+  {
+    RenderJob oJob;
+    TileStream oStream = StreamRenderJob(oPool, pScene, Camera{}, oSettings, oJob);
+    ReceivedTiles oReceived;
+    oReceived.vCounts.assign(oJob.vTiles.size(), 0);
+    oReceived.vImage.assign(uPixelCount, color(-1.f, -1.f, -1.f));
+    while (const RenderedTile* pTile = WaitForNextTile(oStream))
+    {
+      ReceiveTile(*pTile, oSettings, oReceived);
+    }
+    bool bExtraTile = WaitForNextTile(oStream) != nullptr;
+    WaitForRenderJob(oJob);
+    bOk = CheckTiles("blocking", oJob, oReceived) && !bExtraTile && bOk;
+  }
+
+  {
+    RenderJob oJob;
+    TileStream oStream = StreamRenderJob(oPool, pScene, Camera{}, oSettings, oJob);
+    WaitForNextTile(oStream);
+    WaitForNextTile(oStream);
+    oStream = TileStream();
+    WaitForRenderJob(oJob);
+    printf("dropped between two tiles, job finished\n");
+  }
+
+  {
+    // Slow enough that the first tile is still tracing when the stream is dropped
+    RenderSettings oSlowSettings = oSettings;
+    oSlowSettings.iSamplesPerPixel = 64;
+    oSlowSettings.oTileSettings.iTileSize = 64;
+    RenderJob oJob;
+    std::atomic<int> iTiles = 0;
+    {
+      TileStream oStream = StreamRenderJob(oPool, pScene, Camera{}, oSlowSettings, oJob);
+      AwaitOneTile(oStream, iTiles);
+    }
+    WaitForRenderJob(oJob);
+    printf("dropped while waiting in Next, job finished, %d tiles received\n", iTiles.load());
+  }
+
+  StopThreadPool(oPool);
+  return bOk ? 0 : 1;
+}